@@ -0,0 +1,357 @@
+#include "voip_aec.h"
+
+#include <algorithm>
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#define VOIP_AEC_NEON 1
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#define VOIP_AEC_SSE2 1
+#endif
+
+namespace voip_aec {
+
+namespace {
+
+constexpr int32_t kMuQ15 = 16384;            // NLMS step 0.5
+constexpr int32_t kMaxStep = 16383;          // Per-sample step factor, Q15 (SSE2 doubles it)
+constexpr int32_t kFarActive = 256;          // Far peak below this (-42 dBFS): nothing to cancel
+constexpr int32_t kSuppressGainQ15 = 2068;   // -24 dB while only the far end talks
+constexpr uint32_t kOverBudgetFrames = 3;    // Consecutive frames over budget before falling back
+constexpr uint32_t kRetryFrames = 500;       // Suppressor frames (10 s at 20 ms) before retrying
+constexpr uint32_t kHangoverMs = 30;
+
+uint64_t now_ns() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000u + (uint64_t)ts.tv_nsec;
+}
+
+inline int16_t saturate16(int32_t v) {
+    return (int16_t)std::min<int32_t>(32767, std::max<int32_t>(-32768, v));
+}
+
+// n is a multiple of 8 throughout: taps are rounded up at construction
+
+#if VOIP_AEC_NEON
+// w[k] += round(x[k] * step / 2^15), saturating
+void adapt(int16_t *w, const int16_t *x, int16_t step, uint32_t n) {
+    const int16x8_t sv = vdupq_n_s16(step);
+    for (uint32_t k = 0; k < n; k += 8) {
+        vst1q_s16(w + k, vqaddq_s16(vld1q_s16(w + k), vqrdmulhq_s16(vld1q_s16(x + k), sv)));
+    }
+}
+#elif VOIP_AEC_SSE2
+// acc (two int64 lanes) += the four int32 lanes of p, sign-extended (no SSE4.1 needed)
+inline __m128i add_widened(__m128i acc, __m128i p) {
+    const __m128i sign = _mm_srai_epi32(p, 31);
+    acc = _mm_add_epi64(acc, _mm_unpacklo_epi32(p, sign));
+    return _mm_add_epi64(acc, _mm_unpackhi_epi32(p, sign));
+}
+
+// w[k] += round(x[k] * step / 2^15), saturating. SSE2 has no mulhrs: the rounding bit is the
+// top bit of the low half of x * 2 * step
+void adapt(int16_t *w, const int16_t *x, int16_t step, uint32_t n) {
+    const __m128i sv = _mm_set1_epi16((int16_t)(step * 2));
+    for (uint32_t k = 0; k < n; k += 8) {
+        const __m128i wv = _mm_loadu_si128((const __m128i *)(w + k));
+        const __m128i xv = _mm_loadu_si128((const __m128i *)(x + k));
+        const __m128i hi = _mm_mulhi_epi16(xv, sv);
+        const __m128i round = _mm_srli_epi16(_mm_mullo_epi16(xv, sv), 15);
+        _mm_storeu_si128((__m128i *)(w + k), _mm_adds_epi16(wv, _mm_add_epi16(hi, round)));
+    }
+}
+#else
+void adapt(int16_t *w, const int16_t *x, int16_t step, uint32_t n) {
+    for (uint32_t k = 0; k < n; ++k) w[k] = saturate16(w[k] + (((int32_t)x[k] * step + (1 << 14)) >> 15));
+}
+#endif
+
+}  // namespace
+
+#if VOIP_AEC_NEON
+// Each product fits an int32 lane; vpadalq widens pairs of them before adding
+int64_t dot(const int16_t *w, const int16_t *x, uint32_t n) {
+    int64x2_t acc = vdupq_n_s64(0);
+    for (uint32_t k = 0; k < n; k += 8) {
+        const int16x8_t wv = vld1q_s16(w + k);
+        const int16x8_t xv = vld1q_s16(x + k);
+        acc = vpadalq_s32(acc, vmull_s16(vget_low_s16(wv), vget_low_s16(xv)));
+        acc = vpadalq_s32(acc, vmull_s16(vget_high_s16(wv), vget_high_s16(xv)));
+    }
+    return vgetq_lane_s64(acc, 0) + vgetq_lane_s64(acc, 1);
+}
+#elif VOIP_AEC_SSE2
+// _mm_madd_epi16 would add pairs of products in 32 bits (-32768 * -32768 twice wraps): the
+// products are assembled from their low and high halves and widened one by one
+int64_t dot(const int16_t *w, const int16_t *x, uint32_t n) {
+    __m128i acc = _mm_setzero_si128();
+    for (uint32_t k = 0; k < n; k += 8) {
+        const __m128i wv = _mm_loadu_si128((const __m128i *)(w + k));
+        const __m128i xv = _mm_loadu_si128((const __m128i *)(x + k));
+        const __m128i lo = _mm_mullo_epi16(wv, xv);
+        const __m128i hi = _mm_mulhi_epi16(wv, xv);
+        acc = add_widened(acc, _mm_unpacklo_epi16(lo, hi));
+        acc = add_widened(acc, _mm_unpackhi_epi16(lo, hi));
+    }
+    int64_t lanes[2];
+    _mm_storeu_si128((__m128i *)lanes, acc);
+    return lanes[0] + lanes[1];
+}
+#else
+int64_t dot(const int16_t *w, const int16_t *x, uint32_t n) {
+    int64_t acc = 0;
+    for (uint32_t k = 0; k < n; ++k) acc += (int32_t)w[k] * x[k];
+    return acc;
+}
+#endif
+
+double erle_db(const Stats &stats) {
+    if (stats.echo_in_energy <= 0) return 0;
+    return 10.0 * log10(stats.echo_in_energy / std::max(stats.echo_out_energy, 1.0));
+}
+
+const char *simd_name() {
+#if VOIP_AEC_NEON
+    return "neon";
+#elif VOIP_AEC_SSE2
+    return "sse2";
+#else
+    return "scalar";
+#endif
+}
+
+EchoCanceller::EchoCanceller(const Config &config)
+    : spf_(std::max<uint32_t>(config.samples_per_frame, 1)),
+      taps_(std::max<uint32_t>((config.clock_rate / 1000 * config.tail_ms + 7) / 8 * 8, 8)),
+      budget_ns_((uint64_t)config.budget_us * 1000u),
+      weights_(taps_, 0),
+      history_(taps_ + spf_, 0),
+      block_max_((taps_ + spf_ - 1) / spf_ + 1, 0),
+      delta_((int64_t)taps_ * 32 * 32),
+      hangover_len_(config.clock_rate / 1000 * kHangoverMs) {}
+
+void EchoCanceller::process(int16_t *near, const int16_t *far) {
+    int16_t *frame = history_.data() + taps_;
+    if (far) {
+        memcpy(frame, far, spf_ * sizeof(int16_t));
+    } else {
+        memset(frame, 0, spf_ * sizeof(int16_t));
+    }
+    // Far peak over the tail, from per-frame peaks: the Geigel detector's reference
+    int32_t peak = 0;
+    for (uint32_t i = 0; i < spf_; ++i) peak = std::max<int32_t>(peak, abs((int32_t)frame[i]));
+    block_max_[block_pos_] = peak;
+    block_pos_ = (block_pos_ + 1) % block_max_.size();
+    const int32_t far_max = *std::max_element(block_max_.begin(), block_max_.end());
+
+    const uint64_t start = now_ns();
+    if (mode_ == MODE_CANCEL) {
+        cancel(near, far_max);
+    } else {
+        suppress(near, far_max);
+    }
+    memmove(history_.data(), history_.data() + spf_, taps_ * sizeof(int16_t));
+    if (mode_ == MODE_SUPPRESS) energy_ = dot(history_.data(), history_.data(), taps_);
+    const uint64_t ns = now_ns() - start;
+
+    ++stats_.frames;
+    stats_.last_frame_ns = (uint32_t)std::min<uint64_t>(ns, UINT32_MAX);
+    stats_.max_frame_ns = std::max(stats_.max_frame_ns, stats_.last_frame_ns);
+    if (mode_ == MODE_SUPPRESS) {
+        ++stats_.suppressed_frames;
+        if (--retry_frames_ == 0) {
+            mode_ = MODE_CANCEL;
+            over_budget_ = 0;
+        }
+        return;
+    }
+    if (ns <= budget_ns_) {
+        over_budget_ = 0;
+        return;
+    }
+    ++stats_.over_budget_frames;
+    // A single frame at twice the budget is enough: the device cannot keep up at all
+    if (++over_budget_ >= kOverBudgetFrames || ns > 2 * budget_ns_) {
+        mode_ = MODE_SUPPRESS;
+        retry_frames_ = kRetryFrames;
+        gain_q15_ = 32767;
+        ++stats_.fallbacks;
+    }
+}
+
+// Sample i is predicted from history_[i + 1 .. i + taps_], the newest far sample being the
+// current one; the window energy slides along with it
+void EchoCanceller::cancel(int16_t *near, int32_t far_max) {
+    int16_t *h = history_.data();
+    int16_t *w = weights_.data();
+    const bool far_active = far_max > kFarActive;
+    for (uint32_t i = 0; i < spf_; ++i) {
+        const int32_t x_new = h[taps_ + i];
+        const int32_t x_old = h[i];
+        energy_ += (int64_t)x_new * x_new - (int64_t)x_old * x_old;
+        const int16_t *x = h + i + 1;
+        const int32_t y = (int32_t)((dot(w, x, taps_) + (1 << 14)) >> 15);
+        const int32_t d = near[i];
+        const int32_t e = d - y;
+        // Geigel: a near end louder than half the far peak is the local talker, not echo
+        if (abs(d) * 2 > far_max) {
+            hangover_ = hangover_len_;
+        } else if (hangover_) {
+            --hangover_;
+        }
+        if (far_active && !hangover_) {
+            stats_.echo_in_energy += (double)d * d;
+            stats_.echo_out_energy += (double)e * e;
+            const int64_t step = ((int64_t)kMuQ15 * e * 32768) / (energy_ + delta_);
+            const int16_t s = (int16_t)std::min<int64_t>(kMaxStep, std::max<int64_t>(-kMaxStep, step));
+            if (s) adapt(w, x, s, taps_);
+        }
+        near[i] = saturate16(e);
+    }
+}
+
+// Fallback: attenuates the microphone while only the far end talks, ramping the gain so the
+// switch does not click
+void EchoCanceller::suppress(int16_t *near, int32_t far_max) {
+    const bool far_active = far_max > kFarActive;
+    for (uint32_t i = 0; i < spf_; ++i) {
+        const int32_t d = near[i];
+        if (abs(d) * 2 > far_max) {
+            hangover_ = hangover_len_;
+        } else if (hangover_) {
+            --hangover_;
+        }
+        const int32_t target = far_active && !hangover_ ? kSuppressGainQ15 : 32767;
+        gain_q15_ += (target - gain_q15_) / 32;
+        near[i] = saturate16((d * gain_q15_) >> 15);
+    }
+}
+
+FixtureResult run_fixture(const Config &config, const int16_t *far, const int16_t *near, size_t samples) {
+    FixtureResult result;
+    EchoCanceller aec(config);
+    result.taps = aec.taps();
+    const size_t spf = std::max<uint32_t>(config.samples_per_frame, 1);
+    std::vector<int16_t> frame(spf);
+    std::vector<uint32_t> times;
+    times.reserve(samples / spf);
+    for (size_t off = 0; off + spf <= samples; off += spf) {
+        std::copy(near + off, near + off + spf, frame.begin());
+        aec.process(frame.data(), far + off);
+        times.push_back(aec.stats().last_frame_ns);
+    }
+    result.stats = aec.stats();
+    if (times.empty()) return result;
+    uint64_t sum = 0;
+    for (uint32_t ns : times) sum += ns;
+    std::sort(times.begin(), times.end());
+    result.mean_frame_ns = (uint32_t)(sum / times.size());
+    result.p99_frame_ns = times[std::min(times.size() - 1, times.size() * 99 / 100)];
+    return result;
+}
+
+bool FixtureWriter::open(const std::string &far_path, const std::string &near_path, size_t max_samples) {
+    close();
+    far_ = fopen(far_path.c_str(), "wb");
+    near_ = fopen(near_path.c_str(), "wb");
+    max_samples_ = max_samples;
+    samples_ = 0;
+    if (far_ && near_) return true;
+    close();
+    return false;
+}
+
+bool FixtureWriter::write(const int16_t *near, const int16_t *far, size_t samples) {
+    if (!far_ || !near_) return false;
+    const size_t n = std::min(samples, max_samples_ - samples_);
+    bool ok = fwrite(near, sizeof(int16_t), n, near_) == n;
+    if (far) {
+        ok = ok && fwrite(far, sizeof(int16_t), n, far_) == n;
+    } else {
+        static const int16_t kSilence[512] = {};
+        for (size_t done = 0; ok && done < n; done += 512) {
+            const size_t chunk = std::min<size_t>(512, n - done);
+            ok = fwrite(kSilence, sizeof(int16_t), chunk, far_) == chunk;
+        }
+    }
+    samples_ += n;
+    return ok && samples_ < max_samples_;
+}
+
+void FixtureWriter::close() {
+    if (far_) fclose(far_);
+    if (near_) fclose(near_);
+    far_ = near_ = nullptr;
+}
+
+namespace {
+
+bool read_pcm16(const std::string &path, std::vector<int16_t> *samples) {
+    samples->clear();
+    FILE *f = fopen(path.c_str(), "rb");
+    if (!f) return false;
+    int16_t buf[1024];
+    size_t n;
+    while ((n = fread(buf, sizeof(int16_t), 1024, f)) > 0) samples->insert(samples->end(), buf, buf + n);
+    fclose(f);
+    return !samples->empty();
+}
+
+}  // namespace
+
+bool load_fixture(const std::string &far_path, const std::string &near_path, std::vector<int16_t> *far,
+                  std::vector<int16_t> *near) {
+    if (!read_pcm16(far_path, far) || !read_pcm16(near_path, near)) return false;
+    far->resize(std::min(far->size(), near->size()));
+    near->resize(far->size());
+    return true;
+}
+
+void synth_fixture(uint32_t clock_rate, uint32_t seconds, uint32_t delay_ms, std::vector<int16_t> *far,
+                   std::vector<int16_t> *near) {
+    const size_t samples = (size_t)clock_rate * seconds;
+    uint32_t seed = 0x5EED1234u;
+    auto noise = [&seed]() {
+        seed = seed * 1664525u + 1013904223u;
+        return (double)((int32_t)(seed >> 16) - 32768) / 32768.0;
+    };
+    // Speech-like: low-passed noise in ~3 syllables per second, a pause every 2 s
+    auto talker = [clock_rate](double lp, size_t i, double phase) {
+        const double t = (double)i / clock_rate + phase;
+        if (fmod(t, 2.0) > 1.5) return 0.0;
+        return lp * std::max(0.0, sin(2 * M_PI * 3 * t)) * 12000.0;
+    };
+
+    // Room: bulk delay, then 30 ms of exponentially decaying reflections, echo at about -9 dB
+    const size_t delay = (size_t)clock_rate * delay_ms / 1000;
+    std::vector<double> room((size_t)clock_rate * 30 / 1000);
+    double norm = 0;
+    for (size_t k = 0; k < room.size(); ++k) {
+        room[k] = noise() * exp(-(double)k / (room.size() / 4.0));
+        norm += room[k] * room[k];
+    }
+    for (double &r : room) r *= 0.35 / sqrt(norm);
+
+    double lp_far = 0, lp_near = 0;
+    far->assign(samples, 0);
+    near->assign(samples, 0);
+    for (size_t i = 0; i < samples; ++i) {
+        lp_far += (noise() - lp_far) * 0.25;
+        (*far)[i] = saturate16((int32_t)talker(lp_far, i, 0.0));
+    }
+    for (size_t i = 0; i < samples; ++i) {
+        double echo = 0;
+        for (size_t k = 0; k < room.size() && k + delay <= i; ++k) echo += room[k] * (*far)[i - delay - k];
+        lp_near += (noise() - lp_near) * 0.3;
+        const double local = i >= samples * 3 / 4 ? talker(lp_near, i, 0.37) * 0.8 : 0.0;
+        (*near)[i] = saturate16((int32_t)(echo + local + noise() * 16));
+    }
+}
+
+}  // namespace voip_aec
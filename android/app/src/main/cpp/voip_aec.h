@@ -0,0 +1,127 @@
+// Acoustic echo canceller for the capture path: a fixed-point (Q15) NLMS filter over the far-end
+// (played) signal with a configurable tail, vectorised with NEON on ARM and SSE2 on x86, and a
+// Geigel double-talk detector that freezes adaptation while the near end speaks. Every frame is
+// timed against a CPU budget; after a few frames over it the canceller falls back to a cheap
+// echo suppressor (attenuates the microphone while only the far end talks) and tries the filter
+// again later. FixtureWriter records a far/near fixture from the device's capture path, and
+// run_fixture() replays one through the canceller and reports cost and ERLE.
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string>
+#include <vector>
+
+namespace voip_aec {
+
+struct Config {
+    uint32_t clock_rate = 16000;
+    uint32_t samples_per_frame = 320;  // Mono, 16-bit
+    uint32_t tail_ms = 64;             // Longest echo path the filter models
+    uint32_t budget_us = 1000;         // CPU allowed per frame
+};
+
+enum Mode : uint8_t { MODE_CANCEL = 0, MODE_SUPPRESS = 1 };
+
+struct Stats {
+    uint64_t frames = 0;
+    uint64_t suppressed_frames = 0;  // Handled by the fallback suppressor
+    uint64_t over_budget_frames = 0;
+    uint64_t fallbacks = 0;
+    uint32_t last_frame_ns = 0;
+    uint32_t max_frame_ns = 0;
+    // Echo-only samples (far end active, no double talk): energy before and after the filter
+    double echo_in_energy = 0;
+    double echo_out_energy = 0;
+};
+
+// Echo return loss enhancement, in dB; 0 until some echo-only samples went through the filter
+double erle_db(const Stats &stats);
+
+// Vector path compiled in: "neon", "sse2" or "scalar"
+const char *simd_name();
+
+// sum w[k] * x[k], n a multiple of 8, with the vector path above. Products are widened to 64
+// bits before they are added: two full-scale products already overflow an int32.
+int64_t dot(const int16_t *w, const int16_t *x, uint32_t n);
+
+class EchoCanceller {
+public:
+    explicit EchoCanceller(const Config &config);
+
+    // near: one captured frame, replaced by the echo-cancelled one. far: the frame played at
+    // the same time (nullptr: silence). Not thread-safe: one capture thread.
+    void process(int16_t *near, const int16_t *far);
+
+    Mode mode() const { return mode_; }
+    uint32_t taps() const { return taps_; }
+    const Stats &stats() const { return stats_; }
+
+private:
+    void cancel(int16_t *near, int32_t far_max);
+    void suppress(int16_t *near, int32_t far_max);
+
+    uint32_t spf_;
+    uint32_t taps_;
+    uint64_t budget_ns_;
+    std::vector<int16_t> weights_;    // Q15, weights_[j] applies to history_[i + 1 + j]
+    std::vector<int16_t> history_;    // Last taps_ far samples, then the current frame
+    std::vector<int32_t> block_max_;  // Peak far amplitude of the frames covering the tail
+    size_t block_pos_ = 0;
+    int64_t energy_ = 0;              // Far energy over the filter window
+    int64_t delta_;                   // NLMS regularisation
+    uint32_t hangover_len_;           // Double talk hold time, samples
+    uint32_t hangover_ = 0;           // Samples left of double talk
+    int32_t gain_q15_ = 32767;        // Suppressor gain, ramped
+    Mode mode_ = MODE_CANCEL;
+    uint32_t over_budget_ = 0;        // Consecutive frames over budget
+    uint32_t retry_frames_ = 0;       // Suppressor frames left before the filter runs again
+    Stats stats_;
+};
+
+struct FixtureResult {
+    Stats stats;
+    uint32_t taps = 0;
+    uint32_t mean_frame_ns = 0;
+    uint32_t p99_frame_ns = 0;
+};
+
+// Replays a recording through a canceller: far is what was played, near what the microphone
+// captured meanwhile (same length, mono 16-bit at config.clock_rate)
+FixtureResult run_fixture(const Config &config, const int16_t *far, const int16_t *near, size_t samples);
+
+// Records a fixture: each captured frame as the microphone delivered it (near) and the frame
+// played at the same time (far, nullptr: silence), appended as raw mono 16-bit little-endian
+// PCM to two files, up to max_samples. One writing thread.
+class FixtureWriter {
+public:
+    FixtureWriter() = default;
+    ~FixtureWriter() { close(); }
+    FixtureWriter(const FixtureWriter &) = delete;
+    FixtureWriter &operator=(const FixtureWriter &) = delete;
+
+    bool open(const std::string &far_path, const std::string &near_path, size_t max_samples);
+    // false once max_samples are written or a write failed: the recording is over
+    bool write(const int16_t *near, const int16_t *far, size_t samples);
+    void close();
+    size_t samples() const { return samples_; }
+
+private:
+    FILE *far_ = nullptr;
+    FILE *near_ = nullptr;
+    size_t max_samples_ = 0;
+    size_t samples_ = 0;
+};
+
+// Reads a FixtureWriter recording (or any raw PCM pair like it), trimmed to the shorter file;
+// false when either file is missing or empty
+bool load_fixture(const std::string &far_path, const std::string &near_path, std::vector<int16_t> *far,
+                  std::vector<int16_t> *near);
+
+// Synthetic recording: a speech-like far end echoed through a decaying room response after
+// delay_ms of bulk delay, the near end also talking over the last quarter (double talk)
+void synth_fixture(uint32_t clock_rate, uint32_t seconds, uint32_t delay_ms, std::vector<int16_t> *far,
+                   std::vector<int16_t> *near);
+
+}  // namespace voip_aec
@@ -0,0 +1,55 @@
+/*
+ * Plain C surface of the engine core for Dart FFI (lib/voip/voip_native.dart).
+ *
+ * Commands are queued on the engine thread exactly like their JNI counterparts and return
+ * the request id (> 0), or -1 when they could not be queued. Telecom integration (audio
+ * routing, ConnectionService, notifications) stays in Kotlin, so there is no call control
+ * here: calls are placed, answered and hung up through the MethodChannel only. These entry
+ * points are for what does not need telecom (BLF, DTMF on an established call).
+ *
+ * Events: once a Dart port is attached, BLF presence events are written to a dedicated
+ * ring (same record layout as voip_events.h) instead of going through JNI and the
+ * EventChannel. The port receives an int64 doorbell (the write cursor) when the ring goes
+ * from empty to non-empty; cv_poll_events() then copies the pending records out.
+ */
+#ifndef VOIP_CAPI_H
+#define VOIP_CAPI_H
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define CV_EXPORT __attribute__((visibility("default")))
+
+#define CV_ABI_VERSION 2
+
+/* Dart_PostCObject as exposed by dart:ffi NativeApi.postCObject */
+typedef int8_t (*cv_post_cobject_fn)(int64_t port, void *message);
+
+CV_EXPORT int32_t cv_abi_version(void);
+CV_EXPORT int32_t cv_event_schema_version(void);
+
+/* Routes presence events to the Dart ring and rings port on new data. 0 on success. */
+CV_EXPORT int32_t cv_attach_events(cv_post_cobject_fn post_cobject, int64_t port);
+CV_EXPORT void cv_detach_events(void);
+
+/* Copies whole pending records into out; returns the number of bytes copied */
+CV_EXPORT int64_t cv_poll_events(uint8_t *out, int64_t capacity);
+
+CV_EXPORT int64_t cv_send_dtmf(int32_t call_id, const char *digits);
+
+/* One engine command subscribing every contact (prefix applied as in nativeSubscribePresence) */
+CV_EXPORT int64_t cv_subscribe_batch(const char *const *contacts, int32_t count, const char *prefix);
+CV_EXPORT int64_t cv_unsubscribe(const char *contact);
+
+/* RFC 4662 resource list: one SUBSCRIBE for the whole panel. list_uri is a full SIP URI or a
+ * user part on the account domain; contacts are subscribed one by one if the server refuses. */
+CV_EXPORT int64_t cv_subscribe_list(const char *list_uri, const char *const *contacts, int32_t count, const char *prefix);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* VOIP_CAPI_H */
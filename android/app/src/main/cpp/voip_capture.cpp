@@ -0,0 +1,444 @@
+#include "voip_capture.h"
+
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include <arpa/inet.h>
+#include <stdio.h>
+#include <string.h>
+#include <strings.h>
+#include <sys/time.h>
+#include <time.h>
+#include <unistd.h>
+
+#define VOIP_CAPTURE_MAX_MESSAGE 65000  // Larger messages are truncated (pcap keeps the original length)
+#define VOIP_CAPTURE_LINKTYPE_RAW 101   // pcap: raw IPv4/IPv6 packets, no link-layer header
+
+namespace voip_capture {
+
+namespace {
+
+struct RecordHeader {
+    uint64_t wall_us;
+    uint32_t len;       // Bytes stored after the header
+    uint32_t orig_len;  // Bytes on the wire
+    Address local;
+    Address remote;
+    uint8_t dir;
+    uint8_t transport;
+};
+
+size_t record_size(size_t payload) {
+    return (sizeof(RecordHeader) + payload + 7) & ~(size_t)7;
+}
+
+// One ring per recording thread, written by that thread only, so recording takes no lock and
+// writes nothing another thread writes. Records are laid out back to back in a byte ring (wrapping at
+// the end) and indexed by a slot ring; both cursors only grow. The writer publishes what it
+// is about to overwrite (reserved_*) before touching it, and the reader drops any record
+// copied out while it was being overwritten (a seqlock over the whole ring).
+struct ThreadRing {
+    explicit ThreadRing(size_t bytes)
+        : buf(new uint8_t[bytes]), capacity(bytes), slot_count(slots_for(bytes)), slots(new Slot[slots_for(bytes)]) {}
+    // SIP messages are rarely under 256 bytes: the bytes, not the slots, run out first
+    static size_t slots_for(size_t bytes) { return bytes / 256 ? bytes / 256 : 1; }
+
+    struct Slot {
+        std::atomic<uint64_t> pos{0};   // Byte cursor value where the record starts
+        std::atomic<uint32_t> size{0};  // record_size() of it
+    };
+
+    std::unique_ptr<uint8_t[]> buf;
+    const size_t capacity;  // Multiple of 8
+    const size_t slot_count;
+    std::unique_ptr<Slot[]> slots;
+    uint64_t bytes = 0;                         // Writer only: end of the last record
+    std::atomic<uint64_t> reserved_bytes{0};    // End of the record being written
+    std::atomic<uint64_t> reserved_records{0};  // Records written or being written
+    std::atomic<uint64_t> records{0};           // Records complete
+    bool owned = true;                          // g_mutex: a live thread writes it, else free to adopt
+};
+
+// A recording thread: its ring and whether it is inside record(). configure() bumps
+// g_generation, then waits for every busy thread before freeing the rings; a thread that
+// sees a new generation drops its ring and attaches another.
+struct ThreadState {
+    ThreadState();
+    ~ThreadState();
+    std::atomic<bool> busy{false};
+    ThreadRing *ring = nullptr;
+    uint64_t generation = 0;
+};
+
+std::mutex g_mutex;  // Ring and thread lists, capacity; record() only takes it to attach a ring
+std::vector<ThreadRing *> g_rings;
+std::vector<ThreadState *> g_threads;
+size_t g_capacity = VOIP_CAPTURE_DEFAULT_BYTES;
+std::atomic<uint64_t> g_generation{0};
+
+ThreadState::ThreadState() {
+    std::lock_guard<std::mutex> lock(g_mutex);
+    g_threads.push_back(this);
+}
+
+// The ring outlives its thread, for the export; the next new thread adopts it
+ThreadState::~ThreadState() {
+    std::lock_guard<std::mutex> lock(g_mutex);
+    if (ring && generation == g_generation.load()) ring->owned = false;
+    for (size_t i = 0; i < g_threads.size(); ++i) {
+        if (g_threads[i] == this) {
+            g_threads.erase(g_threads.begin() + i);
+            break;
+        }
+    }
+}
+
+thread_local ThreadState t_state;
+
+void copy_in(ThreadRing &ring, uint64_t pos, const void *data, size_t len) {
+    size_t at = (size_t)(pos % ring.capacity);
+    size_t first = len < ring.capacity - at ? len : ring.capacity - at;
+    memcpy(&ring.buf[at], data, first);
+    if (first < len) memcpy(&ring.buf[0], static_cast<const uint8_t *>(data) + first, len - first);
+}
+
+void copy_out(const ThreadRing &ring, uint64_t pos, void *out, size_t len) {
+    size_t at = (size_t)(pos % ring.capacity);
+    size_t first = len < ring.capacity - at ? len : ring.capacity - at;
+    memcpy(out, &ring.buf[at], first);
+    if (first < len) memcpy(static_cast<uint8_t *>(out) + first, &ring.buf[0], len - first);
+}
+
+// Caller holds g_mutex. Frees every ring once no thread is inside record().
+void drop_rings_locked() {
+    g_generation.fetch_add(1);
+    for (ThreadState *thread : g_threads) {
+        while (thread->busy.load()) std::this_thread::yield();
+    }
+    for (ThreadRing *ring : g_rings) delete ring;
+    g_rings.clear();
+}
+
+// First message of a thread (or first after configure()): takes a ring a dead thread left,
+// or adds one. False when capture is disabled.
+bool attach_ring(ThreadState &state) {
+    std::lock_guard<std::mutex> lock(g_mutex);
+    state.ring = nullptr;
+    state.generation = g_generation.load();
+    if (!g_capacity) return false;
+    for (ThreadRing *ring : g_rings) {
+        if (!ring->owned) {
+            ring->owned = true;
+            state.ring = ring;
+            return true;
+        }
+    }
+    g_rings.push_back(new ThreadRing(g_capacity));
+    state.ring = g_rings.back();
+    return true;
+}
+
+uint64_t wall_now_us() {
+    struct timeval tv;
+    gettimeofday(&tv, nullptr);
+    return (uint64_t)tv.tv_sec * 1000000u + (uint64_t)tv.tv_usec;
+}
+
+struct Snapshot {
+    std::vector<uint8_t> bytes;  // Records oldest first, same layout as the ring
+    uint64_t recorded = 0;
+    uint64_t overwritten = 0;
+};
+
+// Appends the ring's live records, oldest first, to out. Returns how many.
+uint64_t snapshot_ring(const ThreadRing &ring, std::vector<uint8_t> &out) {
+    const uint64_t end = ring.records.load(std::memory_order_acquire);
+    const uint64_t begin = end > ring.slot_count ? end - ring.slot_count : 0;
+    uint64_t live = 0;
+    for (uint64_t seq = begin; seq < end; ++seq) {
+        const ThreadRing::Slot &slot = ring.slots[seq % ring.slot_count];
+        const uint64_t pos = slot.pos.load(std::memory_order_relaxed);
+        const size_t size = slot.size.load(std::memory_order_relaxed);
+        // Both may already belong to a later record: checked below, after the copy
+        if (size < sizeof(RecordHeader) || size > ring.capacity) continue;
+        const size_t at = out.size();
+        out.resize(at + size);
+        copy_out(ring, pos, &out[at], size);
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (ring.reserved_records.load(std::memory_order_relaxed) > seq + ring.slot_count ||
+            ring.reserved_bytes.load(std::memory_order_relaxed) - pos > ring.capacity) {
+            out.resize(at);
+            continue;
+        }
+        live++;
+    }
+    return live;
+}
+
+// Live records of every thread, oldest first
+Snapshot take_snapshot() {
+    Snapshot snap;
+    std::vector<std::vector<uint8_t>> per_ring;
+    {
+        std::lock_guard<std::mutex> lock(g_mutex);
+        uint64_t live = 0;
+        for (const ThreadRing *ring : g_rings) {
+            snap.recorded += ring->records.load(std::memory_order_acquire);
+            per_ring.emplace_back();
+            live += snapshot_ring(*ring, per_ring.back());
+        }
+        snap.overwritten = snap.recorded >= live ? snap.recorded - live : 0;
+    }
+    // Merge by capture time; each ring is already in order
+    std::vector<size_t> cursor(per_ring.size(), 0);
+    for (;;) {
+        size_t best = per_ring.size();
+        uint64_t best_us = 0;
+        for (size_t r = 0; r < per_ring.size(); ++r) {
+            if (cursor[r] >= per_ring[r].size()) continue;
+            uint64_t wall_us = reinterpret_cast<const RecordHeader *>(&per_ring[r][cursor[r]])->wall_us;
+            if (best == per_ring.size() || wall_us < best_us) {
+                best = r;
+                best_us = wall_us;
+            }
+        }
+        if (best == per_ring.size()) break;
+        const uint8_t *rec = &per_ring[best][cursor[best]];
+        size_t size = record_size(reinterpret_cast<const RecordHeader *>(rec)->len);
+        snap.bytes.insert(snap.bytes.end(), rec, rec + size);
+        cursor[best] += size;
+    }
+    return snap;
+}
+
+template <typename Fn>
+void for_each_record(const Snapshot &snap, Fn fn) {
+    size_t pos = 0;
+    while (pos + sizeof(RecordHeader) <= snap.bytes.size()) {
+        RecordHeader hdr;
+        memcpy(&hdr, &snap.bytes[pos], sizeof(hdr));
+        fn(hdr, &snap.bytes[pos + sizeof(RecordHeader)]);
+        pos += record_size(hdr.len);
+    }
+}
+
+// Both exports write next to the target and rename, so a reader never sees half a file
+template <typename Fn>
+long write_atomically(const char *path, Fn body) {
+    std::string tmp_path = std::string(path) + ".tmp";
+    FILE *f = fopen(tmp_path.c_str(), "wb");
+    if (!f) return -1;
+    long written = body(f);
+    bool ok = !ferror(f) && fflush(f) == 0;
+    ok = (fclose(f) == 0) && ok;
+    if (!ok || rename(tmp_path.c_str(), path) != 0) {
+        unlink(tmp_path.c_str());
+        return -1;
+    }
+    return written;
+}
+
+uint16_t ipv4_checksum(const uint8_t *hdr, size_t len) {
+    uint32_t sum = 0;
+    for (size_t i = 0; i + 1 < len; i += 2) sum += (uint32_t)(hdr[i] << 8 | hdr[i + 1]);
+    while (sum >> 16) sum = (sum & 0xffff) + (sum >> 16);
+    return (uint16_t)~sum;
+}
+
+// IPv4-mapped form of a v4 address, for v6 packets whose other end is v4
+void address_as_v6(const Address &a, uint8_t out[16]) {
+    if (a.family == 6) {
+        memcpy(out, a.addr, 16);
+        return;
+    }
+    memset(out, 0, 16);
+    if (a.family == 4) {
+        out[10] = out[11] = 0xff;
+        memcpy(out + 12, a.addr, 4);
+    }
+}
+
+// Synthesised IP + UDP headers in front of the SIP payload. TCP/TLS messages are written as
+// UDP too: one SIP message per packet is what Wireshark's SIP dissector wants, and TLS
+// payloads are already in clear text here.
+size_t build_packet_headers(const RecordHeader &hdr, uint8_t *out) {
+    const Address &src = hdr.dir == DIR_TX ? hdr.local : hdr.remote;
+    const Address &dst = hdr.dir == DIR_TX ? hdr.remote : hdr.local;
+    size_t udp_len = 8 + hdr.orig_len;
+    size_t ip_len;
+    if (src.family == 6 || dst.family == 6) {
+        memset(out, 0, 40);
+        out[0] = 0x60;
+        out[4] = (uint8_t)(udp_len >> 8);
+        out[5] = (uint8_t)udp_len;
+        out[6] = 17;  // UDP
+        out[7] = 64;  // Hop limit
+        address_as_v6(src, out + 8);
+        address_as_v6(dst, out + 24);
+        ip_len = 40;
+    } else {
+        size_t total = 20 + udp_len;
+        if (total > 0xffff) total = 0xffff;
+        memset(out, 0, 20);
+        out[0] = 0x45;
+        out[2] = (uint8_t)(total >> 8);
+        out[3] = (uint8_t)total;
+        out[6] = 0x40;  // Don't fragment
+        out[8] = 64;    // TTL
+        out[9] = 17;    // UDP
+        if (src.family == 4) memcpy(out + 12, src.addr, 4);
+        if (dst.family == 4) memcpy(out + 16, dst.addr, 4);
+        uint16_t checksum = ipv4_checksum(out, 20);
+        out[10] = (uint8_t)(checksum >> 8);
+        out[11] = (uint8_t)checksum;
+        ip_len = 20;
+    }
+    uint8_t *udp = out + ip_len;
+    memcpy(udp, &src.port, 2);
+    memcpy(udp + 2, &dst.port, 2);
+    udp[4] = (uint8_t)(udp_len >> 8);
+    udp[5] = (uint8_t)udp_len;
+    udp[6] = udp[7] = 0;  // No checksum
+    return ip_len + 8;
+}
+
+void format_address(const Address &a, char *out, size_t size) {
+    char host[INET6_ADDRSTRLEN] = "?";
+    if (a.family == 4) inet_ntop(AF_INET, a.addr, host, sizeof(host));
+    if (a.family == 6) inet_ntop(AF_INET6, a.addr, host, sizeof(host));
+    snprintf(out, size, a.family == 6 ? "[%s]:%u" : "%s:%u", host, (unsigned)ntohs(a.port));
+}
+
+const char *transport_name(uint8_t transport) {
+    switch (transport) {
+        case TP_TCP: return "TCP";
+        case TP_TLS: return "TLS";
+        default:     return "UDP";
+    }
+}
+
+bool ends_with(const char *s, const char *suffix) {
+    size_t n = strlen(s), m = strlen(suffix);
+    return n >= m && strcasecmp(s + n - m, suffix) == 0;
+}
+
+}  // namespace
+
+void configure(size_t bytes) {
+    if (bytes && bytes < 4 * record_size(0)) bytes = 4 * record_size(0);
+    if (bytes > UINT32_MAX) bytes = UINT32_MAX;
+    std::lock_guard<std::mutex> lock(g_mutex);
+    drop_rings_locked();
+    g_capacity = bytes & ~(size_t)7;
+}
+
+size_t capacity() {
+    std::lock_guard<std::mutex> lock(g_mutex);
+    return g_capacity;
+}
+
+void record(Direction dir, Transport transport, const Address &local, const Address &remote,
+            const void *data, size_t len, uint64_t wall_us) {
+    ThreadState &state = t_state;
+    for (;;) {
+        state.busy.store(true);
+        if (state.ring && state.generation == g_generation.load()) break;
+        state.busy.store(false);
+        if (!attach_ring(state)) return;
+    }
+    ThreadRing *ring = state.ring;
+
+    RecordHeader hdr;
+    hdr.wall_us = wall_us ? wall_us : wall_now_us();
+    hdr.orig_len = (uint32_t)len;
+    hdr.local = local;
+    hdr.remote = remote;
+    hdr.dir = dir;
+    hdr.transport = transport;
+
+    // A single message never takes more than a quarter of the ring
+    size_t max_payload = ring->capacity / 4 - sizeof(RecordHeader);
+    if (max_payload > VOIP_CAPTURE_MAX_MESSAGE) max_payload = VOIP_CAPTURE_MAX_MESSAGE;
+    hdr.len = (uint32_t)(len < max_payload ? len : max_payload);
+    const size_t need = record_size(hdr.len);
+
+    const uint64_t pos = ring->bytes;
+    const uint64_t seq = ring->records.load(std::memory_order_relaxed);
+    ring->reserved_bytes.store(pos + need, std::memory_order_relaxed);
+    ring->reserved_records.store(seq + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    ThreadRing::Slot &slot = ring->slots[seq % ring->slot_count];
+    slot.pos.store(pos, std::memory_order_relaxed);
+    slot.size.store((uint32_t)need, std::memory_order_relaxed);
+    copy_in(*ring, pos, &hdr, sizeof(hdr));
+    copy_in(*ring, pos + sizeof(hdr), data, hdr.len);
+    ring->bytes = pos + need;
+    ring->records.store(seq + 1, std::memory_order_release);
+    state.busy.store(false, std::memory_order_release);
+}
+
+long export_pcap(const char *path) {
+    Snapshot snap = take_snapshot();
+    return write_atomically(path, [&](FILE *f) {
+        struct {
+            uint32_t magic;
+            uint16_t version_major, version_minor;
+            int32_t thiszone;
+            uint32_t sigfigs, snaplen, network;
+        } file_hdr = { 0xa1b2c3d4, 2, 4, 0, 0, 65535, VOIP_CAPTURE_LINKTYPE_RAW };
+        fwrite(&file_hdr, sizeof(file_hdr), 1, f);
+
+        long written = 0;
+        for_each_record(snap, [&](const RecordHeader &hdr, const uint8_t *payload) {
+            uint8_t headers[48];
+            size_t headers_len = build_packet_headers(hdr, headers);
+            struct {
+                uint32_t ts_sec, ts_usec, incl_len, orig_len;
+            } pkt_hdr = { (uint32_t)(hdr.wall_us / 1000000u), (uint32_t)(hdr.wall_us % 1000000u),
+                          (uint32_t)(headers_len + hdr.len), (uint32_t)(headers_len + hdr.orig_len) };
+            fwrite(&pkt_hdr, sizeof(pkt_hdr), 1, f);
+            fwrite(headers, 1, headers_len, f);
+            fwrite(payload, 1, hdr.len, f);
+            written++;
+        });
+        return written;
+    });
+}
+
+long export_text(const char *path) {
+    Snapshot snap = take_snapshot();
+    return write_atomically(path, [&](FILE *f) {
+        fprintf(f, "# SIP capture: %llu message(s) recorded, %llu overwritten\n",
+                (unsigned long long)snap.recorded, (unsigned long long)snap.overwritten);
+        long written = 0;
+        for_each_record(snap, [&](const RecordHeader &hdr, const uint8_t *payload) {
+            time_t secs = (time_t)(hdr.wall_us / 1000000u);
+            struct tm tm_utc;
+            gmtime_r(&secs, &tm_utc);
+            char when[32];
+            strftime(when, sizeof(when), "%Y-%m-%d %H:%M:%S", &tm_utc);
+            char local[64], remote[64];
+            format_address(hdr.local, local, sizeof(local));
+            format_address(hdr.remote, remote, sizeof(remote));
+            bool tx = hdr.dir == DIR_TX;
+            fprintf(f, "\n---- %s.%06uZ %s %s %s -> %s (%u", when, (unsigned)(hdr.wall_us % 1000000u),
+                    tx ? "TX" : "RX", transport_name(hdr.transport), tx ? local : remote, tx ? remote : local,
+                    hdr.orig_len);
+            if (hdr.len != hdr.orig_len) fprintf(f, ", truncated to %u", hdr.len);
+            fputs(" bytes)\n", f);
+            fwrite(payload, 1, hdr.len, f);
+            if (hdr.len == 0 || payload[hdr.len - 1] != '\n') fputc('\n', f);
+            written++;
+        });
+        return written;
+    });
+}
+
+long export_file(const char *path) {
+    return ends_with(path, ".pcap") ? export_pcap(path) : export_text(path);
+}
+
+}  // namespace voip_capture
@@ -0,0 +1,44 @@
+// SIP capture ring: raw rx/tx SIP messages with timestamps and addresses, kept in fixed-size
+// byte rings (oldest records are overwritten) and exported on demand as pcap or as a text dump.
+//
+// Each thread that sends or receives SIP (the SIP worker, the engine thread) records into its
+// own ring, so recording takes no lock: one header store plus one memcpy of the message,
+// nothing formatted until export. The export merges the rings by capture time and skips any
+// record overwritten while it was being copied out.
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifndef VOIP_CAPTURE_DEFAULT_BYTES
+#define VOIP_CAPTURE_DEFAULT_BYTES (1024 * 1024)  // Per thread, ~10 min of REGISTER/BLF traffic
+#endif
+
+namespace voip_capture {
+
+enum Direction : uint8_t { DIR_RX = 0, DIR_TX = 1 };
+enum Transport : uint8_t { TP_UDP = 0, TP_TCP = 1, TP_TLS = 2 };
+
+// family is 4, 6 or 0 (unknown); addr and port are in network byte order
+struct Address {
+    uint8_t family;
+    uint8_t addr[16];
+    uint16_t port;
+};
+
+// Resizes the rings (dropping their content); 0 disables capture and frees the buffers.
+// Waits for the threads still recording into the previous rings.
+void configure(size_t bytes);
+size_t capacity();
+
+// wall_us is the capture time in microseconds since the epoch, 0 for "now"
+void record(Direction dir, Transport transport, const Address &local, const Address &remote,
+            const void *data, size_t len, uint64_t wall_us = 0);
+
+// Write the ring (oldest first) to path; return the number of messages written, or -1.
+// export_file picks pcap for a ".pcap" path and the text dump otherwise.
+long export_pcap(const char *path);
+long export_text(const char *path);
+long export_file(const char *path);
+
+}  // namespace voip_capture
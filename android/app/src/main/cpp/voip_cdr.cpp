@@ -0,0 +1,163 @@
+#include "voip_cdr.h"
+
+#include <mutex>
+#include <string>
+#include <fcntl.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace voip_cdr {
+
+namespace {
+
+struct FileHeader {
+    uint32_t magic;
+    uint16_t version;
+    uint16_t record_size;
+    uint32_t capacity;
+    uint32_t reserved;
+    uint8_t pad[kHeaderSize - 16];
+};
+static_assert(sizeof(FileHeader) == kHeaderSize, "CDR header layout");
+
+std::mutex g_mutex;
+std::string g_path;
+uint8_t *g_map = nullptr;
+size_t g_map_size = 0;
+uint32_t g_capacity = 0;
+uint64_t g_next_seq = 1;
+
+uint32_t checksum(const Record &rec) {
+    Record copy = rec;
+    copy.checksum = 0;
+    const uint8_t *p = reinterpret_cast<const uint8_t *>(&copy);
+    uint32_t h = 2166136261u;
+    for (size_t i = 0; i < sizeof(copy); ++i) {
+        h = (h ^ p[i]) * 16777619u;
+    }
+    return h;
+}
+
+Record *slot(uint64_t seq) {
+    return reinterpret_cast<Record *>(g_map + kHeaderSize + ((seq - 1) % g_capacity) * kRecordSize);
+}
+
+// The slot holds the record with this sequence, completely written
+bool valid(const Record &rec, uint64_t seq) {
+    return rec.seq == seq && rec.checksum == checksum(rec);
+}
+
+void unmap_locked() {
+    if (g_map) munmap(g_map, g_map_size);
+    g_map = nullptr;
+    g_map_size = 0;
+    g_capacity = 0;
+    g_next_seq = 1;
+    g_path.clear();
+}
+
+// Highest valid sequence + 1. A slot's sequence must map back to that slot: anything else
+// is garbage from a foreign or torn write.
+uint64_t recover_next_seq() {
+    uint64_t max_seq = 0;
+    for (uint32_t i = 0; i < g_capacity; ++i) {
+        const Record *rec = reinterpret_cast<const Record *>(g_map + kHeaderSize + (size_t)i * kRecordSize);
+        if (rec->seq == 0 || (rec->seq - 1) % g_capacity != i) continue;
+        if (rec->seq > max_seq && valid(*rec, rec->seq)) max_seq = rec->seq;
+    }
+    return max_seq + 1;
+}
+
+void copy_string(char *dst, size_t size, const char *src) {
+    size_t len = src ? strnlen(src, size - 1) : 0;
+    memcpy(dst, src ? src : "", len);
+    memset(dst + len, 0, size - len);
+}
+
+}  // namespace
+
+bool open(const char *path, uint32_t capacity) {
+    if (!path || !*path || capacity == 0) return false;
+    std::lock_guard<std::mutex> lock(g_mutex);
+    if (g_map && g_path == path) return true;
+    unmap_locked();
+
+    int fd = ::open(path, O_RDWR | O_CREAT | O_CLOEXEC, 0600);
+    if (fd < 0) return false;
+    const size_t size = kHeaderSize + (size_t)capacity * kRecordSize;
+    struct stat st;
+    bool fresh = fstat(fd, &st) != 0 || (size_t)st.st_size != size;
+    if (!fresh) {
+        FileHeader header;
+        fresh = pread(fd, &header, sizeof(header), 0) != (ssize_t)sizeof(header) || header.magic != kMagic ||
+                header.version != kVersion || header.record_size != kRecordSize || header.capacity != capacity;
+    }
+    if (fresh) {
+        // Blocks are allocated now, so a full disk fails here rather than as SIGBUS on a store
+        // into the mapping during a call
+        if (ftruncate(fd, 0) != 0 || posix_fallocate(fd, 0, (off_t)size) != 0) {
+            ::close(fd);
+            return false;
+        }
+        FileHeader header = {};
+        header.magic = kMagic;
+        header.version = kVersion;
+        header.record_size = kRecordSize;
+        header.capacity = capacity;
+        if (pwrite(fd, &header, sizeof(header), 0) != (ssize_t)sizeof(header)) {
+            ::close(fd);
+            return false;
+        }
+    }
+    void *map = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    ::close(fd);
+    if (map == MAP_FAILED) return false;
+
+    g_map = static_cast<uint8_t *>(map);
+    g_map_size = size;
+    g_capacity = capacity;
+    g_path = path;
+    g_next_seq = recover_next_seq();
+    return true;
+}
+
+void close() {
+    std::lock_guard<std::mutex> lock(g_mutex);
+    unmap_locked();
+}
+
+bool is_open() {
+    std::lock_guard<std::mutex> lock(g_mutex);
+    return g_map != nullptr;
+}
+
+uint64_t append(const Record &rec) {
+    Record out = rec;
+    copy_string(out.number, sizeof(out.number), rec.number);
+    copy_string(out.display_name, sizeof(out.display_name), rec.display_name);
+    copy_string(out.reason, sizeof(out.reason), rec.reason);
+    memset(out.reserved, 0, sizeof(out.reserved));
+
+    std::lock_guard<std::mutex> lock(g_mutex);
+    if (!g_map) return 0;
+    out.seq = g_next_seq++;
+    out.checksum = checksum(out);
+    memcpy(slot(out.seq), &out, sizeof(out));
+    return out.seq;
+}
+
+size_t recent(Record *out, size_t max) {
+    std::lock_guard<std::mutex> lock(g_mutex);
+    if (!g_map || !out) return 0;
+    size_t n = 0;
+    const uint64_t oldest = g_next_seq > g_capacity ? g_next_seq - g_capacity : 1;
+    for (uint64_t seq = g_next_seq - 1; seq >= oldest && seq > 0 && n < max; --seq) {
+        const Record *rec = slot(seq);
+        if (valid(*rec, seq)) out[n++] = *rec;
+    }
+    return n;
+}
+
+}  // namespace voip_cdr
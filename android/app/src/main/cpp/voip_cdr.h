@@ -0,0 +1,60 @@
+// Call detail log: one fixed-layout record per finished call, appended to a memory-mapped
+// ring file in the app's private directory. Appending is a memcpy into the shared mapping
+// under a short mutex: no write(), no fsync on the call path; the kernel writes the pages
+// back on its own, so records survive the death of the process.
+//
+// File layout, all little-endian:
+//   header (kHeaderSize bytes)
+//     0  u32 magic (kMagic)         4  u16 version            6  u16 record size
+//     8  u32 capacity (records)     12 u32 reserved
+//   slots (capacity x kRecordSize); the record with sequence s lives in slot (s - 1) % capacity.
+//
+// There is no write cursor in the file: open() recovers the position from the highest
+// valid sequence. A record half-written when the process died fails its checksum and is
+// skipped; its slot is reused by the next append.
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifndef VOIP_CDR_DEFAULT_RECORDS
+#define VOIP_CDR_DEFAULT_RECORDS 512  // 128 KiB file
+#endif
+
+namespace voip_cdr {
+
+constexpr uint32_t kMagic = 0x52444356;  // "VCDR"
+constexpr uint16_t kVersion = 1;
+constexpr size_t kHeaderSize = 64;
+constexpr size_t kRecordSize = 256;
+
+// Strings are NUL-terminated and truncated to fit
+struct Record {
+    uint64_t seq;          // 1-based append number, 0 = empty slot (filled by append)
+    int64_t started_ms;    // Wall clock, ms since the epoch
+    int64_t setup_ms;      // INVITE -> answer, or -> end when never answered
+    int64_t talk_ms;       // 0 when never answered
+    int32_t call_id;
+    int32_t status;        // Final SIP status
+    uint8_t incoming;
+    uint8_t reserved[3];
+    uint32_t checksum;     // FNV-1a of the record with this field zeroed (filled by append)
+    char number[64];
+    char display_name[64];
+    char reason[80];
+};
+static_assert(sizeof(Record) == kRecordSize, "CDR record layout");
+
+// Maps path, creating it (or resetting it if the header does not match capacity and this
+// layout) and recovers the append position. Reopening the same path is a no-op.
+bool open(const char *path, uint32_t capacity = VOIP_CDR_DEFAULT_RECORDS);
+void close();
+bool is_open();
+
+// Copies rec into the next slot; returns its sequence, or 0 when the log is not open
+uint64_t append(const Record &rec);
+
+// Copies up to max valid records, newest first; returns how many were copied
+size_t recent(Record *out, size_t max);
+
+}  // namespace voip_cdr
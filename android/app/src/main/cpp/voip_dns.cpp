@@ -0,0 +1,98 @@
+#include "voip_dns.h"
+
+#include <stdio.h>
+
+namespace voip_dns {
+
+void Cache::store(const std::vector<Record> &answers) {
+    for (const Record &answer : answers) {
+        if (answer.type != kTypeSrv && answer.type != kTypeA) continue;
+        for (auto it = records_.begin(); it != records_.end();) {
+            if (it->type == answer.type && it->name == answer.name) {
+                it = records_.erase(it);
+            } else {
+                ++it;
+            }
+        }
+    }
+    for (const Record &answer : answers) {
+        if (records_.size() >= kMaxRecords) break;
+        if (answer.type == kTypeSrv || answer.type == kTypeA) records_.push_back(answer);
+    }
+}
+
+std::vector<std::string> Cache::srv_targets_without_a(const std::vector<Record> &answers) const {
+    std::vector<std::string> targets;
+    for (const Record &answer : answers) {
+        if (answer.type != kTypeSrv) continue;
+        bool has_a = false;
+        for (const Record &rec : records_) {
+            if (rec.type == kTypeA && rec.name == answer.target) {
+                has_a = true;
+                break;
+            }
+        }
+        if (!has_a) targets.push_back(answer.target);
+    }
+    return targets;
+}
+
+Groups Cache::unexpired(long now) const {
+    Groups groups;
+    for (const Record &rec : records_) {
+        if (rec.expires_at > now) groups[{rec.name, rec.type}].push_back(rec);
+    }
+    return groups;
+}
+
+bool Cache::save(const std::string &path, long now) const {
+    if (path.empty()) return false;
+    const std::string tmp_path = path + ".tmp";
+    FILE *f = fopen(tmp_path.c_str(), "w");
+    if (!f) return false;
+    for (const Record &rec : records_) {
+        if (rec.expires_at <= now) continue;
+        if (rec.type == kTypeSrv) {
+            fprintf(f, "SRV %s %u %u %u %s %ld\n", rec.name.c_str(), rec.prio, rec.weight, rec.port,
+                    rec.target.c_str(), rec.expires_at);
+        } else if (rec.type == kTypeA) {
+            fprintf(f, "A %s %u %ld\n", rec.name.c_str(), rec.ipv4, rec.expires_at);
+        }
+    }
+    const bool written = fclose(f) == 0;
+    return written && rename(tmp_path.c_str(), path.c_str()) == 0;
+}
+
+size_t Cache::load(const std::string &path, long now) {
+    records_.clear();
+    if (path.empty()) return 0;
+    FILE *f = fopen(path.c_str(), "r");
+    if (!f) return 0;
+    char line[512];
+    while (fgets(line, sizeof(line), f) && records_.size() < kMaxRecords) {
+        char name[256], target[256];
+        unsigned prio = 0, weight = 0, port = 0, ipv4 = 0;
+        long expires_at = 0;
+        Record rec;
+        if (sscanf(line, "SRV %255s %u %u %u %255s %ld", name, &prio, &weight, &port, target, &expires_at) == 6) {
+            rec.type = kTypeSrv;
+            rec.prio = (uint16_t)prio;
+            rec.weight = (uint16_t)weight;
+            rec.port = (uint16_t)port;
+            rec.target = target;
+        } else if (sscanf(line, "A %255s %u %ld", name, &ipv4, &expires_at) == 3) {
+            rec.type = kTypeA;
+            rec.ipv4 = ipv4;
+        } else {
+            continue;
+        }
+        if (expires_at <= now) continue;  // The original TTL holds across restarts
+        rec.name = name;
+        rec.expires_at = expires_at;
+        records_.push_back(rec);
+    }
+    fclose(f);
+    return records_.size();
+}
+
+}  // namespace voip_dns
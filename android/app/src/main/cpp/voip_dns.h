@@ -0,0 +1,65 @@
+// Persistent SRV/A cache behind the resolver prewarm (see "DNS resolver + persistent SRV/A
+// cache" in voip_engine.cpp): the SRV and A answers pjsip's resolver obtained, with their
+// absolute expiry, saved to a text file in the app's private directory so that a cold start
+// can hand the still-valid ones back to the resolver. Time is passed in (seconds since the
+// epoch) rather than read, so expiry is the caller's clock.
+//
+// File format, one record per line:
+//   SRV <name> <priority> <weight> <port> <target> <expires_at>
+//   A <name> <ipv4, network byte order as an unsigned> <expires_at>
+#pragma once
+
+#include <map>
+#include <stddef.h>
+#include <stdint.h>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace voip_dns {
+
+constexpr uint16_t kTypeA = 1;     // PJ_DNS_TYPE_A
+constexpr uint16_t kTypeSrv = 33;  // PJ_DNS_TYPE_SRV
+constexpr size_t kMaxRecords = 64;
+
+struct Record {
+    std::string name;        // Owner name (e.g. "_sip._udp.example.com" or "pbx1.example.com")
+    uint16_t type = 0;       // kTypeSrv or kTypeA
+    uint16_t prio = 0;       // SRV only
+    uint16_t weight = 0;     // SRV only
+    uint16_t port = 0;       // SRV only
+    std::string target;      // SRV only: target host name
+    uint32_t ipv4 = 0;       // A only: address in network byte order
+    long expires_at = 0;     // Wall-clock expiry (seconds since epoch)
+};
+
+typedef std::map<std::pair<std::string, uint16_t>, std::vector<Record>> Groups;  // (name, type) → records
+
+// Not thread-safe: the engine guards it with its DNS mutex
+class Cache {
+public:
+    // Every (name, type) present in answers is replaced by the answers for it; other records
+    // stay. SRV and A records only, kMaxRecords at most.
+    void store(const std::vector<Record> &answers);
+
+    // Targets of the SRV records in answers that have no A record in the cache
+    std::vector<std::string> srv_targets_without_a(const std::vector<Record> &answers) const;
+
+    // Records still valid at now, grouped per (name, type) as the resolver takes them
+    Groups unexpired(long now) const;
+
+    // Writes the records still valid at now to path (through path.tmp and rename(), so a
+    // crash never leaves a truncated file); false when it cannot be written
+    bool save(const std::string &path, long now) const;
+
+    // Replaces the content by the records of path still valid at now; returns how many
+    size_t load(const std::string &path, long now);
+
+    const std::vector<Record> &records() const { return records_; }
+    void clear() { records_.clear(); }
+
+private:
+    std::vector<Record> records_;
+};
+
+}  // namespace voip_dns
@@ -1,9 +1,27 @@
 #include <jni.h>
 #include <android/log.h>
+#include <atomic>
 #include <mutex>
 #include <string>
 #include <map>
+#include <set>
+#include <vector>
+#include <deque>
+#include <functional>
+#include <future>
+#include <condition_variable>
+#include <thread>
+#include <chrono>
+#include <system_error>
+#include <memory>
+#include <algorithm>
 #include <ctype.h>
+#include <strings.h>
+#include <stdio.h>
+#include <dirent.h>
+#include <dlfcn.h>
+#include <link.h>
+#include <sys/stat.h>
 
 #include <pjlib.h>
 #include <pjsip.h>
@@ -12,32 +30,211 @@
 #include <pjmedia/audiodev.h>
 #include <pjmedia/sdp.h>
 
+#include "voip_aec.h"
+#include "voip_capi.h"
+#include "voip_capture.h"
+#include "voip_cdr.h"
+#include "voip_dns.h"
+#include "voip_events.h"
+#include "voip_rls.h"
+#include "voip_sched.h"
+#if defined(VOIP_PGO_GENERATE)
+#include "voip_pgo.h"
+#endif
+#include "voip_srtp.h"  // Header only without VOIP_SRTP: suite names and the default budget
+#include "voip_trace.h"
+
 #define LOG_TAG "PjsipNative"
 #define LOGI(...) __android_log_print(ANDROID_LOG_INFO, LOG_TAG, __VA_ARGS__)
 #define LOGW(...) __android_log_print(ANDROID_LOG_WARN, LOG_TAG, __VA_ARGS__)
 #define LOGE(...) __android_log_print(ANDROID_LOG_ERROR, LOG_TAG, __VA_ARGS__)
 
+// ---------------------------------------------------------------------------
+// Locking model. State is split into independent domains, each with its own mutex:
+//   endpoint  - pjsua_create/init/start (the sound device belongs to the engine thread)
+//   accounts  - g_accounts and the account pools
+//   presence  - buddy maps (BLF subscriptions, last dialog states)
+//   calls     - outgoing call destination buffer, call records
+// Lock order when two are needed: endpoint -> accounts -> presence. The calls domain is
+// never nested. No JNI call (emit_event, NewStringUTF...) and no PJSUA call that can
+// re-enter our callbacks (account, buddy and call operations) or block on a device is made
+// while holding one of them: commands copy what they need under the lock, release it, make
+// the call, then lock again to record the result. This holds because the account table and
+// the sound device are only changed by commands, which the engine thread runs one at a
+// time. The active account is read-mostly and published as an immutable snapshot, so
+// callbacks never lock for it. Every acquisition is counted; contended ones record their
+// wait time (nativeGetLockStats). Each thread counts the domain locks it holds, and
+// pjsua_unlocked_check() flags a PJSUA call made under one (locks.held_across_pjsua,
+// asserted to stay 0 by the soak run).
+// ---------------------------------------------------------------------------
+struct DomainMutex {
+    explicit DomainMutex(const char *n) : name(n) {}
+    const char *name;
+    std::mutex mutex;
+    std::atomic<uint64_t> acquisitions{0};
+    std::atomic<uint64_t> contended{0};
+    std::atomic<uint64_t> wait_total_ns{0};
+    std::atomic<uint64_t> wait_max_ns{0};
+};
+
+#define LOCK_WAIT_WARN_NS (5 * 1000 * 1000)  // Log waits longer than 5 ms
+
+static thread_local unsigned t_domain_locks_held = 0;
+
+class DomainLock {
+public:
+    explicit DomainLock(DomainMutex &m) : m_(m) {
+        m_.acquisitions.fetch_add(1, std::memory_order_relaxed);
+        t_domain_locks_held++;
+        if (m_.mutex.try_lock()) return;
+        auto start = std::chrono::steady_clock::now();
+        m_.mutex.lock();
+        uint64_t waited = std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now() - start).count();
+        m_.contended.fetch_add(1, std::memory_order_relaxed);
+        m_.wait_total_ns.fetch_add(waited, std::memory_order_relaxed);
+        uint64_t prev = m_.wait_max_ns.load(std::memory_order_relaxed);
+        while (waited > prev && !m_.wait_max_ns.compare_exchange_weak(prev, waited, std::memory_order_relaxed)) {
+        }
+        VOIP_TRACE_COMPLETE("lock", "lock_wait", VOIP_TRACE_NOW_US() - waited / 1000, waited / 1000, m_.name);
+        if (waited > LOCK_WAIT_WARN_NS) {
+            LOGW(">>> LOCK: waited %.1f ms for %s lock", waited / 1e6, m_.name);
+        }
+    }
+    ~DomainLock() {
+        t_domain_locks_held--;
+        m_.mutex.unlock();
+    }
+    DomainLock(const DomainLock &) = delete;
+    DomainLock &operator=(const DomainLock &) = delete;
+
+private:
+    DomainMutex &m_;
+};
+
+static DomainMutex g_endpoint_lock("endpoint");
+static DomainMutex g_accounts_lock("accounts");
+static DomainMutex g_presence_lock("presence");
+static DomainMutex g_calls_lock("calls");
+
 static JavaVM *g_vm = nullptr;
 static jclass g_engineClass = nullptr;
-static std::mutex g_mutex;
-static bool g_initialized = false;
-static pjsua_acc_id g_acc_id = PJSUA_INVALID_ID;
-static bool g_audio_ready = false;
-static std::string g_account_domain = "";  // Domaine du compte SIP pour construire les URI de buddy
-static std::string g_account_username = "";  // Username du compte SIP (pour auth Digest des SUBSCRIBE)
-static std::string g_account_password = "";  // Password du compte SIP (pour auth Digest des SUBSCRIBE)
-// Buffers statiques pour les credentials globaux (pour éviter que les pj_str_t pointent vers des buffers temporaires)
-static char g_global_cred_realm_asterisk[32] = "asterisk";
-static char g_global_cred_realm_wildcard[8] = "*";
-static char g_global_cred_username[128] = "";
-static char g_global_cred_password[128] = "";
-static char g_global_proxy_with_transport[256] = "";  // Proxy URI with ;transport=udp suffix
-static char g_global_acc_id[128] = "";                // Account ID URI: sip:user@domain;transport=udp
-static char g_global_acc_reg_uri[128] = "";           // Registration URI: sip:domain;transport=udp
-static char g_global_call_dest_uri[256] = "";         // Current call destination URI (persists for auth retry)
-static std::map<std::string, pjsua_buddy_id> g_buddy_subscriptions;  // Tracker des subscriptions de présence
+static std::atomic<bool> g_initialized{false};
+static std::atomic<bool> g_audio_ready{false};
+static char g_global_call_dest_uri[256] = "";         // Current call destination URI (persists for auth retry), calls domain
+
+// Account table: one entry per SIP identity (user@domain). Several accounts can be
+// registered at the same time; switching the active account does not delete the others.
+// Every string referenced by an account's pjsua_acc_config lives in that account's pool,
+// released only when the account itself is removed.
+struct AccountEntry {
+    pjsua_acc_id acc_id = PJSUA_INVALID_ID;
+    pj_pool_t *pool = nullptr;
+    std::string key;        // "user@domain"
+    std::string username;
+    std::string domain;
+    pj_str_t password = {nullptr, 0};  // Pool-owned, never logged
+};
+static std::map<pjsua_acc_id, AccountEntry> g_accounts;  // accounts domain
+
+// Account used for outgoing calls and new BLF subscriptions. Replaced as a whole (atomic
+// shared_ptr store) and read without locking, including from PJSIP callbacks.
+struct ActiveAccount {
+    pjsua_acc_id acc_id = PJSUA_INVALID_ID;
+    std::string key;
+    std::string domain;
+};
+static std::shared_ptr<const ActiveAccount> g_active_account = std::make_shared<const ActiveAccount>();
+
+static std::shared_ptr<const ActiveAccount> active_account_snapshot() {
+    return std::atomic_load(&g_active_account);
+}
+
+// Presence domain
+static std::map<pjsua_acc_id, std::map<std::string, pjsua_buddy_id>> g_account_buddies;  // BLF subscriptions per account: contact (with prefix) → buddy
 static std::map<pjsua_buddy_id, std::string> g_buddy_reverse_map;  // Reverse map: buddy_id → contact (pour lookup rapide)
+static std::map<pjsua_buddy_id, pjsua_acc_id> g_buddy_account_map;  // buddy_id → owning account
 static std::map<pjsua_buddy_id, std::string> g_buddy_last_dialog_state;  // Track last dialog state for each buddy
+
+// Where a cached presence state came from, most to least specific
+enum PresenceSource : uint8_t {
+    PRESENCE_SRC_SUBSCRIPTION = 0,  // Subscription not active: offline from sub_state alone
+    PRESENCE_SRC_BASIC = 1,         // Active, pjsua online/offline status
+    PRESENCE_SRC_STATUS_TEXT = 2,   // Active, keyword found in the status text
+    PRESENCE_SRC_NOTIFY_BODY = 3,   // dialog-info+xml state from the NOTIFY body
+};
+
+// Lamp states published to the app (names match BLFStateManager on the Dart side)
+enum BlfState : uint8_t {
+    BLF_UNKNOWN = 0,  // Nothing published yet / no information in this update
+    BLF_OFFLINE,
+    BLF_AVAILABLE,
+    BLF_RINGING,
+    BLF_BUSY,
+    BLF_AWAY,
+    BLF_DND,
+};
+static const char *const kBlfStateNames[] = {"unknown", "offline", "available", "ringing", "busy", "away", "dnd"};
+
+struct PresenceDebounce;
+
+// Last published state per contact (with prefix), versioned so the UI can fetch only what
+// changed since its last sync, and the state machine behind presence_updated (see
+// presence_transition_locked). Unsubscribed contacts stay as "removed" tombstones until
+// they are subscribed again.
+struct PresenceCacheEntry {
+    BlfState state = BLF_UNKNOWN;
+    uint64_t version = 0;     // g_presence_version at the last change
+    int64_t updated_us = 0;   // Wall clock of the last change
+    pjsua_buddy_id buddy_id = PJSUA_INVALID_ID;
+    uint8_t source = PRESENCE_SRC_SUBSCRIPTION;
+    uint8_t sub_state = 0;    // pjsip_evsub_state
+    bool removed = false;
+    uint32_t emitted = 0;     // Transitions published
+    uint32_t suppressed = 0;  // Updates dropped: unchanged, transient sub_state or debounced away
+    BlfState pending = BLF_UNKNOWN;  // Debounced transition waiting for its timer
+    uint8_t pending_source = PRESENCE_SRC_SUBSCRIPTION;
+    PresenceDebounce *pending_timer = nullptr;  // Its timer, owned by whoever takes it out
+};
+static std::map<std::string, PresenceCacheEntry> g_presence_cache;
+static uint64_t g_presence_version = 0;  // Bumped on every cache change
+
+// Ringing is held this long before being published, so a call answered right away goes
+// straight to busy instead of flickering through ringing. 0 publishes immediately.
+#define PRESENCE_DEBOUNCE_DEFAULT_MS 250
+static std::atomic<unsigned> g_presence_debounce_ms{PRESENCE_DEBOUNCE_DEFAULT_MS};
+
+// Subscription lifecycle, see the "Subscription lifecycle" section. Every contact the app
+// asked for stays in g_presence_wanted until it is unsubscribed; the buddy behind it can die
+// (TERMINATED, 481 after a PBX reload, account removed) and is then replaced with backoff.
+struct PresenceRetry;
+struct SubscriptionLifecycle {
+    uint32_t attempts = 0;       // pjsua_buddy_add() calls
+    uint32_t failures = 0;       // Consecutive failures, drives the backoff; reset once ACTIVE
+    uint32_t terminations = 0;   // Ended by the server or the network, not by us
+    uint32_t resubscribes = 0;   // Retries and restores started
+    int last_code = 0;           // SIP code of the last termination or add failure
+    uint8_t sub_state = 0;       // pjsip_evsub_state last reported for the buddy
+    bool dead = false;           // Buddy still tracked but its subscription is over
+    uint64_t next_retry_us = 0;  // metric_now_us() of the scheduled retry, 0 = none
+    PresenceRetry *retry = nullptr;  // Scheduled retry timer, owned by whoever takes it out
+};
+static std::map<std::string, SubscriptionLifecycle> g_presence_wanted;  // contact (with prefix) → lifecycle
+static std::map<pjsua_acc_id, bool> g_presence_reg_ok;  // Last registration outcome per account
+
+static void presence_lifecycle_on_state_locked(const std::string &contact, const pjsua_buddy_info &info);
+static void presence_lifecycle_on_registered(pjsua_acc_id acc_id, bool ok);
+static void presence_retry_cancel_locked(SubscriptionLifecycle &life);
+static void presence_retry_cancel_all();
+
+// Resource-list BLF subscription (RFC 4662), see the "Resource lists" section
+static void rls_init_module(pjsip_endpoint *endpt);
+static void rls_drop_account(pjsua_acc_id acc_id);
+
+// Quick REGISTER retry after transport failures, see the "Registration retry" section
+static void reg_retry_on_state(pjsua_acc_id acc_id, const pjsua_acc_info &info);
+static void reg_retry_cancel(pjsua_acc_id acc_id);
+
 static jobject g_engine_instance = nullptr;  // Global reference to the Engine instance for event emission
 
 static void ensure_pj_thread_registered(const char *name) {
@@ -48,124 +245,747 @@ static void ensure_pj_thread_registered(const char *name) {
     pj_status_t status = pj_thread_register(name, tls_desc, &tls_thread);
     if (status != PJ_SUCCESS) {
         LOGE("pj_thread_register failed: %d", status);
+        return;
     }
+    VOIP_TRACE_THREAD_NAME(name);
 }
 
 // Forward declarations
 static void emit_event(const char *type, const char *message);
 
-// Callback to remove RTCP attributes from SDP to reduce INVITE message size
+// ---------------------------------------------------------------------------
+// SDP size minimisation
+//
+// Every locally generated SDP (offer or answer) goes through a small rule table
+// so INVITEs stay below the UDP MTU (PJSIP switches to TCP above
+// PJSIP_UDP_SIZE_THRESHOLD, which our PBXs do not accept). Rules are set from
+// Kotlin as a compact spec string, e.g.
+//   "drop-media:text,drop-attr:rtcp,drop-static-rtpmap,prune-to-offer,keep-codecs:PCMA/PCMU/telephone-event"
+// ---------------------------------------------------------------------------
+enum SdpRuleOp : pj_uint8_t {
+    SDP_RULE_DROP_MEDIA,          // Reject m= sections of a media type: port 0, no attributes (arg: "text")
+    SDP_RULE_DROP_ATTR,           // Remove a media-level attribute (arg: "rtcp")
+    SDP_RULE_DROP_STATIC_RTPMAP,  // Omit a=rtpmap for the static payload types RFC 3551 assigns
+    SDP_RULE_PRUNE_TO_OFFER,      // Answer: keep only the formats present in the remote offer
+    SDP_RULE_KEEP_CODECS,         // Offer: keep only these encodings (arg: "PCMA/PCMU/telephone-event")
+    SDP_RULE_COMPACT_HEADERS,     // Use SIP compact header names (i:, f:, t:, v:, m:, l:...)
+};
+
+struct SdpRule {
+    SdpRuleOp op;
+    char arg[48];
+};
+
+static const char *const kDefaultSdpRules = "drop-media:text,drop-attr:rtcp,drop-static-rtpmap,prune-to-offer";
+
+static std::mutex g_sdp_mutex;
+static std::vector<SdpRule> g_sdp_rules;
+static bool g_sdp_rules_configured = false;  // False until defaults or a Kotlin spec were applied
+
+// Counts one rewrite in the metrics registry (sdp.rewrites, sdp.bytes_saved)
+static void sdp_record_rewrite(int bytes_saved);
+
+// Parses a rule spec into rules. Unknown tokens are logged and skipped.
+static std::vector<SdpRule> sdp_parse_rules(const char *spec) {
+    static const struct { const char *name; SdpRuleOp op; } kOps[] = {
+        {"drop-media", SDP_RULE_DROP_MEDIA},
+        {"drop-attr", SDP_RULE_DROP_ATTR},
+        {"drop-static-rtpmap", SDP_RULE_DROP_STATIC_RTPMAP},
+        {"prune-to-offer", SDP_RULE_PRUNE_TO_OFFER},
+        {"keep-codecs", SDP_RULE_KEEP_CODECS},
+        {"compact-headers", SDP_RULE_COMPACT_HEADERS},
+    };
+    std::vector<SdpRule> rules;
+    std::string all(spec ? spec : "");
+    size_t pos = 0;
+    while (pos <= all.size()) {
+        size_t comma = all.find(',', pos);
+        std::string token = all.substr(pos, comma == std::string::npos ? std::string::npos : comma - pos);
+        pos = (comma == std::string::npos) ? all.size() + 1 : comma + 1;
+        if (token.empty()) continue;
+        size_t colon = token.find(':');
+        std::string name = token.substr(0, colon);
+        std::string arg = colon == std::string::npos ? "" : token.substr(colon + 1);
+        bool known = false;
+        for (const auto &op : kOps) {
+            if (name == op.name) {
+                SdpRule rule{};
+                rule.op = op.op;
+                pj_ansi_snprintf(rule.arg, sizeof(rule.arg), "%s", arg.c_str());
+                rules.push_back(rule);
+                known = true;
+                break;
+            }
+        }
+        if (!known) LOGW(">>> SDP RULES: ignoring unknown rule '%s'", token.c_str());
+    }
+    return rules;
+}
+
+static void sdp_apply_header_rules(const std::vector<SdpRule> &rules) {
+    bool compact = false;
+    for (const auto &rule : rules) {
+        if (rule.op == SDP_RULE_COMPACT_HEADERS) compact = true;
+    }
+    pjsip_cfg()->endpt.use_compact_form = compact ? PJ_TRUE : PJ_FALSE;
+}
+
+// RFC 3551 static payload types (tables 4 and 5) with an encoding name; nullptr when unassigned
+static const char *sdp_static_encoding(const pj_str_t *fmt) {
+    static const char *const kStatic[35] = {
+        "PCMU", nullptr, nullptr, "GSM", "G723", "DVI4", "DVI4", "LPC", "PCMA", "G722",
+        "L16", "L16", "QCELP", "CN", "MPA", "G728", "DVI4", "DVI4", "G729", nullptr,
+        nullptr, nullptr, nullptr, nullptr, nullptr, "CelB", "JPEG", nullptr, "nv", nullptr,
+        nullptr, "H261", "MPV", "MP2T", "H263",
+    };
+    if (fmt->slen < 1 || fmt->slen > 2) return nullptr;
+    int pt = 0;
+    for (pj_ssize_t i = 0; i < fmt->slen; ++i) {
+        if (fmt->ptr[i] < '0' || fmt->ptr[i] > '9') return nullptr;
+        pt = pt * 10 + (fmt->ptr[i] - '0');
+    }
+    return pt < (int)PJ_ARRAY_SIZE(kStatic) ? kStatic[pt] : nullptr;
+}
+
+// Encoding name of a format, from its a=rtpmap or from the RFC 3551 static table. Formats
+// with neither come back as their payload number.
+static std::string sdp_fmt_encoding(const pjmedia_sdp_media *m, const pj_str_t *fmt) {
+    for (unsigned i = 0; i < m->attr_count; ++i) {
+        pjmedia_sdp_rtpmap rtpmap;
+        if (pj_strcmp2(&m->attr[i]->name, "rtpmap") == 0 &&
+            pjmedia_sdp_attr_get_rtpmap(m->attr[i], &rtpmap) == PJ_SUCCESS &&
+            pj_strcmp(&rtpmap.pt, fmt) == 0) {
+            return std::string(rtpmap.enc_name.ptr, rtpmap.enc_name.slen);
+        }
+    }
+    const char *enc = sdp_static_encoding(fmt);
+    return enc ? std::string(enc) : std::string(fmt->ptr, fmt->slen);
+}
+
+// True if the format has no a=rtpmap and no RFC 3551 name: nothing to match it against
+static bool sdp_fmt_is_unnamed(const pjmedia_sdp_media *m, const pj_str_t *fmt) {
+    return !sdp_static_encoding(fmt) && sdp_fmt_encoding(m, fmt) == std::string(fmt->ptr, fmt->slen);
+}
+
+// True if attr is an rtpmap/fmtp line for payload type fmt ("<pt> ...").
+static bool sdp_attr_is_for_fmt(const pjmedia_sdp_attr *attr, const pj_str_t *fmt) {
+    if (pj_strcmp2(&attr->name, "rtpmap") != 0 && pj_strcmp2(&attr->name, "fmtp") != 0) return false;
+    return attr->value.slen > fmt->slen &&
+           strncmp(attr->value.ptr, fmt->ptr, fmt->slen) == 0 &&
+           attr->value.ptr[fmt->slen] == ' ';
+}
+
+// Removes format index fi and its rtpmap/fmtp attributes.
+static void sdp_remove_fmt(pjmedia_sdp_media *m, unsigned fi) {
+    pj_str_t fmt = m->desc.fmt[fi];
+    for (unsigned a = 0; a < m->attr_count;) {
+        if (sdp_attr_is_for_fmt(m->attr[a], &fmt)) {
+            pjmedia_sdp_media_remove_attr(m, m->attr[a]);
+        } else {
+            ++a;
+        }
+    }
+    for (unsigned j = fi; j + 1 < m->desc.fmt_count; ++j) {
+        m->desc.fmt[j] = m->desc.fmt[j + 1];
+    }
+    m->desc.fmt_count--;
+}
+
+static bool sdp_codec_in_list(const std::string &enc, const char *list) {
+    std::string all(list);
+    size_t pos = 0;
+    while (pos <= all.size()) {
+        size_t slash = all.find('/', pos);
+        std::string item = all.substr(pos, slash == std::string::npos ? std::string::npos : slash - pos);
+        if (!item.empty() && strcasecmp(item.c_str(), enc.c_str()) == 0) return true;
+        if (slash == std::string::npos) break;
+        pos = slash + 1;
+    }
+    return false;
+}
+
+static const pjmedia_sdp_media *sdp_find_remote_media(const pjmedia_sdp_session *rem_sdp, unsigned index,
+                                                      const pj_str_t *type) {
+    if (!rem_sdp) return nullptr;
+    if (index < rem_sdp->media_count && pj_stricmp(&rem_sdp->media[index]->desc.media, type) == 0) {
+        return rem_sdp->media[index];
+    }
+    for (unsigned i = 0; i < rem_sdp->media_count; ++i) {
+        if (pj_stricmp(&rem_sdp->media[i]->desc.media, type) == 0) return rem_sdp->media[i];
+    }
+    return nullptr;
+}
+
+static void sdp_apply_media_rule(const SdpRule &rule, pjmedia_sdp_media *m, const pjmedia_sdp_media *rem_m) {
+    switch (rule.op) {
+        case SDP_RULE_DROP_ATTR:
+            pjmedia_sdp_media_remove_all_attr(m, rule.arg);
+            break;
+        case SDP_RULE_DROP_STATIC_RTPMAP:
+            for (unsigned a = 0; a < m->attr_count;) {
+                pjmedia_sdp_rtpmap rtpmap;
+                // Only where the static table says the same: other numbers below 96 need their rtpmap
+                const char *enc;
+                if (pj_strcmp2(&m->attr[a]->name, "rtpmap") == 0 &&
+                    pjmedia_sdp_attr_get_rtpmap(m->attr[a], &rtpmap) == PJ_SUCCESS &&
+                    (enc = sdp_static_encoding(&rtpmap.pt)) != nullptr &&
+                    pj_stricmp2(&rtpmap.enc_name, enc) == 0) {
+                    pjmedia_sdp_media_remove_attr(m, m->attr[a]);
+                } else {
+                    ++a;
+                }
+            }
+            break;
+        case SDP_RULE_PRUNE_TO_OFFER:
+            if (!rem_m) break;
+            // Compare by encoding name: dynamic payload numbers may differ between offer and answer
+            for (unsigned fi = 0; fi < m->desc.fmt_count && m->desc.fmt_count > 1;) {
+                std::string enc = sdp_fmt_encoding(m, &m->desc.fmt[fi]);
+                bool offered = false;
+                for (unsigned r = 0; r < rem_m->desc.fmt_count && !offered; ++r) {
+                    offered = strcasecmp(sdp_fmt_encoding(rem_m, &rem_m->desc.fmt[r]).c_str(), enc.c_str()) == 0;
+                }
+                if (offered) {
+                    ++fi;
+                } else {
+                    sdp_remove_fmt(m, fi);
+                }
+            }
+            break;
+        case SDP_RULE_KEEP_CODECS:
+            if (rem_m) break;  // Offer only; answers are handled by prune-to-offer
+            // Formats we cannot name are kept: dropping them could remove the only usable codec
+            for (unsigned fi = 0; fi < m->desc.fmt_count && m->desc.fmt_count > 1;) {
+                if (sdp_fmt_is_unnamed(m, &m->desc.fmt[fi]) ||
+                    sdp_codec_in_list(sdp_fmt_encoding(m, &m->desc.fmt[fi]), rule.arg)) {
+                    ++fi;
+                } else {
+                    sdp_remove_fmt(m, fi);
+                }
+            }
+            break;
+        default:
+            break;
+    }
+}
+
+// Rewrites every locally created SDP with the rule table and reports the bytes saved
 static void on_call_sdp_created(pjsua_call_id call_id, pjmedia_sdp_session *sdp,
                                 pj_pool_t *pool, const pjmedia_sdp_session *rem_sdp)
 {
-    PJ_UNUSED_ARG(call_id);
-    PJ_UNUSED_ARG(pool);
-    PJ_UNUSED_ARG(rem_sdp);
+    VOIP_TRACE_SCOPE("pjsua", "on_call_sdp_created");
 
     if (!sdp) return;
 
-    pj_str_t STR_RTCP = pj_str((char*)("rtcp"));
-    pj_str_t STR_TEXT = pj_str((char*)"text");
+    std::vector<SdpRule> rules;
+    {
+        std::lock_guard<std::mutex> lock(g_sdp_mutex);
+        rules = g_sdp_rules;
+    }
+    if (rules.empty()) return;
+
+    char print_buf[4096];
+    int size_before = pjmedia_sdp_print(sdp, print_buf, sizeof(print_buf));
+
+    // Section-level rules first. A section is rejected, not removed: an answer has exactly the
+    // offer's m-lines and a later offer cannot have fewer than the previous one (RFC 3264 6, 8).
+    // A rejected section keeps one format and nothing else.
+    for (const auto &rule : rules) {
+        if (rule.op != SDP_RULE_DROP_MEDIA) continue;
+        for (unsigned i = 0; i < sdp->media_count; ++i) {
+            pjmedia_sdp_media *m = sdp->media[i];
+            if (pj_stricmp2(&m->desc.media, rule.arg) != 0) continue;
+            pjmedia_sdp_media_deactivate(pool, m);
+            if (m->desc.fmt_count > 1) m->desc.fmt_count = 1;
+            m->bandw_count = 0;
+            m->conn = nullptr;
+        }
+    }
 
-    // Parcourir toutes les sections media (audio, video, etc.)
     for (unsigned i = 0; i < sdp->media_count; ++i) {
         pjmedia_sdp_media *m = sdp->media[i];
-        
-        // Si c'est le flux m=text, on le retire complètement
-        if (pj_stricmp(&m->desc.media, &STR_TEXT) == 0) {
-            // Décale le tableau de médias vers la gauche
-            for (unsigned j = i; j < sdp->media_count - 1; ++j) {
-                sdp->media[j] = sdp->media[j + 1];
-            }
-            sdp->media_count--;
-            continue; // On ne traite pas cet élément supprimé
+        if (m->desc.port == 0) continue;  // Rejected, by a rule or by pjsua
+        const pjmedia_sdp_media *rem_m = sdp_find_remote_media(rem_sdp, i, &m->desc.media);
+        for (const auto &rule : rules) {
+            sdp_apply_media_rule(rule, m, rem_m);
         }
+    }
 
-        // Chercher et supprimer l'attribut "rtcp"
-        pjmedia_sdp_attr *attr = pjmedia_sdp_media_find_attr(m, &STR_RTCP, NULL);
-        if (attr) {
-            pjmedia_sdp_media_remove_attr(m, attr);
-            LOGI(">>> SDP CLEANUP: Removed RTCP attribute from media section %u", i);
-        }
+    int size_after = pjmedia_sdp_print(sdp, print_buf, sizeof(print_buf));
+    if (size_before > 0 && size_after > 0) {
+        sdp_record_rewrite(size_before - size_after);
+        LOGI(">>> SDP CLEANUP: call_id=%d %s %d -> %d bytes (saved %d)",
+             call_id, rem_sdp ? "answer" : "offer", size_before, size_after, size_before - size_after);
+    }
+}
+
+// ---------------------------------------------------------------------------
+// Metrics registry. Fixed set of counters, gauges and latency histograms, all
+// updated lock-free so they can be bumped from PJSIP worker threads, the engine
+// thread and JNI callers alike.
+//   - counters are sharded per thread (one cache line per shard) and summed on read
+//   - gauges are single atomics (set or add)
+//   - histograms use HDR-style log-linear buckets: 8 sub-buckets per power of two,
+//     i.e. ~12% relative precision from 1 up to 2^34 units
+// nativeSnapshotMetrics() copies everything into one jlong[] (layout documented there).
+// The order of the enums is the wire order: append only.
+// ---------------------------------------------------------------------------
+enum MetricCounter {
+    MC_SIP_RX_INVITE, MC_SIP_RX_ACK, MC_SIP_RX_BYE, MC_SIP_RX_CANCEL, MC_SIP_RX_REGISTER,
+    MC_SIP_RX_SUBSCRIBE, MC_SIP_RX_NOTIFY, MC_SIP_RX_OPTIONS, MC_SIP_RX_OTHER,
+    MC_SIP_TX_INVITE, MC_SIP_TX_ACK, MC_SIP_TX_BYE, MC_SIP_TX_CANCEL, MC_SIP_TX_REGISTER,
+    MC_SIP_TX_SUBSCRIBE, MC_SIP_TX_NOTIFY, MC_SIP_TX_OPTIONS, MC_SIP_TX_OTHER,
+    MC_SIP_RX_RESPONSE_1XX, MC_SIP_RX_RESPONSE_2XX, MC_SIP_RX_RESPONSE_3XX,
+    MC_SIP_RX_RESPONSE_4XX, MC_SIP_RX_RESPONSE_5XX, MC_SIP_RX_RESPONSE_6XX,
+    MC_SIP_TX_RESPONSES,
+    MC_SIP_RX_AUTH_CHALLENGE,     // 401 / 407 received
+    MC_SIP_TX_RETRANSMIT,         // Same tdata sent again (request or response)
+    MC_NOTIFY_PROCESSED,          // Buddy state / dialog-event callbacks handled
+    MC_PRESENCE_EMITTED,          // Lamp transitions published
+    MC_PRESENCE_SUPPRESSED,       // Updates that did not change a lamp
+    MC_PRESENCE_DEBOUNCED,        // Ringing superseded before its debounce expired
+    MC_PRESENCE_SUB_FAILURES,     // BLF subscriptions terminated or refused
+    MC_PRESENCE_RESUBSCRIBES,     // Retries and restores started by the lifecycle manager
+    MC_EVENTS_EMITTED,
+    MC_EVENTS_DROPPED,            // Lost: ring full, or no JNIEnv / handler on the string path
+    MC_CALLS_INCOMING,
+    MC_CALLS_OUTGOING,
+    MC_CALLS_CONNECTED,
+    MC_AUDIO_UNDERRUNS,           // Jitter buffer found empty at playout
+    MC_AUDIO_JB_LOST,
+    MC_AUDIO_JB_DISCARD,
+    MC_MEDIA_PARKED,              // Idle mode entered: bridge clock stopped, media thread parked
+    MC_MEDIA_RESUMED,
+    MC_MEDIA_TICKS_SKIPPED,
+    MC_SRTP_CALLS,                // Calls whose audio was negotiated with SRTP
+    MC_SRTP_OVER_BUDGET,          // Encrypted streams that cost more than the SRTP CPU budget
+    MC_AEC_FALLBACKS,             // Echo canceller over its frame budget, suppressor took over
+    MC_PJSIP_LOG_LINES,
+    MC_SDP_REWRITES,              // Local offers/answers rewritten by the SDP rule table
+    MC_SDP_BYTES_SAVED,           // Bytes those rewrites removed, summed
+    MC_LOCKS_HELD_ACROSS_PJSUA,   // Re-entrant or blocking PJSUA calls made under a domain lock
+    MC_EVENTS_DEFERRED,           // Left in the ring without a doorbell (no JNIEnv), read with the next one
+    MC_COUNT
+};
+
+enum MetricGauge {
+    MG_ACTIVE_CALLS,
+    MG_ACCOUNTS,
+    MG_BUDDIES,
+    MG_COMMAND_QUEUE_DEPTH,
+    MG_COUNT
+};
+
+enum MetricHistogram {
+    MH_JNI_DISPATCH_US,           // emit_event: attach + CallStaticVoidMethod
+    MH_CALL_SETUP_MS,             // INVITE sent/received -> CONFIRMED
+    MH_COMMAND_WAIT_US,           // Engine command queue wait
+    MH_COMMAND_EXEC_US,           // Engine command execution
+    MH_ACCEPT_TO_200_US,          // Accept requested (JNI / C API) -> 200 OK sent (or its ACK received)
+    MH_MEDIA_TICK_LATE_US,        // Media clock thread wake-up past its deadline
+    MH_DEVICE_TICK_LATE_US,       // Bridge tick in the sound device callback, past one frame after the last one
+    MH_SRTP_PROTECT_NS,           // libsrtp protect of one live RTP packet
+    MH_SRTP_UNPROTECT_NS,
+    MH_SRTP_CALL_CPU_US,          // SRTP CPU per second of an encrypted stream, from its live packets
+    MH_AEC_FRAME_US,              // Echo canceller (or fallback suppressor) time per captured frame
+    MH_AEC_ERLE_DB,               // Echo return loss enhancement of a call, when it had echo
+    MH_COUNT
+};
+
+static const char *const kMetricCounterNames[MC_COUNT] = {
+    "sip.rx.invite", "sip.rx.ack", "sip.rx.bye", "sip.rx.cancel", "sip.rx.register",
+    "sip.rx.subscribe", "sip.rx.notify", "sip.rx.options", "sip.rx.other",
+    "sip.tx.invite", "sip.tx.ack", "sip.tx.bye", "sip.tx.cancel", "sip.tx.register",
+    "sip.tx.subscribe", "sip.tx.notify", "sip.tx.options", "sip.tx.other",
+    "sip.rx.response.1xx", "sip.rx.response.2xx", "sip.rx.response.3xx",
+    "sip.rx.response.4xx", "sip.rx.response.5xx", "sip.rx.response.6xx",
+    "sip.tx.responses",
+    "sip.rx.auth_challenge",
+    "sip.tx.retransmit",
+    "presence.notify_processed",
+    "presence.emitted",
+    "presence.suppressed",
+    "presence.debounced",
+    "presence.subscription_failures",
+    "presence.resubscribes",
+    "events.emitted",
+    "events.dropped",
+    "calls.incoming",
+    "calls.outgoing",
+    "calls.connected",
+    "audio.underruns",
+    "audio.jb_lost",
+    "audio.jb_discard",
+    "media.parked",
+    "media.resumed",
+    "media.ticks_skipped",
+    "srtp.calls",
+    "srtp.over_budget",
+    "aec.fallbacks",
+    "pjsip.log_lines",
+    "sdp.rewrites",
+    "sdp.bytes_saved",
+    "locks.held_across_pjsua",
+    "events.deferred",
+};
+static const char *const kMetricGaugeNames[MG_COUNT] = {
+    "calls.active", "accounts", "presence.buddies", "engine.queue_depth",
+};
+static const char *const kMetricHistogramNames[MH_COUNT] = {
+    "jni.dispatch_us", "calls.setup_ms", "engine.wait_us", "engine.exec_us", "calls.accept_to_200_us",
+    "media.tick_late_us", "media.device_tick_late_us", "srtp.protect_ns", "srtp.unprotect_ns", "srtp.call_cpu_us_per_s",
+    "aec.frame_us", "aec.erle_db",
+};
+
+#define METRIC_SHARDS 8
+#define METRIC_HIST_SUB_BITS 3
+#define METRIC_HIST_SUB (1 << METRIC_HIST_SUB_BITS)
+#define METRIC_HIST_MAX_EXP 34
+#define METRIC_HIST_BUCKETS (METRIC_HIST_SUB + (METRIC_HIST_MAX_EXP - METRIC_HIST_SUB_BITS) * METRIC_HIST_SUB)
+#define METRICS_SNAPSHOT_VERSION 1
+
+struct alignas(64) MetricShard {
+    std::atomic<uint64_t> counters[MC_COUNT];
+};
+
+struct MetricHistogramData {
+    std::atomic<uint64_t> count{0};
+    std::atomic<uint64_t> sum{0};
+    std::atomic<uint64_t> max{0};
+    std::atomic<uint64_t> buckets[METRIC_HIST_BUCKETS];
+};
+
+static MetricShard g_metric_shards[METRIC_SHARDS];
+static std::atomic<int64_t> g_metric_gauges[MG_COUNT];
+static MetricHistogramData g_metric_histograms[MH_COUNT];
+static std::atomic<unsigned> g_metric_next_shard{0};
+
+static inline MetricShard &metric_shard() {
+    static thread_local unsigned shard = g_metric_next_shard.fetch_add(1, std::memory_order_relaxed) % METRIC_SHARDS;
+    return g_metric_shards[shard];
+}
+
+static inline void metric_inc(MetricCounter id, uint64_t n = 1) {
+    metric_shard().counters[id].fetch_add(n, std::memory_order_relaxed);
+}
+
+static inline void metric_gauge_set(MetricGauge id, int64_t value) {
+    g_metric_gauges[id].store(value, std::memory_order_relaxed);
+}
+
+static inline void metric_gauge_add(MetricGauge id, int64_t delta) {
+    g_metric_gauges[id].fetch_add(delta, std::memory_order_relaxed);
+}
+
+static inline unsigned metric_hist_bucket(uint64_t v) {
+    if (v < METRIC_HIST_SUB) return (unsigned)v;
+    unsigned exp = 63 - __builtin_clzll(v);  // >= METRIC_HIST_SUB_BITS
+    if (exp >= METRIC_HIST_MAX_EXP) return METRIC_HIST_BUCKETS - 1;
+    unsigned sub = (unsigned)(v >> (exp - METRIC_HIST_SUB_BITS)) - METRIC_HIST_SUB;
+    return METRIC_HIST_SUB + (exp - METRIC_HIST_SUB_BITS) * METRIC_HIST_SUB + sub;
+}
+
+static void metric_observe(MetricHistogram id, uint64_t value) {
+    MetricHistogramData &h = g_metric_histograms[id];
+    h.buckets[metric_hist_bucket(value)].fetch_add(1, std::memory_order_relaxed);
+    h.count.fetch_add(1, std::memory_order_relaxed);
+    h.sum.fetch_add(value, std::memory_order_relaxed);
+    uint64_t prev = h.max.load(std::memory_order_relaxed);
+    while (value > prev && !h.max.compare_exchange_weak(prev, value, std::memory_order_relaxed)) {
+    }
+}
+
+static void sdp_record_rewrite(int bytes_saved) {
+    metric_inc(MC_SDP_REWRITES);
+    if (bytes_saved > 0) metric_inc(MC_SDP_BYTES_SAVED, (uint64_t)bytes_saved);
+}
+
+// Called right before a PJSUA call that can re-enter our callbacks or block on a device
+static void pjsua_unlocked_check(const char *call) {
+    if (t_domain_locks_held == 0) return;
+    metric_inc(MC_LOCKS_HELD_ACROSS_PJSUA);
+    LOGW(">>> LOCK: %s called with %u domain lock(s) held", call, t_domain_locks_held);
+}
+
+static inline uint64_t metric_now_us() {
+    return std::chrono::duration_cast<std::chrono::microseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// Start of call setup per call slot (0 = not pending), filled on INVITE sent/received
+static std::atomic<uint64_t> g_call_setup_start_us[PJSUA_MAX_CALLS];
+
+// Accept -> 200 OK latency per call slot, reported once with EV_CALL_CONNECTED (0 = outgoing)
+static std::atomic<uint64_t> g_call_accept_us[PJSUA_MAX_CALLS];
+
+// When the accept of an incoming call was requested, until its 200 OK is seen on the wire (0 = none)
+static std::atomic<uint64_t> g_call_accept_requested_us[PJSUA_MAX_CALLS];
+
+// Trace flow ids for call setup live above the engine request ids
+#define TRACE_CALL_FLOW_ID(call_id) ((1ull << 48) | (uint64_t)(call_id))
+
+static void metric_call_setup_begin(pjsua_call_id call_id, uint64_t start_us) {
+    if (call_id < 0 || call_id >= PJSUA_MAX_CALLS) return;
+    g_call_setup_start_us[call_id].store(start_us, std::memory_order_relaxed);
+    VOIP_TRACE_FLOW_BEGIN("call", "call_setup", TRACE_CALL_FLOW_ID(call_id));
+}
+
+static void metric_call_setup_end(pjsua_call_id call_id, bool connected) {
+    if (call_id < 0 || call_id >= PJSUA_MAX_CALLS) return;
+    uint64_t start = g_call_setup_start_us[call_id].exchange(0, std::memory_order_relaxed);
+    if (start == 0) return;
+    VOIP_TRACE_FLOW_END("call", "call_setup", TRACE_CALL_FLOW_ID(call_id));
+    if (connected) {
+        metric_observe(MH_CALL_SETUP_MS, (metric_now_us() - start) / 1000);
+    }
+}
+
+// SIP traffic is counted by a module sitting just above the transport layer, so it sees
+// every message, including the retransmissions the transaction layer absorbs or re-sends.
+static int metric_method_offset(const pjsip_method &method) {
+    switch (method.id) {
+        case PJSIP_INVITE_METHOD:   return 0;
+        case PJSIP_ACK_METHOD:      return 1;
+        case PJSIP_BYE_METHOD:      return 2;
+        case PJSIP_CANCEL_METHOD:   return 3;
+        case PJSIP_REGISTER_METHOD: return 4;
+        case PJSIP_OPTIONS_METHOD:  return 7;
+        default: break;
+    }
+    if (method.name.slen == 9 && strncasecmp(method.name.ptr, "SUBSCRIBE", 9) == 0) return 5;
+    if (method.name.slen == 6 && strncasecmp(method.name.ptr, "NOTIFY", 6) == 0) return 6;
+    return 8;
+}
+
+static std::atomic<int> g_mod_metrics_id{-1};  // Module id once registered, indexes tdata->mod_data
+
+#if VOIP_TRACE_ENABLED
+// SIP messages also show up as instants on the trace timeline ("INVITE", "401", ...)
+static void metrics_trace_sip(const char *name, const pjsip_msg *msg) {
+    char detail[32];
+    if (msg->type == PJSIP_REQUEST_MSG) {
+        const pj_str_t &method = msg->line.req.method.name;
+        snprintf(detail, sizeof(detail), "%.*s", (int)method.slen, method.ptr);
+    } else {
+        snprintf(detail, sizeof(detail), "%d", msg->line.status.code);
+    }
+    VOIP_TRACE_INSTANT("sip", name, detail);
+}
+#define METRICS_TRACE_SIP(name, msg) metrics_trace_sip(name, msg)
+#else
+#define METRICS_TRACE_SIP(name, msg) do {} while (0)
+#endif
+
+static pj_bool_t metrics_on_rx_request(pjsip_rx_data *rdata) {
+    METRICS_TRACE_SIP("sip_rx", rdata->msg_info.msg);
+    metric_inc((MetricCounter)(MC_SIP_RX_INVITE + metric_method_offset(rdata->msg_info.msg->line.req.method)));
+    return PJ_FALSE;
+}
+
+static pj_bool_t metrics_on_rx_response(pjsip_rx_data *rdata) {
+    METRICS_TRACE_SIP("sip_rx", rdata->msg_info.msg);
+    int code = rdata->msg_info.msg->line.status.code;
+    int cls = code / 100;
+    if (cls >= 1 && cls <= 6) metric_inc((MetricCounter)(MC_SIP_RX_RESPONSE_1XX + cls - 1));
+    if (code == 401 || code == 407) metric_inc(MC_SIP_RX_AUTH_CHALLENGE);
+    return PJ_FALSE;
+}
+
+// The module's tdata slot remembers the CSeq last sent with that tdata: sending it again with
+// the same CSeq is a retransmission. An auth retry reuses the tdata too, but bumps the CSeq.
+static bool metrics_is_retransmit(pjsip_tx_data *tdata) {
+    int mod_id = g_mod_metrics_id.load(std::memory_order_relaxed);
+    if (mod_id < 0) return false;
+    const pjsip_cseq_hdr *cseq = static_cast<const pjsip_cseq_hdr *>(pjsip_msg_find_hdr(tdata->msg, PJSIP_H_CSEQ, NULL));
+    void *mark = reinterpret_cast<void *>(static_cast<uintptr_t>(cseq ? (uint32_t)cseq->cseq + 1u : 1u));
+    if (tdata->mod_data[mod_id] == mark) return true;
+    tdata->mod_data[mod_id] = mark;
+    return false;
+}
+
+static pj_status_t metrics_on_tx_request(pjsip_tx_data *tdata) {
+    METRICS_TRACE_SIP("sip_tx", tdata->msg);
+    if (metrics_is_retransmit(tdata)) {
+        metric_inc(MC_SIP_TX_RETRANSMIT);
+    } else {
+        metric_inc((MetricCounter)(MC_SIP_TX_INVITE + metric_method_offset(tdata->msg->line.req.method)));
+    }
+    return PJ_SUCCESS;
+}
+
+static pj_status_t metrics_on_tx_response(pjsip_tx_data *tdata) {
+    METRICS_TRACE_SIP("sip_tx", tdata->msg);
+    metric_inc(metrics_is_retransmit(tdata) ? MC_SIP_TX_RETRANSMIT : MC_SIP_TX_RESPONSES);
+    return PJ_SUCCESS;
+}
+
+
+static pjsip_module mod_metrics = {
+    NULL, NULL,                              // prev, next
+    { (char*)"mod-metrics", 11 },            // name
+    -1,                                      // id
+    PJSIP_MOD_PRIORITY_TRANSPORT_LAYER + 1,  // priority
+    NULL,                                    // load()
+    NULL,                                    // start()
+    NULL,                                    // stop()
+    NULL,                                    // unload()
+    &metrics_on_rx_request,                  // on_rx_request()
+    &metrics_on_rx_response,                 // on_rx_response()
+    &metrics_on_tx_request,                  // on_tx_request()
+    &metrics_on_tx_response,                 // on_tx_response()
+    NULL,                                    // on_tsx_state()
+};
+
+// ----------------------------------------------------------------------------
+// SIP capture: mod_sip_capture copies every raw SIP message into voip_capture's ring
+// (one memcpy, no formatting). Support exports the last minutes of traffic with
+// nativeExportSipCapture() instead of relying on always-on message logging.
+// ----------------------------------------------------------------------------
+
+static void capture_address(const pj_sockaddr &sa, voip_capture::Address &out) {
+    memset(&out, 0, sizeof(out));
+    if (sa.addr.sa_family == PJ_AF_INET) {
+        out.family = 4;
+        memcpy(out.addr, &sa.ipv4.sin_addr, 4);
+        out.port = sa.ipv4.sin_port;
+    } else if (sa.addr.sa_family == PJ_AF_INET6) {
+        out.family = 6;
+        memcpy(out.addr, &sa.ipv6.sin6_addr, 16);
+        out.port = sa.ipv6.sin6_port;
+    }
+}
+
+// The transport's bound address is often 0.0.0.0: prefer the published one when it is a literal IPv4
+static void capture_local_address(const pjsip_transport *tp, voip_capture::Address &out) {
+    capture_address(tp->local_addr, out);
+    if (out.family == 4 && tp->local_addr.ipv4.sin_addr.s_addr == 0) {
+        pj_in_addr published;
+        if (pj_inet_aton(&tp->local_name.host, &published)) memcpy(out.addr, &published, 4);
     }
 }
 
+static voip_capture::Transport capture_transport(const pjsip_transport *tp) {
+    if (tp->flag & PJSIP_TRANSPORT_SECURE) return voip_capture::TP_TLS;
+    if (tp->flag & PJSIP_TRANSPORT_RELIABLE) return voip_capture::TP_TCP;
+    return voip_capture::TP_UDP;
+}
+
+static pj_bool_t capture_on_rx(pjsip_rx_data *rdata) {
+    const pjsip_transport *tp = rdata->tp_info.transport;
+    if (!tp || !rdata->msg_info.msg_buf || rdata->msg_info.len <= 0) return PJ_FALSE;
+    voip_capture::Address local, remote;
+    capture_local_address(tp, local);
+    capture_address(rdata->pkt_info.src_addr, remote);
+    const pj_time_val &ts = rdata->pkt_info.timestamp;
+    voip_capture::record(voip_capture::DIR_RX, capture_transport(tp), local, remote,
+                         rdata->msg_info.msg_buf, (size_t)rdata->msg_info.len,
+                         (uint64_t)ts.sec * 1000000u + (uint64_t)ts.msec * 1000u);
+    return PJ_FALSE;
+}
+
+static pj_status_t capture_on_tx(pjsip_tx_data *tdata) {
+    const pjsip_transport *tp = tdata->tp_info.transport;
+    if (!tp || tdata->buf.cur <= tdata->buf.start) return PJ_SUCCESS;
+    voip_capture::Address local, remote;
+    capture_local_address(tp, local);
+    capture_address(tdata->tp_info.dst_addr, remote);
+    voip_capture::record(voip_capture::DIR_TX, capture_transport(tp), local, remote,
+                         tdata->buf.start, (size_t)(tdata->buf.cur - tdata->buf.start));
+    return PJ_SUCCESS;
+}
+
+// Below the transport layer like pjsua's own message logger: on tx, modules run from the
+// highest priority down, so the message has already been printed into tdata->buf.
+static pjsip_module mod_sip_capture = {
+    NULL, NULL,                              // prev, next
+    { (char*)"mod-sip-capture", 15 },        // name
+    -1,                                      // id
+    PJSIP_MOD_PRIORITY_TRANSPORT_LAYER - 1,  // priority
+    NULL,                                    // load()
+    NULL,                                    // start()
+    NULL,                                    // stop()
+    NULL,                                    // unload()
+    &capture_on_rx,                          // on_rx_request()
+    &capture_on_rx,                          // on_rx_response()
+    &capture_on_tx,                          // on_tx_request()
+    &capture_on_tx,                          // on_tx_response()
+    NULL,                                    // on_tsx_state()
+};
+
+// PJSIP log verbosity: 3 (info) keeps registration, call and transport events; 5-6 (debug,
+// trace) also logs every transaction step and is meant for a one-off debugging build only.
+// Full SIP messages are in the capture ring either way.
+#ifndef VOIP_PJSIP_LOG_LEVEL
+#define VOIP_PJSIP_LOG_LEVEL 3
+#endif
+#define VOIP_PJSIP_LOG_TAGGED_LEVEL 5  // From this level on, lines are tagged by content for grep
+
 // Custom PJSIP logger callback pour tracer TOUTES les trames SIP
 static void pjsip_log_callback(int level, const char *data, int len) {
-    // DIAGNOSTIC: Log that callback was invoked at all
-    static bool first_call = true;
-    static int msg_count = 0;
-    if (first_call) {
-        LOGI(">>> CALLBACK INVOKED: pjsip_log_callback called for the FIRST TIME - logging is working!");
-        first_call = false;
+    if (!data || len <= 0) return;
+    metric_inc(MC_PJSIP_LOG_LINES);
+    if (data[len - 1] == '\n') len--;
+
+    // Errors, warnings and info go straight to logcat, without a copy
+    if (level < VOIP_PJSIP_LOG_TAGGED_LEVEL) {
+        int prio = level <= 1 ? ANDROID_LOG_ERROR : level == 2 ? ANDROID_LOG_WARN : ANDROID_LOG_INFO;
+        __android_log_print(prio, LOG_TAG, "PJSIP: %.*s", len, data);
+        return;
     }
-    
-    // Log TOUTES les lignes PJSIP (level 0 and above - CAPTURE EVERYTHING)
-    if (data && len > 0) {  // CAPTURE ALL LEVELS - no filtering
-        msg_count++;
-        
-        // Formater le log - BUFFER AGRANDI pour capturer les messages complets
-        char log_buf[2048];  // Increased from 512 to capture full PJSIP messages
-        int copy_len = (len < 2000) ? len : 2000;  // Copy up to 2000 bytes
-        strncpy(log_buf, data, copy_len);
-        log_buf[copy_len] = '\0';
-        
-        // Retirer le newline final si présent
-        if (copy_len > 0 && log_buf[copy_len-1] == '\n') {
-            log_buf[copy_len-1] = '\0';
-        }
-        
-        // DEBUG: Log message brut SANS FILTRE - afficher tous les messages
-        LOGI(">>> RAW CALLBACK #%d (level=%d): %s", msg_count, level, log_buf);
-        
-        // Préfixer avec "SIP TRAME:" pour faciliter les grep
-        // Colorer selon le contenu pour mieux identifier les trames importantes
-        if (strstr(log_buf, "INVITE")) {
-            LOGI("=== SIP MSG [INVITE] %s", log_buf);
-        } else if (strstr(log_buf, "SUBSCRIBE")) {
-            LOGI("=== SIP MSG [SUBSCRIBE] %s", log_buf);
-        } else if (strstr(log_buf, "401") || strstr(log_buf, "Unauthorized")) {
-            LOGW("=== SIP MSG [401 AUTH REQUIRED] %s", log_buf);
-        } else if (strstr(log_buf, "200") || strstr(log_buf, "200 OK")) {
-            LOGI("=== SIP MSG [200 OK] %s", log_buf);
-        } else if (strstr(log_buf, "NOTIFY")) {
-            LOGI("=== SIP MSG [NOTIFY] %s", log_buf);
-        } else if (strstr(log_buf, "REGISTER") || strstr(log_buf, "registration")) {
-            LOGI("=== SIP MSG [REGISTER] %s", log_buf);
-        } else if (strstr(log_buf, "WWW-Authenticate") || strstr(log_buf, "Authorization")) {
-            LOGW("=== SIP MSG [AUTH] %s", log_buf);
-        } else if (strstr(log_buf, "Contact")) {
-            LOGW("=== SIP MSG [CONTACT] *** %s", log_buf);
-        } else if (strstr(log_buf, "Via")) {
-            LOGI("=== SIP MSG [VIA] %s", log_buf);
-        } else if (strstr(log_buf, "Route")) {
-            LOGW("=== SIP MSG [ROUTE] *** %s", log_buf);
-        } else if (strstr(log_buf, "target") || strstr(log_buf, "Target") || strstr(log_buf, "server") || strstr(log_buf, "Server")) {
-            LOGW("=== SIP MSG [TARGET] *** %s", log_buf);
-        } else if (strstr(log_buf, "Unsupported") || strstr(log_buf, "unsupported") || 
-                   strstr(log_buf, "EUNSUPTRANSPORT") || strstr(log_buf, "transport")) {
-            // Log TOUS les messages sur les transports avec maximum de détail
-            LOGW("=== SIP MSG [TRANSPORT ISSUE] *** %s", log_buf);
-        } else if (strstr(log_buf, "tsx") || strstr(log_buf, "tsxacb") || strstr(log_buf, "transaction")) {
-            LOGI("=== SIP MSG [TRANSACTION] %s", log_buf);
-        } else if (strstr(log_buf, "Unsupported") || strstr(log_buf, "PJSIP_EUNSUPTRANSPORT") ||
-                   strstr(log_buf, "FAILED") || strstr(log_buf, "Error") || strstr(log_buf, "error") || 
-                   strstr(log_buf, "failure") || strstr(log_buf, "Failure") ||
-                   strstr(log_buf, "Temporary failure")) {
-            LOGW("=== SIP MSG [ERROR] *** %s", log_buf);
-        } else if (strstr(log_buf, "next server") || strstr(log_buf, "Next server") || 
-                   strstr(log_buf, "will try") || strstr(log_buf, "failover")) {
-            LOGW("=== SIP MSG [FAILOVER] *** %s", log_buf);
-        } else if (strstr(log_buf, "SIP/2.0")) {
-            // Toute ligne contenant SIP/2.0 (request ou response)
-            LOGI("=== SIP MSG [SIP FRAME] %s", log_buf);
-        } else if (strstr(log_buf, "pjsua") || strstr(log_buf, "evsub")) {
-            // Messages PJSIP relatifs à la subscription
-            LOGI("=== SIP LOG [PJSUA] %s", log_buf);
-        } else {
-            // Toutes les autres lignes aussi (ne pas filtrer)
-            LOGI("=== SIP LOG [OTHER] %s", log_buf);
-        }
+
+    // Formater le log - BUFFER AGRANDI pour capturer les messages complets
+    char log_buf[2048];
+    int copy_len = (len < 2000) ? len : 2000;  // Copy up to 2000 bytes
+    memcpy(log_buf, data, copy_len);
+    log_buf[copy_len] = '\0';
+
+    // Préfixer avec "SIP TRAME:" pour faciliter les grep
+    // Colorer selon le contenu pour mieux identifier les trames importantes
+    if (strstr(log_buf, "INVITE")) {
+        LOGI("=== SIP MSG [INVITE] %s", log_buf);
+    } else if (strstr(log_buf, "SUBSCRIBE")) {
+        LOGI("=== SIP MSG [SUBSCRIBE] %s", log_buf);
+    } else if (strstr(log_buf, "401") || strstr(log_buf, "Unauthorized")) {
+        LOGW("=== SIP MSG [401 AUTH REQUIRED] %s", log_buf);
+    } else if (strstr(log_buf, "200") || strstr(log_buf, "200 OK")) {
+        LOGI("=== SIP MSG [200 OK] %s", log_buf);
+    } else if (strstr(log_buf, "NOTIFY")) {
+        LOGI("=== SIP MSG [NOTIFY] %s", log_buf);
+    } else if (strstr(log_buf, "REGISTER") || strstr(log_buf, "registration")) {
+        LOGI("=== SIP MSG [REGISTER] %s", log_buf);
+    } else if (strstr(log_buf, "WWW-Authenticate") || strstr(log_buf, "Authorization")) {
+        LOGW("=== SIP MSG [AUTH] %s", log_buf);
+    } else if (strstr(log_buf, "Contact")) {
+        LOGW("=== SIP MSG [CONTACT] *** %s", log_buf);
+    } else if (strstr(log_buf, "Via")) {
+        LOGI("=== SIP MSG [VIA] %s", log_buf);
+    } else if (strstr(log_buf, "Route")) {
+        LOGW("=== SIP MSG [ROUTE] *** %s", log_buf);
+    } else if (strstr(log_buf, "target") || strstr(log_buf, "Target") || strstr(log_buf, "server") || strstr(log_buf, "Server")) {
+        LOGW("=== SIP MSG [TARGET] *** %s", log_buf);
+    } else if (strstr(log_buf, "Unsupported") || strstr(log_buf, "unsupported") || 
+               strstr(log_buf, "EUNSUPTRANSPORT") || strstr(log_buf, "transport")) {
+        // Log TOUS les messages sur les transports avec maximum de détail
+        LOGW("=== SIP MSG [TRANSPORT ISSUE] *** %s", log_buf);
+    } else if (strstr(log_buf, "tsx") || strstr(log_buf, "tsxacb") || strstr(log_buf, "transaction")) {
+        LOGI("=== SIP MSG [TRANSACTION] %s", log_buf);
+    } else if (strstr(log_buf, "Unsupported") || strstr(log_buf, "PJSIP_EUNSUPTRANSPORT") ||
+               strstr(log_buf, "FAILED") || strstr(log_buf, "Error") || strstr(log_buf, "error") || 
+               strstr(log_buf, "failure") || strstr(log_buf, "Failure") ||
+               strstr(log_buf, "Temporary failure")) {
+        LOGW("=== SIP MSG [ERROR] *** %s", log_buf);
+    } else if (strstr(log_buf, "next server") || strstr(log_buf, "Next server") || 
+               strstr(log_buf, "will try") || strstr(log_buf, "failover")) {
+        LOGW("=== SIP MSG [FAILOVER] *** %s", log_buf);
+    } else if (strstr(log_buf, "SIP/2.0")) {
+        // Toute ligne contenant SIP/2.0 (request ou response)
+        LOGI("=== SIP MSG [SIP FRAME] %s", log_buf);
+    } else if (strstr(log_buf, "pjsua") || strstr(log_buf, "evsub")) {
+        // Messages PJSIP relatifs à la subscription
+        LOGI("=== SIP LOG [PJSUA] %s", log_buf);
+    } else {
+        // Toutes les autres lignes aussi (ne pas filtrer)
+        LOGI("=== SIP LOG [OTHER] %s", log_buf);
     }
 }
 
@@ -189,13 +1009,19 @@ static void detach_thread(bool did_attach) {
 }
 
 static void emit_event(const char *type, const char *message) {
+    VOIP_TRACE_SCOPE_ARG("jni", "emit_event", type);
+    uint64_t start_us = metric_now_us();
     bool did_attach = false;
     JNIEnv *env = attach_thread(&did_attach);
-    if (!env || !g_engineClass) return;
+    if (!env || !g_engineClass) {
+        metric_inc(MC_EVENTS_DROPPED);
+        return;
+    }
 
     jmethodID mid = env->GetStaticMethodID(g_engineClass, "handleNativeEvent", "(Ljava/lang/String;Ljava/lang/String;)V");
     if (!mid) {
         LOGE("Failed to find handleNativeEvent");
+        metric_inc(MC_EVENTS_DROPPED);
         detach_thread(did_attach);
         return;
     }
@@ -205,132 +1031,970 @@ static void emit_event(const char *type, const char *message) {
     env->DeleteLocalRef(jtype);
     env->DeleteLocalRef(jmsg);
     detach_thread(did_attach);
+    metric_inc(MC_EVENTS_EMITTED);
+    metric_observe(MH_JNI_DISPATCH_US, metric_now_us() - start_us);
 }
 
-static void on_incoming_call(pjsua_acc_id acc_id, pjsua_call_id call_id, pjsip_rx_data *rdata) {
-    (void)acc_id;
-    (void)rdata;
-    
-    LOGI("on_incoming_call: call_id=%d", call_id);
-    
-    pjsua_call_info ci;
-    if (pjsua_call_get_info(call_id, &ci) == PJ_SUCCESS) {
-        LOGI("Incoming call state=%d, media_cnt=%u", ci.state, ci.media_cnt);
+// ----------------------------------------------------------------------------
+// Typed events (see voip_events.h). Once the app has attached the shared ring, events are
+// encoded there and the app is rung with the new write cursor: no string building, no
+// UTF conversion, no parsing. Before that (or when the schemas differ) they fall back to
+// the legacy "type" + "message" strings of emit_event().
+// ----------------------------------------------------------------------------
+#define EVENT_RING_CAPACITY (64 * 1024)
+
+static voip_events::Ring g_app_events;  // Read by PjsipEngine (Kotlin)
+static std::atomic<bool> g_event_ring_attached{false};
+static jmethodID g_on_native_events_mid = nullptr;  // static long onNativeEvents(long writeCursor)
+
+static bool dart_route_event(const voip_events::Event &ev);  // C ABI section
+
+static const char *event_legacy_type(voip_events::EventType type) {
+    switch (type) {
+        case voip_events::EV_INCOMING_CALL:     return "incoming_call";
+        case voip_events::EV_OUTGOING_CALL:     return "outgoing_call";
+        case voip_events::EV_CALL_RINGING:      return "call_ringing";
+        case voip_events::EV_CALL_CONNECTED:    return "call_connected";
+        case voip_events::EV_CALL_ENDED:        return "call_ended";
+        case voip_events::EV_CALL_ERROR:        return "call_error";
+        case voip_events::EV_REGISTRATION:      return "registration";
+        case voip_events::EV_PRESENCE_UPDATED:  return "presence_updated";
+        case voip_events::EV_COMMAND_COMPLETED: return "command_completed";
+        case voip_events::EV_BENCHMARK:         return "benchmark";
+        case voip_events::EV_CALL_SUMMARY:      return "call_summary";
+        case voip_events::EV_PRESENCE_ERROR:    return "presence_error";
+        default:                                return "unknown";
     }
-    
-    char buf[32];
-    pj_ansi_snprintf(buf, sizeof(buf), "%d", call_id);
-    emit_event("incoming_call", buf);
-    pjsua_call_setting opt;
-    pjsua_call_setting_default(&opt);
-    opt.aud_cnt = 1;
-    opt.vid_cnt = 0;
-    
-    pj_status_t status = pjsua_call_answer(call_id, 180, nullptr, nullptr);
-    LOGI("Sent 180 Ringing, status=%d", status);
 }
 
-static void on_call_state(pjsua_call_id call_id, pjsip_event *e) {
-    (void)e;
-    pjsua_call_info ci;
-    if (pjsua_call_get_info(call_id, &ci) != PJ_SUCCESS) return;
-    
-    // Convert state to readable string
-    const char *state_str = "UNKNOWN";
-    if (ci.state == PJSIP_INV_STATE_NULL) state_str = "NULL";
-    else if (ci.state == PJSIP_INV_STATE_CALLING) state_str = "CALLING";
-    else if (ci.state == PJSIP_INV_STATE_INCOMING) state_str = "INCOMING";
-    else if (ci.state == PJSIP_INV_STATE_EARLY) state_str = "EARLY";
-    else if (ci.state == PJSIP_INV_STATE_CONNECTING) state_str = "CONNECTING";
-    else if (ci.state == PJSIP_INV_STATE_CONFIRMED) state_str = "CONFIRMED";
-    else if (ci.state == PJSIP_INV_STATE_DISCONNECTED) state_str = "DISCONNECTED";
-    
-    LOGI("=== CALL STATE: call_id=%d, state=%d(%s), last_status=%d, media_cnt=%u",
-         call_id, ci.state, state_str, ci.last_status, ci.media_cnt);
-    
-    // DEBUG: Capture ALL response codes
-    if (ci.last_status > 0) {
-        LOGI("=== CALL STATE: RESPONSE RECEIVED - code=%d, text=%s",
-             ci.last_status, 
-             ci.last_status_text.ptr ? ci.last_status_text.ptr : "N/A");
-    }
-    
-    // DEBUG: Check for 401 and capture more details
-    if (ci.last_status == 401) {
-        LOGW(">>> CALL STATE: *** 401 UNAUTHORIZED RECEIVED ***");
-        LOGW(">>> CALL STATE: Call ID=%d, state=%s", call_id, state_str);
-        LOGW(">>> CALL STATE: PJSIP should automatically retry with Digest auth from account %d", g_acc_id);
-        LOGW(">>> CALL STATE: Check logs for [TRANSPORT] and [ROUTING] to see how retry is routed");
-        LOGW(">>> CALL STATE: If 'Unsupported transport' error follows, server returned Contact with incompatible transport");
-    }
-    
-    if (ci.state == PJSIP_INV_STATE_CONFIRMED) {
-        LOGI("Call CONFIRMED - call_id=%d, media_cnt=%u", call_id, ci.media_cnt);
-        emit_event("call_connected", std::to_string(call_id).c_str());
-    } else if (ci.state == PJSIP_INV_STATE_CALLING || ci.state == PJSIP_INV_STATE_EARLY) {
-        // Outgoing call is ringing (180 Ringing or 183 Session Progress)
-        LOGI("Call RINGING - call_id=%d, state=%d", call_id, ci.state);
-        emit_event("call_ringing", std::to_string(call_id).c_str());
-    } else if (ci.state == PJSIP_INV_STATE_DISCONNECTED) {
-        LOGI("Call DISCONNECTED - call_id=%d, status=%d, reason=%s", call_id, ci.last_status,
-             ci.last_status_text.ptr ? ci.last_status_text.ptr : "");
-        std::string reason;
-        reason += std::to_string(ci.last_status);
-        reason += " ";
-        reason += std::string(ci.last_status_text.ptr ? ci.last_status_text.ptr : "");
-        std::string payload = std::to_string(call_id) + "|" + reason;
-        emit_event("call_ended", payload.c_str());
-    } else {
-        LOGI("Call state change - call_id=%d, state=%d(%s) (not CONFIRMED/EARLY/DISCONNECTED)", call_id, ci.state, state_str);
+static const char *event_string(const voip_events::Event &ev, int index) {
+    return (index < ev.string_count && ev.strings[index]) ? ev.strings[index] : "";
+}
+
+// Message formats the Kotlin side parsed before the binary protocol
+static std::string event_legacy_message(const voip_events::Event &ev) {
+    char buf[128];
+    switch (ev.type) {
+        case voip_events::EV_CALL_ENDED:
+        case voip_events::EV_BENCHMARK:
+            snprintf(buf, sizeof(buf), "%d|%d ", ev.id, ev.code);
+            return buf + std::string(event_string(ev, 0));
+        case voip_events::EV_CALL_ERROR:
+            return event_string(ev, 0);
+        case voip_events::EV_REGISTRATION: {
+            std::string message = std::to_string(ev.code);
+            if (*event_string(ev, 0)) message += std::string(" ") + event_string(ev, 0);
+            return message;
+        }
+        case voip_events::EV_PRESENCE_UPDATED:
+            return std::string(event_string(ev, 0)) + ":" + event_string(ev, 1);
+        case voip_events::EV_PRESENCE_ERROR:
+            // "status|contact|reason"
+            return std::to_string(ev.code) + "|" + event_string(ev, 0) + "|" + event_string(ev, 1);
+        case voip_events::EV_COMMAND_COMPLETED:
+            snprintf(buf, sizeof(buf), "%lld|%s|%d|%lld|%lld|%d", (long long)ev.v0, event_string(ev, 0), ev.code,
+                     (long long)ev.v1, (long long)ev.v2, ev.id);
+            return buf;
+        case voip_events::EV_CALL_SUMMARY:
+            // "id|status|direction|start_ms|setup_ms|talk_ms|number"
+            snprintf(buf, sizeof(buf), "%d|%d|%s|%lld|%lld|%lld|", ev.id, ev.code, event_string(ev, 0),
+                     (long long)ev.v0, (long long)ev.v1, (long long)ev.v2);
+            return buf + std::string(event_string(ev, 1));
+        default:
+            return std::to_string(ev.id);
     }
 }
 
-static void on_call_media_state(pjsua_call_id call_id) {
-    pjsua_call_info ci;
+static void dispatch_event(const voip_events::Event &ev) {
+    if (dart_route_event(ev)) return;
+    if (!g_event_ring_attached.load(std::memory_order_acquire)) {
+        emit_event(event_legacy_type(ev.type), event_legacy_message(ev).c_str());
+        return;
+    }
+    VOIP_TRACE_SCOPE_ARG("jni", "dispatch_event", event_legacy_type(ev.type));
+    uint64_t start_us = metric_now_us();
+    uint64_t cursor = g_app_events.write(ev);
+    if (!cursor) {
+        LOGW(">>> dispatch_event: event ring full, %s dropped", event_legacy_type(ev.type));
+        metric_inc(MC_EVENTS_DROPPED);
+        return;
+    }
+    bool did_attach = false;
+    JNIEnv *env = attach_thread(&did_attach);
+    if (!env || !g_engineClass) {
+        // Stays in the ring: delivered with the next doorbell, not lost
+        metric_inc(MC_EVENTS_DEFERRED);
+        return;
+    }
+    jlong consumed = env->CallStaticLongMethod(g_engineClass, g_on_native_events_mid, (jlong)cursor);
+    if (env->ExceptionCheck()) {
+        env->ExceptionDescribe();
+        env->ExceptionClear();
+    } else {
+        g_app_events.consume((uint64_t)consumed);
+    }
+    detach_thread(did_attach);
+    metric_inc(MC_EVENTS_EMITTED);
+    metric_observe(MH_JNI_DISPATCH_US, metric_now_us() - start_us);
+}
+
+static void emit_call_event(voip_events::EventType type, pjsua_call_id call_id, int64_t v0 = 0) {
+    voip_events::Event ev;
+    ev.type = type;
+    ev.id = call_id;
+    ev.v0 = v0;
+    dispatch_event(ev);
+}
+
+static void emit_call_ended(pjsua_call_id call_id, int status, const pj_str_t &status_text) {
+    std::string reason(status_text.ptr ? status_text.ptr : "", status_text.ptr ? status_text.slen : 0);
+    voip_events::Event ev;
+    ev.type = voip_events::EV_CALL_ENDED;
+    ev.id = call_id;
+    ev.code = status;
+    ev.string_count = 1;
+    ev.strings[0] = reason.c_str();
+    dispatch_event(ev);
+}
+
+static void emit_registration(pjsua_acc_id acc_id, int status, const std::string &status_text) {
+    voip_events::Event ev;
+    ev.type = voip_events::EV_REGISTRATION;
+    ev.id = acc_id;
+    ev.code = status;
+    ev.string_count = 1;
+    ev.strings[0] = status_text.c_str();
+    dispatch_event(ev);
+}
+
+static void emit_presence(pjsua_buddy_id buddy_id, const std::string &contact, const char *state) {
+    voip_events::Event ev;
+    ev.type = voip_events::EV_PRESENCE_UPDATED;
+    ev.id = buddy_id;
+    ev.string_count = 2;
+    ev.strings[0] = contact.c_str();
+    ev.strings[1] = state;
+    dispatch_event(ev);
+}
+
+// A contact that could not be subscribed for a reason the lifecycle cannot retry away
+static void emit_presence_error(const std::string &contact, pj_status_t status, const char *reason) {
+    voip_events::Event ev;
+    ev.type = voip_events::EV_PRESENCE_ERROR;
+    ev.code = status;
+    ev.string_count = 2;
+    ev.strings[0] = contact.c_str();
+    ev.strings[1] = reason;
+    dispatch_event(ev);
+}
+
+// ----------------------------------------------------------------------------
+// Call records. One per call slot, created when the INVITE is received or sent: parsed
+// remote identity, direction and a monotonic timeline of the call (state transitions,
+// media, accept/hangup requests, end). The record outlives the call until its slot is
+// reused, so the app can still read who called once call_ended has been delivered. A
+// CDR-style EV_CALL_SUMMARY closes every call.
+// ----------------------------------------------------------------------------
+#define CALL_TIMELINE_MAX 32
+
+enum CallMarkKind : uint8_t { CM_INVITE, CM_STATE, CM_MEDIA, CM_ACCEPT, CM_HANGUP, CM_DISCONNECTED };
+static const char *const kCallMarkNames[] = {"invite", "state", "media", "accept", "hangup", "disconnected"};
+
+struct CallMark {
+    uint64_t at_us;
+    CallMarkKind kind;
+    int value;  // Invite state, media status, SIP code
+};
+
+struct CallRecord {
+    bool incoming = false;
+    bool ended = false;
+    int64_t started_wall_ms = 0;
+    uint64_t started_us = 0;
+    uint64_t confirmed_us = 0;
+    uint64_t ended_us = 0;
+    int state = PJSIP_INV_STATE_NULL;
+    std::string remote_info;   // Raw From (incoming) / To (outgoing)
+    std::string display_name;
+    std::string number;
+    int end_status = 0;
+    std::string end_reason;
+    CallMark timeline[CALL_TIMELINE_MAX];
+    unsigned timeline_len = 0;
+    unsigned timeline_dropped = 0;
+};
+
+static std::map<pjsua_call_id, CallRecord> g_call_records;  // g_calls_lock
+
+static const char *inv_state_name(int state) {
+    switch (state) {
+        case PJSIP_INV_STATE_NULL:         return "NULL";
+        case PJSIP_INV_STATE_CALLING:      return "CALLING";
+        case PJSIP_INV_STATE_INCOMING:     return "INCOMING";
+        case PJSIP_INV_STATE_EARLY:        return "EARLY";
+        case PJSIP_INV_STATE_CONNECTING:   return "CONNECTING";
+        case PJSIP_INV_STATE_CONFIRMED:    return "CONFIRMED";
+        case PJSIP_INV_STATE_DISCONNECTED: return "DISCONNECTED";
+        default:                           return "UNKNOWN";
+    }
+}
+
+// "Alice" <sip:100@pbx;user=phone> -> Alice / 100; tel: URIs keep the full number
+static void parse_remote_identity(const std::string &info, std::string *display_name, std::string *number) {
+    display_name->clear();
+    number->clear();
+    size_t lt = info.find('<');
+    if (lt != std::string::npos) {
+        for (char c : info.substr(0, lt)) {
+            if (c != '"' && c != '\'') display_name->push_back(c);
+        }
+        size_t b = display_name->find_first_not_of(" \t");
+        size_t e = display_name->find_last_not_of(" \t");
+        *display_name = b == std::string::npos ? std::string() : display_name->substr(b, e - b + 1);
+    }
+    size_t at = info.find("tel:");
+    const char *stop = ">;";
+    if (at != std::string::npos) {
+        at += 4;
+    } else if ((at = info.find("sip:")) != std::string::npos) {
+        at += 4;
+        stop = "@>;";
+    } else if ((at = info.find("sips:")) != std::string::npos) {
+        at += 5;
+        stop = "@>;";
+    } else {
+        return;
+    }
+    *number = info.substr(at, info.find_first_of(stop, at) - at);
+}
+
+static void call_record_mark_locked(CallRecord &rec, CallMarkKind kind, int value) {
+    if (rec.timeline_len >= CALL_TIMELINE_MAX) {
+        ++rec.timeline_dropped;
+        return;
+    }
+    rec.timeline[rec.timeline_len++] = {metric_now_us(), kind, value};
+}
+
+// Starts a fresh record for the slot (a previous, ended call there is dropped)
+static CallRecord &call_record_begin_locked(pjsua_call_id call_id, const pjsua_call_info &ci) {
+    CallRecord &rec = g_call_records[call_id];
+    rec = CallRecord();
+    rec.incoming = ci.role == PJSIP_ROLE_UAS;
+    rec.started_us = metric_now_us();
+    rec.started_wall_ms = std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::system_clock::now().time_since_epoch()).count();
+    rec.state = ci.state;
+    rec.remote_info.assign(ci.remote_info.ptr ? ci.remote_info.ptr : "", ci.remote_info.ptr ? ci.remote_info.slen : 0);
+    parse_remote_identity(rec.remote_info, &rec.display_name, &rec.number);
+    call_record_mark_locked(rec, CM_INVITE, ci.state);
+    return rec;
+}
+
+// Live record of the call, created on first sight (outgoing calls report CALLING from
+// inside pjsua_call_make_call, before the command knows the call id)
+static CallRecord &call_record_live_locked(pjsua_call_id call_id, const pjsua_call_info &ci) {
+    auto it = g_call_records.find(call_id);
+    if (it == g_call_records.end() || it->second.ended) return call_record_begin_locked(call_id, ci);
+    return it->second;
+}
+
+static void call_record_mark(pjsua_call_id call_id, CallMarkKind kind, int value) {
+    DomainLock lock(g_calls_lock);
+    auto it = g_call_records.find(call_id);
+    if (it != g_call_records.end() && !it->second.ended) call_record_mark_locked(it->second, kind, value);
+}
+
+// Persists the finished call to the memory-mapped call log (voip_cdr.h): a memcpy into the
+// mapping, no file I/O on the SIP worker
+static void call_record_persist(pjsua_call_id call_id, const CallRecord &rec) {
+    voip_cdr::Record cdr = {};
+    uint64_t setup_end = rec.confirmed_us ? rec.confirmed_us : rec.ended_us;
+    cdr.started_ms = rec.started_wall_ms;
+    cdr.setup_ms = (int64_t)((setup_end - rec.started_us) / 1000);
+    cdr.talk_ms = rec.confirmed_us ? (int64_t)((rec.ended_us - rec.confirmed_us) / 1000) : 0;
+    cdr.call_id = call_id;
+    cdr.status = rec.end_status;
+    cdr.incoming = rec.incoming ? 1 : 0;
+    pj_ansi_strncpy(cdr.number, rec.number.c_str(), sizeof(cdr.number) - 1);
+    pj_ansi_strncpy(cdr.display_name, rec.display_name.c_str(), sizeof(cdr.display_name) - 1);
+    pj_ansi_strncpy(cdr.reason, rec.end_reason.c_str(), sizeof(cdr.reason) - 1);
+    if (!voip_cdr::append(cdr)) LOGW(">>> CDR: call log not open, call %d not persisted", call_id);
+}
+
+// CDR: id = call id, code = final SIP status, v0 = start (wall ms), v1 = setup ms
+// (to answer, or to the end if never answered), v2 = talk ms; strings = direction, number
+static void emit_call_summary(pjsua_call_id call_id, const CallRecord &rec) {
+    uint64_t setup_end = rec.confirmed_us ? rec.confirmed_us : rec.ended_us;
+    voip_events::Event ev;
+    ev.type = voip_events::EV_CALL_SUMMARY;
+    ev.id = call_id;
+    ev.code = rec.end_status;
+    ev.v0 = rec.started_wall_ms;
+    ev.v1 = (int64_t)((setup_end - rec.started_us) / 1000);
+    ev.v2 = rec.confirmed_us ? (int64_t)((rec.ended_us - rec.confirmed_us) / 1000) : 0;
+    ev.string_count = 2;
+    ev.strings[0] = rec.incoming ? "incoming" : "outgoing";
+    ev.strings[1] = rec.number.c_str();
+    dispatch_event(ev);
+}
+
+// Idle media, see the "Idle media" section
+static std::mutex g_media_poll_mutex;
+static std::condition_variable g_media_poll_cv;
+static bool g_media_polling = true;                 // g_media_poll_mutex
+static bool g_media_poll_stop = false;              // g_media_poll_mutex
+static std::thread g_media_poll_thread;             // Started by ensure_endpoint, joined by cmd_destroy_endpoint
+static std::atomic<bool> g_media_idle_enabled{true};
+static std::atomic<bool> g_media_parked{false};     // Written by the engine thread
+static std::atomic<uint32_t> g_media_idle_gen{0};   // Bumped by every resume: stale idle timers skip
+
+static std::thread g_media_clock_thread;            // Engine thread
+static std::atomic<bool> g_media_clock_running{false};
+
+static void media_wake_for_incoming();
+static pj_status_t media_attach_null_clock();
+static void media_schedule_idle();
+static void media_poll_thread_main();
+static void media_poll_thread_stop();
+static void media_set_polling(bool polling);
+static void device_probe_create();
+static void device_probe_release();
+
+// Answer path for incoming calls. PJSUA has already created the media transport and the SDP
+// answer when on_incoming_call runs; the provisional response decides when the offer is
+// negotiated and the streams created:
+// - ringing (default): 180 without SDP. Nothing is pre-negotiated: the SDP answer goes out
+//   with the 200, and the offer is negotiated and the streams created only then.
+// - early media: 180 first, so the caller starts its local ringback, then 183 with the SDP
+//   answer; streams are up while ringing and the 200 only confirms them. A caller that gets
+//   early media stops its own ringback, so a ringback tone is played into the call until
+//   CONFIRMED. The mic stays off the bridge until then so it never leaks.
+// Reliable provisionals (100rel/PRACK) are offered per account, see build_account_config.
+enum AnswerMode { ANSWER_RINGING = 0, ANSWER_EARLY_MEDIA = 1 };
+static std::atomic<int> g_answer_mode{ANSWER_RINGING};
+static std::atomic<bool> g_answer_100rel{false};
+
+// Incoming call whose media was negotiated before the 200 (early media), per call slot
+static std::atomic<bool> g_call_prenegotiated[PJSUA_MAX_CALLS];
+
+// Same setting for the provisional and the final answer: a different one makes PJSUA
+// re-initialise the media channel on accept.
+static void incoming_call_setting(pjsua_call_setting *opt) {
+    pjsua_call_setting_default(opt);
+    opt->aud_cnt = 1;
+    opt->vid_cnt = 0;
+}
+
+static bool call_prenegotiated(pjsua_call_id call_id) {
+    return call_id >= 0 && call_id < PJSUA_MAX_CALLS && g_call_prenegotiated[call_id].load(std::memory_order_relaxed);
+}
+
+// Ringback tone toward early media callers (France: 440 Hz, 1.5 s on, 3.5 s off). A port on the
+// bridge with no listener costs nothing: created with the endpoint, released before it goes.
+static pj_pool_t *g_ringback_pool = nullptr;    // Engine thread
+static pjmedia_port *g_ringback_port = nullptr; // Engine thread
+static std::atomic<int> g_ringback_slot{PJSUA_INVALID_ID};
+
+// Engine thread, after pjsua_start()
+static void ringback_create() {
+    pj_pool_t *pool = pjsua_pool_create("ringback", 512, 512);
+    pjmedia_port *port = nullptr;
+    pjsua_conf_port_id slot = PJSUA_INVALID_ID;
+    pj_status_t status = pjmedia_tonegen_create(pool, 8000, 1, 160, 16, 0, &port);
+    if (status == PJ_SUCCESS) {
+        pjmedia_tone_desc desc = {};
+        desc.freq1 = 440;
+        desc.on_msec = 1500;
+        desc.off_msec = 3500;
+        status = pjmedia_tonegen_play(port, 1, &desc, PJMEDIA_TONEGEN_LOOP);
+    }
+    if (status == PJ_SUCCESS) status = pjsua_conf_add_port(pool, port, &slot);
+    if (status != PJ_SUCCESS) {
+        LOGW(">>> RINGBACK: unavailable (%d), early media callers hear silence", status);
+        if (port) pjmedia_port_destroy(port);
+        pj_pool_release(pool);
+        return;
+    }
+    g_ringback_pool = pool;
+    g_ringback_port = port;
+    g_ringback_slot = slot;
+}
+
+// Engine thread, before pjsua_destroy()
+static void ringback_release() {
+    const int slot = g_ringback_slot.exchange(PJSUA_INVALID_ID);
+    if (slot == PJSUA_INVALID_ID) return;
+    pjsua_conf_remove_port(slot);
+    pjmedia_port_destroy(g_ringback_port);
+    pj_pool_release(g_ringback_pool);
+    g_ringback_port = nullptr;
+    g_ringback_pool = nullptr;
+}
+
+// Plays (or stops) the ringback into every active audio stream of the call; one way only
+static void call_ringback(pjsua_call_id call_id, const pjsua_call_info &ci, bool play) {
+    const int tone = g_ringback_slot.load();
+    if (tone == PJSUA_INVALID_ID) return;
+    for (unsigned i = 0; i < ci.media_cnt; ++i) {
+        if (ci.media[i].type != PJMEDIA_TYPE_AUDIO || ci.media[i].status != PJSUA_CALL_MEDIA_ACTIVE) continue;
+        const pjsua_conf_port_id slot = ci.media[i].stream.aud.conf_slot;
+        pj_status_t status = play ? pjsua_conf_connect(tone, slot) : pjsua_conf_disconnect(tone, slot);
+        LOGI("Ringback %s: call_id=%d slot=%d, status=%d", play ? "playing" : "stopped", call_id, slot, status);
+    }
+}
+
+// The 200 OK of an accepted incoming call was sent (or, failing that, its ACK arrived): closes
+// the accept -> 200 measurement started by cmd_accept_call. Only the first caller counts.
+static void call_accept_answered(pjsua_call_id call_id) {
+    if (call_id < 0 || call_id >= PJSUA_MAX_CALLS) return;
+    const uint64_t requested_us = g_call_accept_requested_us[call_id].exchange(0, std::memory_order_relaxed);
+    if (!requested_us) return;
+    const uint64_t latency_us = metric_now_us() - requested_us;
+    metric_observe(MH_ACCEPT_TO_200_US, latency_us);
+    g_call_accept_us[call_id].store(latency_us ? latency_us : 1, std::memory_order_relaxed);
+    LOGI("Call %d: accept->200 %lluus", call_id, (unsigned long long)latency_us);
+}
+
+// Connects every active audio stream of the call to the sound device (playback + capture)
+static void call_connect_audio(pjsua_call_id call_id, const pjsua_call_info &ci) {
+    for (unsigned i = 0; i < ci.media_cnt; ++i) {
+        if (ci.media[i].type != PJMEDIA_TYPE_AUDIO || ci.media[i].status != PJSUA_CALL_MEDIA_ACTIVE) continue;
+        const pjsua_conf_port_id slot = ci.media[i].stream.aud.conf_slot;
+
+        pj_status_t conn1 = pjsua_conf_connect(slot, 0);
+        pj_status_t conn2 = pjsua_conf_connect(0, slot);
+
+        LOGI("Audio connected: call_id=%d slot=%d, results slot->device=%d, device->slot=%d", call_id, slot, conn1, conn2);
+    }
+}
+
+// ---------------------------------------------------------------------------
+// Media encryption (SRTP)
+//
+// Only in builds with VOIP_SRTP (libsrtp + OpenSSL, see build_pjsip.sh PJSIP_SRTP=1). Each
+// account has its own policy, applied when it is next registered: off, optional (RTP/AVP
+// offer with crypto attributes, peers without SRTP still work) or mandatory (RTP/SAVP), keyed
+// with SDES and/or DTLS-SRTP. There is no SIP TLS transport in this build, so SDES keys
+// travel in the clear in the SDP; DTLS-SRTP, offered first, does not depend on signalling.
+//
+// Encryption must fit a CPU budget per call (microseconds per second of call, both
+// directions at 50 packets/s). Once the endpoint is up every suite is measured on synthetic
+// packets (voip_srtp.h) and accounts only offer the suites within the budget, strongest
+// first; when none fits, the cheapest one is offered. The packets of real calls are timed in
+// the libsrtp calls themselves: each one feeds srtp.protect_ns / srtp.unprotect_ns, and each
+// encrypted stream reports what its packets cost to srtp.call_cpu_us_per_s when it ends.
+// ---------------------------------------------------------------------------
+
+#define SRTP_CALIBRATION_PACKETS 200
+
+enum SrtpMode { SRTP_OFF = 0, SRTP_OPTIONAL = 1, SRTP_MANDATORY = 2 };
+
+struct SrtpAccountPolicy {
+    SrtpMode mode = SRTP_OFF;
+    bool dtls = true;
+    bool sdes = true;
+};
+
+static std::map<std::string, SrtpAccountPolicy> g_srtp_policies;  // Accounts domain, "user@domain" → policy
+static std::atomic<uint32_t> g_srtp_budget_us{voip_srtp::kDefaultBudgetUs};
+
+// Suite negotiated per call slot: 1 + index in voip_srtp::kSuites, 0 = clear RTP
+static std::atomic<int> g_call_srtp_suite[PJSUA_MAX_CALLS];
+
+#if defined(VOIP_SRTP) && VOIP_SRTP
+static std::mutex g_srtp_mutex;
+static voip_srtp::SuiteCost g_srtp_costs[voip_srtp::kSuiteCount];  // Guarded by g_srtp_mutex
+static bool g_srtp_calibrated = false;
+static voip_srtp::LiveCost g_call_srtp_live_start[PJSUA_MAX_CALLS];  // Guarded by g_srtp_mutex
+// Held for the whole calibration, and by cmd_destroy_endpoint() around pjsua_destroy(): libsrtp
+// is shut down with pjmedia
+static std::mutex g_srtp_calibration_mutex;
+
+static void srtp_packet_observed(bool protect, uint32_t ns) {
+    metric_observe(protect ? MH_SRTP_PROTECT_NS : MH_SRTP_UNPROTECT_NS, ns);
+}
+
+// Once per process, by ensure_endpoint() after it released g_endpoint_lock: a few milliseconds
+// of libsrtp only. Accounts registered meanwhile offer every suite.
+static void srtp_calibrate() {
+    voip_srtp::set_packet_observer(&srtp_packet_observed);
+    std::lock_guard<std::mutex> calibration(g_srtp_calibration_mutex);
+    {
+        std::lock_guard<std::mutex> lock(g_srtp_mutex);
+        if (g_srtp_calibrated) return;
+    }
+    if (!g_initialized) return;  // Destroyed meanwhile: the next endpoint start calibrates
+    voip_srtp::SuiteCost costs[voip_srtp::kSuiteCount];
+    for (size_t i = 0; i < voip_srtp::kSuiteCount; ++i) {
+        costs[i] = voip_srtp::measure_suite(i, SRTP_CALIBRATION_PACKETS);
+        LOGI(">>> SRTP: %s %s protect=%uns unprotect=%uns (%llu us/s per call)", voip_srtp::kSuites[i],
+             costs[i].available ? "available" : "unavailable", costs[i].protect_ns, costs[i].unprotect_ns,
+             (unsigned long long)voip_srtp::call_cost_us_per_s(costs[i]));
+    }
+    std::lock_guard<std::mutex> lock(g_srtp_mutex);
+    std::copy(costs, costs + voip_srtp::kSuiteCount, g_srtp_costs);
+    g_srtp_calibrated = true;
+}
+
+// Suites to offer (voip_srtp::offered_suites), or every suite before calibration, letting
+// pjmedia decide
+static std::vector<size_t> srtp_offered_suites() {
+    const uint64_t budget = g_srtp_budget_us.load(std::memory_order_relaxed);
+    std::vector<size_t> suites;
+    std::lock_guard<std::mutex> lock(g_srtp_mutex);
+    if (!g_srtp_calibrated) {
+        for (size_t i = 0; i < voip_srtp::kSuiteCount; ++i) suites.push_back(i);
+        return suites;
+    }
+    suites = voip_srtp::offered_suites(g_srtp_costs, budget);
+    if (suites.size() == 1 && voip_srtp::call_cost_us_per_s(g_srtp_costs[suites[0]]) > budget) {
+        LOGW(">>> SRTP: no suite within %llu us/s, offering %s", (unsigned long long)budget, voip_srtp::kSuites[suites[0]]);
+    }
+    return suites;
+}
+
+// Caller must hold g_accounts_lock
+static void srtp_apply_account_policy_locked(const std::string &key, pjsua_acc_config *acc_cfg) {
+    auto it = g_srtp_policies.find(key);
+    if (it == g_srtp_policies.end() || it->second.mode == SRTP_OFF) {
+        acc_cfg->use_srtp = PJMEDIA_SRTP_DISABLED;
+        return;
+    }
+    const SrtpAccountPolicy &policy = it->second;
+    acc_cfg->use_srtp = policy.mode == SRTP_MANDATORY ? PJMEDIA_SRTP_MANDATORY : PJMEDIA_SRTP_OPTIONAL;
+    acc_cfg->srtp_secure_signaling = 0;  // No SIP TLS transport: SDES would otherwise be refused
+    acc_cfg->srtp_optional_dup_offer = PJ_FALSE;
+
+    acc_cfg->srtp_opt.keying_count = 0;
+    if (policy.dtls) acc_cfg->srtp_opt.keying[acc_cfg->srtp_opt.keying_count++] = PJMEDIA_SRTP_KEYING_DTLS_SRTP;
+    if (policy.sdes) acc_cfg->srtp_opt.keying[acc_cfg->srtp_opt.keying_count++] = PJMEDIA_SRTP_KEYING_SDES;
+
+    std::vector<size_t> suites = srtp_offered_suites();
+    acc_cfg->srtp_opt.crypto_count = 0;
+    for (size_t suite : suites) {
+        if (acc_cfg->srtp_opt.crypto_count >= PJ_ARRAY_SIZE(acc_cfg->srtp_opt.crypto)) break;
+        pjmedia_srtp_crypto &crypto = acc_cfg->srtp_opt.crypto[acc_cfg->srtp_opt.crypto_count++];
+        pj_bzero(&crypto, sizeof(crypto));
+        crypto.name = pj_str((char *)voip_srtp::kSuites[suite]);
+    }
+    LOGI(">>> SRTP: %s %s, %s%s%s, %u suite(s), first %s", key.c_str(),
+         policy.mode == SRTP_MANDATORY ? "mandatory" : "optional", policy.dtls ? "dtls" : "",
+         policy.dtls && policy.sdes ? "+" : "", policy.sdes ? "sdes" : "", acc_cfg->srtp_opt.crypto_count,
+         suites.empty() ? "-" : voip_srtp::kSuites[suites[0]]);
+}
+
+// Remembers which suite protects the call's audio, from the negotiated transport
+static void srtp_on_media_state(pjsua_call_id call_id, const pjsua_call_info &ci) {
+    if (call_id < 0 || call_id >= PJSUA_MAX_CALLS) return;
+    for (unsigned i = 0; i < ci.media_cnt; ++i) {
+        if (ci.media[i].type != PJMEDIA_TYPE_AUDIO || ci.media[i].status != PJSUA_CALL_MEDIA_ACTIVE) continue;
+        pjmedia_transport_info tp_info;
+        if (pjsua_call_get_med_transport_info(call_id, i, &tp_info) != PJ_SUCCESS) continue;
+        const pjmedia_srtp_info *srtp =
+            (const pjmedia_srtp_info *)pjmedia_transport_info_get_spc_info(&tp_info, PJMEDIA_TRANSPORT_TYPE_SRTP);
+        const int suite = srtp && srtp->active
+            ? voip_srtp::suite_index(srtp->tx_policy.name.ptr, (size_t)srtp->tx_policy.name.slen) : -1;
+        if (g_call_srtp_suite[call_id].exchange(suite + 1, std::memory_order_relaxed) != suite + 1 && suite >= 0) {
+            {
+                std::lock_guard<std::mutex> lock(g_srtp_mutex);
+                g_call_srtp_live_start[call_id] = voip_srtp::live_cost();
+            }
+            metric_inc(MC_SRTP_CALLS);
+            LOGI(">>> SRTP: call_id=%d audio protected with %s", call_id, voip_srtp::kSuites[suite]);
+        }
+        return;
+    }
+}
+
+// Encryption cost of a finished stream, per second of stream: its packets sent and received
+// times the mean time of the live protect / unprotect calls since it went encrypted (its own
+// packets' when it is the only encrypted call)
+static void srtp_on_stream_destroyed(pjsua_call_id call_id, pjmedia_stream *strm) {
+    if (call_id < 0 || call_id >= PJSUA_MAX_CALLS) return;
+    const int suite = g_call_srtp_suite[call_id].exchange(0, std::memory_order_relaxed) - 1;
+    if (suite < 0) return;
+    pjmedia_rtcp_stat stat;
+    if (pjmedia_stream_get_stat(strm, &stat) != PJ_SUCCESS) return;
+    voip_srtp::LiveCost start;
+    {
+        std::lock_guard<std::mutex> lock(g_srtp_mutex);
+        start = g_call_srtp_live_start[call_id];
+    }
+    const voip_srtp::LiveCost end = voip_srtp::live_cost();
+    const uint64_t protected_packets = end.protect_packets - start.protect_packets;
+    const uint64_t unprotected_packets = end.unprotect_packets - start.unprotect_packets;
+    const uint64_t protect_ns = protected_packets ? (end.protect_ns - start.protect_ns) / protected_packets : 0;
+    const uint64_t unprotect_ns = unprotected_packets ? (end.unprotect_ns - start.unprotect_ns) / unprotected_packets : 0;
+    pj_time_val now;
+    pj_gettimeofday(&now);
+    const int64_t duration_ms = (int64_t)(now.sec - stat.start.sec) * 1000 + (now.msec - stat.start.msec);
+    if (duration_ms <= 0) return;
+    const uint64_t cpu_ns = (uint64_t)stat.tx.pkt * protect_ns + (uint64_t)stat.rx.pkt * unprotect_ns;
+    const uint64_t us_per_s = cpu_ns / (uint64_t)duration_ms;  // ns per ms == us per s
+    metric_observe(MH_SRTP_CALL_CPU_US, us_per_s);
+    const uint32_t budget = g_srtp_budget_us.load(std::memory_order_relaxed);
+    if (us_per_s > budget) metric_inc(MC_SRTP_OVER_BUDGET);
+    LOGI(">>> SRTP: call_id=%d %s tx=%u rx=%u packets, %llu/%llu ns per packet, %llu us/s (budget %u)", call_id,
+         voip_srtp::kSuites[suite], stat.tx.pkt, stat.rx.pkt, (unsigned long long)protect_ns,
+         (unsigned long long)unprotect_ns, (unsigned long long)us_per_s, budget);
+}
+#else
+static void srtp_on_media_state(pjsua_call_id, const pjsua_call_info &) {}
+static void srtp_on_stream_destroyed(pjsua_call_id, pjmedia_stream *) {}
+#endif
+
+// Loopback calls of the PGO training workload (instrumented builds only, voip_pgo.h)
+static bool pgo_workload_account(pjsua_acc_id acc_id) {
+#if defined(VOIP_PGO_GENERATE)
+    return voip_pgo::is_workload_account(acc_id);
+#else
+    (void)acc_id;
+    return false;
+#endif
+}
+
+static void on_incoming_call(pjsua_acc_id acc_id, pjsua_call_id call_id, pjsip_rx_data *rdata) {
+    VOIP_TRACE_SCOPE("pjsua", "on_incoming_call");
+    (void)rdata;
+    if (pgo_workload_account(acc_id)) {
+        pjsua_unlocked_check("pjsua_call_answer");
+        pjsua_call_answer(call_id, 200, nullptr, nullptr);
+        return;
+    }
+    
+    LOGI("on_incoming_call: call_id=%d", call_id);
+    metric_inc(MC_CALLS_INCOMING);
+    metric_call_setup_begin(call_id, metric_now_us());
+    media_wake_for_incoming();
+    
+    pjsua_call_info ci;
+    if (pjsua_call_get_info(call_id, &ci) == PJ_SUCCESS) {
+        LOGI("Incoming call state=%d, media_cnt=%u", ci.state, ci.media_cnt);
+        DomainLock lock(g_calls_lock);
+        call_record_begin_locked(call_id, ci);
+    }
+    
+    emit_call_event(voip_events::EV_INCOMING_CALL, call_id);
+    pjsua_call_setting opt;
+    incoming_call_setting(&opt);
+
+    const bool early_media = g_answer_mode.load(std::memory_order_relaxed) == ANSWER_EARLY_MEDIA;
+    if (call_id >= 0 && call_id < PJSUA_MAX_CALLS) {
+        g_call_accept_us[call_id].store(0, std::memory_order_relaxed);
+        g_call_accept_requested_us[call_id].store(0, std::memory_order_relaxed);
+        g_call_prenegotiated[call_id].store(early_media, std::memory_order_relaxed);
+    }
+    pjsua_unlocked_check("pjsua_call_answer2");
+    pj_status_t status = pjsua_call_answer2(call_id, &opt, 180, nullptr, nullptr);
+    LOGI("Sent 180 Ringing, status=%d", status);
+    if (early_media && status == PJ_SUCCESS) {
+        pjsua_unlocked_check("pjsua_call_answer2");
+        status = pjsua_call_answer2(call_id, &opt, 183, nullptr, nullptr);
+        LOGI("Sent 183 Session Progress (SDP answer), status=%d", status);
+    }
+}
+
+// The INVITE server transaction sends the 2xx of an accepted call: may be well after
+// pjsua_call_answer2() returns (a PRACK still pending, media re-initialised)
+static void on_call_tsx_state(pjsua_call_id call_id, pjsip_transaction *tsx, pjsip_event *e) {
+    VOIP_TRACE_SCOPE("pjsua", "on_call_tsx_state");
+    (void)e;
+    if (tsx->role != PJSIP_ROLE_UAS || tsx->method.id != PJSIP_INVITE_METHOD) return;
+    if (tsx->status_code / 100 != 2 || tsx->state < PJSIP_TSX_STATE_COMPLETED) return;
+    call_accept_answered(call_id);
+}
+
+static void on_call_state(pjsua_call_id call_id, pjsip_event *e) {
+    VOIP_TRACE_SCOPE("pjsua", "on_call_state");
+    (void)e;
+    pjsua_call_info ci;
+    if (pjsua_call_get_info(call_id, &ci) != PJ_SUCCESS) return;
+    
+    const char *state_str = inv_state_name(ci.state);
+    
+    LOGI("=== CALL STATE: call_id=%d, state=%d(%s), last_status=%d, media_cnt=%u",
+         call_id, ci.state, state_str, ci.last_status, ci.media_cnt);
+
+    // The disconnected call is still counted by PJSUA while this callback runs
+    int live_calls = (int)pjsua_call_get_count() - (ci.state == PJSIP_INV_STATE_DISCONNECTED ? 1 : 0);
+    metric_gauge_set(MG_ACTIVE_CALLS, live_calls < 0 ? 0 : live_calls);
+    if (pgo_workload_account(ci.acc_id)) return;
+
+    // Timeline; the summary is emitted (unlocked) after call_ended
+    bool summarize = false;
+    CallRecord summary;
+    {
+        DomainLock lock(g_calls_lock);
+        CallRecord &rec = call_record_live_locked(call_id, ci);
+        if (rec.state != ci.state) call_record_mark_locked(rec, CM_STATE, ci.state);
+        rec.state = ci.state;
+        if (ci.state == PJSIP_INV_STATE_CONFIRMED && !rec.confirmed_us) {
+            rec.confirmed_us = metric_now_us();
+        } else if (ci.state == PJSIP_INV_STATE_DISCONNECTED) {
+            call_record_mark_locked(rec, CM_DISCONNECTED, ci.last_status);
+            rec.ended = true;
+            rec.ended_us = metric_now_us();
+            rec.end_status = ci.last_status;
+            rec.end_reason.assign(ci.last_status_text.ptr ? ci.last_status_text.ptr : "",
+                                  ci.last_status_text.ptr ? ci.last_status_text.slen : 0);
+            summary = rec;
+            summarize = true;
+        }
+    }
+    
+    // DEBUG: Capture ALL response codes
+    if (ci.last_status > 0) {
+        LOGI("=== CALL STATE: RESPONSE RECEIVED - code=%d, text=%s",
+             ci.last_status, 
+             ci.last_status_text.ptr ? ci.last_status_text.ptr : "N/A");
+    }
+    
+    // DEBUG: Check for 401 and capture more details
+    if (ci.last_status == 401) {
+        LOGW(">>> CALL STATE: *** 401 UNAUTHORIZED RECEIVED ***");
+        LOGW(">>> CALL STATE: Call ID=%d, state=%s", call_id, state_str);
+        LOGW(">>> CALL STATE: PJSIP should automatically retry with Digest auth from account %d", ci.acc_id);
+        LOGW(">>> CALL STATE: Check logs for [TRANSPORT] and [ROUTING] to see how retry is routed");
+        LOGW(">>> CALL STATE: If 'Unsupported transport' error follows, server returned Contact with incompatible transport");
+    }
+    
+    if (ci.state == PJSIP_INV_STATE_CONFIRMED) {
+        LOGI("Call CONFIRMED - call_id=%d, media_cnt=%u", call_id, ci.media_cnt);
+        metric_inc(MC_CALLS_CONNECTED);
+        metric_call_setup_end(call_id, true);
+        call_accept_answered(call_id);
+        // Early media streams were kept off the bridge until now
+        if (call_prenegotiated(call_id)) {
+            call_ringback(call_id, ci, false);
+            call_connect_audio(call_id, ci);
+        }
+        uint64_t accept_us = (call_id >= 0 && call_id < PJSUA_MAX_CALLS)
+            ? g_call_accept_us[call_id].exchange(0, std::memory_order_relaxed) : 0;
+        emit_call_event(voip_events::EV_CALL_CONNECTED, call_id, (int64_t)accept_us);
+    } else if (ci.state == PJSIP_INV_STATE_CALLING || ci.state == PJSIP_INV_STATE_EARLY) {
+        // Outgoing call is ringing (180 Ringing or 183 Session Progress)
+        LOGI("Call RINGING - call_id=%d, state=%d", call_id, ci.state);
+        emit_call_event(voip_events::EV_CALL_RINGING, call_id);
+    } else if (ci.state == PJSIP_INV_STATE_DISCONNECTED) {
+        LOGI("Call DISCONNECTED - call_id=%d, status=%d, reason=%s", call_id, ci.last_status,
+             ci.last_status_text.ptr ? ci.last_status_text.ptr : "");
+        metric_call_setup_end(call_id, false);
+        if (call_id >= 0 && call_id < PJSUA_MAX_CALLS) {
+            g_call_prenegotiated[call_id].store(false, std::memory_order_relaxed);
+            g_call_accept_us[call_id].store(0, std::memory_order_relaxed);
+            g_call_accept_requested_us[call_id].store(0, std::memory_order_relaxed);
+        }
+        emit_call_ended(call_id, ci.last_status, ci.last_status_text);
+        if (summarize) {
+            call_record_persist(call_id, summary);
+            emit_call_summary(call_id, summary);
+        }
+        if (live_calls <= 0) media_schedule_idle();
+    } else {
+        LOGI("Call state change - call_id=%d, state=%d(%s) (not CONFIRMED/EARLY/DISCONNECTED)", call_id, ci.state, state_str);
+    }
+}
+
+static void on_call_media_state(pjsua_call_id call_id) {
+    VOIP_TRACE_SCOPE("pjsua", "on_call_media_state");
+    pjsua_call_info ci;
     if (pjsua_call_get_info(call_id, &ci) != PJ_SUCCESS) return;
     
     LOGI("on_call_media_state: call_id=%d, state=%d, media_cnt=%u", call_id, ci.state, ci.media_cnt);
+    if (pgo_workload_account(ci.acc_id)) return;  // Null audio: never bridged
+    call_record_mark(call_id, CM_MEDIA, ci.media_status);
+    srtp_on_media_state(call_id, ci);
     
     for (unsigned i = 0; i < ci.media_cnt; ++i) {
         if (ci.media[i].type == PJMEDIA_TYPE_AUDIO) {
             LOGI("Media %u: type=AUDIO, status=%d", i, ci.media[i].status);
             
-            if (ci.media[i].status == PJSUA_CALL_MEDIA_ACTIVE) {
-                // Connect call audio to sound device (playback + capture).
-                const pjsua_conf_port_id slot = ci.media[i].stream.aud.conf_slot;
-                
-                pj_status_t conn1 = pjsua_conf_connect(slot, 0);
-                pj_status_t conn2 = pjsua_conf_connect(0, slot);
-                
-                LOGI("Audio connected: slot=%d, results slot->device=%d, device->slot=%d", slot, conn1, conn2);
-            } else if (ci.media[i].status == PJSUA_CALL_MEDIA_ERROR) {
+            if (ci.media[i].status == PJSUA_CALL_MEDIA_ERROR) {
                 LOGE("Media ERROR on call %d", call_id);
-            } else {
+            } else if (ci.media[i].status != PJSUA_CALL_MEDIA_ACTIVE) {
                 LOGI("Media status on call %d: %d (not active yet)", call_id, ci.media[i].status);
             }
         }
     }
+
+    // Negotiated on the 183: the stream runs, but is only bridged once the call is answered.
+    // Until then the caller hears our ringback.
+    if (call_prenegotiated(call_id) && ci.state != PJSIP_INV_STATE_CONFIRMED) {
+        LOGI("on_call_media_state: call_id=%d media ready during early media, bridge deferred", call_id);
+        call_ringback(call_id, ci, true);
+        return;
+    }
+    call_connect_audio(call_id, ci);
+}
+
+// Jitter buffer statistics are only complete once the stream stops: fold them into the metrics
+static void on_stream_destroyed(pjsua_call_id call_id, pjmedia_stream *strm, unsigned stream_idx) {
+    VOIP_TRACE_SCOPE("pjsua", "on_stream_destroyed");
+    srtp_on_stream_destroyed(call_id, strm);
+    pjmedia_jb_state jb;
+    if (pjmedia_stream_get_stat_jbuf(strm, &jb) != PJ_SUCCESS) return;
+    metric_inc(MC_AUDIO_UNDERRUNS, jb.empty);
+    metric_inc(MC_AUDIO_JB_LOST, jb.lost);
+    metric_inc(MC_AUDIO_JB_DISCARD, jb.discard);
+    LOGI("on_stream_destroyed: call_id=%d stream=%u jb empty=%u lost=%u discard=%u avg_delay=%ums",
+         call_id, stream_idx, jb.empty, jb.lost, jb.discard, jb.avg_delay);
 }
 
 static void on_reg_state(pjsua_acc_id acc_id) {
+    VOIP_TRACE_SCOPE("pjsua", "on_reg_state");
     pjsua_acc_info info;
     if (pjsua_acc_get_info(acc_id, &info) != PJ_SUCCESS) return;
     std::string status_text;
     if (info.status_text.ptr && info.status_text.slen > 0) {
         status_text.assign(info.status_text.ptr, info.status_text.slen);
     }
-    std::string message = std::to_string(info.status);
-    if (!status_text.empty()) {
-        message += " ";
-        message += status_text;
+    // The app tracks the registration of the active account only; the others are background tenants.
+    // Read from the snapshot: this callback can fire synchronously from pjsua_acc_add()
+    // while nativeRegister still holds the accounts lock.
+    bool is_active = (acc_id == active_account_snapshot()->acc_id);
+    LOGI(">>> on_reg_state: acc_id=%d (%.*s) active=%d -> %d %s", acc_id, (int)info.acc_uri.slen, info.acc_uri.ptr,
+         is_active, info.status, status_text.c_str());
+    reg_retry_on_state(acc_id, info);
+    if (is_active) {
+        emit_registration(acc_id, info.status, status_text);
+        // Un-REGISTER (expires 0) is not a recovery
+        if (info.expires > 0 || info.status / 100 != 2) {
+            presence_lifecycle_on_registered(acc_id, info.status / 100 == 2);
+        }
+    }
+}
+
+static BlfState blf_state_from_name(const char *name) {
+    for (size_t i = BLF_OFFLINE; i < PJ_ARRAY_SIZE(kBlfStateNames); ++i) {
+        if (strcmp(name, kBlfStateNames[i]) == 0) return (BlfState)i;
+    }
+    return BLF_OFFLINE;
+}
+
+// Caller must hold g_presence_lock
+static void presence_publish_locked(PresenceCacheEntry &entry, BlfState state, uint8_t source) {
+    pj_time_val now;
+    pj_gettimeofday(&now);
+    entry.state = state;
+    entry.source = source;
+    entry.removed = false;
+    entry.updated_us = (int64_t)now.sec * 1000000 + (int64_t)now.msec * 1000;
+    entry.version = ++g_presence_version;
+    entry.emitted++;
+    metric_inc(MC_PRESENCE_EMITTED);
+}
+
+struct PresenceDebounce {
+    pj_timer_entry timer;
+    std::string contact;
+};
+
+// Endpoint timer: publishes a debounced transition unless something superseded it meanwhile
+static void presence_debounce_fired(pj_timer_heap_t *, pj_timer_entry *timer) {
+    std::unique_ptr<PresenceDebounce> debounce(static_cast<PresenceDebounce *>(timer->user_data));
+    pjsua_buddy_id buddy_id;
+    BlfState state;
+    {
+        DomainLock lock(g_presence_lock);
+        auto it = g_presence_cache.find(debounce->contact);
+        // Superseded or cancelled while already firing: the canceller left it to us
+        if (it == g_presence_cache.end() || it->second.pending_timer != debounce.get()) return;
+        PresenceCacheEntry &entry = it->second;
+        entry.pending_timer = nullptr;
+        presence_publish_locked(entry, entry.pending, entry.pending_source);
+        entry.pending = BLF_UNKNOWN;
+        buddy_id = entry.buddy_id;
+        state = entry.state;
+    }
+    emit_presence(buddy_id, debounce->contact, kBlfStateNames[state]);
+}
+
+// Caller must hold g_presence_lock (the timer heap calls presence_debounce_fired() without its
+// own lock, so cancelling under it is safe). Drops the held transition and frees its timer
+// entry, unless it is already firing: presence_debounce_fired() frees it then.
+static void presence_debounce_cancel_locked(PresenceCacheEntry &entry) {
+    PresenceDebounce *pending = entry.pending_timer;
+    entry.pending = BLF_UNKNOWN;
+    entry.pending_timer = nullptr;
+    if (pending && pjsip_endpt_cancel_timer(pjsua_get_pjsip_endpt(), &pending->timer) > 0) delete pending;
+}
+
+// Endpoint shutdown: no debounce timer may outlive the timer heap
+static void presence_debounce_cancel_all() {
+    DomainLock lock(g_presence_lock);
+    for (auto &entry : g_presence_cache) presence_debounce_cancel_locked(entry.second);
+}
+
+// Caller must hold g_presence_lock. Per-contact lamp state machine fed by every buddy
+// callback, dialog-event NOTIFY and resource-list entity:
+//   - BLF_UNKNOWN (subscription SENT/ACCEPTED/PENDING, refresh in flight) keeps the lamp
+//   - the published state again (refreshes, NOTIFYs repeating the state) is dropped
+//   - entering ringing from a known state waits g_presence_debounce_ms; a newer update in
+//     that window replaces it (early → confirmed shows busy only)
+//   - anything else is published at once
+// Returns true when the caller must emit presence_updated with the entry's new state.
+static bool presence_transition_locked(const std::string &contact, pjsua_buddy_id buddy_id, BlfState next,
+                                       PresenceSource source, pjsip_evsub_state sub_state) {
+    PresenceCacheEntry &entry = g_presence_cache[contact];
+    entry.buddy_id = buddy_id;
+    entry.sub_state = (uint8_t)sub_state;
+    if (next == BLF_UNKNOWN) {
+        entry.suppressed++;
+        metric_inc(MC_PRESENCE_SUPPRESSED);
+        return false;
+    }
+    if (entry.pending != BLF_UNKNOWN) {
+        // The held transition never reaches the app
+        presence_debounce_cancel_locked(entry);
+        entry.suppressed++;
+        metric_inc(MC_PRESENCE_DEBOUNCED);
+    }
+    if (!entry.removed && entry.state == next) {
+        entry.suppressed++;
+        metric_inc(MC_PRESENCE_SUPPRESSED);
+        return false;
+    }
+    unsigned debounce_ms = g_presence_debounce_ms.load(std::memory_order_relaxed);
+    if (next == BLF_RINGING && debounce_ms > 0 && !entry.removed && entry.state != BLF_UNKNOWN) {
+        // Endpoint timer rather than pjsua_schedule_timer2(): it only takes the timer heap
+        // lock, while pjsua's would take PJSUA_LOCK under the presence lock
+        auto *debounce = new PresenceDebounce{{}, contact};
+        pj_timer_entry_init(&debounce->timer, 0, debounce, &presence_debounce_fired);
+        pj_time_val delay = {(long)(debounce_ms / 1000), (long)(debounce_ms % 1000)};
+        if (pjsip_endpt_schedule_timer(pjsua_get_pjsip_endpt(), &debounce->timer, &delay) == PJ_SUCCESS) {
+            entry.pending = next;
+            entry.pending_source = source;
+            entry.pending_timer = debounce;
+            return false;
+        }
+        delete debounce;
     }
-    emit_event("registration", message.c_str());
+    presence_publish_locked(entry, next, source);
+    return true;
 }
 
-static std::map<pjsua_buddy_id, int> g_buddy_callback_counter;  // Track how many times on_buddy_state is called per buddy
+// Caller must hold g_presence_lock and have already dropped buddy_id from g_buddy_reverse_map.
+// Leaves a tombstone unless another account still watches the same contact.
+static void presence_cache_remove_locked(const std::string &contact) {
+    for (const auto &other : g_buddy_reverse_map) {
+        if (other.second == contact) return;
+    }
+    auto it = g_presence_cache.find(contact);
+    if (it == g_presence_cache.end() || it->second.removed) return;
+    pj_time_val now;
+    pj_gettimeofday(&now);
+    it->second.removed = true;
+    it->second.buddy_id = PJSUA_INVALID_ID;
+    presence_debounce_cancel_locked(it->second);
+    it->second.updated_us = (int64_t)now.sec * 1000000 + (int64_t)now.msec * 1000;
+    it->second.version = ++g_presence_version;
+}
 
 // Helper function to map PJSUA buddy status to presence string (includes ringing, busy, etc.)
-static const char* map_buddy_status_to_presence(pjsua_buddy_status status, const pj_str_t *status_text) {
+static const char* map_buddy_status_to_presence(pjsua_buddy_status status, const pj_str_t *status_text,
+                                                PresenceSource *source) {
+    *source = PRESENCE_SRC_STATUS_TEXT;
     // PJSUA_BUDDY_STATUS enum values:
     // PJSUA_BUDDY_STATUS_ONLINE    = 1
     // PJSUA_BUDDY_STATUS_OFFLINE   = 2
@@ -363,6 +2027,7 @@ static const char* map_buddy_status_to_presence(pjsua_buddy_status status, const
     }
     
     // Fall back to status enum
+    *source = PRESENCE_SRC_BASIC;
     switch (status) {
         case PJSUA_BUDDY_STATUS_ONLINE:   return "available";
         case PJSUA_BUDDY_STATUS_OFFLINE:  return "offline";
@@ -370,133 +2035,53 @@ static const char* map_buddy_status_to_presence(pjsua_buddy_status status, const
     }
 }
 
-// Helper function to parse dialog-info+xml and extract state
-static const char* parse_dialog_state_from_xml(const char* xml_body, int xml_len) {
-    if (!xml_body || xml_len <= 0) {
-        LOGW(">>> parse_dialog_state_from_xml: No XML body provided");
-        return nullptr;
-    }
-    
-    // Log the received XML for debugging
-    char xml_snippet[512];
-    int snippet_len = (xml_len < 500) ? xml_len : 500;
-    strncpy(xml_snippet, xml_body, snippet_len);
-    xml_snippet[snippet_len] = '\0';
-    LOGI(">>> parse_dialog_state_from_xml: Received XML (first %d bytes): %s", xml_len, xml_snippet);
-    
-    // Look for <state>...</state> tag
-    const char* state_start = strstr(xml_body, "<state>");
-    if (!state_start) {
-        LOGW(">>> parse_dialog_state_from_xml: No <state> tag found in XML");
-        return nullptr;
-    }
-    
-    state_start += 7;  // Skip "<state>"
-    const char* state_end = strstr(state_start, "</state>");
-    if (!state_end) {
-        LOGW(">>> parse_dialog_state_from_xml: No closing </state> tag found");
-        return nullptr;
-    }
-    
-    // Extract state value
-    int state_len = state_end - state_start;
-    static char state_value[128];
-    if (state_len >= 128) {
-        LOGW(">>> parse_dialog_state_from_xml: State value too long: %d", state_len);
-        return nullptr;
+// Dialog-event NOTIFY for a BLF buddy: pjsua has parsed the dialog-info+xml body into the
+// buddy's dialog-event info. The lamp state it maps to is kept in g_buddy_last_dialog_state
+// (on_buddy_state prefers it to the status text) and published as PRESENCE_SRC_NOTIFY_BODY.
+static void on_buddy_dlg_event_state(pjsua_buddy_id buddy_id) {
+    VOIP_TRACE_SCOPE("pjsua", "on_buddy_dlg_event_state");
+    metric_inc(MC_NOTIFY_PROCESSED);
+
+    pjsua_buddy_dlg_event_info dlg_info;
+    if (pjsua_buddy_get_dlg_event_info(buddy_id, &dlg_info) != PJ_SUCCESS) {
+        LOGW(">>> on_buddy_dlg_event_state: no dialog-event info for buddy_id=%d", buddy_id);
+        return;
     }
-    strncpy(state_value, state_start, state_len);
-    state_value[state_len] = '\0';
-    
-    LOGI(">>> parse_dialog_state_from_xml: Extracted dialog state: '%s'", state_value);
-    
-    // Map dialog state to presence state
-    if (strcmp(state_value, "terminated") == 0) {
-        LOGI(">>> parse_dialog_state_from_xml: Dialog terminated → presence='available' (no call)");
-        return "available";
-    } else if (strcmp(state_value, "early") == 0) {
-        LOGI(">>> parse_dialog_state_from_xml: Dialog early → presence='ringing' (call alerting)");
-        return "ringing";
-    } else if (strcmp(state_value, "confirmed") == 0) {
-        LOGI(">>> parse_dialog_state_from_xml: Dialog confirmed → presence='busy' (call active)");
-        return "busy";
-    } else {
-        LOGW(">>> parse_dialog_state_from_xml: Unknown dialog state '%s', defaulting to 'available'", state_value);
-        return "available";
+    const std::string dialog_state(dlg_info.dialog_state.ptr, dlg_info.dialog_state.slen);
+    const std::string presence = voip_rls::dialog_presence(dialog_state);
+    LOGI(">>> on_buddy_dlg_event_state: buddy_id=%d sub_state=%s dialog state='%s' → %s", buddy_id,
+         dlg_info.sub_state_name ? dlg_info.sub_state_name : "?", dialog_state.c_str(), presence.c_str());
+
+    // Copied out, the event is emitted unlocked
+    std::string contact, state;
+    {
+        DomainLock lock(g_presence_lock);
+        if (dlg_info.sub_state != PJSIP_EVSUB_STATE_ACTIVE) {
+            // No body worth keeping; the subscription lifecycle handles the lamp
+            g_buddy_last_dialog_state.erase(buddy_id);
+            return;
+        }
+        auto contact_it = g_buddy_reverse_map.find(buddy_id);
+        if (contact_it == g_buddy_reverse_map.end()) return;
+        g_buddy_last_dialog_state[buddy_id] = presence;
+        contact = contact_it->second;
+        BlfState next = blf_state_from_name(presence.c_str());
+        if (!presence_transition_locked(contact, buddy_id, next, PRESENCE_SRC_NOTIFY_BODY, dlg_info.sub_state)) {
+            return;
+        }
+        state = kBlfStateNames[next];
     }
+    LOGI(">>> on_buddy_dlg_event_state: Emitting presence_updated: %s:%s", contact.c_str(), state.c_str());
+    emit_presence(buddy_id, contact, state.c_str());
 }
 
-// Callback for buddy dialog event (dialog-info+xml events from NOTIFY)
-// Signature must be: void callback(pjsua_buddy_id buddy_id)
-static void on_buddy_dlg_event_state(pjsua_buddy_id buddy_id) {
-    LOGI(">>> on_buddy_dlg_event_state: Dialog event for buddy_id=%d", buddy_id);
+static void on_buddy_state(pjsua_buddy_id buddy_id) {
+    VOIP_TRACE_SCOPE("pjsua", "on_buddy_state");
+    metric_inc(MC_NOTIFY_PROCESSED);
     
-    // Get buddy info to check if there's dialog state data available
     pjsua_buddy_info buddy_info;
     pjsua_buddy_get_info(buddy_id, &buddy_info);
     
-    // Check if we have stored dialog state from NOTIFY
-    std::lock_guard<std::mutex> lock(g_mutex);
-    auto state_it = g_buddy_last_dialog_state.find(buddy_id);
-    if (state_it != g_buddy_last_dialog_state.end()) {
-        const char *presence_state = state_it->second.c_str();
-        LOGI(">>> on_buddy_dlg_event_state: Found dialog state '%s' for buddy_id=%d", presence_state, buddy_id);
-        
-        // Find contact URI from our subscription map
-        for (const auto &sub : g_buddy_subscriptions) {
-            if (sub.second == buddy_id) {
-                std::string event_data = sub.first + ":" + presence_state;
-                LOGI(">>> on_buddy_dlg_event_state: Emitting presence_updated: %s", event_data.c_str());
-                
-                JNIEnv *env = nullptr;
-                if (g_vm && g_vm->AttachCurrentThread(&env, nullptr) == 0 && g_engineClass && g_engine_instance) {
-                    jmethodID mid = env->GetMethodID(g_engineClass, "notifyPresenceUpdated", "(Ljava/lang/String;)V");
-                    if (mid) {
-                        jstring java_event = env->NewStringUTF(event_data.c_str());
-                        env->CallVoidMethod(g_engine_instance, mid, java_event);
-                        env->DeleteLocalRef(java_event);
-                        LOGI(">>> on_buddy_dlg_event_state: Event sent to Dart");
-                    }
-                }
-                break;
-            }
-        }
-    } else {
-        LOGI(">>> on_buddy_dlg_event_state: No stored dialog state for buddy_id=%d", buddy_id);
-    }
-}
-
-// PJSIP module definition for NOTIFY interception (kept but not used - on_buddy_dlg_event_state is primary)
-static pjsip_module mod_notify_handler = {
-    NULL, NULL,                              // prev, next
-    { (char*)"mod-notify-handler", 18 },    // name
-    -1,                                      // priority
-    PJSIP_MOD_PRIORITY_APPLICATION,         // priority
-    NULL,                          // load()
-    NULL,                          // start()
-    NULL,                          // stop()
-    NULL,                          // unload()
-    NULL,                          // on_rx_request() - Not used, using on_buddy_dlg_event_state instead
-    NULL,                          // on_rx_response()
-    NULL,                          // on_tx_request()
-    NULL,                          // on_tx_response()
-    NULL,                          // on_tsx_state()
-};
-
-static void on_buddy_state(pjsua_buddy_id buddy_id) {
-    // This callback is called by PJSUA when buddy state changes
-    // Log IMMEDIATELY to verify callback is being invoked at all
-    __android_log_write(ANDROID_LOG_INFO, "PjsipNative", ">>> on_buddy_state: ===== CALLBACK FIRED ===== (logging BEFORE any logic)");
-    LOGI(">>> on_buddy_state: ===== CALLBACK FIRED for buddy_id=%d =====", buddy_id);
-    
-    pjsua_buddy_info buddy_info;
-    pjsua_buddy_get_info(buddy_id, &buddy_info);
-    
-    // Compter les appels au callback
-    g_buddy_callback_counter[buddy_id]++;
-    int call_count = g_buddy_callback_counter[buddy_id];
-    LOGI(">>> on_buddy_state: This is call #%d for buddy_id=%d", call_count, buddy_id);
-    
     // Convertir sub_state en string lisible
     const char *sub_state_str = "UNKNOWN";
     switch (buddy_info.sub_state) {
@@ -509,38 +2094,20 @@ static void on_buddy_state(pjsua_buddy_id buddy_id) {
         default:                           sub_state_str = "UNKNOWN"; break;
     }
     
-    // SIP TRACE: Afficher le code de statut SIP (401, 200, etc.)
-    LOGI("=== SIP TRACE: on_buddy_state CALL #%d: buddy_id=%d, sub_state=%d(%s), sip_status=%d", 
-         call_count, buddy_id, buddy_info.sub_state, sub_state_str, buddy_info.status);
-    
-    LOGI("=== SIP TRACE: IMPORTANT: This is callback invocation #%d for this buddy (server must have responded)", call_count);
-    LOGI("=== SIP TRACE: on_buddy_state DEBUG: uri=%s, monitor_pres=%d, status_text=%s",
-         buddy_info.uri.ptr ? buddy_info.uri.ptr : "N/A",
-         buddy_info.monitor_pres,
-         buddy_info.status_text.ptr ? buddy_info.status_text.ptr : "N/A");
-    
-    // CRITICAL: Si status=0, cela signifie "pas de réponse SIP reçue du tout"
-    // buddy_info.status contient le type pjsua_buddy_status (enum) et ne peut pas être comparé directement avec des codes HTTP
-    // On se fie à sub_state pour déterminer l'état réel
-    if (buddy_info.sub_state == PJSIP_EVSUB_STATE_SENT) {
-        LOGI("=== SIP TRACE: sub_state=SENT (waiting for server response with credentials from acc_id=%d)", g_acc_id);
-    } else if (buddy_info.sub_state == PJSIP_EVSUB_STATE_ACTIVE) {
-        LOGI("=== SIP TRACE: sub_state=ACTIVE - Server accepted SUBSCRIBE ✓");
-    } else if (buddy_info.sub_state == PJSIP_EVSUB_STATE_TERMINATED) {
-        LOGW("=== SIP TRACE: sub_state=TERMINATED - Server ended subscription");
-    }
+    LOGI(">>> on_buddy_state: buddy_id=%d sub_state=%s status=%d", buddy_id, sub_state_str, buddy_info.status);
     
     // Parser le status de présence
     const char *presence_status = "offline";
+    PresenceSource presence_source = PRESENCE_SRC_SUBSCRIPTION;
+    std::string stored_dialog_state;  // Outlives the branch below: presence_status may point into it
     if (buddy_info.sub_state == PJSIP_EVSUB_STATE_ACTIVE) {
         // Subscription is active - use the status field and status_text to determine presence
-        presence_status = map_buddy_status_to_presence(buddy_info.status, &buddy_info.status_text);
+        presence_status = map_buddy_status_to_presence(buddy_info.status, &buddy_info.status_text, &presence_source);
         
         // Check if we have a more accurate dialog state from a recent NOTIFY
         // Copy the dialog state string while holding the lock to avoid use-after-free
-        std::string stored_dialog_state;
         {
-            std::lock_guard<std::mutex> lock_dialog(g_mutex);
+            DomainLock lock_dialog(g_presence_lock);
             auto dialog_it = g_buddy_last_dialog_state.find(buddy_id);
             if (dialog_it != g_buddy_last_dialog_state.end() && !dialog_it->second.empty()) {
                 stored_dialog_state = dialog_it->second;  // Copy the string
@@ -550,6 +2117,7 @@ static void on_buddy_state(pjsua_buddy_id buddy_id) {
         if (!stored_dialog_state.empty()) {
             LOGI(">>> on_buddy_state: Found stored dialog state from NOTIFY: '%s' (overriding status-based '%s')", stored_dialog_state.c_str(), presence_status);
             presence_status = stored_dialog_state.c_str();
+            presence_source = PRESENCE_SRC_NOTIFY_BODY;
         }
         
         LOGI(">>> on_buddy_state: Subscription ACTIVE ✓ → presence_status=%s (buddy_status=%d)", presence_status, buddy_info.status);
@@ -559,42 +2127,300 @@ static void on_buddy_state(pjsua_buddy_id buddy_id) {
             LOGI(">>> on_buddy_state: status_text: %.*s", (int)buddy_info.status_text.slen, buddy_info.status_text.ptr);
         }
     } else if (buddy_info.sub_state == PJSIP_EVSUB_STATE_SENT) {
-        LOGI(">>> on_buddy_state: Subscription SENT - PJSIP will retry with acc_id=%d credentials if needed", g_acc_id);
+        LOGI(">>> on_buddy_state: Subscription SENT - PJSIP will retry with the owning account credentials if needed");
     } else {
         LOGI(">>> on_buddy_state: Subscription state=%s (not SENT, not ACTIVE) → monitoring...", sub_state_str);
     }
     
-    // Lookup du contact depuis la reverse map
-    std::lock_guard<std::mutex> lock(g_mutex);
+    // SENT/ACCEPTED/PENDING (subscription or refresh in flight) say nothing about the lamp
+    BlfState next = BLF_UNKNOWN;
+    if (buddy_info.sub_state == PJSIP_EVSUB_STATE_ACTIVE) {
+        next = blf_state_from_name(presence_status);
+    } else if (buddy_info.sub_state == PJSIP_EVSUB_STATE_TERMINATED) {
+        next = BLF_OFFLINE;
+    }
+    
+    // Lookup du contact depuis la reverse map, puis machine d'état (seules les vraies transitions sont émises)
     std::string contact = "";
-    auto it = g_buddy_reverse_map.find(buddy_id);
-    if (it != g_buddy_reverse_map.end()) {
-        contact = it->second;
+    bool publish = false;
+    {
+        DomainLock lock(g_presence_lock);
+        auto it = g_buddy_reverse_map.find(buddy_id);
+        if (it != g_buddy_reverse_map.end()) {
+            contact = it->second;
+            presence_lifecycle_on_state_locked(contact, buddy_info);
+            publish = presence_transition_locked(contact, buddy_id, next, presence_source, buddy_info.sub_state);
+        }
+    }
+    if (!publish) {
+        LOGI(">>> on_buddy_state: no lamp change for %s (%s), not emitted", contact.c_str(), sub_state_str);
+        return;
     }
     
-    // Émettre l'event
-    char event_data[256];
-    pj_ansi_snprintf(event_data, sizeof(event_data), "%s:%s", contact.c_str(), presence_status);
-    LOGI(">>> Emitting presence_updated: %s (contact=%s, state=%s)", event_data, contact.c_str(), presence_status);
-    emit_event("presence_updated", event_data);
+    // Émettre l'event (sans verrou)
+    LOGI(">>> Emitting presence_updated: contact=%s, state=%s", contact.c_str(), kBlfStateNames[next]);
+    emit_presence(buddy_id, contact, kBlfStateNames[next]);
 }
 
-static bool ensure_endpoint() {
-    ensure_pj_thread_registered("jni");
-    std::lock_guard<std::mutex> lock(g_mutex);
-    if (g_initialized) return true;
+// ---------------------------------------------------------------------------
+// Memory profile
+//
+// pjsua_config_default() / pjsua_media_config_default() are sized for desktop softphones,
+// and whatever they reserve stays resident in the foreground service. The profile picked
+// before init (nativeSetMemoryProfile) caps the call slots and conference bridge ports,
+// and makes pool reuse explicit: pjsua creates its caching pool with a 0-byte cache, so
+// every pool released at the end of a call or subscription goes back to malloc and the
+// next call allocates it again. With pool_cache_bytes, released pools are reset and kept
+// on the factory free lists for the next call, up to that budget. The static pjsua call and
+// account tables (PJSUA_MAX_CALLS / PJSUA_MAX_ACC) are capped in config_site.h.
+// ---------------------------------------------------------------------------
+struct MemoryProfile {
+    const char *name;
+    unsigned max_calls;          // pjsua_config.max_calls, 0 = pjsua default
+    unsigned max_media_ports;    // Bridge slots (sound device + one per call + spare), 0 = pjsua default
+    pj_size_t pool_cache_bytes;  // Released pool blocks kept for reuse
+};
+static const MemoryProfile kMemoryProfiles[] = {
+    {"compact", 3, 8, 256 * 1024},  // Active call, held/consulted call and one incoming
+    {"standard", 0, 0, 1024 * 1024},
+};
+static std::atomic<const MemoryProfile *> g_memory_profile{&kMemoryProfiles[1]};  // "standard" until the app opts in
+
+// Caching pool behind pjsua_get_pool_factory(): the factory is its first member
+static pj_caching_pool *memory_caching_pool() {
+    return reinterpret_cast<pj_caching_pool *>(pjsua_get_pool_factory());
+}
+
+// ---------------------------------------------------------------------------
+// Threading profile
+//
+// sip_workers is pjsua's SIP worker count (read when the endpoint is created). With
+// media_clock the conference bridge is clocked by our own thread instead of the null sound
+// device's pjmedia clock, whose "highest priority" request is a no-op under SCHED_OTHER; that
+// thread reports every late tick (media.tick_late_us); during calls the sound device's callback
+// clocks the bridge and its late ticks go to media.device_tick_late_us. The media threads (clock and ioqueue
+// poll) get audio-class scheduling when audio_priority is set, SCHED_FIFO if the process may,
+// nice -19 (URGENT_AUDIO) otherwise, and optional big/little core affinity, applied when they
+// start. The defaults are pjsua's: one worker, pjmedia's clock, no priority change.
+// ---------------------------------------------------------------------------
+#define MEDIA_THREAD_NICE -19
+#define MEDIA_THREAD_FIFO_PRIORITY 2
+
+struct ThreadingProfile {
+    unsigned sip_workers;
+    bool media_clock;
+    bool audio_priority;
+    voip_sched::CoreClass media_cores;
+};
+
+static std::mutex g_threading_mutex;
+static ThreadingProfile g_threading = {1, false, false, voip_sched::CORES_ANY};  // g_threading_mutex
+
+static ThreadingProfile threading_profile() {
+    std::lock_guard<std::mutex> lock(g_threading_mutex);
+    return g_threading;
+}
+
+// Called by a media thread on itself when it starts
+static void threading_apply_media(const char *name) {
+    ThreadingProfile profile = threading_profile();
+    bool pinned = voip_sched::set_current_thread_cores(profile.media_cores);
+    voip_sched::PriorityResult prio = voip_sched::PRIO_UNCHANGED;
+    if (profile.audio_priority) {
+        prio = voip_sched::raise_current_thread_priority(MEDIA_THREAD_NICE, MEDIA_THREAD_FIFO_PRIORITY);
+    }
+    LOGI(">>> THREADS: %s thread scheduling=%s pinned=%d", name, voip_sched::priority_result_name(prio), pinned);
+}
+
+// ---------------------------------------------------------------------------
+// DNS resolver + persistent SRV/A cache
+//
+// PJSIP only performs SRV lookups (and server failover across the resolved
+// targets, ordered by priority and weighted per RFC 2782) when a resolver is
+// configured through ua_cfg.nameserver. Android does not expose resolv.conf,
+// so the nameservers are pushed from Kotlin (LinkProperties) before init.
+//
+// The resolver already keeps a TTL-respecting in-process cache. We mirror every
+// SRV/A answer we obtain into g_dns_cache (voip_dns.h) and persist it, so that a cold start
+// can inject the still-valid records back into the resolver cache
+// (pj_dns_resolver_add_entry) and send the first REGISTER without a network
+// round trip. NAPTR is not used: we only run a UDP transport, and PJSIP
+// resolves _sip._udp SRV directly in that case.
+// ---------------------------------------------------------------------------
+#define DNS_MAX_NAMESERVERS 4
+
+static_assert(voip_dns::kTypeA == PJ_DNS_TYPE_A && voip_dns::kTypeSrv == PJ_DNS_TYPE_SRV, "voip_dns record types");
+
+static std::mutex g_dns_mutex;
+static std::vector<std::string> g_dns_servers;      // Nameservers pushed from Kotlin
+static std::string g_dns_cache_path;                // Persisted cache file (app private dir)
+static voip_dns::Cache g_dns_cache;                 // Mirror of resolved SRV/A records (voip_dns.h)
+// pj_str_t storage for ua_cfg.nameserver (must outlive pjsua_init)
+static char g_dns_server_bufs[DNS_MAX_NAMESERVERS][64];
+
+static long dns_now_sec() {
+    pj_time_val now;
+    pj_gettimeofday(&now);
+    return now.sec;
+}
+
+// Caller must hold g_dns_mutex
+static void dns_cache_save_locked() {
+    if (g_dns_cache_path.empty()) return;
+    if (!g_dns_cache.save(g_dns_cache_path, dns_now_sec())) {
+        LOGW(">>> DNS CACHE: cannot write %s", g_dns_cache_path.c_str());
+    }
+}
+
+// Caller must hold g_dns_mutex
+static void dns_cache_load_locked() {
+    size_t loaded = g_dns_cache.load(g_dns_cache_path, dns_now_sec());
+    if (!g_dns_cache_path.empty()) {
+        LOGI(">>> DNS CACHE: loaded %zu unexpired records from %s", loaded, g_dns_cache_path.c_str());
+    }
+}
+
+// SRV and A records of a resolver answer section, expiring ttl seconds after now
+static std::vector<voip_dns::Record> dns_records_of(const pj_dns_parsed_rr *rrs, unsigned count, long now) {
+    std::vector<voip_dns::Record> records;
+    for (unsigned i = 0; i < count; ++i) {
+        const pj_dns_parsed_rr &rr = rrs[i];
+        voip_dns::Record rec;
+        rec.name.assign(rr.name.ptr, rr.name.slen);
+        rec.type = rr.type;
+        rec.expires_at = now + (long)rr.ttl;
+        if (rr.type == PJ_DNS_TYPE_SRV) {
+            rec.prio = rr.rdata.srv.prio;
+            rec.weight = rr.rdata.srv.weight;
+            rec.port = rr.rdata.srv.port;
+            rec.target.assign(rr.rdata.srv.target.ptr, rr.rdata.srv.target.slen);
+        } else if (rr.type == PJ_DNS_TYPE_A) {
+            rec.ipv4 = rr.rdata.a.ip_addr.s_addr;
+        } else {
+            continue;
+        }
+        records.push_back(rec);
+    }
+    return records;
+}
+
+// Inject the persisted records into the PJSIP resolver cache (one entry per name/type).
+static void dns_cache_inject(pj_dns_resolver *resolver) {
+    if (!resolver) return;
+    std::lock_guard<std::mutex> lock(g_dns_mutex);
+    long now = dns_now_sec();
+    const voip_dns::Groups groups = g_dns_cache.unexpired(now);
+    unsigned injected = 0;
+    for (const auto &group : groups) {
+        std::vector<pj_dns_parsed_rr> answers(group.second.size());
+        for (size_t i = 0; i < group.second.size(); ++i) {
+            const voip_dns::Record *rec = &group.second[i];
+            pj_dns_parsed_rr &rr = answers[i];
+            pj_bzero(&rr, sizeof(rr));
+            rr.name = pj_str_t{const_cast<char *>(rec->name.c_str()), static_cast<pj_ssize_t>(rec->name.size())};
+            rr.type = rec->type;
+            rr.dnsclass = PJ_DNS_CLASS_IN;
+            rr.ttl = static_cast<pj_uint32_t>(rec->expires_at - now);
+            if (rec->type == PJ_DNS_TYPE_SRV) {
+                rr.rdata.srv.prio = rec->prio;
+                rr.rdata.srv.weight = rec->weight;
+                rr.rdata.srv.port = rec->port;
+                rr.rdata.srv.target = pj_str_t{const_cast<char *>(rec->target.c_str()),
+                                               static_cast<pj_ssize_t>(rec->target.size())};
+            } else {
+                rr.rdata.a.ip_addr.s_addr = rec->ipv4;
+            }
+        }
+        pj_dns_parsed_packet pkt;
+        pj_bzero(&pkt, sizeof(pkt));
+        pkt.hdr.flags = PJ_DNS_SET_QR(1) | PJ_DNS_SET_RD(1) | PJ_DNS_SET_RA(1);
+        pkt.hdr.anscount = static_cast<pj_uint16_t>(answers.size());
+        pkt.ans = answers.data();
+        // set_ttl=PJ_TRUE: the resolver expires the entry with the remaining TTL
+        if (pj_dns_resolver_add_entry(resolver, &pkt, PJ_TRUE) == PJ_SUCCESS) injected++;
+    }
+    LOGI(">>> DNS CACHE: injected %u cached name/type entries into PJSIP resolver", injected);
+}
+
+static void dns_start_query(const std::string &name, int type);
+
+static void on_dns_prewarm_result(void *user_data, pj_status_t status, pj_dns_parsed_packet *response) {
+    VOIP_TRACE_SCOPE("pjsua", "on_dns_prewarm_result");
+    int qtype = static_cast<int>(reinterpret_cast<intptr_t>(user_data));
+    if (status != PJ_SUCCESS || !response) {
+        LOGW(">>> DNS PREWARM: query type=%d failed: %d", qtype, status);
+        return;
+    }
+    std::vector<std::string> unresolved_targets;
+    {
+        std::lock_guard<std::mutex> lock(g_dns_mutex);
+        long now = dns_now_sec();
+        const std::vector<voip_dns::Record> answers = dns_records_of(response->ans, response->hdr.anscount, now);
+        g_dns_cache.store(answers);
+        g_dns_cache.store(dns_records_of(response->arr, response->hdr.arcount, now));
+        // SRV targets not covered by the additional section need their own A lookup
+        unresolved_targets = g_dns_cache.srv_targets_without_a(answers);
+        dns_cache_save_locked();
+        LOGI(">>> DNS PREWARM: type=%d answers=%u additional=%u, cache now %zu records",
+             qtype, response->hdr.anscount, response->hdr.arcount, g_dns_cache.records().size());
+    }
+    for (const auto &target : unresolved_targets) {
+        dns_start_query(target, PJ_DNS_TYPE_A);
+    }
+}
+
+static void dns_start_query(const std::string &name, int type) {
+    pjsip_endpoint *endpt = pjsua_get_pjsip_endpt();
+    pj_dns_resolver *resolver = endpt ? pjsip_endpt_get_resolver(endpt) : nullptr;
+    if (!resolver) return;
+    pj_str_t qname = pj_str_t{const_cast<char *>(name.c_str()), static_cast<pj_ssize_t>(name.size())};
+    pj_status_t status = pj_dns_resolver_start_query(resolver, &qname, type, 0, &on_dns_prewarm_result,
+                                                     reinterpret_cast<void *>(static_cast<intptr_t>(type)), nullptr);
+    if (status != PJ_SUCCESS) {
+        LOGW(">>> DNS PREWARM: start_query(%s, type=%d) failed: %d", name.c_str(), type, status);
+    }
+}
 
+// Warm the resolver for a SIP domain: SRV for _sip._udp, plus the bare A record (RFC 3263 fallback).
+static void dns_prewarm_domain(const char *domain) {
+    if (!domain || !*domain) return;
+    {
+        std::lock_guard<std::mutex> lock(g_dns_mutex);
+        if (g_dns_servers.empty()) return;
+    }
+    pj_str_t host = pj_str(const_cast<char *>(domain));
+    pj_in_addr numeric;
+    if (pj_inet_aton(&host, &numeric) || domain[0] == '[') return;  // IP literal: nothing to resolve
+    LOGI(">>> DNS PREWARM: resolving _sip._udp.%s and %s", domain, domain);
+    dns_start_query(std::string("_sip._udp.") + domain, PJ_DNS_TYPE_SRV);
+    dns_start_query(domain, PJ_DNS_TYPE_A);
+}
+
+// Caller holds g_endpoint_lock
+static bool endpoint_start_locked() {
     pj_status_t status = pjsua_create();
     if (status != PJ_SUCCESS) {
         LOGE("pjsua_create failed");
         return false;
     }
 
+    // Before pjsua_init(), which creates pjsua's own pools from this factory: the budget
+    // applies to every pool released from then on
+    const MemoryProfile *profile = g_memory_profile.load();
+    memory_caching_pool()->max_capacity = profile->pool_cache_bytes;
+
     pjsua_config ua_cfg;
     pjsua_config_default(&ua_cfg);
+    if (profile->max_calls) ua_cfg.max_calls = profile->max_calls;
+    const ThreadingProfile threading = threading_profile();
+    ua_cfg.thread_cnt = threading.sip_workers;
+    LOGI(">>> THREADS: %u SIP worker(s), media clock=%s", ua_cfg.thread_cnt,
+         threading.media_clock ? "own thread" : "pjmedia");
     ua_cfg.cb.on_incoming_call = &on_incoming_call;
     ua_cfg.cb.on_call_state = &on_call_state;
+    ua_cfg.cb.on_call_tsx_state = &on_call_tsx_state;
     ua_cfg.cb.on_call_media_state = &on_call_media_state;
+    ua_cfg.cb.on_stream_destroyed = &on_stream_destroyed;
     ua_cfg.cb.on_reg_state = &on_reg_state;
     ua_cfg.cb.on_buddy_state = &on_buddy_state;  // Callback PJSIP natif pour présence
     ua_cfg.cb.on_buddy_dlg_event_state = &on_buddy_dlg_event_state;  // Callback for dialog-info+xml events
@@ -602,11 +2428,24 @@ static bool ensure_endpoint() {
     static const pj_str_t kUserAgent = pj_str(const_cast<char *>("CelyaVox Mobile"));
     ua_cfg.user_agent = kUserAgent;
 
+    // Enable the PJSIP resolver (SRV + weighted failover) when Kotlin supplied nameservers
+    {
+        std::lock_guard<std::mutex> dns_lock(g_dns_mutex);
+        ua_cfg.nameserver_count = 0;
+        for (const auto &server : g_dns_servers) {
+            if (ua_cfg.nameserver_count >= DNS_MAX_NAMESERVERS) break;
+            char *buf = g_dns_server_bufs[ua_cfg.nameserver_count];
+            pj_ansi_snprintf(buf, sizeof(g_dns_server_bufs[0]), "%s", server.c_str());
+            ua_cfg.nameserver[ua_cfg.nameserver_count++] = pj_str(buf);
+        }
+        LOGI(">>> DNS: %u nameserver(s) configured for PJSIP resolver", ua_cfg.nameserver_count);
+    }
+
     pjsua_logging_config log_cfg;
     pjsua_logging_config_default(&log_cfg);
-    log_cfg.console_level = 6;  // TRACE level (maximum verbosity - shows ALL SIP messages)
-    log_cfg.level = 6;          // File level aussi - captures everything
-    log_cfg.msg_logging = PJ_TRUE;  // Activer logging des messages SIP
+    log_cfg.console_level = VOIP_PJSIP_LOG_LEVEL;
+    log_cfg.level = VOIP_PJSIP_LOG_LEVEL;
+    log_cfg.msg_logging = PJ_FALSE;  // Messages complets dans la capture SIP (nativeExportSipCapture)
     log_cfg.decor = PJ_LOG_HAS_SENDER | PJ_LOG_HAS_LEVEL_TEXT | PJ_LOG_HAS_MICRO_SEC;  // Include microseconds for timing
     LOGI(">>> pjsua_logging_config: console_level=%d, level=%d, msg_logging=%d", log_cfg.console_level, log_cfg.level, log_cfg.msg_logging);
 
@@ -618,6 +2457,10 @@ static bool ensure_endpoint() {
     media_cfg.clock_rate = 8000;
     media_cfg.snd_clock_rate = 8000;
     media_cfg.enable_ice = PJ_FALSE;
+    media_cfg.thread_cnt = 0;  // The media ioqueue is polled by media_poll_thread_main, parked between calls
+    if (profile->max_media_ports) media_cfg.max_media_ports = profile->max_media_ports;
+    LOGI(">>> MEMORY: profile %s, max_calls=%u, max_media_ports=%u, pool cache=%zu bytes", profile->name,
+         ua_cfg.max_calls, media_cfg.max_media_ports, (size_t)profile->pool_cache_bytes);
 
     status = pjsua_init(&ua_cfg, &log_cfg, &media_cfg);
     if (status != PJ_SUCCESS) {
@@ -626,30 +2469,45 @@ static bool ensure_endpoint() {
         return false;
     }
 
-    // CRITICAL: Enable custom logging AFTER pjsua_init() so PJSIP is ready to dispatch logs
-    LOGI("=== SIP TRACING ENABLED: Registering custom PJSIP logger callback AFTER init");
+    // Our logger replaces pjsua's once pjsua_init() has applied log_cfg
     pj_log_set_log_func(&pjsip_log_callback);
-    pj_log_set_level(6);  // Level 6 = maximum debug (DBG) - highest verbosity
-    LOGI(">>> pjsua_init: PJSIP log level set to 6 (DEBUG) for maximum detailed debugging");
-    LOGI(">>> pjsua_init: Custom log callback registered - all PJSIP messages will now be captured");
-    
-    // VERIFICATION: Confirm log level is really 6
-    pj_log_set_level(6);  // Set again to ensure it sticks
-    LOGI(">>> CRITICAL VERIFICATION: Log level RECONFIRMED to 6 - all modules should now produce full debug traces");
-    LOGI(">>> If you don't see many more RAW CALLBACK messages, the logging config is being overridden");
+    pj_log_set_level(VOIP_PJSIP_LOG_LEVEL);
+    LOGI(">>> pjsua_init: PJSIP log level %d, logged through pjsip_log_callback", VOIP_PJSIP_LOG_LEVEL);
+
+    // SDP rewrite rules: defaults unless Kotlin already pushed a spec
+    {
+        std::lock_guard<std::mutex> sdp_lock(g_sdp_mutex);
+        if (!g_sdp_rules_configured) {
+            g_sdp_rules = sdp_parse_rules(kDefaultSdpRules);
+            g_sdp_rules_configured = true;
+        }
+        sdp_apply_header_rules(g_sdp_rules);
+        LOGI(">>> SDP RULES: %zu rule(s) active", g_sdp_rules.size());
+    }
+
+    // Pre-warm the resolver with the records persisted by a previous run
+    if (ua_cfg.nameserver_count > 0) {
+        {
+            std::lock_guard<std::mutex> dns_lock(g_dns_mutex);
+            dns_cache_load_locked();
+        }
+        dns_cache_inject(pjsip_endpt_get_resolver(pjsua_get_pjsip_endpt()));
+    }
 
-    // Register PJSIP module to intercept NOTIFY messages
+    // Register the PJSIP modules (SIP counters, capture, resource lists)
     {
         pjsip_endpoint *endpt = pjsua_get_pjsip_endpt();
         LOGI(">>> MODULE_INIT: pjsua_get_pjsip_endpt() returned: %p", (void*)endpt);
         if (endpt) {
-            status = pjsip_endpt_register_module(endpt, &mod_notify_handler);
-            LOGI(">>> MODULE_INIT: pjsip_endpt_register_module() returned status=%d (PJ_SUCCESS=0)", status);
-            if (status == PJ_SUCCESS) {
-                LOGI(">>> MODULE_INIT: ✓ PJSIP module registered successfully for NOTIFY interception");
+            if (pjsip_endpt_register_module(endpt, &mod_metrics) == PJ_SUCCESS) {
+                g_mod_metrics_id = mod_metrics.id;
             } else {
-                LOGW(">>> MODULE_INIT: ✗ Failed to register PJSIP module: %d", status);
+                LOGW(">>> MODULE_INIT: metrics module not registered, SIP counters stay at 0");
             }
+            if (pjsip_endpt_register_module(endpt, &mod_sip_capture) != PJ_SUCCESS) {
+                LOGW(">>> MODULE_INIT: SIP capture module not registered, exports will be empty");
+            }
+            rls_init_module(endpt);
         } else {
             LOGW(">>> MODULE_INIT: ✗ Could not get PJSIP endpoint (endpt is NULL)");
         }
@@ -686,6 +2544,8 @@ static bool ensure_endpoint() {
         pjsua_destroy();
         return false;
     }
+    ringback_create();
+    device_probe_create();
 
     // FORCE CODEC: Set ALAW as the only codec with highest priority
     // DISABLED - causes SIGSEGV crash at pjsua_codec_set_priority
@@ -707,13 +2567,32 @@ static bool ensure_endpoint() {
     LOGI(">>> CODEC CONFIG: PCMU (ULAW) priority set to 0 (disabled)");
     */
 
-    // Initialize with null audio device to avoid showing microphone indicator at app startup
-    // Real audio devices will be set later via refreshAudio() when a call is actually made
-    pj_status_t null_status = pjsua_set_null_snd_dev();
-    if (null_status != PJ_SUCCESS) {
-        char errbuf[128];
-        pj_strerror(null_status, errbuf, sizeof(errbuf));
-        LOGW("set_null_snd_dev failed: %d (%s)", null_status, errbuf);
+    {
+        std::lock_guard<std::mutex> lock(g_media_poll_mutex);
+        g_media_poll_stop = false;
+    }
+    try {
+        g_media_poll_thread = std::thread(media_poll_thread_main);
+    } catch (const std::system_error &e) {
+        LOGE("media poll thread not started: %s", e.what());
+        pjsua_destroy();
+        return false;
+    }
+
+    // No sound device at app startup (no microphone indicator, no bridge clock): the first
+    // call attaches the null device and refreshAudio() the real one. Still under the endpoint
+    // lock: no command reaches the sound device before g_initialized is set.
+    if (g_media_idle_enabled) {
+        pjsua_set_no_snd_dev();
+        g_media_parked = true;
+        media_set_polling(false);
+    } else {
+        pj_status_t null_status = media_attach_null_clock();
+        if (null_status != PJ_SUCCESS) {
+            char errbuf[128];
+            pj_strerror(null_status, errbuf, sizeof(errbuf));
+            LOGW("set_null_snd_dev failed: %d (%s)", null_status, errbuf);
+        }
     }
     g_audio_ready = true;
 
@@ -722,8 +2601,167 @@ static bool ensure_endpoint() {
     return true;
 }
 
+static bool ensure_endpoint() {
+    ensure_pj_thread_registered("jni");
+    if (g_initialized) return true;  // Fast path, no lock once the endpoint is up
+    VOIP_TRACE_SCOPE("endpoint", "ensure_endpoint");
+    {
+        DomainLock lock(g_endpoint_lock);
+        if (g_initialized) return true;
+        if (!endpoint_start_locked()) return false;
+    }
+#if defined(VOIP_SRTP) && VOIP_SRTP
+    srtp_calibrate();
+#endif
+    return true;
+}
+
+// ---------------------------------------------------------------------------
+// Command queue. Every mutating JNI entry point enqueues a command and returns a request
+// id right away; a single engine thread, registered with PJLIB and attached to the JVM once,
+// runs the commands in FIFO order (so refreshAudio queued before makeCall still runs first).
+// Completion is reported with a "command_completed" event: "id|name|ok|wait_us|exec_us|result",
+// where result is what the command produced (the call id of make_call) or, when it failed,
+// why (a pj_status_t); -1 when it has nothing to report.
+// ---------------------------------------------------------------------------
+
+struct EngineCommand {
+    jlong request_id = 0;
+    const char *name = "";                 // Static string, also the stats key
+    std::function<bool()> run;
+    std::chrono::steady_clock::time_point enqueued_at;
+};
+
+struct CommandStats {
+    uint64_t count = 0;
+    uint64_t failures = 0;
+    uint64_t wait_total_us = 0;
+    uint64_t wait_max_us = 0;
+    uint64_t exec_total_us = 0;
+    uint64_t exec_max_us = 0;
+};
+
+static std::mutex g_cmd_mutex;
+static std::condition_variable g_cmd_cv;
+static std::deque<EngineCommand> g_cmd_queue;
+static std::map<std::string, CommandStats> g_cmd_stats;
+static jlong g_cmd_next_id = 1;
+static bool g_cmd_thread_started = false;
+static thread_local int32_t t_cmd_result = -1;  // Result of the command running on the engine thread
+
+// Returns ok, reporting result with the completion of the running command
+static bool command_done(bool ok, int32_t result) {
+    t_cmd_result = result;
+    return ok;
+}
+
+static void cmd_record_stats_locked(const EngineCommand &cmd, bool ok, uint64_t wait_us, uint64_t exec_us) {
+    CommandStats &st = g_cmd_stats[cmd.name];
+    st.count++;
+    if (!ok) st.failures++;
+    st.wait_total_us += wait_us;
+    st.exec_total_us += exec_us;
+    if (wait_us > st.wait_max_us) st.wait_max_us = wait_us;
+    if (exec_us > st.exec_max_us) st.exec_max_us = exec_us;
+    LOGI(">>> engine: #%lld %s ok=%d wait=%lluus exec=%lluus (n=%llu avg_wait=%lluus max_wait=%lluus avg_exec=%lluus max_exec=%lluus)",
+         (long long)cmd.request_id, cmd.name, ok ? 1 : 0,
+         (unsigned long long)wait_us, (unsigned long long)exec_us, (unsigned long long)st.count,
+         (unsigned long long)(st.wait_total_us / st.count), (unsigned long long)st.wait_max_us,
+         (unsigned long long)(st.exec_total_us / st.count), (unsigned long long)st.exec_max_us);
+}
+
+static void engine_thread_main() {
+    // Stay attached for the lifetime of the thread: dispatch_event() then never pays an attach/detach
+    bool did_attach = false;
+    attach_thread(&did_attach);
+    LOGI(">>> engine: command thread started (jvm attached=%d)", did_attach ? 1 : 0);
+    VOIP_TRACE_THREAD_NAME("engine");
+
+    for (;;) {
+        EngineCommand cmd;
+        {
+            std::unique_lock<std::mutex> lock(g_cmd_mutex);
+            g_cmd_cv.wait(lock, [] { return !g_cmd_queue.empty(); });
+            cmd = std::move(g_cmd_queue.front());
+            g_cmd_queue.pop_front();
+            metric_gauge_set(MG_COMMAND_QUEUE_DEPTH, (int64_t)g_cmd_queue.size());
+        }
+
+        // pjsua_create() may not have run yet when the first command arrives; ensure_endpoint()
+        // inside the command registers the thread in that case.
+        if (g_initialized) ensure_pj_thread_registered("engine");
+
+        auto started = std::chrono::steady_clock::now();
+        bool ok = false;
+        t_cmd_result = -1;
+        {
+            VOIP_TRACE_SCOPE("engine", cmd.name);
+            VOIP_TRACE_FLOW_END("engine", cmd.name, (uint64_t)cmd.request_id);
+            try {
+                ok = cmd.run();
+            } catch (const std::exception &e) {
+                LOGE(">>> engine: command %s threw: %s", cmd.name, e.what());
+            }
+        }
+        auto finished = std::chrono::steady_clock::now();
+        uint64_t wait_us = std::chrono::duration_cast<std::chrono::microseconds>(started - cmd.enqueued_at).count();
+        uint64_t exec_us = std::chrono::duration_cast<std::chrono::microseconds>(finished - started).count();
+        metric_observe(MH_COMMAND_WAIT_US, wait_us);
+        metric_observe(MH_COMMAND_EXEC_US, exec_us);
+        {
+            std::lock_guard<std::mutex> lock(g_cmd_mutex);
+            cmd_record_stats_locked(cmd, ok, wait_us, exec_us);
+        }
+
+        voip_events::Event ev;
+        ev.type = voip_events::EV_COMMAND_COMPLETED;
+        ev.id = t_cmd_result;
+        ev.code = ok ? 1 : 0;
+        ev.v0 = cmd.request_id;
+        ev.v1 = (int64_t)wait_us;
+        ev.v2 = (int64_t)exec_us;
+        ev.string_count = 1;
+        ev.strings[0] = cmd.name;
+        dispatch_event(ev);
+    }
+}
+
+// Returns the request id, or -1 if the engine thread could not be started
+static jlong submit_command(const char *name, std::function<bool()> run) {
+    std::lock_guard<std::mutex> lock(g_cmd_mutex);
+    if (!g_cmd_thread_started) {
+        try {
+            std::thread(engine_thread_main).detach();
+        } catch (const std::system_error &e) {
+            LOGE(">>> engine: cannot start command thread: %s", e.what());
+            return -1;
+        }
+        g_cmd_thread_started = true;
+    }
+    EngineCommand cmd;
+    cmd.request_id = g_cmd_next_id++;
+    cmd.name = name;
+    cmd.run = std::move(run);
+    cmd.enqueued_at = std::chrono::steady_clock::now();
+    jlong id = cmd.request_id;
+    VOIP_TRACE_FLOW_BEGIN("engine", name, (uint64_t)id);
+    g_cmd_queue.push_back(std::move(cmd));
+    metric_gauge_set(MG_COMMAND_QUEUE_DEPTH, (int64_t)g_cmd_queue.size());
+    g_cmd_cv.notify_one();
+    return id;
+}
+
+static std::string jstring_to_std(JNIEnv *env, jstring jstr) {
+    if (!jstr) return std::string();
+    const char *chars = env->GetStringUTFChars(jstr, nullptr);
+    std::string out(chars ? chars : "");
+    if (chars) env->ReleaseStringUTFChars(jstr, chars);
+    return out;
+}
+
 extern "C" JNIEXPORT jboolean JNICALL
 Java_fr_celya_celyavox_PjsipEngine_nativeInit(JNIEnv *env, jobject obj) {
+    VOIP_TRACE_SCOPE("jni", "nativeInit");
     __android_log_write(ANDROID_LOG_INFO, "PjsipNative", ">>> nativeInit: FUNCTION CALLED");
     LOGI(">>> nativeInit: FUNCTION CALLED - starting PJSIP initialization");
     ensure_pj_thread_registered("jni");
@@ -743,212 +2781,1113 @@ Java_fr_celya_celyavox_PjsipEngine_nativeInit(JNIEnv *env, jobject obj) {
     return ensure_endpoint() ? JNI_TRUE : JNI_FALSE;
 }
 
-extern "C" JNIEXPORT jboolean JNICALL
-Java_fr_celya_celyavox_PjsipEngine_nativeRefreshAudio(JNIEnv *, jobject) {
-    ensure_pj_thread_registered("jni");
-    if (!ensure_endpoint()) return JNI_FALSE;
-    std::lock_guard<std::mutex> lock(g_mutex);
-    
-    LOGI("Refreshing audio devices");
-    
-    // Get current audio device info
-    pjmedia_aud_dev_index current_cap_dev, current_play_dev;
-    pjsua_snd_get_setting(PJMEDIA_AUD_DEV_CAP_OUTPUT_ROUTE, &current_play_dev);
-    pjsua_snd_get_setting(PJMEDIA_AUD_DEV_CAP_INPUT_ROUTE, &current_cap_dev);
-    LOGI("Current audio devices: capture=%d, playback=%d", current_cap_dev, current_play_dev);
-    
-    pj_status_t status = pjsua_set_snd_dev(PJMEDIA_AUD_DEFAULT_CAPTURE_DEV, PJMEDIA_AUD_DEFAULT_PLAYBACK_DEV);
-    
-    LOGI("pjsua_set_snd_dev result: %d", status);
-    if (status != PJ_SUCCESS) {
-        char errbuf[128];
-        pj_strerror(status, errbuf, sizeof(errbuf));
-        LOGE("Failed to set audio device: %d (%s). Falling back to null sound device.", status, errbuf);
-        pj_status_t null_status = pjsua_set_null_snd_dev();
-        if (null_status != PJ_SUCCESS) {
-            pj_strerror(null_status, errbuf, sizeof(errbuf));
-            LOGE("set_null_snd_dev also failed: %d (%s)", null_status, errbuf);
-            return JNI_FALSE;
+extern "C" JNIEXPORT void JNICALL
+Java_fr_celya_celyavox_PjsipEngine_nativeConfigureDns(JNIEnv *env, jobject, jobjectArray jservers, jstring jcachePath) {
+    VOIP_TRACE_SCOPE("jni", "nativeConfigureDns");
+    std::vector<std::string> servers;
+    jsize count = jservers ? env->GetArrayLength(jservers) : 0;
+    for (jsize i = 0; i < count && servers.size() < DNS_MAX_NAMESERVERS; ++i) {
+        jstring jserver = static_cast<jstring>(env->GetObjectArrayElement(jservers, i));
+        if (!jserver) continue;
+        const char *server = env->GetStringUTFChars(jserver, nullptr);
+        if (server && *server) servers.emplace_back(server);
+        env->ReleaseStringUTFChars(jserver, server);
+        env->DeleteLocalRef(jserver);
+    }
+    const char *cache_path = jcachePath ? env->GetStringUTFChars(jcachePath, nullptr) : nullptr;
+
+    bool initialized;
+    {
+        DomainLock lock(g_endpoint_lock);
+        initialized = g_initialized;
+    }
+    {
+        std::lock_guard<std::mutex> lock(g_dns_mutex);
+        g_dns_servers = servers;
+        if (cache_path) g_dns_cache_path = cache_path;
+    }
+    LOGI(">>> nativeConfigureDns: %zu nameserver(s), cache=%s, endpoint_initialized=%d",
+         servers.size(), cache_path ? cache_path : "(none)", initialized);
+    if (cache_path) env->ReleaseStringUTFChars(jcachePath, cache_path);
+
+    // Network change after init: point the live resolver at the new nameservers
+    if (initialized && !servers.empty()) {
+        ensure_pj_thread_registered("jni");
+        pjsip_endpoint *endpt = pjsua_get_pjsip_endpt();
+        pj_dns_resolver *resolver = pjsip_endpt_get_resolver(endpt);
+        if (!resolver && pjsip_endpt_create_resolver(endpt, &resolver) == PJ_SUCCESS) {
+            pjsip_endpt_set_resolver(endpt, resolver);
+            {
+                std::lock_guard<std::mutex> lock(g_dns_mutex);
+                dns_cache_load_locked();
+            }
+            dns_cache_inject(resolver);
+        }
+        if (resolver) {
+            pj_str_t ns[DNS_MAX_NAMESERVERS];
+            for (size_t i = 0; i < servers.size(); ++i) {
+                ns[i] = pj_str_t{const_cast<char *>(servers[i].c_str()), static_cast<pj_ssize_t>(servers[i].size())};
+            }
+            pj_status_t status = pj_dns_resolver_set_ns(resolver, static_cast<unsigned>(servers.size()), ns, nullptr);
+            LOGI(">>> nativeConfigureDns: resolver nameservers updated, status=%d", status);
         }
     }
-    
-    // Get audio device info after change
-    pjsua_snd_get_setting(PJMEDIA_AUD_DEV_CAP_OUTPUT_ROUTE, &current_play_dev);
-    pjsua_snd_get_setting(PJMEDIA_AUD_DEV_CAP_INPUT_ROUTE, &current_cap_dev);
-    LOGI("Audio devices after refresh: capture=%d, playback=%d", current_cap_dev, current_play_dev);
-    
-    g_audio_ready = true;
-    return JNI_TRUE;
 }
 
-extern "C" JNIEXPORT jboolean JNICALL
-Java_fr_celya_celyavox_PjsipEngine_nativeRegister(JNIEnv *env, jobject, jstring juser, jstring jpass, jstring jdomain, jstring jproxy) {
-    ensure_pj_thread_registered("jni");
-    if (!ensure_endpoint()) return JNI_FALSE;
+extern "C" JNIEXPORT void JNICALL
+Java_fr_celya_celyavox_PjsipEngine_nativeSetSdpRules(JNIEnv *env, jobject, jstring jspec) {
+    VOIP_TRACE_SCOPE("jni", "nativeSetSdpRules");
+    const char *spec = jspec ? env->GetStringUTFChars(jspec, nullptr) : nullptr;
+    std::vector<SdpRule> rules = sdp_parse_rules(spec ? spec : kDefaultSdpRules);
+    LOGI(">>> nativeSetSdpRules: '%s' -> %zu rule(s)", spec ? spec : kDefaultSdpRules, rules.size());
+    if (spec) env->ReleaseStringUTFChars(jspec, spec);
 
-    const char *user = env->GetStringUTFChars(juser, nullptr);
-    const char *pass = env->GetStringUTFChars(jpass, nullptr);
-    const char *domain = env->GetStringUTFChars(jdomain, nullptr);
-    const char *proxy = env->GetStringUTFChars(jproxy, nullptr);
-    
-    LOGI(">>> nativeRegister: Called with parameters:");
-    LOGI("    - user=%s", user ? user : "NULL");
-    LOGI("    - domain=%s", domain ? domain : "NULL");
-    LOGI("    - proxy=%s (length=%lu)", proxy ? proxy : "NULL", proxy ? strlen(proxy) : 0);
-    LOGI("    - proxy is empty? %s", (proxy == nullptr || strlen(proxy) == 0) ? "YES" : "NO");
+    std::lock_guard<std::mutex> lock(g_sdp_mutex);
+    g_sdp_rules = rules;
+    g_sdp_rules_configured = true;
+    sdp_apply_header_rules(g_sdp_rules);
+}
 
-    std::lock_guard<std::mutex> lock(g_mutex);
+// ---------------------------------------------------------------------------
+// Echo cancellation
+//
+// pjmedia's echo cancellers are compiled out (config_site.h): on speakerphone the device's
+// own processing was all there was. With an AEC mode set, refreshAudio opens the sound
+// device itself instead of pjsua_set_snd_dev(), and connects it to the bridge through
+// AecPort: playback frames pulled from the bridge are kept as the far-end reference, and
+// every captured frame goes through voip_aec's canceller before reaching the bridge.
+// "speaker" only processes while the app reports the loudspeaker route, "always" on every
+// route. The canceller has a per-frame CPU budget and drops to its suppressor past it.
+// captureEchoFixture records what AecPort sees (microphone before cancellation, played
+// frames) for benchmarkEchoCanceller and the host tests to replay.
+// ---------------------------------------------------------------------------
+#define AEC_DEFAULT_TAIL_MS 64
+#define AEC_MAX_TAIL_MS 512
+#define AEC_DEFAULT_BUDGET_US 1000  // 5% of a 20 ms frame
+#define AEC_REF_FRAMES 8            // Played frames waiting for their captured counterpart
 
-    // CRITICAL: Copy credentials to static buffers BEFORE creating pj_str_t
-    // This ensures they remain valid throughout the account lifetime
-    // (JNI strings will be released after this function)
-    memset(g_global_cred_username, 0, sizeof(g_global_cred_username));
-    memset(g_global_cred_password, 0, sizeof(g_global_cred_password));
-    strncpy(g_global_cred_username, user, sizeof(g_global_cred_username) - 1);
-    strncpy(g_global_cred_password, pass, sizeof(g_global_cred_password) - 1);
-    
-    LOGI(">>> nativeRegister: CRITICAL FIX - Copying JNI credentials to static buffers");
-    LOGI(">>> nativeRegister: JNI user=%s, pass=%s (will be released after function)", user, pass);
-    LOGI(">>> nativeRegister: Static buffer username=%s, password=%s (PERSISTENT)", g_global_cred_username, g_global_cred_password);
-    LOGI(">>> nativeRegister: Buffer addresses: username_buf=%p, password_buf=%p", g_global_cred_username, g_global_cred_password);
+enum AecMode { AEC_OFF = 0, AEC_SPEAKER = 1, AEC_ALWAYS = 2 };
+
+struct AecSettings {
+    AecMode mode = AEC_OFF;
+    uint32_t tail_ms = AEC_DEFAULT_TAIL_MS;
+    uint32_t budget_us = AEC_DEFAULT_BUDGET_US;
+};
+
+static std::mutex g_aec_mutex;
+static AecSettings g_aec_settings;  // g_aec_mutex
+static std::atomic<bool> g_aec_speaker{false};
+
+static AecSettings aec_settings() {
+    std::lock_guard<std::mutex> lock(g_aec_mutex);
+    return g_aec_settings;
+}
+
+// Sits between the sound device and the bridge's master port: put_frame runs on the capture
+// thread, get_frame on the playback thread
+struct AecPort {
+    pjmedia_port base{};
+    pjmedia_port *conf = nullptr;
+    AecMode mode = AEC_OFF;
+    unsigned spf = 0;
+    std::unique_ptr<voip_aec::EchoCanceller> aec;  // Capture thread only, like the two below
+    std::vector<pj_int16_t> far;
+    uint64_t fallbacks = 0;
+
+    std::mutex ref_mutex;                          // Far-end frames, oldest at ref_head
+    std::vector<pj_int16_t> ref;
+    unsigned ref_head = 0;
+    unsigned ref_count = 0;
+};
+
+static pj_pool_t *g_aec_pool = nullptr;             // Engine thread, like the two below
+static pjmedia_snd_port *g_aec_snd = nullptr;
+static std::unique_ptr<AecPort> g_aec_port;
+static std::atomic<unsigned> g_aec_clock_rate{0};   // Of the attached AecPort, 0 when detached
 
-    if (g_acc_id != PJSUA_INVALID_ID) {
-        pjsua_acc_del(g_acc_id);
-        g_acc_id = PJSUA_INVALID_ID;
+// Fixture being recorded, armed from JNI; the capture thread only try-locks the mutex
+static std::mutex g_aec_fixture_mutex;
+static std::unique_ptr<voip_aec::FixtureWriter> g_aec_fixture;  // g_aec_fixture_mutex
+
+static AecPort *aec_port_of(pjmedia_port *port) {
+    return static_cast<AecPort *>(port->port_data.pdata);
+}
+
+static pj_status_t aec_get_frame(pjmedia_port *port, pjmedia_frame *frame) {
+    AecPort *aec = aec_port_of(port);
+    pj_status_t status = pjmedia_port_get_frame(aec->conf, frame);
+    std::lock_guard<std::mutex> lock(aec->ref_mutex);
+    const unsigned depth = (unsigned)(aec->ref.size() / aec->spf);
+    if (aec->ref_count == depth) {  // Capture stalled: the oldest reference is useless now
+        aec->ref_head = (aec->ref_head + 1) % depth;
+        aec->ref_count--;
+    }
+    pj_int16_t *slot = &aec->ref[(size_t)((aec->ref_head + aec->ref_count) % depth) * aec->spf];
+    if (status == PJ_SUCCESS && frame->type == PJMEDIA_FRAME_TYPE_AUDIO &&
+        frame->size == aec->spf * sizeof(pj_int16_t)) {
+        memcpy(slot, frame->buf, frame->size);
+    } else {
+        memset(slot, 0, aec->spf * sizeof(pj_int16_t));
     }
+    aec->ref_count++;
+    return status;
+}
 
-    pjsua_acc_config acc_cfg;
-    pjsua_acc_config_default(&acc_cfg);
+static pj_status_t aec_put_frame(pjmedia_port *port, pjmedia_frame *frame) {
+    AecPort *aec = aec_port_of(port);
+    const bool active = aec->mode == AEC_ALWAYS || g_aec_speaker.load(std::memory_order_relaxed);
+    if (frame->type == PJMEDIA_FRAME_TYPE_AUDIO && frame->size == aec->spf * sizeof(pj_int16_t)) {
+        std::unique_lock<std::mutex> fixture(g_aec_fixture_mutex, std::try_to_lock);
+        voip_aec::FixtureWriter *writer = fixture.owns_lock() ? g_aec_fixture.get() : nullptr;
+        bool have_far = false;
+        {
+            std::lock_guard<std::mutex> lock(aec->ref_mutex);
+            if (aec->ref_count) {
+                const unsigned depth = (unsigned)(aec->ref.size() / aec->spf);
+                const pj_int16_t *oldest = &aec->ref[(size_t)aec->ref_head * aec->spf];
+                if (active || writer) std::copy(oldest, oldest + aec->spf, aec->far.begin());
+                have_far = true;
+                aec->ref_head = (aec->ref_head + 1) % depth;
+                aec->ref_count--;
+            }
+        }
+        if (writer && !writer->write((const pj_int16_t *)frame->buf, have_far ? aec->far.data() : nullptr, aec->spf)) {
+            LOGI(">>> AEC: fixture recorded, %zu samples", writer->samples());
+            g_aec_fixture.reset();
+        }
+        if (fixture.owns_lock()) fixture.unlock();
+        if (active) {
+            aec->aec->process((pj_int16_t *)frame->buf, have_far ? aec->far.data() : nullptr);
+            const voip_aec::Stats &stats = aec->aec->stats();
+            metric_observe(MH_AEC_FRAME_US, stats.last_frame_ns / 1000u);
+            if (stats.fallbacks != aec->fallbacks) {
+                metric_inc(MC_AEC_FALLBACKS, stats.fallbacks - aec->fallbacks);
+                aec->fallbacks = stats.fallbacks;
+                LOGW(">>> AEC: %u us over the %u us frame budget, suppressor for now", stats.last_frame_ns / 1000u,
+                     aec_settings().budget_us);
+            }
+        }
+    }
+    return pjmedia_port_put_frame(aec->conf, frame);
+}
 
-    // Use static buffers for account URIs (not temporary std::string!)
-    // This prevents pj_str_t from pointing to freed memory
-    memset(g_global_acc_id, 0, sizeof(g_global_acc_id));
-    memset(g_global_acc_reg_uri, 0, sizeof(g_global_acc_reg_uri));
-    
-    // Simple URIs without forced transport (like SUBSCRIBE which works)
-    snprintf(g_global_acc_id, sizeof(g_global_acc_id) - 1, 
-             "sip:%s@%s", user, domain);
-    snprintf(g_global_acc_reg_uri, sizeof(g_global_acc_reg_uri) - 1, 
-             "sip:%s", domain);
-    
-    acc_cfg.id = pj_str_t{g_global_acc_id, static_cast<pj_ssize_t>(strlen(g_global_acc_id))};
-    acc_cfg.reg_uri = pj_str_t{g_global_acc_reg_uri, static_cast<pj_ssize_t>(strlen(g_global_acc_reg_uri))};
-    
-    LOGI(">>> nativeRegister: Account URIs (in static buffers for persistence):");
-    LOGI("    - id=%s", g_global_acc_id);
-    LOGI("    - reg_uri=%s", g_global_acc_reg_uri);
-    acc_cfg.cred_count = 2;
-    
-    // Credential 1: realm="asterisk" (pour FreePBX/Asterisk)
-    // IMPORTANT: Use static buffers (g_global_cred_*) not JNI strings!
-    acc_cfg.cred_info[0].realm = pj_str_t{g_global_cred_realm_asterisk, 8};
-    acc_cfg.cred_info[0].scheme = pj_str_t{const_cast<char *>("digest"), 6};
-    acc_cfg.cred_info[0].username = pj_str_t{g_global_cred_username, static_cast<pj_ssize_t>(strlen(g_global_cred_username))};
-    acc_cfg.cred_info[0].data = pj_str_t{g_global_cred_password, static_cast<pj_ssize_t>(strlen(g_global_cred_password))};
-    
-    LOGI(">>> nativeRegister: Credential[0] (realm=asterisk, algo=MD5):");
-    LOGI("    - username ptr=%p, value=%s", acc_cfg.cred_info[0].username.ptr, acc_cfg.cred_info[0].username.ptr);
-    LOGI("    - password ptr=%p, slen=%ld", acc_cfg.cred_info[0].data.ptr, acc_cfg.cred_info[0].data.slen);
-    
-    // Credential 2: realm="*" (wildcard pour les autres realms)
-    acc_cfg.cred_info[1].realm = pj_str_t{g_global_cred_realm_wildcard, 1};
-    acc_cfg.cred_info[1].scheme = pj_str_t{const_cast<char *>("digest"), 6};
-    acc_cfg.cred_info[1].username = pj_str_t{g_global_cred_username, static_cast<pj_ssize_t>(strlen(g_global_cred_username))};
-    acc_cfg.cred_info[1].data = pj_str_t{g_global_cred_password, static_cast<pj_ssize_t>(strlen(g_global_cred_password))};
-    
-    LOGI(">>> nativeRegister: Credential[1] (realm=wildcard, algo=MD5):");
-    LOGI("    - username ptr=%p, value=%s", acc_cfg.cred_info[1].username.ptr, acc_cfg.cred_info[1].username.ptr);
-    LOGI("    - password ptr=%p, slen=%ld", acc_cfg.cred_info[1].data.ptr, acc_cfg.cred_info[1].data.slen);
-
-    // NO PROXY - Direct connection to domain
-    // (same as SUBSCRIBE which works: routes directly to sip:number@domain)
-    acc_cfg.proxy_cnt = 0;
-    LOGI(">>> nativeRegister: NO PROXY - Direct routing to domain");
+// Engine thread only, like every sound device change
+static void aec_detach() {
+    if (!g_aec_snd) return;
+    pjmedia_snd_port_disconnect(g_aec_snd);
+    pjmedia_snd_port_destroy(g_aec_snd);
+    g_aec_snd = nullptr;
+    g_aec_clock_rate = 0;
+    const voip_aec::Stats &stats = g_aec_port->aec->stats();
+    if (stats.echo_in_energy > 0) metric_observe(MH_AEC_ERLE_DB, (uint64_t)std::max(0.0, voip_aec::erle_db(stats)));
+    LOGI(">>> AEC: detached after %llu frames (%llu suppressed, %llu fallbacks, max %u us, ERLE %.1f dB)",
+         (unsigned long long)stats.frames, (unsigned long long)stats.suppressed_frames,
+         (unsigned long long)stats.fallbacks, stats.max_frame_ns / 1000u, voip_aec::erle_db(stats));
+    g_aec_port.reset();
+    pj_pool_release(g_aec_pool);
+    g_aec_pool = nullptr;
+}
 
-    // CRITICAL: Enable shared auth for buddies (SUBSCRIBE/NOTIFY) to use account credentials
-    // This allows SUBSCRIBE to automatically retry with Digest auth after receiving 401
-    acc_cfg.use_shared_auth = PJ_TRUE;
-    LOGI(">>> nativeRegister: SHARED AUTH ENABLED - buddies will use account credentials for 401 retries");
+// Engine thread only. Opens the default devices with the canceller in the
+// capture path; on failure the bridge is left without a device and the caller falls back to
+// pjsua_set_snd_dev().
+static pj_status_t aec_attach(const AecSettings &settings) {
+    aec_detach();
+    pjmedia_port *conf = pjsua_set_no_snd_dev();
+    if (!conf) return PJ_EINVAL;
+    const unsigned clock_rate = PJMEDIA_PIA_SRATE(&conf->info);
+    const unsigned spf = PJMEDIA_PIA_SPF(&conf->info);
+    if (PJMEDIA_PIA_CCNT(&conf->info) != 1 || PJMEDIA_PIA_BITS(&conf->info) != 16) return PJ_ENOTSUP;
 
-    pj_status_t status = pjsua_acc_add(&acc_cfg, PJ_TRUE, &g_acc_id);
-    
-    // DEBUG: Vérifier que g_acc_id est correctement set par pjsua_acc_add
-    LOGI(">>> nativeRegister: pjsua_acc_add returned status=%d, g_acc_id=%d", status, g_acc_id);
+    auto port = std::make_unique<AecPort>();
+    pj_str_t name = pj_str((char *)"aec");
+    pjmedia_port_info_init(&port->base.info, &name, PJMEDIA_SIG_CLASS_APP('A', 'E'), clock_rate, 1, 16, spf);
+    port->base.port_data.pdata = port.get();
+    port->base.get_frame = &aec_get_frame;
+    port->base.put_frame = &aec_put_frame;
+    port->conf = conf;
+    port->mode = settings.mode;
+    port->spf = spf;
+    port->ref.assign((size_t)spf * AEC_REF_FRAMES, 0);
+    port->far.assign(spf, 0);
+    voip_aec::Config config;
+    config.clock_rate = clock_rate;
+    config.samples_per_frame = spf;
+    config.tail_ms = settings.tail_ms;
+    config.budget_us = settings.budget_us;
+    port->aec = std::make_unique<voip_aec::EchoCanceller>(config);
+
+    pj_pool_t *pool = pjsua_pool_create("aec", 512, 512);
+    pjmedia_snd_port *snd = nullptr;
+    pjsua_unlocked_check("pjmedia_snd_port_create");
+    pj_status_t status = pjmedia_snd_port_create(pool, PJMEDIA_AUD_DEFAULT_CAPTURE_DEV, PJMEDIA_AUD_DEFAULT_PLAYBACK_DEV,
+                                                  clock_rate, 1, spf, 16, 0, &snd);
+    if (status == PJ_SUCCESS) {
+        status = pjmedia_snd_port_connect(snd, &port->base);
+        if (status != PJ_SUCCESS) pjmedia_snd_port_destroy(snd);
+    }
     if (status != PJ_SUCCESS) {
-        LOGE(">>> nativeRegister: Account add FAILED with status=%d", status);
-        env->ReleaseStringUTFChars(juser, user);
-        env->ReleaseStringUTFChars(jpass, pass);
-        env->ReleaseStringUTFChars(jdomain, domain);
-        env->ReleaseStringUTFChars(jproxy, proxy);
-        return JNI_FALSE;
+        pj_pool_release(pool);
+        return status;
     }
-    
-    // CRITICAL VERIFICATION: Check that account credentials are using STATIC buffers, not JNI strings
-    // If they point to JNI memory, 401 retries will fail when JNI strings are released
-    LOGI(">>> nativeRegister: VERIFICATION - Account created successfully:");
-    LOGI("    - Account ID (g_acc_id)=%d", g_acc_id);
-    LOGI("    - Credential count=%d (username=%s, password set)", acc_cfg.cred_count, g_global_cred_username);
+    LOGI(">>> AEC: %s, %u taps (%u ms) at %u Hz, %s, budget %u us per %u-sample frame",
+         settings.mode == AEC_ALWAYS ? "always" : "speaker only", port->aec->taps(), settings.tail_ms, clock_rate,
+         voip_aec::simd_name(), settings.budget_us, spf);
+    g_aec_pool = pool;
+    g_aec_snd = snd;
+    g_aec_port = std::move(port);
+    g_aec_clock_rate = clock_rate;
+    return PJ_SUCCESS;
+}
 
+// ---------------------------------------------------------------------------
+// Idle media
+//
+// Between calls nothing needs the media stack, yet the null sound device clocks the
+// conference bridge every 20 ms and pjmedia's worker polls the media ioqueue every 10 ms,
+// around the clock. Once the last call has been gone for MEDIA_IDLE_GRACE_MS the bridge is
+// detached from any sound device (pjsua_set_no_snd_dev(): no clock at all) and the media
+// poll thread, ours instead of pjmedia's (media_cfg.thread_cnt = 0), parks on a condition
+// variable. An outgoing call resumes both before its INVITE; an incoming call wakes the
+// poll thread from on_incoming_call and queues the sound device ahead of the app's accept.
+// The SIP worker keeps pjsua's 10 ms poll: timers scheduled from other threads rely on it.
+// ---------------------------------------------------------------------------
+#define MEDIA_IDLE_GRACE_MS 2000
 
-    // Sauvegarder les credentials du compte pour les SUBSCRIBE (auth Digest)
-    g_account_username = user;
-    g_account_password = pass;
-    g_account_domain = domain;
-    
-    LOGI(">>> nativeRegister: Account registered! username=%s, domain=%s, g_acc_id=%d (credentials from static buffers)", user, domain, g_acc_id);
+static void media_poll_thread_main() {
+    ensure_pj_thread_registered("media");
+    threading_apply_media("media poll");
+    pj_ioqueue_t *ioqueue = pjmedia_endpt_get_ioqueue(pjsua_get_pjmedia_endpt());
+    for (;;) {
+        {
+            std::unique_lock<std::mutex> lock(g_media_poll_mutex);
+            g_media_poll_cv.wait(lock, [] { return g_media_polling || g_media_poll_stop; });
+            if (g_media_poll_stop) return;
+        }
+        pj_time_val timeout = {0, 10};
+        pj_ioqueue_poll(ioqueue, &timeout);
+    }
+}
 
-    // DEBUG: Verify transport configuration was applied correctly
-    pjsua_acc_info acc_info;
-    pjsua_acc_get_info(g_acc_id, &acc_info);
-    LOGI(">>> nativeRegister: TRANSPORT CONFIG VERIFICATION:");
-    LOGI("    - account ID: %d", g_acc_id);
-    LOGI("    - status text: %s", acc_info.status_text.ptr ? acc_info.status_text.ptr : "N/A");
-    LOGI("    - has credentials (cred_count from cfg): 2");
-    LOGI("    - proxy[0] with transport=udp: %s (forces all SIP requests through UDP)", acc_cfg.proxy_cnt > 0 ? "CONFIGURED" : "NOT CONFIGURED");
-    LOGI("    - use_shared_auth: PJ_TRUE (enabled)");
-
-    env->ReleaseStringUTFChars(juser, user);
-    env->ReleaseStringUTFChars(jpass, pass);
-    env->ReleaseStringUTFChars(jdomain, domain);
-    env->ReleaseStringUTFChars(jproxy, proxy);
-    
-    // Mettre le compte en défaut pour que les buddies l'utilisent
-    pjsua_acc_set_default(g_acc_id);
-    LOGI(">>> nativeRegister: Account set as default for buddy SUBSCRIBE authentication");
-    return JNI_TRUE;
+// Engine thread, before pjsua_destroy(): the media ioqueue goes with the endpoint
+static void media_poll_thread_stop() {
+    if (!g_media_poll_thread.joinable()) return;
+    {
+        std::lock_guard<std::mutex> lock(g_media_poll_mutex);
+        g_media_poll_stop = true;
+    }
+    g_media_poll_cv.notify_one();
+    g_media_poll_thread.join();
 }
 
-extern "C" JNIEXPORT void JNICALL
-Java_fr_celya_celyavox_PjsipEngine_nativeUnregister(JNIEnv *, jobject) {
-    ensure_pj_thread_registered("jni");
-    std::lock_guard<std::mutex> lock(g_mutex);
-    if (g_acc_id != PJSUA_INVALID_ID) {
-        pj_status_t st = pjsua_acc_set_registration(g_acc_id, PJ_FALSE);
-        if (st == PJ_SUCCESS) {
-            LOGI("Unregister requested (REGISTER expires=0) for account id=%d", g_acc_id);
-        } else {
-            LOGE("Unregister request failed for account id=%d status=%d", g_acc_id, st);
+// Stands in for pjmedia's null sound device: each tick pushes a silent frame into the bridge
+// and pulls the mixed one out, as the null device's master port does, on our schedule.
+static void media_clock_thread_main(pjmedia_port *conf) {
+    ensure_pj_thread_registered("media-clock");
+    threading_apply_media("media clock");
+    const unsigned spf = PJMEDIA_PIA_SPF(&conf->info);
+    std::vector<pj_int16_t> samples(spf);
+    voip_sched::Ticker ticker(PJMEDIA_PIA_PTIME(&conf->info) * 1000);
+    uint64_t skipped = 0;
+    pj_uint64_t timestamp = 0;
+    while (g_media_clock_running.load(std::memory_order_acquire)) {
+        metric_observe(MH_MEDIA_TICK_LATE_US, ticker.wait_next());
+        if (ticker.skipped() != skipped) {
+            metric_inc(MC_MEDIA_TICKS_SKIPPED, ticker.skipped() - skipped);
+            skipped = ticker.skipped();
         }
+        pjmedia_frame frame;
+        std::fill(samples.begin(), samples.end(), 0);
+        frame.type = PJMEDIA_FRAME_TYPE_AUDIO;
+        frame.buf = samples.data();
+        frame.size = spf * sizeof(pj_int16_t);
+        frame.timestamp.u64 = timestamp;
+        frame.bit_info = 0;
+        pjmedia_port_put_frame(conf, &frame);
+
+        frame.type = PJMEDIA_FRAME_TYPE_AUDIO;
+        frame.size = spf * sizeof(pj_int16_t);
+        frame.timestamp.u64 = timestamp;
+        pjmedia_port_get_frame(conf, &frame);
+        timestamp += spf;
     }
 }
 
-extern "C" JNIEXPORT jboolean JNICALL
-Java_fr_celya_celyavox_PjsipEngine_nativeMakeCall(JNIEnv *env, jobject, jstring jnumber) {
-    ensure_pj_thread_registered("jni");
-    
-    LOGI("nativeMakeCall: Starting outgoing call");
-    
-    if (!ensure_endpoint() || g_acc_id == PJSUA_INVALID_ID) {
-        LOGE("nativeMakeCall: Endpoint not ready or not registered");
-        return JNI_FALSE;
+// With the sound device attached the bridge is clocked from the device's playback callback.
+// This port listens to the device slot, so the bridge writes to it on every tick from inside
+// that callback: it measures the real audio path, not a thread of ours.
+struct DeviceTickProbe {
+    pjmedia_port base{};
+    voip_sched::TickMeter meter;  // Clock thread only
+
+    explicit DeviceTickProbe(uint32_t period_us) : meter(period_us) {}
+};
+
+static std::unique_ptr<DeviceTickProbe> g_device_probe;  // Engine thread, like the two below
+static pj_pool_t *g_device_probe_pool = nullptr;
+static pjsua_conf_port_id g_device_probe_slot = PJSUA_INVALID_ID;
+static std::atomic<bool> g_device_clocked{false};        // The sound device clocks the bridge
+
+static pj_status_t device_probe_get_frame(pjmedia_port *, pjmedia_frame *frame) {
+    frame->type = PJMEDIA_FRAME_TYPE_NONE;
+    frame->size = 0;
+    return PJ_SUCCESS;
+}
+
+static pj_status_t device_probe_put_frame(pjmedia_port *port, pjmedia_frame *) {
+    DeviceTickProbe *probe = static_cast<DeviceTickProbe *>(port->port_data.pdata);
+    // The null device or our clock thread: media.tick_late_us covers the latter
+    if (!g_device_clocked.load(std::memory_order_relaxed)) {
+        probe->meter.reset();
+        return PJ_SUCCESS;
     }
-    
-    const char *number = env->GetStringUTFChars(jnumber, nullptr);
-    
+    metric_observe(MH_DEVICE_TICK_LATE_US, probe->meter.on_tick());
+    return PJ_SUCCESS;
+}
+
+// Engine thread, after pjsua_start()
+static void device_probe_create() {
+    pjsua_conf_port_info info;
+    if (pjsua_conf_get_port_info(0, &info) != PJ_SUCCESS || !info.clock_rate) return;
+    auto probe = std::make_unique<DeviceTickProbe>(
+        (uint32_t)((uint64_t)info.samples_per_frame * 1000000u / info.clock_rate));
+    pj_str_t name = pj_str((char *)"device-tick");
+    pjmedia_port_info_init(&probe->base.info, &name, PJMEDIA_SIG_CLASS_APP('D', 'T'), info.clock_rate,
+                           info.channel_count, 16, info.samples_per_frame);
+    probe->base.port_data.pdata = probe.get();
+    probe->base.get_frame = &device_probe_get_frame;
+    probe->base.put_frame = &device_probe_put_frame;
+    pj_pool_t *pool = pjsua_pool_create("probe", 256, 256);
+    pjsua_conf_port_id slot = PJSUA_INVALID_ID;
+    pj_status_t status = pjsua_conf_add_port(pool, &probe->base, &slot);
+    if (status == PJ_SUCCESS) status = pjsua_conf_connect(0, slot);
+    if (status != PJ_SUCCESS) {
+        LOGW(">>> MEDIA: device tick probe not attached (%d)", status);
+        if (slot != PJSUA_INVALID_ID) pjsua_conf_remove_port(slot);
+        pj_pool_release(pool);
+        return;
+    }
+    g_device_probe = std::move(probe);
+    g_device_probe_pool = pool;
+    g_device_probe_slot = slot;
+}
+
+// Engine thread, before pjsua_destroy()
+static void device_probe_release() {
+    if (g_device_probe_slot == PJSUA_INVALID_ID) return;
+    pjsua_conf_remove_port(g_device_probe_slot);
+    g_device_probe_slot = PJSUA_INVALID_ID;
+    g_device_probe.reset();
+    pj_pool_release(g_device_probe_pool);
+    g_device_probe_pool = nullptr;
+}
+
+// Engine thread only, like every sound device change
+static void media_clock_stop() {
+    if (!g_media_clock_thread.joinable()) return;
+    g_media_clock_running.store(false, std::memory_order_release);
+    g_media_clock_thread.join();
+}
+
+// Engine thread only. Clocks the bridge without a sound device: pjmedia's null
+// device, or our media clock thread when the threading profile asks for it.
+static pj_status_t media_attach_null_clock() {
+    g_device_clocked = false;
+    media_clock_stop();
+    aec_detach();
+    if (!threading_profile().media_clock) return pjsua_set_null_snd_dev();
+    pjmedia_port *conf = pjsua_set_no_snd_dev();
+    if (!conf) return PJ_EINVAL;
+    g_media_clock_running.store(true, std::memory_order_release);
+    try {
+        g_media_clock_thread = std::thread(media_clock_thread_main, conf);
+    } catch (const std::system_error &e) {
+        LOGE("media clock thread not started: %s", e.what());
+        g_media_clock_running = false;
+        return pjsua_set_null_snd_dev();
+    }
+    return PJ_SUCCESS;
+}
+
+static void media_set_polling(bool polling) {
+    {
+        std::lock_guard<std::mutex> lock(g_media_poll_mutex);
+        if (g_media_polling == polling) return;
+        g_media_polling = polling;
+    }
+    if (polling) g_media_poll_cv.notify_one();
+}
+
+// Engine thread only. Brings the media stack back for a call; the app swaps
+// in the real sound device with refreshAudio as before.
+static void media_resume(const char *why) {
+    g_media_idle_gen++;
+    media_set_polling(true);
+    if (!g_media_parked) return;
+    uint64_t start_us = metric_now_us();
+    pj_status_t status = media_attach_null_clock();
+    g_media_parked = false;
+    metric_inc(MC_MEDIA_RESUMED);
+    LOGI(">>> MEDIA: resumed for %s in %llu us (status=%d)", why,
+         (unsigned long long)(metric_now_us() - start_us), status);
+}
+
+// Engine thread only: no clock, no sound device, poll thread parked
+static void media_park() {
+    g_device_clocked = false;
+    media_clock_stop();
+    aec_detach();
+    pjsua_set_no_snd_dev();
+    g_media_parked = true;
+    media_set_polling(false);
+}
+
+static bool cmd_media_idle(uint32_t gen) {
+    if (gen != g_media_idle_gen || g_media_parked || !g_media_idle_enabled) return true;
+    if (pjsua_call_get_count() > 0) return true;
+    media_park();
+    metric_inc(MC_MEDIA_PARKED);
+    LOGI(">>> MEDIA: no call left, bridge clock stopped and media thread parked");
+    return true;
+}
+
+struct MediaIdleTimer {
+    pj_timer_entry timer;
+    uint32_t gen;
+};
+
+// Scheduled idle timer, owned by whoever takes it out (g_media_poll_mutex): the callback, a
+// newer schedule or media_idle_cancel()
+static MediaIdleTimer *g_media_idle_timer = nullptr;
+
+static void media_idle_fired(pj_timer_heap_t *, pj_timer_entry *timer) {
+    std::unique_ptr<MediaIdleTimer> idle(static_cast<MediaIdleTimer *>(timer->user_data));
+    {
+        std::lock_guard<std::mutex> lock(g_media_poll_mutex);
+        // Replaced or cancelled while already firing: the canceller left it to us
+        if (g_media_idle_timer != idle.get()) return;
+        g_media_idle_timer = nullptr;
+    }
+    uint32_t gen = idle->gen;
+    if (gen != g_media_idle_gen) return;
+    submit_command("media_idle", [gen] { return cmd_media_idle(gen); });
+}
+
+static void media_idle_cancel_timer(MediaIdleTimer *pending) {
+    if (pending && pjsip_endpt_cancel_timer(pjsua_get_pjsip_endpt(), &pending->timer) > 0) delete pending;
+}
+
+// Parks the media stack after the grace period unless a call shows up meanwhile; replaces
+// the timer of the previous call
+static void media_schedule_idle() {
+    if (!g_media_idle_enabled || !g_initialized) return;
+    auto *idle = new MediaIdleTimer{{}, g_media_idle_gen.load()};
+    pj_timer_entry_init(&idle->timer, 0, idle, &media_idle_fired);
+    pj_time_val delay = {MEDIA_IDLE_GRACE_MS / 1000, MEDIA_IDLE_GRACE_MS % 1000};
+    MediaIdleTimer *previous;
+    {
+        // Scheduled under the lock so media_idle_cancel() never misses it; the timer heap runs
+        // media_idle_fired() without its own lock held
+        std::lock_guard<std::mutex> lock(g_media_poll_mutex);
+        if (pjsip_endpt_schedule_timer(pjsua_get_pjsip_endpt(), &idle->timer, &delay) != PJ_SUCCESS) {
+            LOGW(">>> MEDIA: cannot schedule idle mode");
+            delete idle;
+            return;
+        }
+        previous = g_media_idle_timer;
+        g_media_idle_timer = idle;
+    }
+    media_idle_cancel_timer(previous);
+}
+
+static void media_idle_cancel() {
+    MediaIdleTimer *pending;
+    {
+        std::lock_guard<std::mutex> lock(g_media_poll_mutex);
+        pending = g_media_idle_timer;
+        g_media_idle_timer = nullptr;
+    }
+    media_idle_cancel_timer(pending);
+}
+
+// on_incoming_call runs on the SIP worker, possibly under PJSUA_LOCK: only the poll thread
+// is woken here, the sound device is attached by a command queued before any accept
+static void media_wake_for_incoming() {
+    g_media_idle_gen++;
+    media_set_polling(true);
+    if (!g_media_parked) return;
+    submit_command("media_resume", [] {
+        media_resume("incoming call");
+        return true;
+    });
+}
+
+// Opening the device can take hundreds of milliseconds on some phones: no domain lock is
+// held meanwhile (the sound device is the engine thread's, see the locking model)
+static bool cmd_refresh_audio() {
+    if (!ensure_endpoint()) return false;
+    
+    LOGI("Refreshing audio devices");
+    g_media_idle_gen++;  // A device is attached again: the media thread must run
+    media_set_polling(true);
+    
+    // Get current audio device info
+    pjmedia_aud_dev_index current_cap_dev, current_play_dev;
+    pjsua_snd_get_setting(PJMEDIA_AUD_DEV_CAP_OUTPUT_ROUTE, &current_play_dev);
+    pjsua_snd_get_setting(PJMEDIA_AUD_DEV_CAP_INPUT_ROUTE, &current_cap_dev);
+    LOGI("Current audio devices: capture=%d, playback=%d", current_cap_dev, current_play_dev);
+    
+    // The device clocks the bridge from now on
+    media_clock_stop();
+    const AecSettings aec = aec_settings();
+    pj_status_t status = PJ_EINVAL;
+    if (aec.mode != AEC_OFF) {
+        status = aec_attach(aec);
+        if (status != PJ_SUCCESS) LOGW(">>> AEC: sound device not opened with the canceller (%d), without it", status);
+    }
+    if (status != PJ_SUCCESS) {
+        aec_detach();
+        pjsua_unlocked_check("pjsua_set_snd_dev");
+        status = pjsua_set_snd_dev(PJMEDIA_AUD_DEFAULT_CAPTURE_DEV, PJMEDIA_AUD_DEFAULT_PLAYBACK_DEV);
+    }
+    
+    LOGI("pjsua_set_snd_dev result: %d", status);
+    if (status != PJ_SUCCESS) {
+        char errbuf[128];
+        pj_strerror(status, errbuf, sizeof(errbuf));
+        LOGE("Failed to set audio device: %d (%s). Falling back to null sound device.", status, errbuf);
+        // media_attach_null_clock() clears g_device_clocked
+        pj_status_t null_status = media_attach_null_clock();
+        if (null_status != PJ_SUCCESS) {
+            pj_strerror(null_status, errbuf, sizeof(errbuf));
+            LOGE("set_null_snd_dev also failed: %d (%s)", null_status, errbuf);
+            return command_done(false, null_status);
+        }
+    }
+    
+    // Get audio device info after change
+    pjsua_snd_get_setting(PJMEDIA_AUD_DEV_CAP_OUTPUT_ROUTE, &current_play_dev);
+    pjsua_snd_get_setting(PJMEDIA_AUD_DEV_CAP_INPUT_ROUTE, &current_cap_dev);
+    LOGI("Audio devices after refresh: capture=%d, playback=%d", current_cap_dev, current_play_dev);
+    
+    if (status == PJ_SUCCESS) g_device_clocked = true;
+    g_media_parked = false;
+    g_audio_ready = true;
+    return true;
+}
+
+extern "C" JNIEXPORT jlong JNICALL
+Java_fr_celya_celyavox_PjsipEngine_nativeRefreshAudio(JNIEnv *, jobject) {
+    VOIP_TRACE_SCOPE("jni", "nativeRefreshAudio");
+    return submit_command("refresh_audio", [] { return cmd_refresh_audio(); });
+}
+
+// Caller must hold g_accounts_lock
+static AccountEntry *find_account_by_key_locked(const std::string &key) {
+    for (auto &entry : g_accounts) {
+        if (entry.second.key == key) return &entry.second;
+    }
+    return nullptr;
+}
+
+// Caller must hold g_accounts_lock. Makes acc_id the account used for outgoing calls and new
+// BLF subscriptions, and publishes the new snapshot.
+static void set_active_account_locked(pjsua_acc_id acc_id) {
+    auto next = std::make_shared<ActiveAccount>();
+    auto it = g_accounts.find(acc_id);
+    if (it != g_accounts.end()) {
+        next->acc_id = acc_id;
+        next->key = it->second.key;
+        next->domain = it->second.domain;
+        pjsua_acc_set_default(acc_id);
+    }
+    std::atomic_store(&g_active_account, std::shared_ptr<const ActiveAccount>(std::move(next)));
+    metric_gauge_set(MG_ACCOUNTS, (int64_t)g_accounts.size());
+    LOGI(">>> ACCOUNTS: active account is now %d (%zu account(s) in table)", acc_id, g_accounts.size());
+}
+
+// Caller must hold g_accounts_lock. Takes the account out of the table (and out of the active
+// slot) and hands it to the caller, who deletes it with remove_account() once unlocked.
+static bool detach_account_locked(pjsua_acc_id acc_id, AccountEntry *out) {
+    auto it = g_accounts.find(acc_id);
+    if (it == g_accounts.end()) return false;
+    *out = it->second;
+    g_accounts.erase(it);
+    metric_gauge_set(MG_ACCOUNTS, (int64_t)g_accounts.size());
+    if (active_account_snapshot()->acc_id == acc_id) {
+        set_active_account_locked(g_accounts.empty() ? PJSUA_INVALID_ID : g_accounts.begin()->first);
+    }
+    return true;
+}
+
+// No domain lock held: drops the detached account's BLF subscriptions, the PJSUA account and its pool.
+static void remove_account(const AccountEntry &acc) {
+    const pjsua_acc_id acc_id = acc.acc_id;
+
+    // Detach the subscriptions from the presence maps first, then delete them unlocked:
+    // pjsua_buddy_del() can call on_buddy_state(), which takes the presence lock.
+    std::vector<pjsua_buddy_id> buddies;
+    {
+        DomainLock lock(g_presence_lock);
+        auto subs = g_account_buddies.find(acc_id);
+        if (subs != g_account_buddies.end()) {
+            for (const auto &buddy : subs->second) {
+                buddies.push_back(buddy.second);
+                g_buddy_reverse_map.erase(buddy.second);
+                g_buddy_account_map.erase(buddy.second);
+                g_buddy_last_dialog_state.erase(buddy.second);
+                presence_cache_remove_locked(buddy.first);
+            }
+            g_account_buddies.erase(subs);
+        }
+        g_presence_reg_ok.erase(acc_id);  // Account ids are reused
+        metric_gauge_set(MG_BUDDIES, (int64_t)g_buddy_reverse_map.size());
+    }
+    for (pjsua_buddy_id buddy_id : buddies) {
+        pjsua_unlocked_check("pjsua_buddy_del");
+        pjsua_buddy_del(buddy_id);
+    }
+    rls_drop_account(acc_id);
+    reg_retry_cancel(acc_id);
+
+    pjsua_unlocked_check("pjsua_acc_del");
+    pj_status_t status = pjsua_acc_del(acc_id);
+    LOGI(">>> ACCOUNTS: removed %s (acc_id=%d, %zu buddies), status=%d", acc.key.c_str(), acc_id, buddies.size(), status);
+    if (acc.pool) pj_pool_release(acc.pool);
+}
+
+// ---------------------------------------------------------------------------
+// Registration retry
+//
+// With the resolver enabled, "sip:domain" goes through _sip._udp SRV. When a REGISTER times
+// out or cannot be sent (no route, DNS failure, connection refused), pjsua would wait for
+// its 300 s retry interval; instead it is resent after REG_QUICK_RETRY_MS, up to
+// REG_QUICK_RETRY_MAX times in a row, which reaches the next SRV target or the new network.
+// Rejections by the server (401/403/404...) are not retried quickly: they do not get better,
+// and a burst of REGISTERs with a wrong password is what gets a client banned by the PBX.
+// ---------------------------------------------------------------------------
+#define REG_QUICK_RETRY_MS 5000
+#define REG_QUICK_RETRY_MAX 3
+
+struct RegRetryTimer {
+    pj_timer_entry timer;
+    pjsua_acc_id acc_id;
+};
+
+struct RegRetryState {
+    uint32_t attempts = 0;           // Quick retries since the last success
+    RegRetryTimer *pending = nullptr;  // Scheduled timer, owned by whoever takes it out
+};
+static std::mutex g_reg_retry_mutex;  // Leaf lock, never held across PJSUA calls
+static std::map<pjsua_acc_id, RegRetryState> g_reg_retry;
+
+// The final status decides first: pjsip_regc reports a wrong password as 401 with
+// PJSIP_EFAILEDCREDENTIAL in reg_last_err, which must not count as a transport error.
+// reg_last_err only matters when no final response came back.
+static bool reg_failure_is_transient(const pjsua_acc_info &info) {
+    if (info.status == 408 || info.status == 503 || info.status == 504) return true;  // Timeout, unreachable
+    if (info.status >= 400) return false;  // Any other final 4xx/5xx/6xx is the server's answer
+    return info.reg_last_err != PJ_SUCCESS;  // Transport or resolver error
+}
+
+static void reg_retry_fired(pj_timer_heap_t *, pj_timer_entry *timer) {
+    std::unique_ptr<RegRetryTimer> retry(static_cast<RegRetryTimer *>(timer->user_data));
+    pjsua_acc_id acc_id = retry->acc_id;
+    {
+        std::lock_guard<std::mutex> lock(g_reg_retry_mutex);
+        auto it = g_reg_retry.find(acc_id);
+        // Cancelled while already firing: the canceller left the timer to us
+        if (it == g_reg_retry.end() || it->second.pending != retry.get()) return;
+        it->second.pending = nullptr;
+    }
+    submit_command("register_retry", [acc_id] {
+        if (!pjsua_acc_is_valid(acc_id)) return false;
+        pjsua_unlocked_check("pjsua_acc_set_registration");
+        pj_status_t status = pjsua_acc_set_registration(acc_id, PJ_TRUE);
+        LOGI(">>> REGISTER RETRY: acc_id=%d resent, status=%d", acc_id, status);
+        return status == PJ_SUCCESS;
+    });
+}
+
+// Called from on_reg_state for every account
+static void reg_retry_on_state(pjsua_acc_id acc_id, const pjsua_acc_info &info) {
+    if (info.status / 100 == 2 || !reg_failure_is_transient(info)) {
+        // Registered, unregistered or rejected: quick retries start over next time
+        if (info.status / 100 == 2 || info.status / 100 >= 4) {
+            std::lock_guard<std::mutex> lock(g_reg_retry_mutex);
+            auto it = g_reg_retry.find(acc_id);
+            if (it != g_reg_retry.end()) it->second.attempts = 0;
+        }
+        return;
+    }
+    auto *retry = new RegRetryTimer{{}, acc_id};
+    {
+        std::lock_guard<std::mutex> lock(g_reg_retry_mutex);
+        RegRetryState &state = g_reg_retry[acc_id];
+        if (state.pending || state.attempts >= REG_QUICK_RETRY_MAX) {
+            delete retry;
+            return;
+        }
+        state.attempts++;
+        state.pending = retry;
+        LOGI(">>> REGISTER RETRY: acc_id=%d failed (%d, last_err=%d), retry %u/%u in %d ms", acc_id, info.status,
+             info.reg_last_err, state.attempts, REG_QUICK_RETRY_MAX, REG_QUICK_RETRY_MS);
+    }
+    pj_timer_entry_init(&retry->timer, 0, retry, &reg_retry_fired);
+    pj_time_val delay = {REG_QUICK_RETRY_MS / 1000, REG_QUICK_RETRY_MS % 1000};
+    if (pjsip_endpt_schedule_timer(pjsua_get_pjsip_endpt(), &retry->timer, &delay) != PJ_SUCCESS) {
+        std::lock_guard<std::mutex> lock(g_reg_retry_mutex);
+        g_reg_retry[acc_id].pending = nullptr;
+        delete retry;
+    }
+}
+
+// Drops the account's retry state and its pending timer (account removed, ids are reused)
+static void reg_retry_cancel(pjsua_acc_id acc_id) {
+    RegRetryTimer *pending = nullptr;
+    {
+        std::lock_guard<std::mutex> lock(g_reg_retry_mutex);
+        auto it = g_reg_retry.find(acc_id);
+        if (it == g_reg_retry.end()) return;
+        pending = it->second.pending;
+        g_reg_retry.erase(it);
+    }
+    if (pending && pjsip_endpt_cancel_timer(pjsua_get_pjsip_endpt(), &pending->timer) > 0) delete pending;
+}
+
+// ---------------------------------------------------------------------------
+// Endpoint shutdown
+//
+// PjsipEngine.destroy() tears the endpoint down in a process that stays alive (soak cycles,
+// leaving the app without killing it); the next command that needs it goes through
+// ensure_endpoint() again. Accounts leave the usual way (BLF subscriptions, resource list,
+// registration retry, un-REGISTER), then the remaining endpoint timers that own heap entries
+// are cancelled and the media threads joined before pjsua_destroy() hangs up the calls and
+// frees the pools. Contacts the app subscribed stay in g_presence_wanted and are subscribed
+// again once an account registers on the new endpoint.
+// ---------------------------------------------------------------------------
+static bool cmd_destroy_endpoint() {
+    if (!g_initialized) return true;
+    std::vector<AccountEntry> accounts;
+    {
+        DomainLock lock(g_accounts_lock);
+        while (!g_accounts.empty()) {
+            AccountEntry acc;
+            detach_account_locked(g_accounts.begin()->first, &acc);
+            accounts.push_back(acc);
+        }
+    }
+    for (const auto &acc : accounts) remove_account(acc);
+
+    presence_debounce_cancel_all();
+    presence_retry_cancel_all();
+    media_idle_cancel();
+    media_clock_stop();
+    aec_detach();
+    ringback_release();
+    device_probe_release();
+    media_poll_thread_stop();
+
+    pj_status_t status;
+    {
+        // Counterpart of ensure_endpoint(): no new endpoint is created meanwhile. Callbacks run
+        // by the shutdown still see g_initialized and take the fast path.
+        DomainLock lock(g_endpoint_lock);
+#if defined(VOIP_SRTP) && VOIP_SRTP
+        std::lock_guard<std::mutex> calibration(g_srtp_calibration_mutex);
+#endif
+        status = pjsua_destroy();
+        g_initialized = false;
+        g_audio_ready = false;
+        g_media_parked = false;
+    }
+    {
+        std::lock_guard<std::mutex> lock(g_media_poll_mutex);
+        g_media_polling = true;
+    }
+    {
+        DomainLock lock(g_presence_lock);
+        g_account_buddies.clear();
+        g_buddy_reverse_map.clear();
+        g_buddy_account_map.clear();
+        g_buddy_last_dialog_state.clear();
+        g_presence_reg_ok.clear();
+    }
+    LOGI(">>> ENDPOINT: destroyed (%zu account(s) removed), status=%d", accounts.size(), status);
+    return command_done(status == PJ_SUCCESS, status);
+}
+
+// Blocks until the engine thread has run the shutdown: an init() right after it then creates
+// a new endpoint instead of finding the old one about to go away
+extern "C" JNIEXPORT jboolean JNICALL
+Java_fr_celya_celyavox_PjsipEngine_nativeDestroy(JNIEnv *, jobject) {
+    VOIP_TRACE_SCOPE("jni", "nativeDestroy");
+    auto done = std::make_shared<std::promise<bool>>();
+    std::future<bool> result = done->get_future();
+    if (submit_command("destroy", [done] {
+            bool ok = cmd_destroy_endpoint();
+            done->set_value(ok);
+            return ok;
+        }) <= 0) {
+        return JNI_FALSE;
+    }
+    return result.get() ? JNI_TRUE : JNI_FALSE;
+}
+
+// Outbound proxy from provisioning ("host", "host:port", "sip:host;transport=tcp"...) as a
+// loose-routing SIP URI in pool. Empty proxy: false with out untouched. Invalid: false, logged.
+static bool account_proxy_uri(pj_pool_t *pool, const char *proxy, pj_str_t *out) {
+    if (!proxy || !*proxy) return false;
+    std::string uri = proxy;
+    if (uri.compare(0, 4, "sip:") != 0 && uri.compare(0, 5, "sips:") != 0) uri = "sip:" + uri;
+    if (uri.find(";lr") == std::string::npos) uri += ";lr";
+    if (pjsua_verify_sip_url(uri.c_str()) != PJ_SUCCESS) {
+        LOGE(">>> nativeRegister: invalid proxy '%s'", proxy);
+        return false;
+    }
+    pj_strdup2(pool, out, uri.c_str());
+    return true;
+}
+
+// Fills acc_cfg for user@domain with every string allocated from pool (owned by the account
+// entry). An empty proxy routes directly to the domain; an invalid one fails the whole
+// configuration. Caller must hold g_accounts_lock.
+static bool build_account_config(pj_pool_t *pool, const char *user, const char *pass, const char *domain,
+                                 const char *proxy, pjsua_acc_config *acc_cfg) {
+    pjsua_acc_config_default(acc_cfg);
+
+    char uri_buf[256];
+    // Simple URIs without forced transport (like SUBSCRIBE which works)
+    pj_ansi_snprintf(uri_buf, sizeof(uri_buf), "sip:%s@%s", user, domain);
+    pj_strdup2(pool, &acc_cfg->id, uri_buf);
+    pj_ansi_snprintf(uri_buf, sizeof(uri_buf), "sip:%s", domain);
+    pj_strdup2(pool, &acc_cfg->reg_uri, uri_buf);
+
+    pj_str_t username, password;
+    pj_strdup2(pool, &username, user);
+    pj_strdup2(pool, &password, pass);
+
+    // Credential 1: realm="asterisk" (pour FreePBX/Asterisk), credential 2: realm="*" (wildcard pour les autres realms)
+    static const char *const kRealms[] = {"asterisk", "*"};
+    acc_cfg->cred_count = 2;
+    for (unsigned i = 0; i < acc_cfg->cred_count; ++i) {
+        pj_strdup2(pool, &acc_cfg->cred_info[i].realm, kRealms[i]);
+        pj_strdup2(pool, &acc_cfg->cred_info[i].scheme, "digest");
+        acc_cfg->cred_info[i].username = username;
+        acc_cfg->cred_info[i].data = password;
+    }
+
+    // Without a proxy, REGISTER, INVITE and SUBSCRIBE route directly to the domain. With one,
+    // it becomes the account's route set, used by every request of the account.
+    acc_cfg->proxy_cnt = 0;
+    if (proxy && *proxy) {
+        if (!account_proxy_uri(pool, proxy, &acc_cfg->proxy[0])) return false;
+        acc_cfg->proxy_cnt = 1;
+    }
+
+    // Failed REGISTERs keep pjsua's default retry interval (300 s, none at all after a 401/403
+    // with wrong credentials); timeouts and transport errors get a few quick retries from
+    // reg_retry_on_state so the next SRV target is tried without that wait.
+
+    // CRITICAL: Enable shared auth for buddies (SUBSCRIBE/NOTIFY) to use account credentials
+    // This allows SUBSCRIBE to automatically retry with Digest auth after receiving 401
+    acc_cfg->use_shared_auth = PJ_TRUE;
+
+    // REGISTER is started explicitly once the account is in the table, so on_reg_state can
+    // already tell whether it belongs to the active account.
+    acc_cfg->register_on_acc_add = PJ_FALSE;
+
+    // 100rel is offered, not required: servers without PRACK support still get plain provisionals
+    acc_cfg->require_100rel = g_answer_100rel.load(std::memory_order_relaxed) ? PJSUA_100REL_OPTIONAL
+                                                                             : PJSUA_100REL_NOT_USED;
+
+#if defined(VOIP_SRTP) && VOIP_SRTP
+    srtp_apply_account_policy_locked(std::string(user) + "@" + domain, acc_cfg);
+#endif
+    return true;
+}
+
+static bool cmd_register(const std::string &user_s, const std::string &pass_s, const std::string &domain_s, const std::string &proxy_s) {
+    if (!ensure_endpoint()) return false;
+
+    const char *user = user_s.c_str();
+    const char *pass = pass_s.c_str();
+    const char *domain = domain_s.c_str();
+    const char *proxy = proxy_s.c_str();
+    
+    LOGI(">>> nativeRegister: Called with parameters:");
+    LOGI("    - user=%s", user ? user : "NULL");
+    LOGI("    - domain=%s", domain ? domain : "NULL");
+    LOGI("    - proxy=%s", *proxy ? proxy : "(none, direct routing to domain)");
+
+    const std::string key = std::string(user) + "@" + domain;
+    dns_prewarm_domain(domain);
+
+    // Each registration owns its strings in a fresh pool; the previous pool of the same
+    // account is only released once PJSUA has accepted the new configuration.
+    pj_pool_t *pool = pjsua_pool_create("acc%p", 512, 512);
+    pjsua_acc_config acc_cfg;
+    pjsua_acc_id acc_id = PJSUA_INVALID_ID;
+    {
+        DomainLock lock(g_accounts_lock);
+        if (!build_account_config(pool, user, pass, domain, proxy, &acc_cfg)) {
+            pj_pool_release(pool);
+            return false;
+        }
+        AccountEntry *existing = find_account_by_key_locked(key);
+        if (existing) acc_id = existing->acc_id;
+    }
+    LOGI(">>> nativeRegister: id=%.*s reg_uri=%.*s proxy=%.*s (strings owned by account pool)",
+         (int)acc_cfg.id.slen, acc_cfg.id.ptr, (int)acc_cfg.reg_uri.slen, acc_cfg.reg_uri.ptr,
+         acc_cfg.proxy_cnt ? (int)acc_cfg.proxy[0].slen : 0, acc_cfg.proxy_cnt ? acc_cfg.proxy[0].ptr : "");
+
+    // Unlocked: both can re-enter on_reg_state(). Only commands change the table, so the
+    // entry looked up above is still there afterwards.
+    pj_status_t status;
+    const bool modify = acc_id != PJSUA_INVALID_ID;
+    if (modify) {
+        // Same identity registered again (new password, refresh): modify in place, keeping its buddies
+        pjsua_unlocked_check("pjsua_acc_modify");
+        status = pjsua_acc_modify(acc_id, &acc_cfg);
+        LOGI(">>> nativeRegister: %s already in table (acc_id=%d), pjsua_acc_modify status=%d", key.c_str(), acc_id, status);
+    } else {
+        pjsua_unlocked_check("pjsua_acc_add");
+        status = pjsua_acc_add(&acc_cfg, PJ_FALSE, &acc_id);
+        LOGI(">>> nativeRegister: pjsua_acc_add returned status=%d, acc_id=%d", status, acc_id);
+    }
+
+    if (status != PJ_SUCCESS) {
+        LOGE(">>> nativeRegister: Account add/modify FAILED with status=%d", status);
+        pj_pool_release(pool);
+        return false;
+    }
+
+    {
+        DomainLock lock(g_accounts_lock);
+        AccountEntry &entry = g_accounts[acc_id];
+        if (modify) {
+            pj_pool_release(entry.pool);
+        } else {
+            entry.acc_id = acc_id;
+            entry.key = key;
+            entry.username = user;
+            entry.domain = domain;
+        }
+        entry.pool = pool;
+        entry.password = acc_cfg.cred_info[0].data;
+        // Mettre le compte en défaut pour que les buddies l'utilisent. Other accounts stay registered.
+        set_active_account_locked(acc_id);
+    }
+    pjsua_unlocked_check("pjsua_acc_set_registration");
+    status = pjsua_acc_set_registration(acc_id, PJ_TRUE);
+    LOGI(">>> nativeRegister: %s registering (acc_id=%d, status=%d), SHARED AUTH enabled for buddies", key.c_str(), acc_id, status);
+    return status == PJ_SUCCESS;
+}
+
+extern "C" JNIEXPORT jlong JNICALL
+Java_fr_celya_celyavox_PjsipEngine_nativeRegister(JNIEnv *env, jobject, jstring juser, jstring jpass, jstring jdomain, jstring jproxy) {
+    VOIP_TRACE_SCOPE("jni", "nativeRegister");
+    std::string user = jstring_to_std(env, juser);
+    std::string pass = jstring_to_std(env, jpass);
+    std::string domain = jstring_to_std(env, jdomain);
+    std::string proxy = jstring_to_std(env, jproxy);
+    return submit_command("register", [user, pass, domain, proxy] { return cmd_register(user, pass, domain, proxy); });
+}
+
+static bool cmd_unregister() {
+    pjsua_acc_id acc_id = active_account_snapshot()->acc_id;
+    if (acc_id != PJSUA_INVALID_ID) {
+        pjsua_unlocked_check("pjsua_acc_set_registration");
+        pj_status_t st = pjsua_acc_set_registration(acc_id, PJ_FALSE);
+        if (st == PJ_SUCCESS) {
+            LOGI("Unregister requested (REGISTER expires=0) for account id=%d", acc_id);
+        } else {
+            LOGE("Unregister request failed for account id=%d status=%d", acc_id, st);
+            return false;
+        }
+    }
+    return true;
+}
+
+extern "C" JNIEXPORT jlong JNICALL
+Java_fr_celya_celyavox_PjsipEngine_nativeUnregister(JNIEnv *, jobject) {
+    VOIP_TRACE_SCOPE("jni", "nativeUnregister");
+    return submit_command("unregister", [] { return cmd_unregister(); });
+}
+
+static bool cmd_set_active_account(const std::string &user, const std::string &domain) {
+    if (!ensure_endpoint()) return false;
+    const std::string key = user + "@" + domain;
+
+    DomainLock lock(g_accounts_lock);
+    AccountEntry *acc = find_account_by_key_locked(key);
+    if (!acc) {
+        LOGW(">>> nativeSetActiveAccount: %s is not registered", key.c_str());
+        return false;
+    }
+    set_active_account_locked(acc->acc_id);
+    return true;
+}
+
+extern "C" JNIEXPORT jlong JNICALL
+Java_fr_celya_celyavox_PjsipEngine_nativeSetActiveAccount(JNIEnv *env, jobject, jstring juser, jstring jdomain) {
+    VOIP_TRACE_SCOPE("jni", "nativeSetActiveAccount");
+    std::string user = jstring_to_std(env, juser);
+    std::string domain = jstring_to_std(env, jdomain);
+    return submit_command("set_active_account", [user, domain] { return cmd_set_active_account(user, domain); });
+}
+
+static bool cmd_remove_account(const std::string &user, const std::string &domain) {
+    if (!ensure_endpoint()) return false;
+    const std::string key = user + "@" + domain;
+
+    AccountEntry removed;
+    {
+        DomainLock lock(g_accounts_lock);
+        AccountEntry *acc = find_account_by_key_locked(key);
+        if (!acc || !detach_account_locked(acc->acc_id, &removed)) {
+            LOGW(">>> nativeRemoveAccount: %s is not registered", key.c_str());
+            return false;
+        }
+    }
+    remove_account(removed);
+    return true;
+}
+
+extern "C" JNIEXPORT jlong JNICALL
+Java_fr_celya_celyavox_PjsipEngine_nativeRemoveAccount(JNIEnv *env, jobject, jstring juser, jstring jdomain) {
+    VOIP_TRACE_SCOPE("jni", "nativeRemoveAccount");
+    std::string user = jstring_to_std(env, juser);
+    std::string domain = jstring_to_std(env, jdomain);
+    return submit_command("remove_account", [user, domain] { return cmd_remove_account(user, domain); });
+}
+
+static bool cmd_make_call(const std::string &number_s) {
+    
+    LOGI("nativeMakeCall: Starting outgoing call");
+    
+    if (!ensure_endpoint()) {
+        LOGE("nativeMakeCall: Endpoint not ready");
+        return false;
+    }
+    media_resume("outgoing call");
+
+    // Route the call through the active account, using its own domain
+    std::shared_ptr<const ActiveAccount> active = active_account_snapshot();
+    pjsua_acc_id acc_id = active->acc_id;
+    const std::string &account_domain = active->domain;
+    if (acc_id == PJSUA_INVALID_ID) {
+        LOGE("nativeMakeCall: no active account registered");
+        return command_done(false, PJ_EINVALIDOP);
+    }
+    
+    const char *number = number_s.c_str();
+    
     // Use static buffer for call destination (CRITICAL: PJSIP needs it to persist during auth retry)
     // IMPORTANT: Include domain for proper credential matching during 401 auth retry
     // REGISTER uses "sip:domain", SUBSCRIBE uses "sip:contact@domain", so INVITE should use "sip:number@domain"
-    memset(g_global_call_dest_uri, 0, sizeof(g_global_call_dest_uri));
+    char dest_uri[sizeof(g_global_call_dest_uri)];
+    memset(dest_uri, 0, sizeof(dest_uri));
     
     // FIX: Check if number already has @domain (Dart may have added it)
     if (strchr(number, '@') != nullptr) {
@@ -962,28 +3901,28 @@ Java_fr_celya_celyavox_PjsipEngine_nativeMakeCall(JNIEnv *env, jobject, jstring
         
         if (strncmp(number, "sip:", 4) == 0) {
             // Already has sip: prefix - replace domain
-            snprintf(g_global_call_dest_uri, sizeof(g_global_call_dest_uri) - 1, "sip:%s@%s", extracted_num + 4, g_account_domain.c_str());
+            snprintf(dest_uri, sizeof(dest_uri) - 1, "sip:%s@%s", extracted_num + 4, account_domain.c_str());
             LOGI(">>> nativeMakeCall: Number already has sip: prefix, using domain from account");
         } else {
             // Has @domain but missing sip: prefix - add sip: and replace domain
-            snprintf(g_global_call_dest_uri, sizeof(g_global_call_dest_uri) - 1, "sip:%s@%s", extracted_num, g_account_domain.c_str());
+            snprintf(dest_uri, sizeof(dest_uri) - 1, "sip:%s@%s", extracted_num, account_domain.c_str());
             LOGI(">>> nativeMakeCall: Number has @domain from Dart, replacing with account domain");
         }
-    } else if (g_account_domain.empty()) {
+    } else if (account_domain.empty()) {
         // Number has no @domain and domain not available (shouldn't happen)
-        snprintf(g_global_call_dest_uri, sizeof(g_global_call_dest_uri) - 1, "sip:%s", number);
+        snprintf(dest_uri, sizeof(dest_uri) - 1, "sip:%s", number);
         LOGW(">>> nativeMakeCall: WARNING - domain not available, using number-only destination");
     } else {
         // Number has no @domain, add it with account domain
-        snprintf(g_global_call_dest_uri, sizeof(g_global_call_dest_uri) - 1, "sip:%s@%s", number, g_account_domain.c_str());
+        snprintf(dest_uri, sizeof(dest_uri) - 1, "sip:%s@%s", number, account_domain.c_str());
         LOGI(">>> nativeMakeCall: Number has no @domain, adding account domain");
     }
     
-    LOGI(">>> nativeMakeCall: Destination=%s", g_global_call_dest_uri);
+    LOGI(">>> nativeMakeCall: Destination=%s", dest_uri);
     
     // DEBUG: Show account configuration before INVITE
     pjsua_acc_info acc_info;
-    if (pjsua_acc_get_info(g_acc_id, &acc_info) == PJ_SUCCESS) {
+    if (pjsua_acc_get_info(acc_id, &acc_info) == PJ_SUCCESS) {
         LOGI(">>> nativeMakeCall: Account Config (from pjsua_acc_get_info):");
         LOGI("    Account ID: %d", acc_info.id);
         LOGI("    Is Default: %d", acc_info.is_default);
@@ -994,21 +3933,26 @@ Java_fr_celya_celyavox_PjsipEngine_nativeMakeCall(JNIEnv *env, jobject, jstring
         LOGI("    Online Status: %d", acc_info.online_status);
     }
     
-    LOGI(">>> nativeMakeCall: About to send INVITE via account %d to %s", g_acc_id, g_global_call_dest_uri);
+    LOGI(">>> nativeMakeCall: About to send INVITE via account %d to %s", acc_id, dest_uri);
     LOGI(">>> nativeMakeCall: INVITE destination has explicit ;transport=udp (no DNS SRV lookups)");
     LOGI(">>> nativeMakeCall: If 401 Unauthorized received, PJSIP should auto-retry with Digest auth");
     
-    // Release JNI string NOW, before taking mutex and calling native APIs
-    env->ReleaseStringUTFChars(jnumber, number);
-    
-    std::lock_guard<std::mutex> lock(g_mutex);
-    pj_str_t dst = {g_global_call_dest_uri, static_cast<pj_ssize_t>(strlen(g_global_call_dest_uri))};
+    // Publish the destination in the persistent buffer; the INVITE itself is sent unlocked
+    // because pjsua_call_make_call() re-enters on_call_state(), which calls into the JVM.
+    pj_str_t dst;
+    {
+        DomainLock lock(g_calls_lock);
+        pj_ansi_strncpy(g_global_call_dest_uri, dest_uri, sizeof(g_global_call_dest_uri) - 1);
+        dst = pj_str(g_global_call_dest_uri);
+    }
     
-    LOGI(">>> nativeMakeCall: INVITE destination: %s", g_global_call_dest_uri);
-    LOGI(">>> nativeMakeCall: INVITE will use account %d credentials for 401 auth retry (credential realm matching enabled)", g_acc_id);
+    LOGI(">>> nativeMakeCall: INVITE destination: %s", dest_uri);
+    LOGI(">>> nativeMakeCall: INVITE will use account %d credentials for 401 auth retry (credential realm matching enabled)", acc_id);
     
+    uint64_t setup_start_us = metric_now_us();
     pjsua_call_id call_id = PJSUA_INVALID_ID;
-    pj_status_t status = pjsua_call_make_call(g_acc_id, &dst, 0, nullptr, nullptr, &call_id);
+    pjsua_unlocked_check("pjsua_call_make_call");
+    pj_status_t status = pjsua_call_make_call(acc_id, &dst, 0, nullptr, nullptr, &call_id);
     
     LOGI(">>> nativeMakeCall: pjsua_call_make_call returned status=%d, call_id=%d", status, call_id);
     if (status != PJ_SUCCESS) {
@@ -1021,10 +3965,11 @@ Java_fr_celya_celyavox_PjsipEngine_nativeMakeCall(JNIEnv *env, jobject, jstring
     
     if (status == PJMEDIA_EAUD_NODEFDEV) {
         LOGE("nativeMakeCall: No audio device. Retrying with null sound device.");
-        pj_status_t null_status = pjsua_set_null_snd_dev();
+        pj_status_t null_status = media_attach_null_clock();
         if (null_status == PJ_SUCCESS) {
             call_id = PJSUA_INVALID_ID;
-            status = pjsua_call_make_call(g_acc_id, &dst, 0, nullptr, nullptr, &call_id);
+            pjsua_unlocked_check("pjsua_call_make_call");
+            status = pjsua_call_make_call(acc_id, &dst, 0, nullptr, nullptr, &call_id);
             LOGI("nativeMakeCall: Retry after set_null_snd_dev status=%d, call_id=%d", status, call_id);
         }
     }
@@ -1033,70 +3978,89 @@ Java_fr_celya_celyavox_PjsipEngine_nativeMakeCall(JNIEnv *env, jobject, jstring
         char errbuf[128];
         pj_strerror(status, errbuf, sizeof(errbuf));
         LOGE("nativeMakeCall: Failed with status %d (%s)", status, errbuf);
-        emit_event("call_error", errbuf);
-        return JNI_FALSE;
+        voip_events::Event ev;
+        ev.type = voip_events::EV_CALL_ERROR;
+        ev.code = status;
+        ev.string_count = 1;
+        ev.strings[0] = errbuf;
+        dispatch_event(ev);
+        return command_done(false, status);
     }
-    LOGI("nativeMakeCall: Successfully initiated call %s (id=%d, URI stored for auth retry)", g_global_call_dest_uri, call_id);
-    emit_event("outgoing_call", std::to_string(call_id).c_str());
-    return JNI_TRUE;
+    LOGI("nativeMakeCall: Successfully initiated call %s (id=%d, URI stored for auth retry)", dest_uri, call_id);
+    metric_inc(MC_CALLS_OUTGOING);
+    metric_call_setup_begin(call_id, setup_start_us);
+    emit_call_event(voip_events::EV_OUTGOING_CALL, call_id);
+    return command_done(true, call_id);
 }
 
-extern "C" JNIEXPORT jboolean JNICALL
-Java_fr_celya_celyavox_PjsipEngine_nativeAcceptCall(JNIEnv *env, jobject, jstring jcallId) {
-    ensure_pj_thread_registered("jni");
-    const char *cid = env->GetStringUTFChars(jcallId, nullptr);
-    int call_id = atoi(cid);
-    env->ReleaseStringUTFChars(jcallId, cid);
+extern "C" JNIEXPORT jlong JNICALL
+Java_fr_celya_celyavox_PjsipEngine_nativeMakeCall(JNIEnv *env, jobject, jstring jnumber) {
+    VOIP_TRACE_SCOPE("jni", "nativeMakeCall");
+    std::string number = jstring_to_std(env, jnumber);
+    return submit_command("make_call", [number] { return cmd_make_call(number); });
+}
+
+// requested_us: when the accept entered the engine (JNI / C API), so the queue wait is included
+static bool cmd_accept_call(int call_id, uint64_t requested_us) {
     
     LOGI("nativeAcceptCall: Answering incoming call id=%d", call_id);
     
     pjsua_call_info ci;
     if (pjsua_call_get_info(call_id, &ci) == PJ_SUCCESS) {
-        LOGI("nativeAcceptCall: Call state=%d, media_cnt=%u before answer", ci.state, ci.media_cnt);
+        LOGI("nativeAcceptCall: Call state=%d, media_cnt=%u before answer (prenegotiated=%d)",
+             ci.state, ci.media_cnt, call_prenegotiated(call_id));
     }
     
-    pj_status_t status = pjsua_call_answer(call_id, 200, nullptr, nullptr);
+    // Everything else (transport, SDP answer, streams in early media mode) is ready: only the 200 goes out.
+    // The accept -> 200 latency is taken when the transaction sends it (on_call_tsx_state).
+    if (call_id >= 0 && call_id < PJSUA_MAX_CALLS) {
+        g_call_accept_requested_us[call_id].store(requested_us, std::memory_order_relaxed);
+    }
+    pjsua_call_setting opt;
+    incoming_call_setting(&opt);
+    pjsua_unlocked_check("pjsua_call_answer2");
+    pj_status_t status = pjsua_call_answer2(call_id, &opt, 200, nullptr, nullptr);
     
-    LOGI("nativeAcceptCall: pjsua_call_answer returned status=%d", status);
+    LOGI("nativeAcceptCall: pjsua_call_answer2 returned status=%d", status);
     
     if (status != PJ_SUCCESS) {
         LOGE("nativeAcceptCall: Failed to answer call with status %d", status);
-        return JNI_FALSE;
+        if (call_id >= 0 && call_id < PJSUA_MAX_CALLS) {
+            g_call_accept_requested_us[call_id].store(0, std::memory_order_relaxed);
+        }
+        return command_done(false, status);
     }
     
+    call_record_mark(call_id, CM_ACCEPT, 200);
     LOGI("nativeAcceptCall: Successfully answered call id=%d", call_id);
-    return JNI_TRUE;
+    return true;
 }
 
-extern "C" JNIEXPORT jboolean JNICALL
-Java_fr_celya_celyavox_PjsipEngine_nativeHangupCall(JNIEnv *env, jobject, jstring jcallId) {
-    ensure_pj_thread_registered("jni");
-    if (!ensure_endpoint()) return JNI_FALSE;
-    const char *cid = env->GetStringUTFChars(jcallId, nullptr);
-    int call_id = atoi(cid);
-    env->ReleaseStringUTFChars(jcallId, cid);
+extern "C" JNIEXPORT jlong JNICALL
+Java_fr_celya_celyavox_PjsipEngine_nativeAcceptCall(JNIEnv *env, jobject, jstring jcallId) {
+    VOIP_TRACE_SCOPE("jni", "nativeAcceptCall");
+    const uint64_t requested_us = metric_now_us();
+    int call_id = atoi(jstring_to_std(env, jcallId).c_str());
+    return submit_command("accept_call", [call_id, requested_us] { return cmd_accept_call(call_id, requested_us); });
+}
+
+static bool cmd_hangup_call(int call_id) {
+    if (!ensure_endpoint()) return false;
     if (call_id < 0) {
         LOGE("hangup failed: invalid call_id=%d", call_id);
-        return JNI_FALSE;
+        return command_done(false, PJ_EINVAL);
     }
     
-    std::lock_guard<std::mutex> lock(g_mutex);
-    
+    // No engine lock here: PJSUA serialises call operations itself, and the hangup re-enters
+    // on_call_state() (JNI) synchronously.
     pjsua_call_info ci;
     if (pjsua_call_get_info(call_id, &ci) != PJ_SUCCESS) {
         LOGE("hangup failed: unknown call_id=%d", call_id);
-        return JNI_FALSE;
+        return command_done(false, PJ_ENOTFOUND);
     }
     
     // Log call state to help debug CANCEL issues
-    const char *state_str = "UNKNOWN";
-    if (ci.state == PJSIP_INV_STATE_NULL) state_str = "NULL";
-    else if (ci.state == PJSIP_INV_STATE_CALLING) state_str = "CALLING";
-    else if (ci.state == PJSIP_INV_STATE_INCOMING) state_str = "INCOMING";
-    else if (ci.state == PJSIP_INV_STATE_EARLY) state_str = "EARLY";
-    else if (ci.state == PJSIP_INV_STATE_CONNECTING) state_str = "CONNECTING";
-    else if (ci.state == PJSIP_INV_STATE_CONFIRMED) state_str = "CONFIRMED";
-    else if (ci.state == PJSIP_INV_STATE_DISCONNECTED) state_str = "DISCONNECTED";
+    const char *state_str = inv_state_name(ci.state);
     
     LOGI(">>> nativeHangupCall: call_id=%d, state=%d(%s), last_status=%d", call_id, ci.state, state_str, ci.last_status);
     
@@ -1117,120 +4081,186 @@ Java_fr_celya_celyavox_PjsipEngine_nativeHangupCall(JNIEnv *env, jobject, jstrin
     }
     
     LOGI(">>> nativeHangupCall: Using hangup code=%d", hangup_code);
+    // Marked before the hangup: it re-enters on_call_state (DISCONNECTED) synchronously
+    call_record_mark(call_id, CM_HANGUP, hangup_code);
+    pjsua_unlocked_check("pjsua_call_hangup");
     pj_status_t status = pjsua_call_hangup(call_id, hangup_code, nullptr, nullptr);
     if (status != PJ_SUCCESS) {
         char errbuf[128];
         pj_strerror(status, errbuf, sizeof(errbuf));
         LOGE(">>> nativeHangupCall: hangup failed for call_id=%d: %d (%s)", call_id, status, errbuf);
-        return JNI_FALSE;
+        return command_done(false, status);
     }
     LOGI(">>> nativeHangupCall: Successfully initiated hangup for call_id=%d", call_id);
-    return JNI_TRUE;
+    return true;
 }
 
-extern "C" JNIEXPORT jboolean JNICALL
-Java_fr_celya_celyavox_PjsipEngine_nativeSendDtmf(JNIEnv *env, jobject, jstring jcallId, jstring jdigits) {
-    ensure_pj_thread_registered("jni");
-    if (!ensure_endpoint()) return JNI_FALSE;
-    const char *cid = env->GetStringUTFChars(jcallId, nullptr);
-    const char *digits = env->GetStringUTFChars(jdigits, nullptr);
-    int call_id = atoi(cid);
-    pj_str_t dtmf = pj_str(const_cast<char *>(digits));
-    std::lock_guard<std::mutex> lock(g_mutex);
+extern "C" JNIEXPORT jlong JNICALL
+Java_fr_celya_celyavox_PjsipEngine_nativeHangupCall(JNIEnv *env, jobject, jstring jcallId) {
+    VOIP_TRACE_SCOPE("jni", "nativeHangupCall");
+    int call_id = atoi(jstring_to_std(env, jcallId).c_str());
+    return submit_command("hangup_call", [call_id] { return cmd_hangup_call(call_id); });
+}
+
+static bool cmd_send_dtmf(int call_id, const std::string &digits) {
+    if (!ensure_endpoint()) return false;
+    pj_str_t dtmf = pj_str(const_cast<char *>(digits.c_str()));
     pj_status_t status = pjsua_call_dial_dtmf(call_id, &dtmf);
-    env->ReleaseStringUTFChars(jcallId, cid);
-    env->ReleaseStringUTFChars(jdigits, digits);
     if (status != PJ_SUCCESS) {
         LOGE("send dtmf failed: %d", status);
-        return JNI_FALSE;
+        return command_done(false, status);
     }
-    return JNI_TRUE;
+    return true;
+}
+
+extern "C" JNIEXPORT jlong JNICALL
+Java_fr_celya_celyavox_PjsipEngine_nativeSendDtmf(JNIEnv *env, jobject, jstring jcallId, jstring jdigits) {
+    VOIP_TRACE_SCOPE("jni", "nativeSendDtmf");
+    int call_id = atoi(jstring_to_std(env, jcallId).c_str());
+    std::string digits = jstring_to_std(env, jdigits);
+    return submit_command("send_dtmf", [call_id, digits] { return cmd_send_dtmf(call_id, digits); });
 }
 
 extern "C" JNIEXPORT jstring JNICALL
 Java_fr_celya_celyavox_PjsipEngine_nativeGetCallerInfo(JNIEnv *env, jobject, jstring jcallId) {
-    ensure_pj_thread_registered("jni");
-    if (!ensure_endpoint()) return nullptr;
-    
-    const char *cid = env->GetStringUTFChars(jcallId, nullptr);
-    int call_id = atoi(cid);
-    env->ReleaseStringUTFChars(jcallId, cid);
-    
-    pjsua_call_info ci;
-    std::lock_guard<std::mutex> lock(g_mutex);
+    VOIP_TRACE_SCOPE("jni", "nativeGetCallerInfo");
+    int call_id = atoi(jstring_to_std(env, jcallId).c_str());
     
-    if (pjsua_call_get_info(call_id, &ci) != PJ_SUCCESS) {
-        LOGE("Failed to get call info for call_id=%d", call_id);
-        return nullptr;
-    }
-    
-    // Extract From header which contains the caller info
-    if (ci.remote_info.slen > 0) {
-        std::string remote_info(ci.remote_info.ptr, ci.remote_info.slen);
-        jstring jresult = env->NewStringUTF(remote_info.c_str());
-        return jresult;
+    // Cached from the INVITE: no PJSUA call, and still there after the call has ended
+    std::string remote_info;
+    {
+        DomainLock lock(g_calls_lock);
+        auto it = g_call_records.find(call_id);
+        if (it == g_call_records.end()) {
+            LOGE("Failed to get call info for call_id=%d", call_id);
+            return nullptr;
+        }
+        remote_info = it->second.remote_info;
     }
-    
-    return nullptr;
+    return remote_info.empty() ? nullptr : env->NewStringUTF(remote_info.c_str());
 }
 
+// Maps the call log file (app private dir). Safe to call again with the same path.
 extern "C" JNIEXPORT jboolean JNICALL
-Java_fr_celya_celyavox_PjsipEngine_nativeSubscribePresence(JNIEnv *env, jobject, jstring jcontact, jstring jprefix) {
-    ensure_pj_thread_registered("jni");
-    if (!ensure_endpoint()) return JNI_FALSE;
-    if (g_acc_id == PJSUA_INVALID_ID) {
-        LOGW(">>> nativeSubscribePresence: account not registered yet");
-        return JNI_FALSE;
+Java_fr_celya_celyavox_PjsipEngine_nativeOpenCallLog(JNIEnv *env, jobject, jstring jpath) {
+    VOIP_TRACE_SCOPE("jni", "nativeOpenCallLog");
+    std::string path = jstring_to_std(env, jpath);
+    bool ok = voip_cdr::open(path.c_str());
+    LOGI(">>> CDR: call log %s %s", path.c_str(), ok ? "mapped" : "could not be mapped");
+    return ok ? JNI_TRUE : JNI_FALSE;
+}
+
+// Up to count call log records, newest first, as raw voip_cdr::Record bytes (CallLogEntry.kt)
+extern "C" JNIEXPORT jbyteArray JNICALL
+Java_fr_celya_celyavox_PjsipEngine_nativeGetRecentCalls(JNIEnv *env, jobject, jint count) {
+    VOIP_TRACE_SCOPE("jni", "nativeGetRecentCalls");
+    std::vector<voip_cdr::Record> records(count > 0 ? (size_t)count : 0);
+    records.resize(voip_cdr::recent(records.data(), records.size()));
+    const jsize size = (jsize)(records.size() * sizeof(voip_cdr::Record));
+    jbyteArray result = env->NewByteArray(size);
+    if (result) env->SetByteArrayRegion(result, 0, size, reinterpret_cast<const jbyte *>(records.data()));
+    return result;
+}
+
+// Call record as "key value" lines, then one "mark <us since start> <kind> <value>" line per
+// timeline entry. Empty when the slot never held a call.
+extern "C" JNIEXPORT jstring JNICALL
+Java_fr_celya_celyavox_PjsipEngine_nativeGetCallRecord(JNIEnv *env, jobject, jstring jcallId) {
+    VOIP_TRACE_SCOPE("jni", "nativeGetCallRecord");
+    int call_id = atoi(jstring_to_std(env, jcallId).c_str());
+    std::string out;
+    {
+        DomainLock lock(g_calls_lock);
+        auto it = g_call_records.find(call_id);
+        if (it != g_call_records.end()) {
+            const CallRecord &rec = it->second;
+            char line[160];
+            out += std::string("direction ") + (rec.incoming ? "incoming" : "outgoing") + "\n";
+            out += "display_name " + rec.display_name + "\n";
+            out += "number " + rec.number + "\n";
+            out += "remote_info " + rec.remote_info + "\n";
+            snprintf(line, sizeof(line), "state %s\nstarted_ms %lld\nended %d\nend_status %d\ntimeline_dropped %u\n",
+                     inv_state_name(rec.state), (long long)rec.started_wall_ms, rec.ended ? 1 : 0, rec.end_status,
+                     rec.timeline_dropped);
+            out += line;
+            out += "end_reason " + rec.end_reason + "\n";
+            for (unsigned i = 0; i < rec.timeline_len; ++i) {
+                const CallMark &m = rec.timeline[i];
+                if (m.kind == CM_STATE || m.kind == CM_INVITE) {
+                    snprintf(line, sizeof(line), "mark %llu %s %s\n", (unsigned long long)(m.at_us - rec.started_us),
+                             kCallMarkNames[m.kind], inv_state_name(m.value));
+                } else {
+                    snprintf(line, sizeof(line), "mark %llu %s %d\n", (unsigned long long)(m.at_us - rec.started_us),
+                             kCallMarkNames[m.kind], m.value);
+                }
+                out += line;
+            }
+        }
     }
+    return env->NewStringUTF(out.c_str());
+}
+
+static bool presence_add_buddy(const ActiveAccount &acc, const std::string &contact_with_prefix);
+static bool cmd_resubscribe_presence(const std::string &contact_with_prefix);
+static void presence_lifecycle_failed(const std::string &contact_with_prefix, int code);
+
+static bool cmd_subscribe_presence(const std::string &contact, const std::string &prefix) {
+    if (!ensure_endpoint()) return false;
     
-    const char *contact_str = env->GetStringUTFChars(jcontact, nullptr);
-    const char *prefix_str = env->GetStringUTFChars(jprefix, nullptr);
-    LOGI(">>> nativeSubscribePresence CALLED: contact=%s, prefix=%s, g_acc_id=%d (should be >= 0)", contact_str, prefix_str, g_acc_id);
+    const char *contact_str = contact.c_str();
+    const char *prefix_str = prefix.c_str();
     
-    // DEBUG: Vérifier que g_acc_id est valide (non-INVALID et accessible)
-    if (g_acc_id < 0) {
-        LOGE(">>> nativeSubscribePresence: ERROR - g_acc_id=%d is negative/invalid!", g_acc_id);
-        env->ReleaseStringUTFChars(jcontact, contact_str);
-        env->ReleaseStringUTFChars(jprefix, prefix_str);
-        return JNI_FALSE;
-    }
+    // Construire le contact final avec prefix si fourni: same key as the entities of a
+    // resource list (voip_rls::contact_key), so both paths update the same lamp
+    std::string contact_with_prefix = voip_rls::contact_key(contact, prefix);
+    LOGI(">>> nativeSubscribePresence CALLED: contact=%s, prefix=%s, final_contact_with_prefix=%s",
+         contact_str, prefix_str, contact_with_prefix.c_str());
+    if (contact_with_prefix.empty()) return false;
     
-    // DEBUG: Vérifier que le compte par défaut a les credentials
-    pjsua_acc_id default_acc = pjsua_acc_get_default();
-    LOGI(">>> nativeSubscribePresence: default account ID = %d, g_acc_id = %d", default_acc, g_acc_id);
-    if (default_acc != g_acc_id) {
-        LOGW(">>> nativeSubscribePresence: WARNING - default account (%d) != our account (%d)!", default_acc, g_acc_id);
+    // Wanted from now on, even if the SUBSCRIBE cannot start yet: the lifecycle manager
+    // retries it and restores it after (re-)registration
+    bool dead = false;
+    {
+        DomainLock lock(g_presence_lock);
+        dead = g_presence_wanted[contact_with_prefix].dead;
     }
-    
-    std::lock_guard<std::mutex> lock(g_mutex);
-    
-    // Construire le contact final avec prefix si fourni
-    std::string contact_with_prefix = std::string(contact_str);
-    if (prefix_str && strlen(prefix_str) > 0 && contact_with_prefix.find(prefix_str) != 0) {
-        contact_with_prefix = std::string(prefix_str) + contact_str;
+    if (dead) {
+        LOGI(">>> nativeSubscribePresence: subscription to %s is over, resubscribing now", contact_with_prefix.c_str());
+        return cmd_resubscribe_presence(contact_with_prefix);
     }
-    LOGI(">>> nativeSubscribePresence: final_contact_with_prefix=%s", contact_with_prefix.c_str());
     
+    // BLF subscriptions belong to the active account (its credentials answer the 401 challenge)
+    std::shared_ptr<const ActiveAccount> acc = active_account_snapshot();
+    if (acc->acc_id == PJSUA_INVALID_ID) {
+        LOGW(">>> nativeSubscribePresence: account not registered yet");
+        return false;
+    }
+    return presence_add_buddy(*acc, contact_with_prefix);
+}
+
+// Adds the dialog-event buddy for contact_with_prefix on acc and tracks it; a failure is
+// handed to the lifecycle manager, which retries with backoff
+static bool presence_add_buddy(const ActiveAccount &acc, const std::string &contact_with_prefix) {
     // Vérifier si déjà subscribé (utiliser contact_with_prefix comme clé, pas juste contact_str)
-    auto it = g_buddy_subscriptions.find(contact_with_prefix);
-    if (it != g_buddy_subscriptions.end()) {
-        LOGI(">>> nativeSubscribePresence: already subscribed to %s", contact_with_prefix.c_str());
-        env->ReleaseStringUTFChars(jcontact, contact_str);
-        env->ReleaseStringUTFChars(jprefix, prefix_str);
-        return JNI_TRUE;
+    {
+        DomainLock lock(g_presence_lock);
+        auto &subs = g_account_buddies[acc.acc_id];
+        if (subs.find(contact_with_prefix) != subs.end()) {
+            LOGI(">>> nativeSubscribePresence: already subscribed to %s on account %d", contact_with_prefix.c_str(), acc.acc_id);
+            return true;
+        }
+        g_presence_wanted[contact_with_prefix].attempts++;
     }
     
     // Construire un URI SIP valide: sip:contact@domain
-    if (g_account_domain.empty()) {
+    if (acc.domain.empty()) {
         LOGE(">>> nativeSubscribePresence: account domain not available, cannot subscribe");
-        env->ReleaseStringUTFChars(jcontact, contact_str);
-        env->ReleaseStringUTFChars(jprefix, prefix_str);
-        return JNI_FALSE;
+        return false;
     }
     
     // Buffer pour l'URI SIP
     char buddy_uri_buf[256];
-    pj_ansi_snprintf(buddy_uri_buf, sizeof(buddy_uri_buf), "sip:%s@%s", contact_with_prefix.c_str(), g_account_domain.c_str());
+    pj_ansi_snprintf(buddy_uri_buf, sizeof(buddy_uri_buf), "sip:%s@%s", contact_with_prefix.c_str(), acc.domain.c_str());
     LOGI(">>> nativeSubscribePresence: constructed buddy URI=%s", buddy_uri_buf);
     
     // Configuration du buddy pour SUBSCRIBE/NOTIFY de présence
@@ -1242,194 +4272,1526 @@ Java_fr_celya_celyavox_PjsipEngine_nativeSubscribePresence(JNIEnv *env, jobject,
     // Non pas subscribe (qui est pour la presence classique)
     buddy_cfg.subscribe = PJ_FALSE;             // Désactiver la presence classique
     buddy_cfg.subscribe_dlg_event = PJ_TRUE;    // Activer BLF (dialog event subscription)
-    // Note: buddy_cb doesn't exist in pjsua_buddy_config - NOTIFY messages handled by notify_msg_callback module
-    
-    // DEBUG: Vérifier que g_acc_id a bien les credentials AVANT d'assigner au buddy
-    LOGI(">>> nativeSubscribePresence: CREDENTIAL VERIFICATION BEFORE BUDDY SETUP:");
-    LOGI("    - g_acc_id=%d (should be >= 0)", g_acc_id);
-    LOGI("    - g_global_cred_username=%s (should not be empty)", g_global_cred_username);
-    LOGI("    - g_global_cred_password=%s (should not be empty)", g_global_cred_password);
-    
-    if (g_acc_id < 0) {
-        LOGE(">>> nativeSubscribePresence: CRITICAL ERROR - g_acc_id is INVALID (%d)! Cannot assign to buddy", g_acc_id);
-        env->ReleaseStringUTFChars(jcontact, contact_str);
-        env->ReleaseStringUTFChars(jprefix, prefix_str);
-        return JNI_FALSE;
-    }
-    
-    if (strlen(g_global_cred_username) == 0 || strlen(g_global_cred_password) == 0) {
-        LOGE(">>> nativeSubscribePresence: CRITICAL ERROR - Account credentials are EMPTY!");
-        LOGE("    - username length=%zu", strlen(g_global_cred_username));
-        LOGE("    - password length=%zu", strlen(g_global_cred_password));
-        env->ReleaseStringUTFChars(jcontact, contact_str);
-        env->ReleaseStringUTFChars(jprefix, prefix_str);
-        return JNI_FALSE;
-    }
+    buddy_cfg.acc_id = acc.acc_id;             // Lier le buddy au compte pour réutiliser ses credentials
     
-    // Vérifier que le compte par défaut est bien g_acc_id
-    pjsua_acc_id default_acc = pjsua_acc_get_default();
-    LOGI(">>> nativeSubscribePresence: Default account=%d, buddy will use account=%d", default_acc, g_acc_id);
-    
-    // Vérifier que le compte a bien les credentials
-    pjsua_acc_info acc_info;
-    if (pjsua_acc_get_info(g_acc_id, &acc_info) == PJ_SUCCESS) {
-        LOGI(">>> nativeSubscribePresence: Account info for acc_id=%d:", g_acc_id);
-        LOGI("    - has_registration=%d", acc_info.has_registration);
-        LOGI("    - status=%d", acc_info.status);
-        if (acc_info.status_text.ptr) {
-            LOGI("    - status_text=%s", acc_info.status_text.ptr);
-        }
-    } else {
-        LOGE(">>> nativeSubscribePresence: ERROR - pjsua_acc_get_info failed for acc_id=%d", g_acc_id);
-    }
+    LOGI(">>> nativeSubscribePresence: buddy_cfg uri=%s, subscribe=%d, subscribe_dlg_event=%d, acc_id=%d",
+         buddy_uri_buf, buddy_cfg.subscribe, buddy_cfg.subscribe_dlg_event, buddy_cfg.acc_id);
     
-    buddy_cfg.acc_id = g_acc_id;                // Lier le buddy au compte pour réutiliser ses credentials
-    // Le buddy utilisera les credentials du compte g_acc_id pour authentifier le SUBSCRIBE après 401
-    LOGI(">>> nativeSubscribePresence: buddy_cfg.acc_id assigned to %d", buddy_cfg.acc_id);
-    
-    LOGI(">>> nativeSubscribePresence: buddy_cfg parameters:");
-    LOGI("    - uri=%s", buddy_uri_buf);
-    LOGI("    - subscribe=%d (presence, disabled)", buddy_cfg.subscribe);
-    LOGI("    - subscribe_dlg_event=%d (BLF, enabled)", buddy_cfg.subscribe_dlg_event);
-    LOGI("    - acc_id=%d (will use account credentials)", buddy_cfg.acc_id);
-    
-    // Ajouter le buddy (PJSIP envoie automatiquement SUBSCRIBE SIP au serveur)
-    LOGI(">>> nativeSubscribePresence: Calling pjsua_buddy_add()...");
-    pjsua_buddy_id buddy_id;
+    // Ajouter le buddy (PJSIP envoie automatiquement SUBSCRIBE SIP au serveur).
+    // Unlocked: the add can re-enter on_buddy_state(), which takes the presence lock.
+    pjsua_buddy_id buddy_id = PJSUA_INVALID_ID;
+    pjsua_unlocked_check("pjsua_buddy_add");
     pj_status_t status = pjsua_buddy_add(&buddy_cfg, &buddy_id);
     
     LOGI(">>> nativeSubscribePresence: pjsua_buddy_add() returned status=%d, buddy_id=%d", status, buddy_id);
     
-    if (status != PJ_SUCCESS) {
-        LOGE(">>> nativeSubscribePresence: pjsua_buddy_add FAILED! status=%d (PJ_SUCCESS=0)", status);
+    if (status != PJ_SUCCESS || buddy_id < 0) {
         char errbuf[128];
         pj_strerror(status, errbuf, sizeof(errbuf));
-        LOGE(">>> nativeSubscribePresence: Error message: %s", errbuf);
-        env->ReleaseStringUTFChars(jcontact, contact_str);
-        env->ReleaseStringUTFChars(jprefix, prefix_str);
-        return JNI_FALSE;
-    }
-    
-    // Vérifier que buddy_id est valide
-    if (buddy_id < 0) {
-        LOGE(">>> nativeSubscribePresence: buddy_id is INVALID (%d)! PJSUA returned PJ_SUCCESS but invalid buddy_id", buddy_id);
-        env->ReleaseStringUTFChars(jcontact, contact_str);
-        env->ReleaseStringUTFChars(jprefix, prefix_str);
-        return JNI_FALSE;
+        LOGE(">>> nativeSubscribePresence: pjsua_buddy_add FAILED! status=%d (%s), buddy_id=%d", status, errbuf, buddy_id);
+        if (status == PJ_ETOOMANY) {
+            // Table full (PJSUA_MAX_BUDDIES): retrying cannot help, the next registration will try again
+            LOGE(">>> nativeSubscribePresence: buddy table full (%d), %s not subscribed", PJSUA_MAX_BUDDIES,
+                 contact_with_prefix.c_str());
+            char reason[64];
+            snprintf(reason, sizeof(reason), "buddy table full (%d)", PJSUA_MAX_BUDDIES);
+            emit_presence_error(contact_with_prefix, status, reason);
+            return command_done(false, status);
+        }
+        presence_lifecycle_failed(contact_with_prefix, 0);
+        return false;
     }
     
-    LOGI(">>> nativeSubscribePresence: pjsua_buddy_add SUCCESS! buddy_id=%d is VALID", buddy_id);
-    
-    // Tracker la subscription dans les deux maps (utiliser contact_with_prefix comme clé, PAS contact_str!)
+    // Tracker la subscription (utiliser contact_with_prefix comme clé, PAS contact_str!)
     // Cela permet de distinguer les subscriptions au même contact avec des prefixes différents
-    g_buddy_subscriptions[contact_with_prefix] = buddy_id;
-    g_buddy_reverse_map[buddy_id] = contact_with_prefix;  // Stocker le contact complet avec prefix
-    LOGI(">>> nativeSubscribePresence: Tracked in maps. SUBSCRIBE should now be sent to server for: %s", contact_with_prefix.c_str());
-    
-    env->ReleaseStringUTFChars(jcontact, contact_str);
-    env->ReleaseStringUTFChars(jprefix, prefix_str);
-    return JNI_TRUE;
+    {
+        DomainLock lock(g_presence_lock);
+        g_account_buddies[acc.acc_id][contact_with_prefix] = buddy_id;
+        g_buddy_reverse_map[buddy_id] = contact_with_prefix;  // Stocker le contact complet avec prefix
+        g_buddy_account_map[buddy_id] = acc.acc_id;
+        SubscriptionLifecycle &life = g_presence_wanted[contact_with_prefix];
+        life.dead = false;
+        life.sub_state = PJSIP_EVSUB_STATE_NULL;
+        metric_gauge_set(MG_BUDDIES, (int64_t)g_buddy_reverse_map.size());
+    }
+    LOGI(">>> nativeSubscribePresence: Tracked on account %d. SUBSCRIBE should now be sent to server for: %s",
+         acc.acc_id, contact_with_prefix.c_str());
+    return true;
 }
 
-extern "C" JNIEXPORT jboolean JNICALL
-Java_fr_celya_celyavox_PjsipEngine_nativeUnsubscribePresence(JNIEnv *env, jobject, jstring jcontact) {
-    ensure_pj_thread_registered("jni");
-    if (!ensure_endpoint()) return JNI_FALSE;
+extern "C" JNIEXPORT jlong JNICALL
+Java_fr_celya_celyavox_PjsipEngine_nativeSubscribePresence(JNIEnv *env, jobject, jstring jcontact, jstring jprefix) {
+    VOIP_TRACE_SCOPE("jni", "nativeSubscribePresence");
+    std::string contact = jstring_to_std(env, jcontact);
+    std::string prefix = jstring_to_std(env, jprefix);
+    return submit_command("subscribe_presence", [contact, prefix] { return cmd_subscribe_presence(contact, prefix); });
+}
+
+// Exact match or key ending with contact (the same contact behind a prefix)
+static bool subscription_key_matches(const std::string &key, const std::string &contact) {
+    return key == contact ||
+           (key.size() > contact.size() && key.compare(key.size() - contact.size(), std::string::npos, contact) == 0);
+}
+
+static bool cmd_unsubscribe_presence(const std::string &contact_str) {
+    if (!ensure_endpoint()) return false;
     
-    const char *contact_cstr = env->GetStringUTFChars(jcontact, nullptr);
-    std::string contact_str(contact_cstr);  // Convert to std::string
     LOGI(">>> nativeUnsubscribePresence CALLED: contact=%s", contact_str.c_str());
-    std::lock_guard<std::mutex> lock(g_mutex);
+    pjsua_acc_id acc_id = active_account_snapshot()->acc_id;
+    if (acc_id == PJSUA_INVALID_ID) {
+        LOGW(">>> nativeUnsubscribePresence: no active account, only dropping %s from the wanted set", contact_str.c_str());
+    }
     
     // Find subscription: either exact match OR matching contact with any prefix
     // Example: looking for "100" should find "100" or "250100" (prefix="250")
     pjsua_buddy_id buddy_id_to_delete = -1;
     std::string key_to_delete = "";
+    bool wanted = false;
     
-    for (auto& pair : g_buddy_subscriptions) {
-        const std::string& key = pair.first;
-        // Check exact match or if key ends with contact_str
-        if (key == contact_str || (key.size() > contact_str.size() && 
-            key.substr(key.size() - contact_str.size()) == contact_str)) {
-            buddy_id_to_delete = pair.second;
-            key_to_delete = key;
-            LOGI(">>> nativeUnsubscribePresence: Found subscription key=%s matching contact=%s", key.c_str(), contact_str.c_str());
-            break;
+    {
+        DomainLock lock(g_presence_lock);
+        auto subs_it = g_account_buddies.find(acc_id);
+        if (subs_it != g_account_buddies.end()) {
+            for (auto& pair : subs_it->second) {
+                const std::string& key = pair.first;
+                if (subscription_key_matches(key, contact_str)) {
+                    buddy_id_to_delete = pair.second;
+                    key_to_delete = key;
+                    break;
+                }
+            }
+        }
+        // Not wanted anymore: no retry or restore either, even when the buddy is already gone
+        auto wanted_it = g_presence_wanted.find(key_to_delete);
+        if (key_to_delete.empty()) {
+            for (wanted_it = g_presence_wanted.begin(); wanted_it != g_presence_wanted.end(); ++wanted_it) {
+                if (subscription_key_matches(wanted_it->first, contact_str)) break;
+            }
+        }
+        if (wanted_it != g_presence_wanted.end()) {
+            if (buddy_id_to_delete < 0) presence_cache_remove_locked(wanted_it->first);
+            presence_retry_cancel_locked(wanted_it->second);
+            g_presence_wanted.erase(wanted_it);
+            wanted = true;
+        }
+        if (buddy_id_to_delete >= 0) {
+            // Clean up every map before the UNSUBSCRIBE, so late NOTIFYs are ignored
+            subs_it->second.erase(key_to_delete);
+            g_buddy_reverse_map.erase(buddy_id_to_delete);
+            g_buddy_account_map.erase(buddy_id_to_delete);
+            g_buddy_last_dialog_state.erase(buddy_id_to_delete);
+            presence_cache_remove_locked(key_to_delete);
+            metric_gauge_set(MG_BUDDIES, (int64_t)g_buddy_reverse_map.size());
         }
     }
     
     if (buddy_id_to_delete < 0) {
+        if (wanted) {
+            LOGI(">>> nativeUnsubscribePresence: %s had no live subscription, dropped from the wanted set", contact_str.c_str());
+            return true;
+        }
         LOGW(">>> nativeUnsubscribePresence: NOT subscribed to %s", contact_str.c_str());
-        env->ReleaseStringUTFChars(jcontact, contact_cstr);
-        return JNI_FALSE;
+        return false;
+    }
+    LOGI(">>> nativeUnsubscribePresence: Found subscription key=%s matching contact=%s", key_to_delete.c_str(), contact_str.c_str());
+    
+    // Supprimer le buddy (PJSIP envoie automatiquement UNSUBSCRIBE SIP), hors verrou
+    pjsua_unlocked_check("pjsua_buddy_del");
+    pj_status_t status = pjsua_buddy_del(buddy_id_to_delete);
+    if (status != PJ_SUCCESS) {
+        LOGE(">>> nativeUnsubscribePresence: pjsua_buddy_del FAILED for %s (buddy_id=%d, status=%d)", contact_str.c_str(), buddy_id_to_delete, status);
+    } else {
+        LOGI(">>> nativeUnsubscribePresence: pjsua_buddy_del SUCCESS buddy_id=%d (sending UNSUBSCRIBE to server)", buddy_id_to_delete);
     }
     
-    // Supprimer le buddy (PJSIP envoie automatiquement UNSUBSCRIBE SIP)
-    if (buddy_id_to_delete >= 0) {
-        pj_status_t status = pjsua_buddy_del(buddy_id_to_delete);
-        if (status != PJ_SUCCESS) {
-            LOGE(">>> nativeUnsubscribePresence: pjsua_buddy_del FAILED for %s (buddy_id=%d, status=%d)", contact_str.c_str(), buddy_id_to_delete, status);
+    LOGI(">>> nativeUnsubscribePresence: COMPLETE - unsubscribed from %s, cleaned maps", contact_str.c_str());
+    return true;
+}
+
+extern "C" JNIEXPORT jlong JNICALL
+Java_fr_celya_celyavox_PjsipEngine_nativeUnsubscribePresence(JNIEnv *env, jobject, jstring jcontact) {
+    VOIP_TRACE_SCOPE("jni", "nativeUnsubscribePresence");
+    std::string contact = jstring_to_std(env, jcontact);
+    return submit_command("unsubscribe_presence", [contact] { return cmd_unsubscribe_presence(contact); });
+}
+
+// ---------------------------------------------------------------------------
+// Subscription lifecycle
+//
+// pjsua does not bring a dialog-event subscription back once the server ends it (PBX
+// reload, 481 on refresh, network loss): the buddy stays in the maps with a dead
+// subscription. Every contact of g_presence_wanted is watched here and replaced by a fresh
+// buddy, after an exponential backoff with jitter so that a reloaded PBX is not hit by all
+// its clients in the same second, and right away (spread over a short window) when the
+// active account registers again. The wanted set lives as long as the process: after an
+// in-process endpoint restart (PjsipEngine.destroy() then init()) the first registration
+// restores it; a new process starts empty and the app subscribes its contacts again.
+
+#define PRESENCE_RETRY_BASE_MS 4000
+#define PRESENCE_RETRY_MAX_MS 300000
+#define PRESENCE_RESTORE_SPREAD_MS 2000
+
+struct PresenceRetry {
+    pj_timer_entry timer;
+    std::string contact;
+};
+
+// Endpoint timer: hands the retry to the engine thread unless it was superseded
+static void presence_retry_fired(pj_timer_heap_t *, pj_timer_entry *timer) {
+    std::unique_ptr<PresenceRetry> retry(static_cast<PresenceRetry *>(timer->user_data));
+    {
+        DomainLock lock(g_presence_lock);
+        auto it = g_presence_wanted.find(retry->contact);
+        // Superseded or cancelled while already firing: the canceller left it to us
+        if (it == g_presence_wanted.end() || it->second.retry != retry.get()) return;
+        it->second.retry = nullptr;
+        it->second.next_retry_us = 0;
+    }
+    std::string contact = retry->contact;
+    submit_command("resubscribe_presence", [contact] { return cmd_resubscribe_presence(contact); });
+}
+
+// Half fixed, half random, doubling with every consecutive failure
+static unsigned presence_backoff_ms(uint32_t failures) {
+    unsigned ceiling = PRESENCE_RETRY_BASE_MS;
+    for (uint32_t i = 1; i < failures && ceiling < PRESENCE_RETRY_MAX_MS; ++i) ceiling *= 2;
+    if (ceiling > PRESENCE_RETRY_MAX_MS) ceiling = PRESENCE_RETRY_MAX_MS;
+    return ceiling / 2 + pj_rand() % (ceiling / 2 + 1);
+}
+
+// Caller must hold g_presence_lock (the timer heap calls presence_retry_fired() without its own
+// lock). Cancels the pending retry and frees its entry, unless it is already firing.
+static void presence_retry_cancel_locked(SubscriptionLifecycle &life) {
+    PresenceRetry *pending = life.retry;
+    life.retry = nullptr;
+    life.next_retry_us = 0;
+    if (pending && pjsip_endpt_cancel_timer(pjsua_get_pjsip_endpt(), &pending->timer) > 0) delete pending;
+}
+
+// Endpoint shutdown: the wanted set stays, its timers go with the timer heap
+static void presence_retry_cancel_all() {
+    DomainLock lock(g_presence_lock);
+    for (auto &item : g_presence_wanted) presence_retry_cancel_locked(item.second);
+}
+
+// Caller must hold g_presence_lock. Replaces any retry already scheduled for contact.
+static void presence_schedule_retry_locked(const std::string &contact, SubscriptionLifecycle &life, unsigned delay_ms) {
+    presence_retry_cancel_locked(life);
+    auto *retry = new PresenceRetry{{}, contact};
+    pj_timer_entry_init(&retry->timer, 0, retry, &presence_retry_fired);
+    pj_time_val delay = {(long)(delay_ms / 1000), (long)(delay_ms % 1000)};
+    if (pjsip_endpt_schedule_timer(pjsua_get_pjsip_endpt(), &retry->timer, &delay) != PJ_SUCCESS) {
+        LOGW(">>> LIFECYCLE: cannot schedule the retry of %s", contact.c_str());
+        delete retry;
+        return;
+    }
+    life.retry = retry;
+    life.next_retry_us = metric_now_us() + (uint64_t)delay_ms * 1000;
+}
+
+// Caller must hold g_presence_lock; called by on_buddy_state for tracked buddies
+static void presence_lifecycle_on_state_locked(const std::string &contact, const pjsua_buddy_info &info) {
+    auto it = g_presence_wanted.find(contact);
+    if (it == g_presence_wanted.end()) return;
+    SubscriptionLifecycle &life = it->second;
+    life.sub_state = (uint8_t)info.sub_state;
+    if (info.sub_state == PJSIP_EVSUB_STATE_ACTIVE) {
+        life.failures = 0;
+        life.dead = false;
+    } else if (info.sub_state == PJSIP_EVSUB_STATE_TERMINATED && !life.dead) {
+        // Buddies we delete ourselves are out of the reverse map first and never get here
+        life.dead = true;
+        life.terminations++;
+        life.failures++;
+        life.last_code = (int)info.sub_term_code;
+        metric_inc(MC_PRESENCE_SUB_FAILURES);
+        unsigned delay_ms = presence_backoff_ms(life.failures);
+        presence_schedule_retry_locked(contact, life, delay_ms);
+        LOGW(">>> LIFECYCLE: subscription to %s terminated (code %d, failure #%u), resubscribing in %u ms",
+             contact.c_str(), life.last_code, life.failures, delay_ms);
+    }
+}
+
+// pjsua_buddy_add() refused the contact (code 0) or the server did
+static void presence_lifecycle_failed(const std::string &contact, int code) {
+    DomainLock lock(g_presence_lock);
+    auto it = g_presence_wanted.find(contact);
+    if (it == g_presence_wanted.end()) return;
+    SubscriptionLifecycle &life = it->second;
+    life.failures++;
+    life.last_code = code;
+    metric_inc(MC_PRESENCE_SUB_FAILURES);
+    unsigned delay_ms = presence_backoff_ms(life.failures);
+    presence_schedule_retry_locked(contact, life, delay_ms);
+    LOGW(">>> LIFECYCLE: subscription to %s failed (failure #%u), retrying in %u ms", contact.c_str(), life.failures,
+         delay_ms);
+}
+
+// Registration outcome of the active account. The first success and every recovery after a
+// failure bring back what is missing: contacts without a buddy (account removed, subscribe
+// refused) and dead subscriptions waiting for their backoff. After a recovery the live ones
+// are replaced too, their dialogs may be bound to a flow that no longer exists.
+static void presence_lifecycle_on_registered(pjsua_acc_id acc_id, bool ok) {
+    DomainLock lock(g_presence_lock);
+    auto prev = g_presence_reg_ok.find(acc_id);
+    bool recovered = prev != g_presence_reg_ok.end() && !prev->second;
+    bool first = prev == g_presence_reg_ok.end();
+    g_presence_reg_ok[acc_id] = ok;
+    if (!ok || (!first && !recovered) || g_presence_wanted.empty()) return;
+
+    std::set<std::string> live;
+    auto subs = g_account_buddies.find(acc_id);
+    if (subs != g_account_buddies.end()) {
+        for (const auto &buddy : subs->second) live.insert(buddy.first);
+    }
+    size_t restored = 0;
+    for (auto &item : g_presence_wanted) {
+        SubscriptionLifecycle &life = item.second;
+        if (!recovered && !life.dead && live.count(item.first)) continue;
+        life.failures = 0;
+        presence_schedule_retry_locked(item.first, life, pj_rand() % (PRESENCE_RESTORE_SPREAD_MS + 1));
+        ++restored;
+    }
+    LOGI(">>> LIFECYCLE: account %d %s, resubscribing %zu of %zu contact(s) within %d ms", acc_id,
+         recovered ? "registered again" : "registered", restored, g_presence_wanted.size(), PRESENCE_RESTORE_SPREAD_MS);
+}
+
+// Replaces whatever buddy contact_with_prefix has (dead or not) by a new one on the active account
+static bool cmd_resubscribe_presence(const std::string &contact_with_prefix) {
+    if (!ensure_endpoint()) return false;
+    std::shared_ptr<const ActiveAccount> acc = active_account_snapshot();
+    pjsua_buddy_id stale = PJSUA_INVALID_ID;
+    {
+        DomainLock lock(g_presence_lock);
+        auto it = g_presence_wanted.find(contact_with_prefix);
+        if (it == g_presence_wanted.end()) {
+            LOGI(">>> LIFECYCLE: %s was unsubscribed meanwhile, nothing to do", contact_with_prefix.c_str());
+            return true;
+        }
+        SubscriptionLifecycle &life = it->second;
+        presence_retry_cancel_locked(life);  // This attempt supersedes any pending timer
+        if (acc->acc_id == PJSUA_INVALID_ID) {
+            LOGW(">>> LIFECYCLE: no registered account for %s, waiting for registration", contact_with_prefix.c_str());
+            return false;
+        }
+        life.resubscribes++;
+        // Out of the maps before the delete, so its final TERMINATED is not taken for a failure
+        for (auto &subs : g_account_buddies) {
+            auto buddy = subs.second.find(contact_with_prefix);
+            if (buddy == subs.second.end()) continue;
+            stale = buddy->second;
+            subs.second.erase(buddy);
+            g_buddy_reverse_map.erase(stale);
+            g_buddy_account_map.erase(stale);
+            g_buddy_last_dialog_state.erase(stale);
+            break;
+        }
+    }
+    metric_inc(MC_PRESENCE_RESUBSCRIBES);
+    pjsua_unlocked_check("pjsua_buddy_del");
+    if (stale != PJSUA_INVALID_ID) pjsua_buddy_del(stale);
+    LOGI(">>> LIFECYCLE: resubscribing %s on account %d (old buddy %d)", contact_with_prefix.c_str(), acc->acc_id, stale);
+    return presence_add_buddy(*acc, contact_with_prefix);
+}
+
+// ---------------------------------------------------------------------------
+// Resource lists (RFC 4662)
+//
+// One SUBSCRIBE (Event: dialog, Require: eventlist) to a server-side list URI replaces one
+// buddy per lamp: a single dialog, 401 challenge and refresh timer for the whole panel.
+// NOTIFYs carry a multipart/related body: an RLMI document listing the resources, plus one
+// dialog-info+xml part per resource with a known state (parsed by voip_rls.cpp, which also
+// gives the entities the per-buddy contact keys). Each entity is published exactly
+// like a buddy (presence cache + presence_updated). When the server refuses the list
+// (420 Bad Extension, 404, 489...) or ends it, the contacts fall back to per-buddy
+// subscriptions.
+// ---------------------------------------------------------------------------
+
+#define RLS_EXPIRES 3600
+
+struct RlsSubscription {
+    pjsip_evsub *sub = nullptr;
+    pjsip_dialog *dlg = nullptr;                 // Session reference (mod_rls) held while in g_rls
+    pjsua_acc_id acc_id = PJSUA_INVALID_ID;
+    std::string list_uri;
+    std::vector<std::string> fallback_contacts;  // Subscribed one by one if the list fails
+    std::string prefix;
+    std::vector<std::string> entities;           // Contacts the list has reported so far
+    bool active = false;                         // At least one NOTIFY received
+};
+static RlsSubscription g_rls;  // Presence domain; one lamp panel list at a time
+
+static pj_str_t STR_DIALOG_EVENT = { (char*)"dialog", 6 };
+
+static pjsip_module mod_rls = {
+    NULL, NULL,                              // prev, next
+    { (char*)"mod-rls-client", 14 },         // name
+    -1,                                      // id
+    PJSIP_MOD_PRIORITY_APPLICATION,          // priority
+    NULL, NULL, NULL, NULL,                  // load(), start(), stop(), unload()
+    NULL, NULL, NULL, NULL,                  // on_rx/tx_request/response()
+    NULL,                                    // on_tsx_state()
+};
+
+// Only owns the session references on list dialogs. The "dialog" event package itself
+// belongs to pjsua's dialog-event module (registered by pjsua_init for BLF buddies): list
+// SUBSCRIBEs use it and add the RLMI and multipart types to Accept per request.
+static bool g_rls_available = false;
+
+static void rls_init_module(pjsip_endpoint *endpt) {
+    // Once per endpoint: a restarted endpoint registers the module again
+    g_rls_available = false;
+    if (pjsip_endpt_register_module(endpt, &mod_rls) != PJ_SUCCESS) {
+        LOGW(">>> RLS: module not registered, resource lists fall back to per-buddy subscriptions");
+        return;
+    }
+    g_rls_available = true;
+}
+
+// The NOTIFY body as sent: pjsip has already split multipart bodies into parts, while
+// voip_rls parses the text (see voip_rls.h); returns the number of unparsable parts
+static size_t rls_parse_notify(const char *msg_buf, size_t msg_len, const pjsip_msg *msg, const std::string &prefix,
+                               voip_rls::States &out) {
+    if (!msg || !msg->body || !msg_buf) return 0;
+    static const char kBlankLine[] = "\r\n\r\n";
+    const char *end = msg_buf + msg_len;
+    const char *body = std::search(msg_buf, end, kBlankLine, kBlankLine + 4);
+    if (body == end) return 1;
+    body += 4;
+    char content_type[256];
+    int len = pjsip_media_type_print(content_type, sizeof(content_type), &msg->body->content_type);
+    if (len <= 0) return 1;
+    return voip_rls::parse_notify(std::string(content_type, (size_t)len), body, (size_t)(end - body), prefix, out);
+}
+
+static void rls_on_rx_notify(pjsip_evsub *sub, pjsip_rx_data *rdata, int *p_st_code, pj_str_t **p_st_text,
+                             pjsip_hdr *res_hdr, pjsip_msg_body **p_body) {
+    VOIP_TRACE_SCOPE("pjsua", "rls_on_rx_notify");
+    metric_inc(MC_NOTIFY_PROCESSED);
+    std::string prefix;
+    {
+        DomainLock lock(g_presence_lock);
+        if (g_rls.sub != sub) return;
+        prefix = g_rls.prefix;
+    }
+    voip_rls::States states;
+    if (rls_parse_notify(rdata->msg_info.msg_buf, (size_t)rdata->msg_info.len, rdata->msg_info.msg, prefix, states) > 0) {
+        LOGW(">>> RLS: NOTIFY body part(s) not parsed");
+    }
+    voip_rls::States changed;
+    {
+        DomainLock lock(g_presence_lock);
+        if (g_rls.sub != sub) return;
+        g_rls.active = true;
+        for (const auto &st : states) {
+            if (std::find(g_rls.entities.begin(), g_rls.entities.end(), st.first) == g_rls.entities.end()) {
+                g_rls.entities.push_back(st.first);
+            }
+            BlfState next = blf_state_from_name(st.second.c_str());
+            if (presence_transition_locked(st.first, PJSUA_INVALID_ID, next, PRESENCE_SRC_NOTIFY_BODY,
+                                           PJSIP_EVSUB_STATE_ACTIVE)) {
+                changed.emplace_back(st.first, kBlfStateNames[next]);
+            }
+        }
+    }
+    // Full-state NOTIFYs repeat every lamp: only the ones that moved are emitted
+    LOGI(">>> RLS: NOTIFY with %zu resource state(s), %zu change(s)", states.size(), changed.size());
+    for (const auto &st : changed) {
+        emit_presence(PJSUA_INVALID_ID, st.first, st.second.c_str());
+    }
+}
+
+// Per-buddy subscriptions for the contacts of a list that could not be used (engine thread)
+static bool rls_fall_back(const std::vector<std::string> &contacts, const std::string &prefix) {
+    bool all_ok = true;
+    for (const auto &contact : contacts) {
+        all_ok = cmd_subscribe_presence(contact, prefix) && all_ok;
+    }
+    return all_ok;
+}
+
+static void rls_on_evsub_state(pjsip_evsub *sub, pjsip_event *event) {
+    VOIP_TRACE_SCOPE("pjsua", "rls_on_evsub_state");
+    pjsip_evsub_state state = pjsip_evsub_get_state(sub);
+    int code = 0;
+    if (event && event->type == PJSIP_EVENT_TSX_STATE && event->body.tsx_state.tsx) {
+        code = event->body.tsx_state.tsx->status_code;
+    }
+    LOGI(">>> RLS: subscription state=%d (last status %d)", state, code);
+    if (state != PJSIP_EVSUB_STATE_TERMINATED) return;
+
+    // Lists we closed ourselves were detached from g_rls first: only server-side ends get here
+    RlsSubscription ended;
+    std::vector<std::string> went_offline;
+    {
+        DomainLock lock(g_presence_lock);
+        if (g_rls.sub != sub) return;
+        ended = std::move(g_rls);
+        g_rls = RlsSubscription();
+        for (const auto &contact : ended.entities) {
+            if (presence_transition_locked(contact, PJSUA_INVALID_ID, BLF_OFFLINE, PRESENCE_SRC_SUBSCRIPTION,
+                                           PJSIP_EVSUB_STATE_TERMINATED)) {
+                went_offline.push_back(contact);
+            }
+        }
+    }
+    // Called with the dialog locked: the dialog goes once pjsip releases it
+    pjsip_dlg_dec_session(ended.dlg, &mod_rls);
+    for (const auto &contact : went_offline) {
+        emit_presence(PJSUA_INVALID_ID, contact, "offline");
+    }
+    LOGW(">>> RLS: list %s %s (status %d), falling back to %zu per-buddy subscription(s)", ended.list_uri.c_str(),
+         ended.active ? "terminated by the server" : "refused", code, ended.fallback_contacts.size());
+    if (ended.fallback_contacts.empty()) return;
+    std::vector<std::string> contacts = std::move(ended.fallback_contacts);
+    std::string prefix = std::move(ended.prefix);
+    submit_command("subscribe_batch", [contacts, prefix] {
+        return rls_fall_back(contacts, prefix);
+    });
+}
+
+static pjsip_evsub_user g_rls_callbacks = {
+    &rls_on_evsub_state,  // on_evsub_state
+    NULL,                 // on_tsx_state
+    NULL,                 // on_rx_refresh (UAS only)
+    &rls_on_rx_notify,    // on_rx_notify
+    NULL,                 // on_client_refresh: default re-SUBSCRIBE
+    NULL,                 // on_server_timeout (UAS only)
+};
+
+// Unsubscribes the current list without falling back (the caller replaces it or the account
+// is going away). The list is detached first, so its late NOTIFYs and final state are ignored.
+static void rls_terminate(pjsua_acc_id only_acc) {
+    pjsip_evsub *sub = nullptr;
+    pjsip_dialog *dlg = nullptr;
+    std::string list_uri;
+    {
+        DomainLock lock(g_presence_lock);
+        if (!g_rls.sub || (only_acc != PJSUA_INVALID_ID && g_rls.acc_id != only_acc)) return;
+        sub = g_rls.sub;
+        dlg = g_rls.dlg;
+        list_uri = g_rls.list_uri;
+        for (const auto &contact : g_rls.entities) presence_cache_remove_locked(contact);
+        g_rls = RlsSubscription();
+    }
+    // The detached session reference keeps the dialog, and the subscription allocated from its
+    // pool, alive even if the server ends the list meanwhile. Outside the presence lock: both
+    // paths can call rls_on_evsub_state() synchronously, which takes it.
+    pjsip_dlg_inc_lock(dlg);
+    if (pjsip_evsub_get_state(sub) != PJSIP_EVSUB_STATE_TERMINATED) {
+        pjsip_tx_data *tdata = nullptr;
+        if (pjsip_evsub_initiate(sub, NULL, 0, &tdata) != PJ_SUCCESS ||
+            pjsip_evsub_send_request(sub, tdata) != PJ_SUCCESS) {
+            pjsip_evsub_terminate(sub, PJ_TRUE);
+        }
+    }
+    pjsip_dlg_dec_lock(dlg);
+    pjsip_dlg_dec_session(dlg, &mod_rls);
+    LOGI(">>> RLS: list %s unsubscribed", list_uri.c_str());
+}
+
+static void rls_drop_account(pjsua_acc_id acc_id) {
+    rls_terminate(acc_id);
+}
+
+static void rls_add_header(pjsip_tx_data *tdata, const char *name, const char *value) {
+    pj_str_t hname = pj_str((char *)name);
+    pj_str_t hvalue = pj_str((char *)value);
+    pjsip_msg_add_hdr(tdata->msg, (pjsip_hdr *)pjsip_generic_string_hdr_create(tdata->pool, &hname, &hvalue));
+}
+
+static bool cmd_subscribe_presence_list(const std::string &list_uri, const std::vector<std::string> &contacts,
+                                        const std::string &prefix) {
+    if (!ensure_endpoint()) return false;
+    auto acc = active_account_snapshot();
+    if (acc->acc_id == PJSUA_INVALID_ID || acc->domain.empty()) {
+        LOGW(">>> RLS: no active account, cannot subscribe to %s", list_uri.c_str());
+        return false;
+    }
+    rls_terminate(PJSUA_INVALID_ID);
+    if (!g_rls_available) return rls_fall_back(contacts, prefix);
+
+    char target_buf[256];
+    if (list_uri.compare(0, 4, "sip:") == 0 || list_uri.compare(0, 5, "sips:") == 0) {
+        pj_ansi_snprintf(target_buf, sizeof(target_buf), "%s", list_uri.c_str());
+    } else {
+        pj_ansi_snprintf(target_buf, sizeof(target_buf), "sip:%s@%s", list_uri.c_str(), acc->domain.c_str());
+    }
+    pj_str_t target = pj_str(target_buf);
+
+    pj_pool_t *pool = pjsua_pool_create("rls", 1024, 1024);
+    if (!pool) return false;
+    pjsua_acc_config acc_cfg;
+    pj_str_t contact;
+    pjsip_dialog *dlg = nullptr;
+    pjsip_evsub *sub = nullptr;
+    pj_status_t status = pjsua_acc_get_config(acc->acc_id, pool, &acc_cfg);
+    if (status == PJ_SUCCESS) status = pjsua_acc_create_uac_contact(pool, &contact, acc->acc_id, &target);
+    if (status == PJ_SUCCESS) status = pjsip_dlg_create_uac(pjsip_ua_instance(), &acc_cfg.id, &contact, &target, NULL, &dlg);
+    if (status != PJ_SUCCESS) {
+        LOGE(">>> RLS: cannot create dialog to %s, status=%d", target_buf, status);
+        pj_pool_release(pool);
+        return false;
+    }
+    pjsip_dlg_inc_lock(dlg);
+    status = pjsip_evsub_create_uac(dlg, &g_rls_callbacks, &STR_DIALOG_EVENT, PJSIP_EVSUB_NO_EVENT_ID, &sub);
+    if (status != PJ_SUCCESS) {
+        // PJSIP_SIMPLE_ENOPKG: pjsua was built without dialog event support
+        LOGE(">>> RLS: pjsip_evsub_create_uac failed, status=%d", status);
+        pjsip_dlg_dec_lock(dlg);  // Destroys the session-less dialog
+        pj_pool_release(pool);
+        return rls_fall_back(contacts, prefix);
+    }
+    // Released by whoever detaches the list from g_rls (rls_terminate or the terminated state)
+    pjsip_dlg_inc_session(dlg, &mod_rls);
+    // The dialog copies the credentials: the pool can go once the request is out
+    pjsip_auth_clt_set_credentials(&dlg->auth_sess, (int)acc_cfg.cred_count, acc_cfg.cred_info);
+    pj_pool_release(pool);
+
+    {
+        DomainLock lock(g_presence_lock);
+        g_rls = RlsSubscription();
+        g_rls.sub = sub;
+        g_rls.dlg = dlg;
+        g_rls.acc_id = acc->acc_id;
+        g_rls.list_uri = target_buf;
+        g_rls.fallback_contacts = contacts;
+        g_rls.prefix = prefix;
+    }
+
+    pjsip_tx_data *tdata = nullptr;
+    status = pjsip_evsub_initiate(sub, NULL, RLS_EXPIRES, &tdata);
+    if (status == PJ_SUCCESS) {
+        rls_add_header(tdata, "Require", "eventlist");
+        rls_add_header(tdata, "Supported", "eventlist");
+        // pjsua's dialog package only accepts dialog-info+xml
+        pjsip_accept_hdr *accept = (pjsip_accept_hdr *)pjsip_msg_find_hdr(tdata->msg, PJSIP_H_ACCEPT, NULL);
+        if (accept) {
+            const char *needed[] = {"application/rlmi+xml", "multipart/related"};
+            for (const char *type : needed) {
+                bool present = false;
+                for (unsigned i = 0; i < accept->count; ++i) {
+                    if (pj_stricmp2(&accept->values[i], type) == 0) present = true;
+                }
+                if (!present && accept->count < PJSIP_GENERIC_ARRAY_MAX_COUNT) {
+                    pj_strdup2(tdata->pool, &accept->values[accept->count++], type);
+                }
+            }
         } else {
-            LOGI(">>> nativeUnsubscribePresence: pjsua_buddy_del SUCCESS buddy_id=%d (sending UNSUBSCRIBE to server)", buddy_id_to_delete);
+            rls_add_header(tdata, "Accept", "application/dialog-info+xml, application/rlmi+xml, multipart/related");
         }
+        status = pjsip_evsub_send_request(sub, tdata);
     }
-    
-    // Clean up both maps
-    if (!key_to_delete.empty()) {
-        g_buddy_subscriptions.erase(key_to_delete);
+    if (status != PJ_SUCCESS) {
+        // The terminated state runs the per-buddy fallback
+        LOGE(">>> RLS: SUBSCRIBE to %s not sent, status=%d", target_buf, status);
+        pjsip_evsub_terminate(sub, PJ_TRUE);
+    } else {
+        LOGI(">>> RLS: SUBSCRIBE sent to %s (%zu fallback contact(s))", target_buf, contacts.size());
     }
-    g_buddy_reverse_map.erase(buddy_id_to_delete);
-    LOGI(">>> nativeUnsubscribePresence: COMPLETE - unsubscribed from %s, cleaned maps", contact_str.c_str());
+    pjsip_dlg_dec_lock(dlg);
+    return status == PJ_SUCCESS;
+}
+
+extern "C" JNIEXPORT jlong JNICALL
+Java_fr_celya_celyavox_PjsipEngine_nativeSubscribePresenceList(JNIEnv *env, jobject, jstring jlistUri,
+                                                              jobjectArray jcontacts, jstring jprefix) {
+    VOIP_TRACE_SCOPE("jni", "nativeSubscribePresenceList");
+    std::string list_uri = jstring_to_std(env, jlistUri);
+    std::string prefix = jstring_to_std(env, jprefix);
+    std::vector<std::string> contacts;
+    jsize count = jcontacts ? env->GetArrayLength(jcontacts) : 0;
+    for (jsize i = 0; i < count; ++i) {
+        jstring jcontact = (jstring)env->GetObjectArrayElement(jcontacts, i);
+        std::string contact = jstring_to_std(env, jcontact);
+        if (jcontact) env->DeleteLocalRef(jcontact);
+        if (!contact.empty()) contacts.push_back(contact);
+    }
+    if (list_uri.empty()) return -1;
+    return submit_command("subscribe_presence_list", [list_uri, contacts, prefix] {
+        return cmd_subscribe_presence_list(list_uri, contacts, prefix);
+    });
+}
+
+extern "C" JNIEXPORT jlong JNICALL
+Java_fr_celya_celyavox_PjsipEngine_nativeUnsubscribePresenceList(JNIEnv *, jobject) {
+    VOIP_TRACE_SCOPE("jni", "nativeUnsubscribePresenceList");
+    return submit_command("unsubscribe_presence_list", [] {
+        rls_terminate(PJSUA_INVALID_ID);
+        return true;
+    });
+}
+
+extern "C" JNIEXPORT jstring JNICALL
+Java_fr_celya_celyavox_PjsipEngine_nativeGetPresenceStatus(JNIEnv *env, jobject, jstring jcontact) {
+    VOIP_TRACE_SCOPE("jni", "nativeGetPresenceStatus");
+    std::string contact = jstring_to_std(env, jcontact);
     
-    env->ReleaseStringUTFChars(jcontact, contact_cstr);
+    // Dernier état riche (busy, ringing, dnd...) depuis le cache, sans pjsua_buddy_get_info
+    std::string result = "offline";
+    {
+        DomainLock lock(g_presence_lock);
+        auto it = g_presence_cache.find(contact);
+        if (it != g_presence_cache.end() && !it->second.removed && it->second.state != BLF_UNKNOWN) {
+            result = kBlfStateNames[it->second.state];
+        }
+    }
+    LOGI(">>> nativeGetPresenceStatus: contact=%s, result=%s", contact.c_str(), result.c_str());
+    return env->NewStringUTF(result.c_str());
+}
+
+/**
+ * Every presence cache entry changed after sinceVersion, in one little-endian buffer:
+ *   0  u16 format (PRESENCE_SNAPSHOT_FORMAT)   2 u16 reserved   4 u32 entry count
+ *   8  u64 cache version: pass it back as sinceVersion for the next delta
+ *   16 entries, back to back:
+ *      0 u64 version   8 i64 updated (us since the epoch)   16 i32 buddy id
+ *      20 u8 source (PresenceSource)   21 u8 sub_state   22 u8 flags (1 = removed)   23 u8 reserved
+ *      24 u32 transitions emitted   28 u32 updates suppressed
+ *      32 u16 length + contact bytes, then u16 length + state bytes
+ * sinceVersion 0 returns the full live set (tombstones are only reported in deltas).
+ */
+#define PRESENCE_SNAPSHOT_FORMAT 2
+
+extern "C" JNIEXPORT jbyteArray JNICALL
+Java_fr_celya_celyavox_PjsipEngine_nativeGetPresenceSnapshot(JNIEnv *env, jobject, jlong sinceVersion) {
+    VOIP_TRACE_SCOPE("jni", "nativeGetPresenceSnapshot");
+    uint64_t since = sinceVersion > 0 ? (uint64_t)sinceVersion : 0;
+    std::vector<uint8_t> out(16, 0);
+    auto put = [&out](const void *p, size_t n) {
+        const uint8_t *b = static_cast<const uint8_t *>(p);
+        out.insert(out.end(), b, b + n);
+    };
+    auto put_string = [&put](const std::string &value) {
+        uint16_t len = (uint16_t)std::min<size_t>(value.size(), 0xffff);
+        put(&len, 2);
+        put(value.data(), len);
+    };
+    uint32_t count = 0;
+    uint64_t version;
+    {
+        DomainLock lock(g_presence_lock);
+        version = g_presence_version;
+        for (const auto &item : g_presence_cache) {
+            const PresenceCacheEntry &entry = item.second;
+            if (entry.version <= since || (since == 0 && entry.removed)) continue;
+            uint8_t fixed[32] = {0};
+            int32_t buddy_id = entry.buddy_id;
+            memcpy(fixed, &entry.version, 8);
+            memcpy(fixed + 8, &entry.updated_us, 8);
+            memcpy(fixed + 16, &buddy_id, 4);
+            fixed[20] = entry.source;
+            fixed[21] = entry.sub_state;
+            fixed[22] = entry.removed ? 1 : 0;
+            memcpy(fixed + 24, &entry.emitted, 4);
+            memcpy(fixed + 28, &entry.suppressed, 4);
+            put(fixed, sizeof(fixed));
+            put_string(item.first);
+            put_string(kBlfStateNames[entry.state]);
+            ++count;
+        }
+    }
+    uint16_t format = PRESENCE_SNAPSHOT_FORMAT;
+    memcpy(out.data(), &format, 2);
+    memcpy(out.data() + 4, &count, 4);
+    memcpy(out.data() + 8, &version, 8);
+    LOGI(">>> nativeGetPresenceSnapshot: since=%llu, version=%llu, %u entr%s, %zu bytes",
+         (unsigned long long)since, (unsigned long long)version, count, count == 1 ? "y" : "ies", out.size());
+
+    jbyteArray result = env->NewByteArray((jsize)out.size());
+    if (result) env->SetByteArrayRegion(result, 0, (jsize)out.size(), reinterpret_cast<const jbyte *>(out.data()));
+    return result;
+}
+
+// Hold time for ringing before it is published (0 = publish at once)
+extern "C" JNIEXPORT void JNICALL
+Java_fr_celya_celyavox_PjsipEngine_nativeSetPresenceDebounce(JNIEnv *, jobject, jint ms) {
+    g_presence_debounce_ms.store(ms > 0 ? (unsigned)ms : 0, std::memory_order_relaxed);
+    LOGI(">>> presence debounce set to %d ms", ms > 0 ? ms : 0);
+}
+
+// Idle media mode (on by default). Turning it off resumes the media stack for good.
+extern "C" JNIEXPORT void JNICALL
+Java_fr_celya_celyavox_PjsipEngine_nativeSetMediaIdle(JNIEnv *, jobject, jboolean enabled) {
+    g_media_idle_enabled = enabled == JNI_TRUE;
+    LOGI(">>> MEDIA: idle mode %s", enabled ? "enabled" : "disabled");
+    if (!g_initialized) return;
+    if (!enabled) {
+        submit_command("media_resume", [] {
+            media_resume("idle mode disabled");
+            return true;
+        });
+    } else if (pjsua_call_get_count() == 0) {
+        ensure_pj_thread_registered("jni");
+        media_schedule_idle();
+    }
+}
+
+// Voluntary context switches (a sleeping thread woke up) of every thread of the process so far
+static uint64_t process_wakeups() {
+    uint64_t total = 0;
+    DIR *dir = opendir("/proc/self/task");
+    if (!dir) return 0;
+    while (struct dirent *entry = readdir(dir)) {
+        if (entry->d_name[0] == '.') continue;
+        char path[64];
+        snprintf(path, sizeof(path), "/proc/self/task/%s/status", entry->d_name);
+        FILE *f = fopen(path, "r");
+        if (!f) continue;  // Thread gone meanwhile
+        char line[128];
+        unsigned long long n;
+        while (fgets(line, sizeof(line), f)) {
+            if (sscanf(line, "voluntary_ctxt_switches: %llu", &n) == 1) total += n;
+        }
+        fclose(f);
+    }
+    closedir(dir);
+    return total;
+}
+
+// Process wakeups per second with no call: duration_ms with the media stack running (idle
+// mode off), then duration_ms parked. Blocks the caller; idle mode is applied again afterwards.
+// "name value" lines, empty when the endpoint is down or a call exists.
+extern "C" JNIEXPORT jstring JNICALL
+Java_fr_celya_celyavox_PjsipEngine_nativeBenchmarkIdleWakeups(JNIEnv *env, jobject, jint duration_ms) {
+    VOIP_TRACE_SCOPE("jni", "nativeBenchmarkIdleWakeups");
+    if (!g_initialized || duration_ms <= 0) return env->NewStringUTF("");
+    std::string out;
+    for (const bool parked : {false, true}) {
+        auto applied = std::make_shared<std::promise<bool>>();
+        std::future<bool> ready = applied->get_future();
+        submit_command("media_wakeup_mode", [parked, applied] {
+            bool ok = pjsua_call_get_count() == 0;
+            if (ok && parked) {
+                media_park();
+            } else if (ok) {
+                media_resume("wakeup benchmark");
+            }
+            applied->set_value(ok);
+            return ok;
+        });
+        if (ready.wait_for(std::chrono::seconds(5)) != std::future_status::ready || !ready.get()) {
+            out.clear();
+            break;
+        }
+        uint64_t start_us = metric_now_us();
+        uint64_t before = process_wakeups();
+        std::this_thread::sleep_for(std::chrono::milliseconds(duration_ms));
+        uint64_t woke = process_wakeups() - before;
+        uint64_t elapsed_us = metric_now_us() - start_us;
+        char line[96];
+        snprintf(line, sizeof(line), "%s.wakeups_per_s %.1f\n", parked ? "idle" : "active", woke * 1e6 / elapsed_us);
+        out += line;
+    }
+    // Back to the configured behaviour: running, or parked again after the grace period
+    submit_command("media_resume", [] {
+        media_resume("wakeup benchmark done");
+        if (pjsua_call_get_count() == 0) media_schedule_idle();
+        return true;
+    });
+    LOGI(">>> MEDIA: wakeup benchmark\n%s", out.c_str());
+    return env->NewStringUTF(out.c_str());
+}
+
+// Incoming answer path: early media sends the SDP answer in a 183 so streams are up before
+// accept. 100rel is applied to accounts registered afterwards.
+extern "C" JNIEXPORT void JNICALL
+Java_fr_celya_celyavox_PjsipEngine_nativeSetAnswerMode(JNIEnv *, jobject, jboolean early_media, jboolean reliable) {
+    g_answer_mode = early_media == JNI_TRUE ? ANSWER_EARLY_MEDIA : ANSWER_RINGING;
+    g_answer_100rel = reliable == JNI_TRUE;
+    LOGI(">>> ANSWER: mode=%s 100rel=%s", early_media ? "early_media" : "ringing", reliable ? "optional" : "off");
+}
+
+// SRTP policy of user@domain, applied when the account is next registered (see "Media
+// encryption"). mode is "off", "optional" or "mandatory"; keying lists "dtls" and/or "sdes"
+// (DTLS is always offered first). False when this build has no SRTP or the arguments are not
+// understood.
+extern "C" JNIEXPORT jboolean JNICALL
+Java_fr_celya_celyavox_PjsipEngine_nativeSetAccountSrtp(JNIEnv *env, jobject, jstring juser, jstring jdomain,
+                                                        jstring jmode, jstring jkeying) {
+    std::string mode = jstring_to_std(env, jmode);
+    std::string keying = jstring_to_std(env, jkeying);
+    SrtpAccountPolicy policy;
+    if (mode == "off") policy.mode = SRTP_OFF;
+    else if (mode == "optional") policy.mode = SRTP_OPTIONAL;
+    else if (mode == "mandatory") policy.mode = SRTP_MANDATORY;
+    else return JNI_FALSE;
+    policy.dtls = keying.find("dtls") != std::string::npos;
+    policy.sdes = keying.find("sdes") != std::string::npos;
+    if (policy.mode != SRTP_OFF && !policy.dtls && !policy.sdes) return JNI_FALSE;
+#if defined(VOIP_SRTP) && VOIP_SRTP
+    const std::string key = jstring_to_std(env, juser) + "@" + jstring_to_std(env, jdomain);
+    DomainLock lock(g_accounts_lock);
+    g_srtp_policies[key] = policy;
+    LOGI(">>> SRTP: policy for %s set to %s (applies at the next registration)", key.c_str(), mode.c_str());
     return JNI_TRUE;
+#else
+    if (policy.mode != SRTP_OFF) LOGW(">>> SRTP: not available in this build (VOIP_SRTP off)");
+    return policy.mode == SRTP_OFF ? JNI_TRUE : JNI_FALSE;
+#endif
 }
 
+// CPU budget per encrypted call, microseconds per second of call; applies to accounts
+// registered afterwards
+extern "C" JNIEXPORT void JNICALL
+Java_fr_celya_celyavox_PjsipEngine_nativeSetSrtpBudget(JNIEnv *, jobject, jint us_per_s) {
+    g_srtp_budget_us = us_per_s > 0 ? (uint32_t)us_per_s : voip_srtp::kDefaultBudgetUs;
+    LOGI(">>> SRTP: budget %u us per second of call", g_srtp_budget_us.load());
+}
+
+// Measures every suite again over packets packets: "<suite>.protect_ns", ".unprotect_ns" and
+// ".call_us_per_s" lines (-1 when the suite is unavailable), plus the budget. "" without SRTP.
 extern "C" JNIEXPORT jstring JNICALL
-Java_fr_celya_celyavox_PjsipEngine_nativeGetPresenceStatus(JNIEnv *env, jobject, jstring jcontact) {
+Java_fr_celya_celyavox_PjsipEngine_nativeBenchmarkSrtp(JNIEnv *env, jobject, jint packets) {
+    VOIP_TRACE_SCOPE("jni", "nativeBenchmarkSrtp");
+    std::string out;
+#if defined(VOIP_SRTP) && VOIP_SRTP
+    for (size_t i = 0; i < voip_srtp::kSuiteCount; ++i) {
+        voip_srtp::SuiteCost cost = voip_srtp::measure_suite(i, packets > 0 ? (unsigned)packets : 1000);
+        const char *name = voip_srtp::kSuites[i];
+        char buf[256];
+        if (cost.available) {
+            snprintf(buf, sizeof(buf), "%s.protect_ns %u\n%s.unprotect_ns %u\n%s.call_us_per_s %llu\n", name,
+                     cost.protect_ns, name, cost.unprotect_ns, name,
+                     (unsigned long long)voip_srtp::call_cost_us_per_s(cost));
+        } else {
+            snprintf(buf, sizeof(buf), "%s.protect_ns -1\n%s.unprotect_ns -1\n%s.call_us_per_s -1\n", name, name, name);
+        }
+        out += buf;
+    }
+    out += "budget_us_per_s " + std::to_string(g_srtp_budget_us.load()) + "\n";
+#else
+    (void)packets;
+#endif
+    return env->NewStringUTF(out.c_str());
+}
+
+// Echo canceller, see "Echo cancellation": mode "off", "speaker" or "always", tail in ms,
+// CPU budget per captured frame in us (0: defaults). Applies at the next refreshAudio.
+extern "C" JNIEXPORT jboolean JNICALL
+Java_fr_celya_celyavox_PjsipEngine_nativeSetEchoCanceller(JNIEnv *env, jobject, jstring jmode, jint tail_ms,
+                                                          jint budget_us) {
+    std::string mode = jstring_to_std(env, jmode);
+    AecSettings settings;
+    if (mode == "off") settings.mode = AEC_OFF;
+    else if (mode == "speaker") settings.mode = AEC_SPEAKER;
+    else if (mode == "always") settings.mode = AEC_ALWAYS;
+    else {
+        LOGW(">>> AEC: unknown mode '%s'", mode.c_str());
+        return JNI_FALSE;
+    }
+    if (tail_ms > 0) settings.tail_ms = std::min<uint32_t>((uint32_t)tail_ms, AEC_MAX_TAIL_MS);
+    if (budget_us > 0) settings.budget_us = (uint32_t)budget_us;
+    {
+        std::lock_guard<std::mutex> lock(g_aec_mutex);
+        g_aec_settings = settings;
+    }
+    LOGI(">>> AEC: mode=%s tail=%u ms budget=%u us (at the next refreshAudio)", mode.c_str(), settings.tail_ms,
+         settings.budget_us);
+    return JNI_TRUE;
+}
+
+// Audio route as seen by the app: the "speaker" mode only cancels while this is true
+extern "C" JNIEXPORT void JNICALL
+Java_fr_celya_celyavox_PjsipEngine_nativeSetSpeakerRoute(JNIEnv *, jobject, jboolean speaker) {
+    g_aec_speaker.store(speaker == JNI_TRUE, std::memory_order_relaxed);
+}
+
+// Records the next seconds of the capture path: the microphone before cancellation to
+// near_path, the frames played meanwhile to far_path (raw mono 16-bit PCM at the rate the
+// call returns), the input of nativeBenchmarkEchoCanceller. Needs the sound device to go
+// through AecPort (an echo canceller mode and refreshAudio); returns 0 otherwise. Replaces a
+// recording in progress, seconds <= 0 just stops it.
+extern "C" JNIEXPORT jint JNICALL
+Java_fr_celya_celyavox_PjsipEngine_nativeCaptureEchoFixture(JNIEnv *env, jobject, jstring jfar, jstring jnear,
+                                                            jint seconds) {
+    VOIP_TRACE_SCOPE("jni", "nativeCaptureEchoFixture");
+    const unsigned clock_rate = g_aec_clock_rate.load();
+    std::unique_ptr<voip_aec::FixtureWriter> writer;
+    if (seconds > 0 && clock_rate) {
+        const std::string far_path = jstring_to_std(env, jfar);
+        const std::string near_path = jstring_to_std(env, jnear);
+        writer = std::make_unique<voip_aec::FixtureWriter>();
+        if (!writer->open(far_path, near_path, (size_t)seconds * clock_rate)) {
+            LOGW(">>> AEC: cannot create fixture %s / %s", far_path.c_str(), near_path.c_str());
+            writer.reset();
+        }
+    }
+    std::lock_guard<std::mutex> lock(g_aec_fixture_mutex);
+    g_aec_fixture = std::move(writer);
+    return g_aec_fixture ? (jint)clock_rate : 0;
+}
+
+// Replays an echo recording through the canceller: far_path (played) and near_path (captured)
+// are raw mono 16-bit little-endian PCM at clock_rate. Empty paths use a synthetic 20 s
+// recording (20 ms bulk delay, double talk over the last quarter). "name value" lines.
+extern "C" JNIEXPORT jstring JNICALL
+Java_fr_celya_celyavox_PjsipEngine_nativeBenchmarkEchoCanceller(JNIEnv *env, jobject, jstring jfar, jstring jnear,
+                                                                jint clock_rate, jint tail_ms, jint budget_us) {
+    VOIP_TRACE_SCOPE("jni", "nativeBenchmarkEchoCanceller");
+    voip_aec::Config config;
+    config.clock_rate = clock_rate > 0 ? (uint32_t)clock_rate : 8000;
+    config.samples_per_frame = config.clock_rate / 50;
+    config.tail_ms = tail_ms > 0 ? std::min<uint32_t>((uint32_t)tail_ms, AEC_MAX_TAIL_MS) : AEC_DEFAULT_TAIL_MS;
+    config.budget_us = budget_us > 0 ? (uint32_t)budget_us : AEC_DEFAULT_BUDGET_US;
+    const std::string far_path = jstring_to_std(env, jfar);
+    const std::string near_path = jstring_to_std(env, jnear);
+    std::vector<int16_t> far, near;
+    const bool recorded = !far_path.empty() || !near_path.empty();
+    if (recorded) {
+        if (!voip_aec::load_fixture(far_path, near_path, &far, &near)) {
+            LOGW(">>> AEC: cannot read fixture %s / %s", far_path.c_str(), near_path.c_str());
+            return env->NewStringUTF("");
+        }
+    } else {
+        voip_aec::synth_fixture(config.clock_rate, 20, 20, &far, &near);
+    }
+    voip_aec::FixtureResult result = voip_aec::run_fixture(config, far.data(), near.data(), far.size());
+    char buf[640];
+    snprintf(buf, sizeof(buf),
+             "aec.fixture %s\naec.simd %s\naec.taps %u\naec.budget_us %u\naec.frames %llu\n"
+             "aec.mean_frame_us %.1f\naec.p99_frame_us %.1f\naec.max_frame_us %.1f\naec.over_budget_frames %llu\n"
+             "aec.fallbacks %llu\naec.suppressed_frames %llu\naec.erle_db %.1f\n",
+             recorded ? "recorded" : "synthetic", voip_aec::simd_name(), result.taps, config.budget_us,
+             (unsigned long long)result.stats.frames, result.mean_frame_ns / 1000.0, result.p99_frame_ns / 1000.0,
+             result.stats.max_frame_ns / 1000.0, (unsigned long long)result.stats.over_budget_frames,
+             (unsigned long long)result.stats.fallbacks, (unsigned long long)result.stats.suppressed_frames,
+             voip_aec::erle_db(result.stats));
+    return env->NewStringUTF(buf);
+}
+
+// Threading profile, see its section. cores is "any", "big" or "little"; false for anything else.
+extern "C" JNIEXPORT jboolean JNICALL
+Java_fr_celya_celyavox_PjsipEngine_nativeSetThreadingProfile(JNIEnv *env, jobject, jint sip_workers,
+                                                             jboolean media_clock, jboolean audio_priority, jstring jcores) {
+    std::string cores = jstring_to_std(env, jcores);
+    voip_sched::CoreClass core_class;
+    if (cores == "any") core_class = voip_sched::CORES_ANY;
+    else if (cores == "big") core_class = voip_sched::CORES_BIG;
+    else if (cores == "little") core_class = voip_sched::CORES_LITTLE;
+    else {
+        LOGW(">>> THREADS: unknown core class '%s'", cores.c_str());
+        return JNI_FALSE;
+    }
+    {
+        std::lock_guard<std::mutex> lock(g_threading_mutex);
+        g_threading.sip_workers = sip_workers > 0 ? (unsigned)sip_workers : 1;
+        g_threading.media_clock = media_clock == JNI_TRUE;
+        g_threading.audio_priority = audio_priority == JNI_TRUE;
+        g_threading.media_cores = core_class;
+    }
+    LOGI(">>> THREADS: profile workers=%d media_clock=%d audio_priority=%d cores=%s%s", sip_workers,
+         media_clock ? 1 : 0, audio_priority ? 1 : 0, cores.c_str(),
+         g_initialized ? " (workers at next start, media threads when they next start)" : "");
+    return JNI_TRUE;
+}
+
+// Selects the memory profile ("compact" or "standard") used when the endpoint is created
+extern "C" JNIEXPORT jboolean JNICALL
+Java_fr_celya_celyavox_PjsipEngine_nativeSetMemoryProfile(JNIEnv *env, jobject, jstring jname) {
+    std::string name = jstring_to_std(env, jname);
+    for (const MemoryProfile &profile : kMemoryProfiles) {
+        if (name != profile.name) continue;
+        g_memory_profile.store(&profile);
+        LOGI(">>> MEMORY: profile %s selected%s", profile.name, g_initialized ? " (applies at the next start)" : "");
+        return JNI_TRUE;
+    }
+    LOGW(">>> MEMORY: unknown profile '%s', keeping %s", name.c_str(), g_memory_profile.load()->name);
+    return JNI_FALSE;
+}
+
+// "name value" lines: pool factory usage (the peak is the high-water mark since start),
+// reuse cache, and the slots in use against their limits
+extern "C" JNIEXPORT jstring JNICALL
+Java_fr_celya_celyavox_PjsipEngine_nativeGetMemoryReport(JNIEnv *env, jobject) {
+    VOIP_TRACE_SCOPE("jni", "nativeGetMemoryReport");
+    std::string out = std::string("profile ") + g_memory_profile.load()->name + "\n";
+    if (!g_initialized) return env->NewStringUTF(out.c_str());
     ensure_pj_thread_registered("jni");
-    if (!ensure_endpoint()) return env->NewStringUTF("offline");
-    
-    const char *contact_str = env->GetStringUTFChars(jcontact, nullptr);
-    LOGI(">>> nativeGetPresenceStatus CALLED: contact=%s", contact_str);
-    std::lock_guard<std::mutex> lock(g_mutex);
-    
-    // Chercher le buddy_id
-    auto it = g_buddy_subscriptions.find(contact_str);
-    if (it == g_buddy_subscriptions.end()) {
-        LOGW(">>> nativeGetPresenceStatus: NOT subscribed to %s", contact_str);
-        env->ReleaseStringUTFChars(jcontact, contact_str);
-        return env->NewStringUTF("offline");
+
+    pj_caching_pool *cp = memory_caching_pool();
+    pj_lock_acquire(cp->lock);
+    unsigned long long values[] = {cp->used_size, cp->peak_used_size, cp->used_count, cp->capacity, cp->max_capacity};
+    pj_lock_release(cp->lock);
+    static const char *const kPoolKeys[] = {"pool.used_bytes", "pool.peak_bytes", "pool.count", "pool.cached_bytes",
+                                            "pool.cache_limit_bytes"};
+
+    char line[96];
+    for (size_t i = 0; i < PJ_ARRAY_SIZE(kPoolKeys); ++i) {
+        snprintf(line, sizeof(line), "%s %llu\n", kPoolKeys[i], values[i]);
+        out += line;
     }
-    
-    pjsua_buddy_id buddy_id = it->second;
-    if (buddy_id < 0) {
-        LOGW(">>> nativeGetPresenceStatus: invalid buddy_id for %s", contact_str);
-        env->ReleaseStringUTFChars(jcontact, contact_str);
-        return env->NewStringUTF("offline");
+    snprintf(line, sizeof(line), "calls.active %u\ncalls.max %u\n", pjsua_call_get_count(), pjsua_call_get_max_count());
+    out += line;
+    snprintf(line, sizeof(line), "buddies.active %u\nbuddies.max %d\n", pjsua_get_buddy_count(), PJSUA_MAX_BUDDIES);
+    out += line;
+    snprintf(line, sizeof(line), "conf.ports_active %u\nconf.ports_max %u\n", pjsua_conf_get_active_ports(),
+             pjsua_conf_get_max_ports());
+    out += line;
+    return env->NewStringUTF(out.c_str());
+}
+
+// One line per wanted BLF contact:
+// "contact buddy_id sub_state attempts failures terminations resubscribes last_code next_retry_ms"
+// (buddy_id -1 = no buddy right now, next_retry_ms -1 = nothing scheduled)
+extern "C" JNIEXPORT jstring JNICALL
+Java_fr_celya_celyavox_PjsipEngine_nativeGetSubscriptionHealth(JNIEnv *env, jobject) {
+    VOIP_TRACE_SCOPE("jni", "nativeGetSubscriptionHealth");
+    std::string out;
+    uint64_t now = metric_now_us();
+    {
+        DomainLock lock(g_presence_lock);
+        for (const auto &item : g_presence_wanted) {
+            const SubscriptionLifecycle &life = item.second;
+            pjsua_buddy_id buddy_id = PJSUA_INVALID_ID;
+            for (const auto &subs : g_account_buddies) {
+                auto buddy = subs.second.find(item.first);
+                if (buddy != subs.second.end()) {
+                    buddy_id = buddy->second;
+                    break;
+                }
+            }
+            long long next_retry_ms = life.next_retry_us == 0 ? -1
+                                      : life.next_retry_us > now ? (long long)((life.next_retry_us - now) / 1000) : 0;
+            char line[256];
+            snprintf(line, sizeof(line), "%s %d %u %u %u %u %u %d %lld\n", item.first.c_str(), buddy_id,
+                     (unsigned)life.sub_state, life.attempts, life.failures, life.terminations, life.resubscribes,
+                     life.last_code, next_retry_ms);
+            out += line;
+        }
     }
-    
-    // Récupérer les infos du buddy
-    pjsua_buddy_info info;
-    pj_status_t status = pjsua_buddy_get_info(buddy_id, &info);
-    if (status != PJ_SUCCESS) {
-        LOGE(">>> nativeGetPresenceStatus: pjsua_buddy_get_info FAILED for buddy_id=%d", buddy_id);
-        env->ReleaseStringUTFChars(jcontact, contact_str);
-        return env->NewStringUTF("offline");
+    return env->NewStringUTF(out.c_str());
+}
+
+// One line per lock domain: "name acquisitions contended wait_total_us wait_max_us"
+extern "C" JNIEXPORT jstring JNICALL
+Java_fr_celya_celyavox_PjsipEngine_nativeGetLockStats(JNIEnv *env, jobject) {
+    VOIP_TRACE_SCOPE("jni", "nativeGetLockStats");
+    const DomainMutex *domains[] = {&g_endpoint_lock, &g_accounts_lock, &g_presence_lock, &g_calls_lock};
+    std::string out;
+    for (const DomainMutex *m : domains) {
+        char line[160];
+        snprintf(line, sizeof(line), "%s %llu %llu %llu %llu\n", m->name,
+                 (unsigned long long)m->acquisitions.load(std::memory_order_relaxed),
+                 (unsigned long long)m->contended.load(std::memory_order_relaxed),
+                 (unsigned long long)(m->wait_total_ns.load(std::memory_order_relaxed) / 1000),
+                 (unsigned long long)(m->wait_max_ns.load(std::memory_order_relaxed) / 1000));
+        out += line;
     }
-    
-    // Déterminer le statut en fonction de l'état de subscription
-    const char *result = "offline";
-    
-    // Vérifier si la subscription est active
-    if (info.sub_state == PJSIP_EVSUB_STATE_ACTIVE) {
-        // Subscription active - le serveur nous a accepté la subscription
-        // Utiliser un état par défaut "available"
-        result = "available";
+    return env->NewStringUTF(out.c_str());
+}
+
+/**
+ * Packed snapshot of the metrics registry, cheap enough to poll every second:
+ *   [0] version  [1] steady clock (us)  [2] counter count  [3] gauge count
+ *   [4] histogram count  [5] buckets per histogram  [6] sub-bucket bits
+ *   then the counters, the gauges, and per histogram: count, sum, max, buckets[].
+ * Names, in the same order, come from nativeGetMetricNames().
+ */
+extern "C" JNIEXPORT jlongArray JNICALL
+Java_fr_celya_celyavox_PjsipEngine_nativeSnapshotMetrics(JNIEnv *env, jobject) {
+    VOIP_TRACE_SCOPE("jni", "nativeSnapshotMetrics");
+    const size_t header = 7;
+    const size_t total = header + MC_COUNT + MG_COUNT + (size_t)MH_COUNT * (3 + METRIC_HIST_BUCKETS);
+    std::vector<jlong> out(total, 0);
+    size_t pos = 0;
+    out[pos++] = METRICS_SNAPSHOT_VERSION;
+    out[pos++] = (jlong)metric_now_us();
+    out[pos++] = MC_COUNT;
+    out[pos++] = MG_COUNT;
+    out[pos++] = MH_COUNT;
+    out[pos++] = METRIC_HIST_BUCKETS;
+    out[pos++] = METRIC_HIST_SUB_BITS;
+    for (int c = 0; c < MC_COUNT; ++c) {
+        uint64_t sum = 0;
+        for (int shard = 0; shard < METRIC_SHARDS; ++shard) {
+            sum += g_metric_shards[shard].counters[c].load(std::memory_order_relaxed);
+        }
+        out[pos++] = (jlong)sum;
     }
-    
-    LOGI(">>> nativeGetPresenceStatus: buddy_id=%d, contact=%s, sub_state=%d, result=%s", buddy_id, contact_str, info.sub_state, result);
-    jstring jresult = env->NewStringUTF(result);
-    env->ReleaseStringUTFChars(jcontact, contact_str);
-    return jresult;
+    for (int g = 0; g < MG_COUNT; ++g) {
+        out[pos++] = g_metric_gauges[g].load(std::memory_order_relaxed);
+    }
+    for (int h = 0; h < MH_COUNT; ++h) {
+        const MetricHistogramData &hist = g_metric_histograms[h];
+        out[pos++] = (jlong)hist.count.load(std::memory_order_relaxed);
+        out[pos++] = (jlong)hist.sum.load(std::memory_order_relaxed);
+        out[pos++] = (jlong)hist.max.load(std::memory_order_relaxed);
+        for (int b = 0; b < METRIC_HIST_BUCKETS; ++b) {
+            out[pos++] = (jlong)hist.buckets[b].load(std::memory_order_relaxed);
+        }
+    }
+    jlongArray result = env->NewLongArray((jsize)total);
+    if (result) env->SetLongArrayRegion(result, 0, (jsize)total, out.data());
+    return result;
+}
+
+// Counter names, then gauge names, then histogram names (snapshot order)
+extern "C" JNIEXPORT jobjectArray JNICALL
+Java_fr_celya_celyavox_PjsipEngine_nativeGetMetricNames(JNIEnv *env, jobject) {
+    VOIP_TRACE_SCOPE("jni", "nativeGetMetricNames");
+    jclass stringClass = env->FindClass("java/lang/String");
+    jobjectArray names = env->NewObjectArray(MC_COUNT + MG_COUNT + MH_COUNT, stringClass, nullptr);
+    if (!names) return nullptr;
+    jsize idx = 0;
+    for (const char *name : kMetricCounterNames) {
+        jstring jname = env->NewStringUTF(name);
+        env->SetObjectArrayElement(names, idx++, jname);
+        env->DeleteLocalRef(jname);
+    }
+    for (const char *name : kMetricGaugeNames) {
+        jstring jname = env->NewStringUTF(name);
+        env->SetObjectArrayElement(names, idx++, jname);
+        env->DeleteLocalRef(jname);
+    }
+    for (const char *name : kMetricHistogramNames) {
+        jstring jname = env->NewStringUTF(name);
+        env->SetObjectArrayElement(names, idx++, jname);
+        env->DeleteLocalRef(jname);
+    }
+    return names;
+}
+
+// Writes the trace ring as Chrome trace JSON; returns the number of events, -1 when tracing
+// is compiled out (VOIP_TRACING=OFF) or the file cannot be written
+extern "C" JNIEXPORT jlong JNICALL
+Java_fr_celya_celyavox_PjsipEngine_nativeDumpTrace(JNIEnv *env, jobject, jstring jpath) {
+#if VOIP_TRACE_ENABLED
+    std::string path = jstring_to_std(env, jpath);
+    long written = voip_trace::dump(path.c_str());
+    LOGI(">>> TRACE: dumped %ld event(s) to %s", written, path.c_str());
+    return written;
+#else
+    (void)env;
+    (void)jpath;
+    return -1;
+#endif
+}
+
+extern "C" JNIEXPORT void JNICALL
+Java_fr_celya_celyavox_PjsipEngine_nativeSetTraceEnabled(JNIEnv *, jobject, jboolean enabled) {
+#if VOIP_TRACE_ENABLED
+    voip_trace::set_enabled(enabled == JNI_TRUE);
+#else
+    (void)enabled;
+#endif
+}
+
+extern "C" JNIEXPORT void JNICALL
+Java_fr_celya_celyavox_PjsipEngine_nativeConfigureSipCapture(JNIEnv *, jobject, jint bytes) {
+    VOIP_TRACE_SCOPE("jni", "nativeConfigureSipCapture");
+    voip_capture::configure(bytes > 0 ? (size_t)bytes : 0);
+    LOGI(">>> SIP CAPTURE: rings set to %d byte(s) per thread%s", bytes > 0 ? bytes : 0, bytes > 0 ? "" : " (disabled)");
+}
+
+extern "C" JNIEXPORT jlong JNICALL
+Java_fr_celya_celyavox_PjsipEngine_nativeExportSipCapture(JNIEnv *env, jobject, jstring jpath) {
+    VOIP_TRACE_SCOPE("jni", "nativeExportSipCapture");
+    std::string path = jstring_to_std(env, jpath);
+    long written = voip_capture::export_file(path.c_str());
+    LOGI(">>> SIP CAPTURE: exported %ld message(s) to %s", written, path.c_str());
+    return written;
+}
+
+// Maps the shared event ring for the app (see voip_events.h). Returns null when the app
+// expects another schema version: events then keep using the legacy string path.
+extern "C" JNIEXPORT jobject JNICALL
+Java_fr_celya_celyavox_PjsipEngine_nativeAttachEventRing(JNIEnv *env, jobject, jint schema_version) {
+    VOIP_TRACE_SCOPE("jni", "nativeAttachEventRing");
+    if (schema_version != voip_events::kSchemaVersion) {
+        LOGW(">>> EVENTS: app expects schema v%d, native writes v%u: staying on string events", schema_version,
+             (unsigned)voip_events::kSchemaVersion);
+        return nullptr;
+    }
+    if (!g_engineClass) {
+        LOGW(">>> EVENTS: nativeAttachEventRing called before nativeInit");
+        return nullptr;
+    }
+    if (!g_on_native_events_mid) {
+        g_on_native_events_mid = env->GetStaticMethodID(g_engineClass, "onNativeEvents", "(J)J");
+        if (!g_on_native_events_mid) {
+            LOGE(">>> EVENTS: onNativeEvents(long) not found, staying on string events");
+            env->ExceptionClear();
+            return nullptr;
+        }
+    }
+    uint8_t *buf = g_app_events.init(EVENT_RING_CAPACITY);
+    jobject byte_buffer = env->NewDirectByteBuffer(buf, (jlong)g_app_events.buffer_size());
+    if (byte_buffer) {
+        g_event_ring_attached.store(true, std::memory_order_release);
+        LOGI(">>> EVENTS: binary event ring attached (schema v%u, %zu bytes)", (unsigned)voip_events::kSchemaVersion,
+             g_app_events.buffer_size());
+    }
+    return byte_buffer;
+}
+
+// Media tick jitter under load: a 20 ms ticker for duration_ms against load_threads busy
+// threads, once with default scheduling and once with the threading profile's media
+// scheduling. Blocks the caller for twice duration_ms; one "name value" line per figure.
+extern "C" JNIEXPORT jstring JNICALL
+Java_fr_celya_celyavox_PjsipEngine_nativeBenchmarkMediaTick(JNIEnv *env, jobject, jint duration_ms, jint load_threads) {
+    VOIP_TRACE_SCOPE("jni", "nativeBenchmarkMediaTick");
+    const ThreadingProfile profile = threading_profile();
+    const uint32_t duration = duration_ms > 0 ? (uint32_t)duration_ms : 0;
+    const unsigned load = load_threads > 0 ? (unsigned)load_threads : 0;
+    std::string out;
+    for (int run = 0; run < 2; ++run) {
+        const bool tuned = run == 1;
+        voip_sched::JitterReport r = voip_sched::measure_tick_jitter(
+            20000, duration, load, tuned && profile.audio_priority ? MEDIA_THREAD_NICE : 0,
+            tuned && profile.audio_priority ? MEDIA_THREAD_FIFO_PRIORITY : 0,
+            tuned ? profile.media_cores : voip_sched::CORES_ANY);
+        const char *name = tuned ? "profile" : "default";
+        char buf[384];
+        snprintf(buf, sizeof(buf),
+                 "%s.scheduling %s\n%s.pinned %d\n%s.ticks %llu\n%s.skipped %llu\n%s.late_mean_us %llu\n"
+                 "%s.late_p50_us %llu\n%s.late_p99_us %llu\n%s.late_max_us %llu\n",
+                 name, voip_sched::priority_result_name(r.priority), name, r.pinned ? 1 : 0,
+                 name, (unsigned long long)r.ticks, name, (unsigned long long)r.skipped,
+                 name, (unsigned long long)r.mean_us, name, (unsigned long long)r.p50_us,
+                 name, (unsigned long long)r.p99_us, name, (unsigned long long)r.max_us);
+        out += buf;
+    }
+    return env->NewStringUTF(out.c_str());
+}
+
+struct LibraryFootprint {
+    uintptr_t addr = 0;  // Any address inside the library
+    uint64_t mapped = 0;
+};
+
+static int library_footprint_phdr(struct dl_phdr_info *info, size_t, void *data) {
+    LibraryFootprint *fp = static_cast<LibraryFootprint *>(data);
+    bool ours = false;
+    uint64_t mapped = 0;
+    for (int i = 0; i < info->dlpi_phnum; ++i) {
+        const ElfW(Phdr) &ph = info->dlpi_phdr[i];
+        if (ph.p_type != PT_LOAD) continue;
+        const uintptr_t start = (uintptr_t)info->dlpi_addr + ph.p_vaddr;
+        if (fp->addr >= start && fp->addr < start + ph.p_memsz) ours = true;
+        mapped += ph.p_memsz;
+    }
+    if (!ours) return 0;
+    fp->mapped = mapped;
+    return 1;
+}
+
+// Footprint of libvoip_engine.so as loaded, for the startup benchmark: file size (0 when the
+// library is mapped straight from the APK) and the sum of its PT_LOAD segments. One
+// "name value" line per figure.
+extern "C" JNIEXPORT jstring JNICALL
+Java_fr_celya_celyavox_PjsipEngine_nativeGetLibraryFootprint(JNIEnv *env, jobject) {
+    VOIP_TRACE_SCOPE("jni", "nativeGetLibraryFootprint");
+    Dl_info info = {};
+    if (!dladdr((const void *)&library_footprint_phdr, &info)) return env->NewStringUTF("");
+    LibraryFootprint fp;
+    fp.addr = (uintptr_t)&library_footprint_phdr;
+    dl_iterate_phdr(library_footprint_phdr, &fp);
+    struct stat st;
+    const long long file_bytes = info.dli_fname && stat(info.dli_fname, &st) == 0 ? (long long)st.st_size : 0;
+    char buf[512];
+    snprintf(buf, sizeof(buf), "lib.path %s\nlib.file_bytes %lld\nlib.mapped_bytes %llu\n",
+             info.dli_fname ? info.dli_fname : "", file_bytes, (unsigned long long)fp.mapped);
+    return env->NewStringUTF(buf);
+}
+
+// Pushes count synthetic call_ended-sized events through one path (binary ring or legacy
+// strings) and returns the elapsed nanoseconds, or -1 if the binary ring is not attached.
+// The app swallows "benchmark" events, so this only measures encode + JNI + decode.
+extern "C" JNIEXPORT jlong JNICALL
+Java_fr_celya_celyavox_PjsipEngine_nativeBenchmarkEvents(JNIEnv *, jobject, jint count, jboolean binary) {
+    VOIP_TRACE_SCOPE("jni", "nativeBenchmarkEvents");
+    if (binary == JNI_TRUE && !g_event_ring_attached.load(std::memory_order_acquire)) return -1;
+    static const char kReason[] = "Request Terminated";
+    auto start = std::chrono::steady_clock::now();
+    for (jint i = 0; i < count; ++i) {
+        voip_events::Event ev;
+        ev.type = voip_events::EV_BENCHMARK;
+        ev.id = i;
+        ev.code = 487;
+        ev.string_count = 1;
+        ev.strings[0] = kReason;
+        if (binary == JNI_TRUE) {
+            dispatch_event(ev);
+        } else {
+            emit_event(event_legacy_type(ev.type), event_legacy_message(ev).c_str());
+        }
+    }
+    return (jlong)std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+}
+
+// ----------------------------------------------------------------------------
+// PGO training workload
+//
+// Profile-guided builds (VOIP_PGO in CMakeLists.txt, driven by android/pjsip/pgo.sh) are
+// trained on voip_pgo::run_workload() (voip_pgo.h): REGISTER and BLF NOTIFY traffic and call
+// cycles through pjsip's loopback transport, G.711 and bridge ticks. It is only compiled into
+// the instrumented (generate) build; the baseline and optimised builds are compared on the
+// benchmarks every build has (PjsipEngine.runPgoBenchmarks).
+// ----------------------------------------------------------------------------
+
+#ifndef VOIP_PGO_MODE
+#define VOIP_PGO_MODE "off"
+#endif
+
+#if defined(VOIP_PGO_GENERATE)
+// compiler-rt profile runtime, linked by -fprofile-generate
+extern "C" void __llvm_profile_set_filename(const char *name);
+extern "C" int __llvm_profile_write_file(void);
+#endif
+
+extern "C" JNIEXPORT jstring JNICALL
+Java_fr_celya_celyavox_PjsipEngine_nativePgoMode(JNIEnv *env, jobject) {
+    return env->NewStringUTF(VOIP_PGO_MODE);
+}
+
+// Blocks the caller for the whole workload; "" before nativeInit() and outside instrumented builds
+extern "C" JNIEXPORT jstring JNICALL
+Java_fr_celya_celyavox_PjsipEngine_nativeRunPgoWorkload(JNIEnv *env, jobject, jint iterations) {
+    VOIP_TRACE_SCOPE("jni", "nativeRunPgoWorkload");
+#if defined(VOIP_PGO_GENERATE)
+    if (!g_initialized || iterations <= 0) return env->NewStringUTF("");
+    ensure_pj_thread_registered("jni");
+    LOGI(">>> PGO: running workload (%d iterations, build mode %s)", iterations, VOIP_PGO_MODE);
+    voip_pgo::EngineHooks hooks;
+    hooks.parse_rls_notify = &rls_parse_notify;
+    std::string report = voip_pgo::run_workload((unsigned)iterations, hooks);
+    return env->NewStringUTF(report.c_str());
+#else
+    (void)iterations;
+    return env->NewStringUTF("");
+#endif
+}
+
+// Writes the counters gathered so far to path (instrumented builds only: the app is killed,
+// never exits, so the runtime's atexit writer does not run)
+extern "C" JNIEXPORT jboolean JNICALL
+Java_fr_celya_celyavox_PjsipEngine_nativeWritePgoProfile(JNIEnv *env, jobject, jstring path) {
+#if defined(VOIP_PGO_GENERATE)
+    const char *c_path = path ? env->GetStringUTFChars(path, nullptr) : nullptr;
+    if (!c_path) return JNI_FALSE;
+    __llvm_profile_set_filename(c_path);
+    const int status = __llvm_profile_write_file();
+    LOGI(">>> PGO: profile written to %s (status %d)", c_path, status);
+    env->ReleaseStringUTFChars(path, c_path);
+    return status == 0 ? JNI_TRUE : JNI_FALSE;
+#else
+    return JNI_FALSE;
+#endif
+}
+
+// ----------------------------------------------------------------------------
+// C ABI for Dart FFI (voip_capi.h)
+// ----------------------------------------------------------------------------
+
+// Dart_CObject carrying an int64: type tag then the value union (8-byte aligned)
+struct DartInt64Message {
+    int32_t type;  // Dart_CObject_kInt64
+    int64_t value;
+};
+static const int32_t kDartCObjectInt64 = 3;
+
+static voip_events::Ring g_dart_events;
+static std::atomic<cv_post_cobject_fn> g_dart_post{nullptr};
+static std::atomic<int64_t> g_dart_port{0};
+static std::atomic<bool> g_dart_doorbell_pending{false};
+
+// Presence goes straight to Dart while a port is attached; everything else stays on the
+// Kotlin path, which needs it for telecom
+static bool dart_route_event(const voip_events::Event &ev) {
+    if (ev.type != voip_events::EV_PRESENCE_UPDATED && ev.type != voip_events::EV_PRESENCE_ERROR) return false;
+    cv_post_cobject_fn post = g_dart_post.load(std::memory_order_acquire);
+    if (!post) return false;
+    uint64_t cursor = g_dart_events.write(ev);
+    if (!cursor) {
+        LOGW(">>> dart_route_event: Dart event ring full, presence update dropped");
+        metric_inc(MC_EVENTS_DROPPED);
+        return true;
+    }
+    metric_inc(MC_EVENTS_EMITTED);
+    // One doorbell per batch: the isolate drains everything pending when it polls
+    if (!g_dart_doorbell_pending.exchange(true, std::memory_order_acq_rel)) {
+        DartInt64Message msg{kDartCObjectInt64, (int64_t)cursor};
+        post(g_dart_port.load(std::memory_order_relaxed), &msg);
+    }
+    return true;
+}
+
+extern "C" CV_EXPORT int32_t cv_abi_version(void) {
+    return CV_ABI_VERSION;
+}
+
+extern "C" CV_EXPORT int32_t cv_event_schema_version(void) {
+    return voip_events::kSchemaVersion;
+}
+
+extern "C" CV_EXPORT int32_t cv_attach_events(cv_post_cobject_fn post_cobject, int64_t port) {
+    VOIP_TRACE_SCOPE("capi", "cv_attach_events");
+    if (!post_cobject) return -1;
+    g_dart_events.init(EVENT_RING_CAPACITY);
+    g_dart_port.store(port, std::memory_order_relaxed);
+    g_dart_doorbell_pending.store(false, std::memory_order_relaxed);
+    g_dart_post.store(post_cobject, std::memory_order_release);
+    LOGI(">>> C ABI: Dart port %lld attached for presence events", (long long)port);
+    return 0;
+}
+
+extern "C" CV_EXPORT void cv_detach_events(void) {
+    VOIP_TRACE_SCOPE("capi", "cv_detach_events");
+    g_dart_post.store(nullptr, std::memory_order_release);
+    LOGI(">>> C ABI: Dart port detached, presence events back on the Kotlin path");
+}
+
+extern "C" CV_EXPORT int64_t cv_poll_events(uint8_t *out, int64_t capacity) {
+    if (!out || capacity <= 0) return 0;
+    // Cleared before reading: a write racing with this poll rings again instead of being missed
+    g_dart_doorbell_pending.store(false, std::memory_order_release);
+    return (int64_t)g_dart_events.read(out, (size_t)capacity);
+}
+
+extern "C" CV_EXPORT int64_t cv_send_dtmf(int32_t call_id, const char *digits) {
+    VOIP_TRACE_SCOPE("capi", "cv_send_dtmf");
+    if (!digits) return -1;
+    std::string digits_s(digits);
+    return submit_command("send_dtmf", [call_id, digits_s] { return cmd_send_dtmf(call_id, digits_s); });
+}
+
+extern "C" CV_EXPORT int64_t cv_subscribe_batch(const char *const *contacts, int32_t count, const char *prefix) {
+    VOIP_TRACE_SCOPE("capi", "cv_subscribe_batch");
+    if (!contacts || count <= 0) return -1;
+    std::vector<std::string> list;
+    list.reserve((size_t)count);
+    for (int32_t i = 0; i < count; ++i) {
+        if (contacts[i] && *contacts[i]) list.emplace_back(contacts[i]);
+    }
+    std::string prefix_s(prefix ? prefix : "");
+    return submit_command("subscribe_batch", [list, prefix_s] {
+        bool all_ok = true;
+        for (const auto &contact : list) {
+            all_ok = cmd_subscribe_presence(contact, prefix_s) && all_ok;
+        }
+        LOGI(">>> C ABI: subscribe_batch of %zu contact(s) done, all_ok=%d", list.size(), all_ok);
+        return all_ok;
+    });
+}
+
+extern "C" CV_EXPORT int64_t cv_subscribe_list(const char *list_uri, const char *const *contacts, int32_t count,
+                                                const char *prefix) {
+    VOIP_TRACE_SCOPE("capi", "cv_subscribe_list");
+    if (!list_uri || !*list_uri) return -1;
+    std::vector<std::string> list;
+    for (int32_t i = 0; contacts && i < count; ++i) {
+        if (contacts[i] && *contacts[i]) list.emplace_back(contacts[i]);
+    }
+    std::string uri_s(list_uri), prefix_s(prefix ? prefix : "");
+    return submit_command("subscribe_presence_list", [uri_s, list, prefix_s] {
+        return cmd_subscribe_presence_list(uri_s, list, prefix_s);
+    });
+}
+
+extern "C" CV_EXPORT int64_t cv_unsubscribe(const char *contact) {
+    VOIP_TRACE_SCOPE("capi", "cv_unsubscribe");
+    if (!contact) return -1;
+    std::string contact_s(contact);
+    return submit_command("unsubscribe_presence", [contact_s] { return cmd_unsubscribe_presence(contact_s); });
 }
@@ -0,0 +1,129 @@
+#include "voip_events.h"
+
+#include <string.h>
+#include <sys/time.h>
+
+namespace voip_events {
+
+namespace {
+
+void put16(uint8_t *p, uint16_t v) { memcpy(p, &v, 2); }
+void put32(uint8_t *p, uint32_t v) { memcpy(p, &v, 4); }
+void put64(uint8_t *p, uint64_t v) { memcpy(p, &v, 8); }
+
+uint64_t wall_now_us() {
+    struct timeval tv;
+    gettimeofday(&tv, nullptr);
+    return (uint64_t)tv.tv_sec * 1000000u + (uint64_t)tv.tv_usec;
+}
+
+}  // namespace
+
+// Cursors are mirrored into the header for readers that poll the buffer instead of
+// waiting for the doorbell
+void Ring::publish_cursor(size_t offset, uint64_t value) {
+    __atomic_store_n(reinterpret_cast<uint64_t *>(buf_ + offset), value, __ATOMIC_RELEASE);
+}
+
+uint8_t *Ring::init(size_t capacity) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (buf_) return buf_;
+    size_t rounded = 4096;
+    while (rounded < capacity) rounded <<= 1;
+    buf_ = new uint8_t[kHeaderSize + rounded]();
+    capacity_ = rounded;
+    put32(buf_, kMagic);
+    put16(buf_ + 4, kSchemaVersion);
+    put16(buf_ + 6, (uint16_t)kHeaderSize);
+    put32(buf_ + 8, (uint32_t)rounded);
+    return buf_;
+}
+
+size_t Ring::buffer_size() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return buf_ ? kHeaderSize + capacity_ : 0;
+}
+
+uint64_t Ring::write(const Event &ev) {
+    size_t lengths[kMaxStrings] = {0, 0};
+    size_t size = kRecordHeaderSize;
+    uint8_t count = ev.string_count > kMaxStrings ? (uint8_t)kMaxStrings : ev.string_count;
+    for (uint8_t i = 0; i < count; ++i) {
+        lengths[i] = ev.strings[i] ? strnlen(ev.strings[i], kMaxStringBytes) : 0;
+        size += 2 + lengths[i];
+    }
+    size = (size + 3) & ~(size_t)3;
+    uint64_t timestamp = wall_now_us();
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (!buf_) return 0;
+    size_t offset = (size_t)(write_ & (capacity_ - 1));
+    size_t pad = (offset + size > capacity_) ? capacity_ - offset : 0;
+    if ((write_ + pad + size) - read_ > capacity_) {
+        dropped_++;
+        return 0;
+    }
+
+    uint8_t *data = buf_ + kHeaderSize;
+    if (pad) {
+        put16(data + offset, (uint16_t)pad);
+        data[offset + 2] = EV_PAD;
+        data[offset + 3] = 0;
+        write_ += pad;
+        offset = 0;
+    }
+    uint8_t *rec = data + offset;
+    put16(rec, (uint16_t)size);
+    rec[2] = ev.type;
+    rec[3] = count;
+    put32(rec + 4, ++sequence_);
+    put32(rec + 8, (uint32_t)ev.id);
+    put32(rec + 12, (uint32_t)ev.code);
+    put64(rec + 16, timestamp);
+    put64(rec + 24, (uint64_t)ev.v0);
+    put64(rec + 32, (uint64_t)ev.v1);
+    put64(rec + 40, (uint64_t)ev.v2);
+    uint8_t *p = rec + kRecordHeaderSize;
+    for (uint8_t i = 0; i < count; ++i) {
+        put16(p, (uint16_t)lengths[i]);
+        if (lengths[i]) memcpy(p + 2, ev.strings[i], lengths[i]);
+        p += 2 + lengths[i];
+    }
+    write_ += size;
+    publish_cursor(16, write_);
+    return write_;
+}
+
+void Ring::consume(uint64_t cursor) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (!buf_ || cursor <= read_ || cursor > write_) return;
+    read_ = cursor;
+    publish_cursor(24, read_);
+}
+
+size_t Ring::read(uint8_t *out, size_t capacity) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (!buf_) return 0;
+    const uint8_t *data = buf_ + kHeaderSize;
+    size_t copied = 0;
+    while (read_ < write_) {
+        size_t offset = (size_t)(read_ & (capacity_ - 1));
+        uint16_t size;
+        memcpy(&size, data + offset, 2);
+        if (data[offset + 2] != EV_PAD) {
+            if (copied + size > capacity) break;
+            memcpy(out + copied, data + offset, size);
+            copied += size;
+        }
+        read_ += size;
+    }
+    publish_cursor(24, read_);
+    return copied;
+}
+
+uint64_t Ring::dropped() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return dropped_;
+}
+
+}  // namespace voip_events
@@ -0,0 +1,103 @@
+// Binary event protocol: native events are encoded as fixed-layout records (type tag, fixed
+// integer fields, length-prefixed UTF-8 strings) into a byte ring that the app maps as a
+// direct ByteBuffer and decodes once (PjsipEngine.onNativeEvents / NativeEvents.kt). The
+// Dart isolate reads the same records through the C ABI (voip_capi.h, voip_native.dart).
+//
+// Shared buffer layout, all little-endian:
+//   header (kHeaderSize bytes)
+//     0  u32 magic (kMagic)         4  u16 schema version     6  u16 header size
+//     8  u32 data capacity          12 u32 reserved
+//     16 u64 write cursor           24 u64 read cursor
+//   data (capacity bytes, power of two); cursors are byte positions that only grow,
+//   a record lives at cursor % capacity and never straddles the end (PAD fills the gap).
+//
+// Record layout (size is a multiple of 4):
+//     0  u16 size    2  u8 type    3  u8 string count    4  u32 sequence
+//     8  i32 id      12 i32 code   16 i64 timestamp (us since the epoch)
+//     24 i64 v0      32 i64 v1     40 i64 v2
+//     48 strings: u16 length + bytes, back to back
+//
+// Bump kSchemaVersion whenever a field moves or changes meaning; new event types can be
+// added without a bump (readers skip unknown types by size).
+#pragma once
+
+#include <mutex>
+#include <stddef.h>
+#include <stdint.h>
+
+namespace voip_events {
+
+constexpr uint32_t kMagic = 0x54564556;  // "VEVT"
+constexpr uint16_t kSchemaVersion = 1;
+constexpr size_t kHeaderSize = 64;
+constexpr size_t kRecordHeaderSize = 48;
+constexpr size_t kMaxStrings = 2;
+constexpr size_t kMaxStringBytes = 1024;  // Longer strings are truncated
+
+//                          id         code             v0 / v1 / v2                    strings
+enum EventType : uint8_t {
+    EV_PAD = 0,
+    EV_INCOMING_CALL = 1,     // call id
+    EV_OUTGOING_CALL = 2,     // call id
+    EV_CALL_RINGING = 3,      // call id
+    EV_CALL_CONNECTED = 4,    // call id                    accept -> 200 us (0 outgoing)
+    EV_CALL_ENDED = 5,        // call id   SIP status                                        reason
+    EV_CALL_ERROR = 6,        //           pj_status_t                                       error text
+    EV_REGISTRATION = 7,      // acc id    SIP status                                        status text
+    EV_PRESENCE_UPDATED = 8,  // buddy id                                                    contact, state
+    EV_COMMAND_COMPLETED = 9, // result    1 ok / 0 failed  request id / wait us / exec us   command name
+    EV_BENCHMARK = 10,        // index     SIP status                                        reason
+    EV_CALL_SUMMARY = 11,     // call id   final SIP status start wall ms / setup ms / talk ms direction, number
+    EV_PRESENCE_ERROR = 12,   //           pj_status_t                                       contact, reason
+};
+// EV_COMMAND_COMPLETED result: the command's value (call id of make_call), or the pj_status_t
+// it failed with; -1 when there is nothing to report.
+
+struct Event {
+    EventType type = EV_PAD;
+    int32_t id = -1;
+    int32_t code = 0;
+    int64_t v0 = 0, v1 = 0, v2 = 0;
+    uint8_t string_count = 0;
+    const char *strings[kMaxStrings] = {nullptr, nullptr};
+};
+
+// One single-reader ring. The engine keeps one per consumer (the Kotlin app, the Dart
+// isolate through the C ABI); each has its own buffer and cursors.
+class Ring {
+public:
+    Ring() = default;
+    Ring(const Ring &) = delete;
+    Ring &operator=(const Ring &) = delete;
+
+    // Allocates the buffer once (capacity rounded up to a power of two); later calls return
+    // the existing one. The buffer is never freed: readers keep pointers into it.
+    uint8_t *init(size_t capacity);
+    size_t buffer_size();  // Header + data
+
+    // Appends an event and returns the committed write cursor, or 0 when the ring is not
+    // initialised or the reader is too far behind (the event is dropped)
+    uint64_t write(const Event &ev);
+
+    // The reader has decoded everything below cursor: that space can be reused
+    void consume(uint64_t cursor);
+
+    // Copy-out reader for in-process consumers: copies whole pending records (PAD skipped)
+    // into out, consumes them, and returns the number of bytes copied
+    size_t read(uint8_t *out, size_t capacity);
+
+    uint64_t dropped();
+
+private:
+    void publish_cursor(size_t offset, uint64_t value);
+
+    std::mutex mutex_;
+    uint8_t *buf_ = nullptr;  // Header followed by the data area
+    size_t capacity_ = 0;
+    uint64_t write_ = 0;
+    uint64_t read_ = 0;
+    uint32_t sequence_ = 0;
+    uint64_t dropped_ = 0;
+};
+
+}  // namespace voip_events
@@ -0,0 +1,279 @@
+#include "voip_pgo.h"
+
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <stdio.h>
+#include <string.h>
+
+namespace voip_pgo {
+
+namespace {
+
+std::atomic<pjsua_acc_id> g_workload_acc{PJSUA_INVALID_ID};
+
+const char kRegisterResponses[][512] = {
+    "SIP/2.0 401 Unauthorized\r\n"
+    "Via: SIP/2.0/UDP 10.0.0.2:5060;rport=5060;branch=z9hG4bKPj1\r\n"
+    "From: <sip:250100@pbx.example>;tag=a1\r\n"
+    "To: <sip:250100@pbx.example>;tag=b1\r\n"
+    "Call-ID: reg-1@10.0.0.2\r\n"
+    "CSeq: 1 REGISTER\r\n"
+    "WWW-Authenticate: Digest realm=\"pbx.example\",nonce=\"6a1f0e\",algorithm=MD5,qop=\"auth\"\r\n"
+    "Content-Length: 0\r\n\r\n",
+    "SIP/2.0 200 OK\r\n"
+    "Via: SIP/2.0/UDP 10.0.0.2:5060;rport=5060;branch=z9hG4bKPj2\r\n"
+    "From: <sip:250100@pbx.example>;tag=a1\r\n"
+    "To: <sip:250100@pbx.example>;tag=b1\r\n"
+    "Call-ID: reg-1@10.0.0.2\r\n"
+    "CSeq: 2 REGISTER\r\n"
+    "Contact: <sip:250100@10.0.0.2:5060;ob>;expires=300\r\n"
+    "Expires: 300\r\n"
+    "Content-Length: 0\r\n\r\n",
+};
+
+const char kNotifyHead[] =
+    "NOTIFY sip:250100@10.0.0.2:5060;ob SIP/2.0\r\n"
+    "Via: SIP/2.0/UDP 10.0.0.9:5060;branch=z9hG4bK88\r\n"
+    "Max-Forwards: 70\r\n"
+    "From: <sip:lamps@pbx.example>;tag=e1\r\n"
+    "To: <sip:250100@pbx.example>;tag=f1\r\n"
+    "Call-ID: rls-1@10.0.0.2\r\n"
+    "CSeq: 12 NOTIFY\r\n"
+    "Event: dialog\r\n"
+    "Subscription-State: active;expires=3600\r\n"
+    "Require: eventlist\r\n"
+    "Content-Type: multipart/related;type=\"application/rlmi+xml\";boundary=\"b1\"\r\n";
+
+
+// Full-state RLS NOTIFY for lamps contacts 250300.., each confirmed, early or terminated
+std::string build_notify(int lamps) {
+    std::string rlmi = "<?xml version=\"1.0\"?>\r\n<list xmlns=\"urn:ietf:params:xml:ns:rlmi\" "
+                       "uri=\"sip:lamps@pbx.example\" version=\"12\" fullState=\"true\">\r\n";
+    std::string parts;
+    static const char *const kStates[] = {"confirmed", "early", "terminated"};
+    for (int i = 0; i < lamps; ++i) {
+        char uri[64];
+        snprintf(uri, sizeof(uri), "sip:%d@pbx.example", 250300 + i);
+        char cid[32];
+        snprintf(cid, sizeof(cid), "lamp%d@pbx.example", i);
+        rlmi += std::string("<resource uri=\"") + uri + "\"><instance id=\"" + std::to_string(i) +
+                "\" state=\"active\" cid=\"" + cid + "\"/></resource>\r\n";
+        parts += std::string("--b1\r\nContent-Type: application/dialog-info+xml\r\nContent-ID: <") + cid +
+                 ">\r\n\r\n<?xml version=\"1.0\"?>\r\n<dialog-info xmlns=\"urn:ietf:params:xml:ns:dialog-info\" "
+                 "version=\"3\" state=\"full\" entity=\"" + uri + "\">\r\n<dialog id=\"d" + std::to_string(i) +
+                 "\" direction=\"recipient\"><state>" + kStates[i % 3] + "</state></dialog>\r\n</dialog-info>\r\n";
+    }
+    rlmi += "</list>\r\n";
+    std::string body = "--b1\r\nContent-Type: application/rlmi+xml\r\nContent-ID: <list@pbx.example>\r\n\r\n" +
+                       rlmi + parts + "--b1--\r\n";
+    return std::string(kNotifyHead) + "Content-Length: " + std::to_string(body.size()) + "\r\n\r\n" + body;
+}
+
+
+// The loop transport and the local account calling through it
+struct Loopback {
+    pjsip_transport *tp = nullptr;
+    pjsua_transport_id tp_id = PJSUA_INVALID_ID;
+    pjsua_acc_id acc_id = PJSUA_INVALID_ID;
+    std::string uri;  // The account's own address, over the loop
+};
+
+bool loopback_open(Loopback &loop) {
+    if (pjsip_loop_start(pjsua_get_pjsip_endpt(), &loop.tp) != PJ_SUCCESS) return false;
+    if (pjsua_transport_register(loop.tp, &loop.tp_id) != PJ_SUCCESS ||
+        pjsua_acc_add_local(loop.tp_id, PJ_FALSE, &loop.acc_id) != PJ_SUCCESS) {
+        return false;
+    }
+    char uri[128];
+    snprintf(uri, sizeof(uri), "sip:pgo@%.*s:%d;transport=loop-dgram", (int)loop.tp->local_name.host.slen,
+             loop.tp->local_name.host.ptr, loop.tp->local_name.port);
+    loop.uri = uri;
+    g_workload_acc = loop.acc_id;
+    return true;
+}
+
+void loopback_close(Loopback &loop) {
+    g_workload_acc = PJSUA_INVALID_ID;
+    if (loop.acc_id != PJSUA_INVALID_ID) pjsua_acc_del(loop.acc_id);
+    if (loop.tp_id != PJSUA_INVALID_ID) pjsua_transport_close(loop.tp_id, PJ_FALSE);
+}
+
+// Polls until done() or a 5 s timeout: the SIP worker drives the calls meanwhile
+bool wait_for(const std::function<bool()> &done) {
+    for (int waited_ms = 0; waited_ms < 5000; ++waited_ms) {
+        if (done()) return true;
+        pj_thread_sleep(1);
+    }
+    return done();
+}
+
+// Parses text and sends the message through the loop transport, which hands it back to the
+// endpoint: responses are dropped as strays, requests answered as outside any dialog
+pjsip_msg *send_through_loop(pj_pool_t *pool, const Loopback &loop, const char *text, size_t len) {
+    char *buf = (char *)pj_pool_alloc(pool, len + 1);
+    memcpy(buf, text, len + 1);
+    pjsip_msg *msg = pjsip_parse_msg(pool, buf, len, nullptr);
+    if (!msg) return nullptr;
+    pjsip_tx_data *tdata = nullptr;
+    if (pjsip_endpt_create_tdata(pjsua_get_pjsip_endpt(), &tdata) != PJ_SUCCESS) return nullptr;
+    tdata->msg = msg;
+    pj_status_t status = pjsip_transport_send(loop.tp, tdata, &loop.tp->local_addr, loop.tp->addr_len, nullptr, nullptr);
+    pjsip_tx_data_dec_ref(tdata);
+    return status == PJ_SUCCESS || status == PJ_EPENDING ? msg : nullptr;
+}
+
+bool register_responses(pj_pool_t *pool, const Loopback &loop) {
+    for (const auto &text : kRegisterResponses) {
+        if (!send_through_loop(pool, loop, text, strlen(text))) return false;
+    }
+    return true;
+}
+
+bool blf_storm(pj_pool_t *pool, const Loopback &loop, const std::string &notify, const EngineHooks &hooks) {
+    pjsip_msg *msg = send_through_loop(pool, loop, notify.c_str(), notify.size());
+    if (!msg || !msg->body) return false;
+    voip_rls::States states;
+    return hooks.parse_rls_notify(notify.data(), notify.size(), msg, "", states) == 0 && !states.empty();
+}
+
+// One call from the loopback account to itself: INVITE, 200 from the engine, ACK, then BYE
+bool call_cycle(const Loopback &loop) {
+    pj_str_t dst = pj_str((char *)loop.uri.c_str());
+    pjsua_call_id call_id = PJSUA_INVALID_ID;
+    if (pjsua_call_make_call(loop.acc_id, &dst, nullptr, nullptr, nullptr, &call_id) != PJ_SUCCESS) return false;
+    int state = PJSIP_INV_STATE_NULL;
+    wait_for([call_id, &state] {
+        pjsua_call_info ci;
+        state = pjsua_call_get_info(call_id, &ci) == PJ_SUCCESS ? (int)ci.state : (int)PJSIP_INV_STATE_DISCONNECTED;
+        return state >= PJSIP_INV_STATE_CONFIRMED;
+    });
+    if (state != PJSIP_INV_STATE_DISCONNECTED) pjsua_call_hangup(call_id, 0, nullptr, nullptr);
+    // Both legs gone before the next cycle
+    return wait_for([] { return pjsua_call_get_count() == 0; }) && state == PJSIP_INV_STATE_CONFIRMED;
+}
+
+bool g711_frames(pj_pool_t *pool, unsigned frames) {
+    pjmedia_codec_mgr *mgr = pjmedia_endpt_get_codec_mgr(pjsua_get_pjmedia_endpt());
+    const pj_str_t id = pj_str((char *)"PCMU/8000/1");
+    unsigned count = 1;
+    const pjmedia_codec_info *info = nullptr;
+    if (pjmedia_codec_mgr_find_codecs_by_id(mgr, &id, &count, &info, nullptr) != PJ_SUCCESS || !count) return false;
+    pjmedia_codec_param param;
+    pjmedia_codec *codec = nullptr;
+    if (pjmedia_codec_mgr_get_default_param(mgr, info, &param) != PJ_SUCCESS ||
+        pjmedia_codec_mgr_alloc_codec(mgr, info, &codec) != PJ_SUCCESS) {
+        return false;
+    }
+    bool ok = pjmedia_codec_init(codec, pool) == PJ_SUCCESS && pjmedia_codec_open(codec, &param) == PJ_SUCCESS;
+    if (ok) {
+        pj_int16_t pcm[160];
+        pj_int16_t decoded[160];
+        pj_uint8_t ulaw[160];
+        uint32_t seed = 1;
+        for (unsigned f = 0; f < frames && ok; ++f) {
+            for (pj_int16_t &s : pcm) {
+                seed = seed * 1103515245u + 12345u;
+                s = (pj_int16_t)(seed >> 16);
+            }
+            pjmedia_frame in = {}, enc = {}, dec = {};
+            in.type = PJMEDIA_FRAME_TYPE_AUDIO;
+            in.buf = pcm;
+            in.size = sizeof(pcm);
+            enc.buf = ulaw;
+            dec.buf = decoded;
+            ok = pjmedia_codec_encode(codec, &in, sizeof(ulaw), &enc) == PJ_SUCCESS &&
+                 pjmedia_codec_decode(codec, &enc, sizeof(decoded), &dec) == PJ_SUCCESS;
+        }
+        pjmedia_codec_close(codec);
+    }
+    pjmedia_codec_mgr_dealloc_codec(mgr, codec);
+    return ok;
+}
+
+
+// A private bridge, so a call in progress is not disturbed: tone generator -> null port
+bool conf_ticks(pj_pool_t *pool, unsigned ticks) {
+    pjmedia_conf *conf = nullptr;
+    if (pjmedia_conf_create(pool, 4, 8000, 1, 160, 16, PJMEDIA_CONF_NO_DEVICE, &conf) != PJ_SUCCESS) return false;
+    pjmedia_port *tone = nullptr, *sink = nullptr;
+    unsigned tone_slot = 0, sink_slot = 0;
+    bool ok = pjmedia_tonegen_create(pool, 8000, 1, 160, 16, PJMEDIA_TONEGEN_LOOP, &tone) == PJ_SUCCESS &&
+              pjmedia_null_port_create(pool, 8000, 1, 160, 16, &sink) == PJ_SUCCESS &&
+              pjmedia_conf_add_port(conf, pool, tone, nullptr, &tone_slot) == PJ_SUCCESS &&
+              pjmedia_conf_add_port(conf, pool, sink, nullptr, &sink_slot) == PJ_SUCCESS &&
+              pjmedia_conf_connect_port(conf, tone_slot, sink_slot, 0) == PJ_SUCCESS &&
+              pjmedia_conf_connect_port(conf, tone_slot, 0, 0) == PJ_SUCCESS;
+    if (ok) {
+        pjmedia_tone_desc desc = {};
+        desc.freq1 = 440;
+        desc.freq2 = 350;
+        desc.on_msec = 1000;
+        desc.off_msec = 0;
+        ok = pjmedia_tonegen_play(tone, 1, &desc, PJMEDIA_TONEGEN_LOOP) == PJ_SUCCESS;
+    }
+    if (ok) {
+        pjmedia_port *master = pjmedia_conf_get_master_port(conf);
+        pj_int16_t samples[160];
+        pj_uint64_t timestamp = 0;
+        for (unsigned t = 0; t < ticks; ++t) {
+            pjmedia_frame frame = {};
+            memset(samples, 0, sizeof(samples));
+            frame.type = PJMEDIA_FRAME_TYPE_AUDIO;
+            frame.buf = samples;
+            frame.size = sizeof(samples);
+            frame.timestamp.u64 = timestamp;
+            pjmedia_port_put_frame(master, &frame);
+            frame.type = PJMEDIA_FRAME_TYPE_AUDIO;
+            frame.size = sizeof(samples);
+            pjmedia_port_get_frame(master, &frame);
+            timestamp += 160;
+        }
+    }
+    pjmedia_conf_destroy(conf);
+    if (tone) pjmedia_port_destroy(tone);
+    if (sink) pjmedia_port_destroy(sink);
+    return ok;
+}
+
+}  // namespace
+
+std::string run_workload(unsigned iterations, const EngineHooks &hooks) {
+    const std::string notify = build_notify(64);
+    Loopback loop;
+    const bool looped = loopback_open(loop);
+    std::string out;
+    auto stage = [&](const char *name, bool needs_loop, const std::function<bool(pj_pool_t *)> &body) {
+        pj_pool_t *pool = pjsua_pool_create("pgo", 16384, 16384);
+        if (!pool || (needs_loop && !looped)) {
+            if (pool) pj_pool_release(pool);
+            out += std::string(name) + "_ns -1\n";
+            return;
+        }
+        bool ok = true;
+        auto start = std::chrono::steady_clock::now();
+        for (unsigned i = 0; i < iterations && ok; ++i) {
+            ok = body(pool);
+            // Messages are parsed into the pool: recycle it so memory stays flat
+            if ((i & 15) == 15) pj_pool_reset(pool);
+        }
+        auto ns = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+        pj_pool_release(pool);
+        char line[96];
+        snprintf(line, sizeof(line), "%s_ns %lld\n", name, ok && iterations ? (long long)(ns / iterations) : -1LL);
+        out += line;
+    };
+    stage("sip.register", true, [&loop](pj_pool_t *pool) { return register_responses(pool, loop); });
+    stage("sip.call_cycle", true, [&loop](pj_pool_t *) { return call_cycle(loop); });
+    stage("blf.notify_64", true, [&](pj_pool_t *pool) { return blf_storm(pool, loop, notify, hooks); });
+    stage("g711.frames_50", false, [](pj_pool_t *pool) { return g711_frames(pool, 50); });
+    stage("conf.ticks_50", false, [](pj_pool_t *pool) { return conf_ticks(pool, 50); });
+    loopback_close(loop);
+    return out;
+}
+
+bool is_workload_account(pjsua_acc_id acc_id) {
+    return acc_id != PJSUA_INVALID_ID && acc_id == g_workload_acc.load(std::memory_order_relaxed);
+}
+
+}  // namespace voip_pgo
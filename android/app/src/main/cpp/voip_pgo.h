@@ -0,0 +1,36 @@
+// PGO training workload (see "PGO training workload" in voip_engine.cpp). Only compiled into
+// instrumented builds (VOIP_PGO=generate in CMakeLists.txt, driven by android/pjsip/pgo.sh), so
+// neither the canned traffic nor the loopback account ever ship.
+//
+// The traffic goes through pjsip's loopback datagram transport, so every message takes the
+// real path: printed, handed to the transport, received, parsed and dispatched to the modules.
+// REGISTER responses and a BLF storm of 64-lamp RLS NOTIFYs are canned messages looped back to
+// the endpoint; call cycles are real calls from a local account on the loop transport to
+// itself (INVITE with SDP, 200, ACK, BYE), answered by the engine with null audio.
+#pragma once
+
+#include <pjsua-lib/pjsua.h>
+#include <stddef.h>
+#include <string>
+
+#include "voip_rls.h"
+
+namespace voip_pgo {
+
+// What the workload needs from the engine
+struct EngineHooks {
+    // The engine's RLS NOTIFY parser (rls_parse_notify): returns the parts it could not parse
+    size_t (*parse_rls_notify)(const char *msg_buf, size_t msg_len, const pjsip_msg *msg, const std::string &prefix,
+                               voip_rls::States &out);
+};
+
+// Runs each stage iterations times and returns "<stage>_ns <ns per iteration>" lines, or
+// "<stage>_ns -1" when the stage failed. Needs an initialised endpoint with no call in
+// progress; blocks the caller, which must be registered with pjlib.
+std::string run_workload(unsigned iterations, const EngineHooks &hooks);
+
+// The loopback account of a running workload: the engine answers its calls itself at once and
+// keeps them, their events and their call records, from the app
+bool is_workload_account(pjsua_acc_id acc_id);
+
+}  // namespace voip_pgo
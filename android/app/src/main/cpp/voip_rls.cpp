@@ -0,0 +1,374 @@
+#include "voip_rls.h"
+
+#include <algorithm>
+#include <ctype.h>
+#include <string.h>
+#include <strings.h>
+
+namespace voip_rls {
+
+namespace {
+
+constexpr int kMaxNesting = 4;  // Lists of lists of lists...
+
+bool starts_with_nocase(const std::string &s, size_t at, const char *prefix) {
+    size_t n = strlen(prefix);
+    return s.size() - std::min(at, s.size()) >= n && strncasecmp(s.c_str() + at, prefix, n) == 0;
+}
+
+std::string trim(const std::string &s) {
+    size_t start = s.find_first_not_of(" \t\r\n");
+    if (start == std::string::npos) return std::string();
+    return s.substr(start, s.find_last_not_of(" \t\r\n") - start + 1);
+}
+
+std::string lower(std::string s) {
+    for (char &c : s) c = (char)tolower((unsigned char)c);
+    return s;
+}
+
+// Namespace prefixes ("dinfo:dialog") are ignored
+std::string local_name(const std::string &name) {
+    size_t colon = name.rfind(':');
+    return colon == std::string::npos ? name : name.substr(colon + 1);
+}
+
+std::string xml_unescape(const std::string &s) {
+    static const struct { const char *entity; char c; } kEntities[] = {
+        {"&amp;", '&'}, {"&lt;", '<'}, {"&gt;", '>'}, {"&quot;", '"'}, {"&apos;", '\''},
+    };
+    std::string out;
+    for (size_t i = 0; i < s.size(); ++i) {
+        bool replaced = false;
+        if (s[i] == '&') {
+            for (const auto &e : kEntities) {
+                size_t n = strlen(e.entity);
+                if (s.compare(i, n, e.entity) == 0) {
+                    out += e.c;
+                    i += n - 1;
+                    replaced = true;
+                    break;
+                }
+            }
+        }
+        if (!replaced) out += s[i];
+    }
+    return out;
+}
+
+struct Tag {
+    std::string name;
+    std::vector<std::pair<std::string, std::string>> attrs;
+    bool closing = false;       // </name>
+    bool self_closing = false;  // <name/>
+
+    std::string attr(const char *wanted) const {
+        for (const auto &a : attrs) {
+            if (local_name(a.first) == wanted) return a.second;
+        }
+        return std::string();
+    }
+};
+
+// Just enough XML for dialog-info and RLMI documents: elements, attributes, text, CDATA;
+// declarations, comments and DOCTYPE are skipped
+class XmlScanner {
+public:
+    XmlScanner(const char *p, size_t n) : p_(p), end_(p + n) {}
+
+    // Next tag; text holds the character data between the previous tag and this one
+    bool next(Tag &tag, std::string &text) {
+        text.clear();
+        while (p_ < end_) {
+            const char *lt = std::find(p_, end_, '<');
+            text.append(p_, lt);
+            p_ = lt;
+            if (p_ == end_) return false;
+            if (skip("<?", "?>") || skip("<!--", "-->")) continue;
+            if (starts("<![CDATA[")) {
+                const char *start = p_ + 9;
+                if (!skip("<![CDATA[", "]]>")) return fail();
+                text.append(start, p_ - 3);
+                continue;
+            }
+            if (skip("<!", ">")) continue;
+            return parse_tag(tag);
+        }
+        return false;
+    }
+
+    bool bad() const { return bad_; }
+
+private:
+    bool starts(const char *s) const {
+        size_t n = strlen(s);
+        return (size_t)(end_ - p_) >= n && memcmp(p_, s, n) == 0;
+    }
+
+    // Skips from open to the end of close; false when p_ is not at open. An unterminated
+    // construct runs to the end of the input and marks it bad.
+    bool skip(const char *open, const char *close) {
+        if (!starts(open)) return false;
+        const char *at = std::search(p_ + strlen(open), end_, close, close + strlen(close));
+        if (at == end_) {
+            bad_ = true;
+            p_ = end_;
+        } else {
+            p_ = at + strlen(close);
+        }
+        return true;
+    }
+
+    bool fail() {
+        bad_ = true;
+        p_ = end_;
+        return false;
+    }
+
+    static bool is_space(char c) { return c == ' ' || c == '\t' || c == '\r' || c == '\n'; }
+
+    void skip_spaces() {
+        while (p_ < end_ && is_space(*p_)) ++p_;
+    }
+
+    std::string name() {
+        const char *start = p_;
+        while (p_ < end_ && !is_space(*p_) && *p_ != '/' && *p_ != '>' && *p_ != '=') ++p_;
+        return std::string(start, p_);
+    }
+
+    bool parse_tag(Tag &tag) {
+        tag = Tag();
+        ++p_;  // '<'
+        if (p_ < end_ && *p_ == '/') {
+            tag.closing = true;
+            ++p_;
+        }
+        tag.name = name();
+        if (tag.name.empty()) return fail();
+        while (true) {
+            skip_spaces();
+            if (p_ == end_) return fail();
+            if (*p_ == '>') {
+                ++p_;
+                return true;
+            }
+            if (*p_ == '/') {
+                if (end_ - p_ < 2 || p_[1] != '>') return fail();
+                tag.self_closing = true;
+                p_ += 2;
+                return true;
+            }
+            std::string attr = name();
+            skip_spaces();
+            if (attr.empty() || p_ == end_ || *p_ != '=') return fail();
+            ++p_;
+            skip_spaces();
+            if (p_ == end_ || (*p_ != '"' && *p_ != '\'')) return fail();
+            char quote = *p_++;
+            const char *close = std::find(p_, end_, quote);
+            if (close == end_) return fail();
+            tag.attrs.emplace_back(attr, xml_unescape(std::string(p_, close)));
+            p_ = close + 1;
+        }
+    }
+
+    const char *p_;
+    const char *end_;
+    bool bad_ = false;
+};
+
+// Busiest dialog wins: confirmed > early/trying/proceeding > terminated or none
+bool parse_dialog_info(XmlScanner &xml, const Tag &root, const std::string &prefix, States &out) {
+    std::string contact = contact_key(root.attr("entity"), prefix);
+    int level = 0;
+    int depth = root.self_closing ? 0 : 1;
+    int dialog_depth = 0;  // Depth of the open <dialog>, 0 outside one
+    Tag tag;
+    std::string text;
+    while (depth > 0 && xml.next(tag, text)) {
+        std::string name = local_name(tag.name);
+        if (tag.closing) {
+            if (name == "state" && dialog_depth > 0 && depth == dialog_depth + 1) {
+                std::string presence = dialog_presence(xml_unescape(text));
+                if (presence == "busy") level = std::max(level, 2);
+                else if (presence == "ringing") level = std::max(level, 1);
+            } else if (name == "dialog" && depth == dialog_depth) {
+                dialog_depth = 0;
+            }
+            --depth;
+        } else if (!tag.self_closing) {
+            ++depth;
+            if (name == "dialog" && depth == 2) dialog_depth = depth;
+        }
+    }
+    if (xml.bad() || depth > 0) return false;
+    if (!contact.empty()) out.emplace_back(contact, level == 2 ? "busy" : level == 1 ? "ringing" : "available");
+    return true;
+}
+
+// Resources whose every instance is terminated are gone (no dialog-info part follows)
+bool parse_rlmi(XmlScanner &xml, const Tag &root, const std::string &prefix, States &out) {
+    int depth = root.self_closing ? 0 : 1;
+    std::string resource;  // Contact key of the open <resource>
+    bool in_resource = false, has_instance = false, live = false;
+    Tag tag;
+    std::string text;
+    while (depth > 0 && xml.next(tag, text)) {
+        std::string name = local_name(tag.name);
+        if (tag.closing) {
+            if (name == "resource" && in_resource && depth == 2) {
+                if (has_instance && !live && !resource.empty()) out.emplace_back(resource, "offline");
+                in_resource = false;
+            }
+            --depth;
+            continue;
+        }
+        if (name == "resource" && depth == 1 && !tag.self_closing) {
+            resource = contact_key(tag.attr("uri"), prefix);
+            in_resource = true;
+            has_instance = live = false;
+        } else if (name == "instance" && in_resource && depth == 2) {
+            has_instance = true;
+            if (tag.attr("state") != "terminated") live = true;
+        }
+        if (!tag.self_closing) ++depth;
+    }
+    return !xml.bad() && depth == 0;
+}
+
+// One XML part; documents that are neither dialog-info nor RLMI are ignored
+bool parse_xml(const char *body, size_t len, const std::string &prefix, States &out) {
+    XmlScanner xml(body, len);
+    Tag root;
+    std::string text;
+    if (!xml.next(root, text) || root.closing) return false;
+    std::string name = local_name(root.name);
+    if (name == "dialog-info") return parse_dialog_info(xml, root, prefix, out);
+    if (name == "list") return parse_rlmi(xml, root, prefix, out);
+    return true;
+}
+
+// Content-Type parameter (boundary), quoted or not
+std::string param(const std::string &content_type, const char *wanted) {
+    size_t at = content_type.find(';');
+    while (at != std::string::npos) {
+        size_t eq = content_type.find('=', at);
+        size_t value_start = (eq == std::string::npos) ? eq : content_type.find_first_not_of(" \t", eq + 1);
+        if (value_start == std::string::npos) break;
+        std::string key = lower(trim(content_type.substr(at + 1, eq - at - 1)));
+        std::string value;
+        size_t next;
+        if (content_type[value_start] == '"') {
+            // A quoted value can hold ';'
+            size_t close = content_type.find('"', value_start + 1);
+            if (close == std::string::npos) break;
+            value = content_type.substr(value_start + 1, close - value_start - 1);
+            next = content_type.find(';', close);
+        } else {
+            next = content_type.find(';', value_start);
+            value = trim(content_type.substr(value_start, next == std::string::npos ? next : next - value_start));
+        }
+        if (key == wanted) return value;
+        at = next;
+    }
+    return std::string();
+}
+
+size_t parse_body(const std::string &content_type, const char *body, size_t len, const std::string &prefix,
+                  States &out, int nesting);
+
+size_t parse_multipart(const std::string &content_type, const char *body, size_t len, const std::string &prefix,
+                       States &out, int nesting) {
+    std::string boundary = param(content_type, "boundary");
+    if (boundary.empty() || nesting >= kMaxNesting) return 1;
+    const std::string text(body, len);
+    const std::string delimiter = "--" + boundary;
+    // The first delimiter may be preceded by a preamble; the others start a line
+    size_t at = text.compare(0, delimiter.size(), delimiter) == 0 ? 0 : text.find("\n" + delimiter);
+    if (at == std::string::npos) return 1;
+    if (at > 0) at += 1;
+    size_t failures = 0;
+    while (true) {
+        at += delimiter.size();
+        if (text.compare(at, 2, "--") == 0) return failures;  // Close delimiter
+        size_t line_end = text.find('\n', at);
+        if (line_end == std::string::npos) return failures + 1;
+        size_t part_start = line_end + 1;
+        size_t next = text.find("\n" + delimiter, part_start);
+        if (next == std::string::npos) return failures + 1;  // Unterminated part
+        size_t part_end = (next > part_start && text[next - 1] == '\r') ? next - 1 : next;
+
+        // Part headers, then an empty line
+        std::string part_type;
+        size_t line = part_start;
+        bool headers_done = false;
+        while (line < part_end) {
+            size_t eol = text.find('\n', line);
+            if (eol == std::string::npos || eol > part_end) eol = part_end;
+            std::string header = trim(text.substr(line, eol - line));
+            line = eol + 1;
+            if (header.empty()) {
+                headers_done = true;
+                break;
+            }
+            size_t colon = header.find(':');
+            std::string name = lower(trim(header.substr(0, colon)));
+            if (colon != std::string::npos && (name == "content-type" || name == "c")) {
+                part_type = trim(header.substr(colon + 1));
+            }
+        }
+        if (!headers_done) {
+            failures++;
+        } else {
+            size_t content = std::min(line, part_end);
+            failures += parse_body(part_type, text.data() + content, part_end - content, prefix, out, nesting + 1);
+        }
+        at = next + 1;
+    }
+}
+
+size_t parse_body(const std::string &content_type, const char *body, size_t len, const std::string &prefix,
+                  States &out, int nesting) {
+    if (!body || len == 0) return 0;
+    std::string type = lower(trim(content_type.substr(0, content_type.find(';'))));
+    if (type.compare(0, 10, "multipart/") == 0) return parse_multipart(content_type, body, len, prefix, out, nesting);
+    // dialog-info+xml, rlmi+xml; a part without a type is tried as XML too
+    bool xml = type.empty() || (type.size() >= 3 && type.compare(type.size() - 3, 3, "xml") == 0);
+    if (!xml) return 0;
+    return parse_xml(body, len, prefix, out) ? 0 : 1;
+}
+
+}  // namespace
+
+std::string contact_key(const std::string &contact, const std::string &prefix) {
+    std::string user = trim(contact);
+    size_t open = user.find('<');
+    if (open != std::string::npos) user = user.substr(open + 1);
+    if (starts_with_nocase(user, 0, "sip:")) {
+        user.erase(0, 4);
+    } else if (starts_with_nocase(user, 0, "sips:")) {
+        user.erase(0, 5);
+    } else if (starts_with_nocase(user, 0, "tel:")) {
+        user.erase(0, 4);
+    }
+    size_t end = user.find_first_of("@;>?");
+    if (end != std::string::npos) user.erase(end);
+    if (user.empty()) return user;
+    if (!prefix.empty() && user.compare(0, prefix.size(), prefix) != 0) user = prefix + user;
+    return user;
+}
+
+std::string dialog_presence(const std::string &dialog_state) {
+    std::string state = lower(trim(dialog_state));
+    if (state == "confirmed") return "busy";
+    if (state.empty() || state == "terminated") return "available";
+    return "ringing";
+}
+
+size_t parse_notify(const std::string &content_type, const char *body, size_t len, const std::string &prefix,
+                    States &out) {
+    return parse_body(content_type, body, len, prefix, out, 0);
+}
+
+}  // namespace voip_rls
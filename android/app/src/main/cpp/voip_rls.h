@@ -0,0 +1,36 @@
+// Resource list (RFC 4662) NOTIFY bodies for the BLF panel list (see "Resource list
+// subscriptions" in voip_engine.cpp): one multipart/related body with an RLMI document listing
+// the resources, and one application/dialog-info+xml part (RFC 4235) per resource with a known
+// state. Nested lists arrive as nested multipart/related parts.
+//
+// Also home of the presence key every BLF path shares (per-contact buddies, list entities,
+// the presence cache and presence_updated): the user part of the contact, with the dial
+// prefix prepended unless it is already there.
+#pragma once
+
+#include <stddef.h>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace voip_rls {
+
+// "sip:250100@pbx.example;user=phone", "<sip:250100@pbx>" or "0100" (prefix "25") → "250100"
+std::string contact_key(const std::string &contact, const std::string &prefix);
+
+// Presence one dialog <state> maps to: "busy" (confirmed), "available" (terminated, or "" when
+// the entity has no dialog), "ringing" for the rest (early, trying, proceeding). Case and
+// surrounding blanks are ignored.
+std::string dialog_presence(const std::string &dialog_state);
+
+typedef std::vector<std::pair<std::string, std::string>> States;  // contact key → presence state
+
+// Appends one state per resource the body reports: "busy" (a confirmed dialog), "ringing"
+// (early, trying or proceeding), "available" (none or all terminated) from dialog-info parts,
+// "offline" for RLMI resources whose every instance is terminated. content_type is the full
+// Content-Type value (boundary parameter included). Unparsable parts are skipped; returns the
+// number of parts that could not be parsed.
+size_t parse_notify(const std::string &content_type, const char *body, size_t len, const std::string &prefix,
+                    States &out);
+
+}  // namespace voip_rls
@@ -0,0 +1,153 @@
+#include "voip_sched.h"
+
+#include <algorithm>
+#include <atomic>
+#include <thread>
+#include <vector>
+#include <errno.h>
+#include <sched.h>
+#include <stdio.h>
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#include <time.h>
+#include <unistd.h>
+
+namespace voip_sched {
+
+namespace {
+
+uint64_t now_ns() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000u + (uint64_t)ts.tv_nsec;
+}
+
+pid_t current_tid() {
+    return (pid_t)syscall(SYS_gettid);
+}
+
+// Max frequency (kHz) per CPU, 0 where unknown
+std::vector<long> cpu_max_freqs() {
+    std::vector<long> freqs;
+    long count = sysconf(_SC_NPROCESSORS_CONF);
+    for (long cpu = 0; cpu < count && cpu < CPU_SETSIZE; ++cpu) {
+        char path[96];
+        snprintf(path, sizeof(path), "/sys/devices/system/cpu/cpu%ld/cpufreq/cpuinfo_max_freq", cpu);
+        long freq = 0;
+        if (FILE *f = fopen(path, "r")) {
+            if (fscanf(f, "%ld", &freq) != 1) freq = 0;
+            fclose(f);
+        }
+        freqs.push_back(freq);
+    }
+    return freqs;
+}
+
+}  // namespace
+
+bool set_current_thread_cores(CoreClass cores) {
+    if (cores == CORES_ANY) return false;
+    std::vector<long> freqs = cpu_max_freqs();
+    long lo = 0, hi = 0;
+    for (long f : freqs) {
+        if (f <= 0) continue;
+        if (!lo || f < lo) lo = f;
+        if (f > hi) hi = f;
+    }
+    if (!lo || lo == hi) return false;
+    const long wanted = cores == CORES_BIG ? hi : lo;
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    for (size_t cpu = 0; cpu < freqs.size(); ++cpu) {
+        if (freqs[cpu] == wanted) CPU_SET(cpu, &set);
+    }
+    return sched_setaffinity(current_tid(), sizeof(set), &set) == 0;
+}
+
+PriorityResult raise_current_thread_priority(int nice_value, int fifo_priority) {
+    if (fifo_priority > 0) {
+        struct sched_param param = {};
+        param.sched_priority = fifo_priority;
+        if (sched_setscheduler(current_tid(), SCHED_FIFO, &param) == 0) return PRIO_FIFO;
+    }
+    if (nice_value == 0) return PRIO_UNCHANGED;
+    // Linux applies nice per thread when given a tid
+    return setpriority(PRIO_PROCESS, (id_t)current_tid(), nice_value) == 0 ? PRIO_NICE : PRIO_UNCHANGED;
+}
+
+const char *priority_result_name(PriorityResult result) {
+    switch (result) {
+        case PRIO_FIFO: return "fifo";
+        case PRIO_NICE: return "nice";
+        default:        return "default";
+    }
+}
+
+uint64_t TickMeter::on_tick() {
+    return on_tick_at(now_ns());
+}
+
+uint64_t TickMeter::on_tick_at(uint64_t now) {
+    const uint64_t last = last_ns_;
+    last_ns_ = now;
+    if (!last || now <= last + period_ns_) return 0;
+    return (now - last - period_ns_) / 1000u;
+}
+
+Ticker::Ticker(uint32_t period_us) : period_ns_((uint64_t)period_us * 1000u), next_ns_(now_ns()) {}
+
+uint64_t Ticker::wait_next(unsigned max_skip) {
+    next_ns_ += period_ns_;
+    struct timespec ts;
+    ts.tv_sec = (time_t)(next_ns_ / 1000000000u);
+    ts.tv_nsec = (long)(next_ns_ % 1000000000u);
+    while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, nullptr) == EINTR) {
+    }
+    uint64_t now = now_ns();
+    uint64_t late_ns = now > next_ns_ ? now - next_ns_ : 0;
+    if (late_ns > (uint64_t)max_skip * period_ns_) {
+        skipped_ += late_ns / period_ns_;
+        next_ns_ = now;
+    }
+    return late_ns / 1000u;
+}
+
+JitterReport measure_tick_jitter(uint32_t period_us, uint32_t duration_ms, unsigned load_threads,
+                                 int nice_value, int fifo_priority, CoreClass cores) {
+    JitterReport report;
+    std::atomic<bool> running{true};
+    std::vector<std::thread> load;
+    for (unsigned i = 0; i < load_threads; ++i) {
+        load.emplace_back([&running] {
+            volatile uint64_t sink = 0;
+            while (running.load(std::memory_order_relaxed)) sink = sink * 6364136223846793005ull + 1;
+        });
+    }
+
+    std::vector<uint64_t> late;
+    std::thread ticker_thread([&] {
+        report.pinned = set_current_thread_cores(cores);
+        report.priority = raise_current_thread_priority(nice_value, fifo_priority);
+        const uint64_t ticks = period_us ? (uint64_t)duration_ms * 1000u / period_us : 0;
+        late.reserve(ticks);
+        Ticker ticker(period_us);
+        for (uint64_t i = 0; i < ticks; ++i) late.push_back(ticker.wait_next());
+        report.skipped = ticker.skipped();
+    });
+    ticker_thread.join();
+    running = false;
+    for (auto &t : load) t.join();
+
+    if (late.empty()) return report;
+    uint64_t sum = 0;
+    for (uint64_t v : late) sum += v;
+    std::sort(late.begin(), late.end());
+    report.ticks = late.size();
+    report.mean_us = sum / late.size();
+    report.p50_us = late[late.size() / 2];
+    report.p99_us = late[std::min(late.size() - 1, late.size() * 99 / 100)];
+    report.max_us = late.back();
+    return report;
+}
+
+}  // namespace voip_sched
@@ -0,0 +1,75 @@
+// Thread scheduling helpers for the engine's own threads (media clock, media poll): audio-class
+// priority, big/little core affinity, and a drift-free periodic ticker that reports how late
+// each tick woke up. TickMeter does the same for ticks driven by someone else's clock (the
+// sound device callback). measure_tick_jitter() runs the ticker against synthetic CPU load, so
+// the effect of a threading profile can be compared on a device or on the host.
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+namespace voip_sched {
+
+enum CoreClass : uint8_t { CORES_ANY = 0, CORES_BIG = 1, CORES_LITTLE = 2 };
+
+enum PriorityResult : uint8_t { PRIO_UNCHANGED = 0, PRIO_NICE = 1, PRIO_FIFO = 2 };
+
+// Pins the calling thread to the fastest (big) or slowest (little) cores, by cpuinfo_max_freq.
+// CORES_ANY, a homogeneous CPU or an unreadable sysfs leaves the affinity alone (false).
+bool set_current_thread_cores(CoreClass cores);
+
+// Audio-class scheduling for the calling thread: SCHED_FIFO when fifo_priority > 0 and the
+// process is allowed to, otherwise the nice value (e.g. -19, Android's URGENT_AUDIO).
+PriorityResult raise_current_thread_priority(int nice_value, int fifo_priority = 0);
+
+const char *priority_result_name(PriorityResult result);
+
+// Absolute-deadline ticker on CLOCK_MONOTONIC: a late tick does not push the next ones back.
+class Ticker {
+public:
+    explicit Ticker(uint32_t period_us);
+    // Sleeps until the next deadline; returns how late the thread woke up, in microseconds.
+    // After more than max_skip periods of lateness the schedule restarts from now.
+    uint64_t wait_next(unsigned max_skip = 4);
+    uint64_t skipped() const { return skipped_; }
+
+private:
+    uint64_t period_ns_;
+    uint64_t next_ns_;
+    uint64_t skipped_ = 0;
+};
+
+// Lateness of periodic callbacks the caller does not schedule itself: each tick is expected
+// one period after the previous one. A device delivering frames in bursts makes some ticks
+// early; those count as on time, and the late one that started the burst carries the delay.
+class TickMeter {
+public:
+    explicit TickMeter(uint32_t period_us) : period_ns_((uint64_t)period_us * 1000u) {}
+    // Microseconds past the expected time; the first tick after construction or reset() is 0
+    uint64_t on_tick();
+    uint64_t on_tick_at(uint64_t now_ns);
+    void reset() { last_ns_ = 0; }
+
+private:
+    uint64_t period_ns_;
+    uint64_t last_ns_ = 0;
+};
+
+struct JitterReport {
+    uint64_t ticks = 0;
+    uint64_t skipped = 0;
+    uint64_t mean_us = 0;
+    uint64_t p50_us = 0;
+    uint64_t p99_us = 0;
+    uint64_t max_us = 0;
+    PriorityResult priority = PRIO_UNCHANGED;
+    bool pinned = false;
+};
+
+// Runs a ticker for duration_ms while load_threads busy-loop threads compete for the CPU,
+// with the ticker thread set to nice_value / fifo_priority / cores (nice 0, fifo 0 and
+// CORES_ANY measure the default scheduling).
+JitterReport measure_tick_jitter(uint32_t period_us, uint32_t duration_ms, unsigned load_threads,
+                                 int nice_value, int fifo_priority, CoreClass cores);
+
+}  // namespace voip_sched
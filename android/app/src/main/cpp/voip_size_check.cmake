@@ -0,0 +1,72 @@
+# Size gate for libvoip_engine.so, run after every link (see "Size report" in CMakeLists.txt):
+#   cmake -DSO=<libvoip_engine.so> -DKEY="<abi> <size profile> <pgo>" -DBASELINE=<file>
+#         [-DSTRIP=<llvm-strip>] [-DTOLERANCE_PCT=1] [-DUPDATE=ON] -P voip_size_check.cmake
+# Measures the stripped library (what ships in the APK; the file size when there is no strip
+# tool), prints it next to the baseline entry for KEY and fails when it grew by more than
+# TOLERANCE_PCT percent. UPDATE=ON records the measured size as the new baseline instead.
+cmake_minimum_required(VERSION 3.22.1)
+
+foreach(arg SO KEY BASELINE)
+    if(NOT DEFINED ${arg})
+        message(FATAL_ERROR "voip_size_check: ${arg} is required")
+    endif()
+endforeach()
+if(NOT DEFINED TOLERANCE_PCT)
+    set(TOLERANCE_PCT 1)
+endif()
+
+set(measured ${SO})
+if(STRIP)
+    set(measured ${SO}.stripped)
+    execute_process(COMMAND ${STRIP} --strip-all -o ${measured} ${SO} RESULT_VARIABLE strip_result)
+    if(NOT strip_result EQUAL 0)
+        message(FATAL_ERROR "voip_size_check: ${STRIP} failed on ${SO}")
+    endif()
+endif()
+file(SIZE ${measured} size)
+if(STRIP)
+    file(REMOVE ${measured})
+endif()
+
+# One "<abi> <size profile> <pgo> <bytes>" line per build flavour; # starts a comment
+set(lines "")
+set(baseline "")
+if(EXISTS ${BASELINE})
+    file(STRINGS ${BASELINE} lines)
+endif()
+set(kept "")
+foreach(line IN LISTS lines)
+    if(line MATCHES "^${KEY} ([0-9]+)$")
+        set(baseline ${CMAKE_MATCH_1})
+    else()
+        list(APPEND kept "${line}")
+    endif()
+endforeach()
+
+if(UPDATE)
+    list(APPEND kept "${KEY} ${size}")
+    list(JOIN kept "\n" text)
+    file(WRITE ${BASELINE} "${text}\n")
+    if(baseline STREQUAL "")
+        set(baseline "none")
+    endif()
+    message(STATUS "libvoip_engine.so [${KEY}]: ${size} bytes recorded as the baseline (was ${baseline})")
+    return()
+endif()
+
+if(baseline STREQUAL "")
+    message(STATUS "libvoip_engine.so [${KEY}]: ${size} bytes, no baseline yet (build with VOIP_SIZE_BASELINE_UPDATE=ON to record one)")
+    return()
+endif()
+
+math(EXPR delta "${size} - ${baseline}")
+if(delta GREATER_EQUAL 0)
+    set(delta "+${delta}")
+endif()
+math(EXPR limit "${baseline} + ${baseline} * ${TOLERANCE_PCT} / 100")
+message(STATUS "libvoip_engine.so [${KEY}]: before ${baseline} bytes, after ${size} bytes (${delta} bytes)")
+if(size GREATER limit)
+    message(FATAL_ERROR "libvoip_engine.so grew past the ${TOLERANCE_PCT}% allowed over its baseline "
+                        "(${size} > ${limit} bytes). Shrink it, or re-record ${BASELINE} with "
+                        "VOIP_SIZE_BASELINE_UPDATE=ON if the growth is intended.")
+endif()
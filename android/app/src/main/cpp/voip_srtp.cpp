@@ -0,0 +1,193 @@
+#include "voip_srtp.h"
+
+#include <atomic>
+#include <string.h>
+#include <time.h>
+
+#if __has_include(<srtp2/srtp.h>)
+#include <srtp2/srtp.h>  // libsrtp 2 installed system-wide (host test build)
+#else
+#include <srtp.h>        // pjproject's bundled libsrtp (third_party/srtp)
+#endif
+
+// libsrtp's own entry points, renamed by the linker's --wrap (see voip_srtp.h)
+extern "C" {
+srtp_err_status_t __real_srtp_protect(srtp_t ctx, void *rtp_hdr, int *len_ptr);
+srtp_err_status_t __real_srtp_unprotect(srtp_t ctx, void *srtp_hdr, int *len_ptr);
+}
+
+namespace voip_srtp {
+
+const char *const kSuites[kSuiteCount] = {
+    "AEAD_AES_256_GCM",
+    "AEAD_AES_128_GCM",
+    "AES_256_CM_HMAC_SHA1_80",
+    "AES_CM_128_HMAC_SHA1_80",
+    "AES_CM_128_HMAC_SHA1_32",
+};
+
+namespace {
+
+constexpr size_t kHeaderBytes = 12;
+constexpr size_t kPayloadBytes = 160;
+constexpr size_t kPacketBytes = kHeaderBytes + kPayloadBytes + SRTP_MAX_TRAILER_LEN;
+
+std::atomic<uint64_t> g_protect_packets{0};
+std::atomic<uint64_t> g_protect_ns{0};
+std::atomic<uint64_t> g_unprotect_packets{0};
+std::atomic<uint64_t> g_unprotect_ns{0};
+std::atomic<PacketObserver> g_observer{nullptr};
+
+uint64_t now_ns() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000u + (uint64_t)ts.tv_nsec;
+}
+
+void record_live(bool protect, uint64_t ns) {
+    (protect ? g_protect_packets : g_unprotect_packets).fetch_add(1, std::memory_order_relaxed);
+    (protect ? g_protect_ns : g_unprotect_ns).fetch_add(ns, std::memory_order_relaxed);
+    PacketObserver observer = g_observer.load(std::memory_order_acquire);
+    if (observer) observer(protect, ns > UINT32_MAX ? UINT32_MAX : (uint32_t)ns);
+}
+
+void set_crypto_policy(size_t suite, srtp_crypto_policy_t *policy) {
+    switch (suite) {
+        case 0:  srtp_crypto_policy_set_aes_gcm_256_16_auth(policy); break;
+        case 1:  srtp_crypto_policy_set_aes_gcm_128_16_auth(policy); break;
+        case 2:  srtp_crypto_policy_set_aes_cm_256_hmac_sha1_80(policy); break;
+        case 3:  srtp_crypto_policy_set_aes_cm_128_hmac_sha1_80(policy); break;
+        default: srtp_crypto_policy_set_aes_cm_128_hmac_sha1_32(policy); break;
+    }
+}
+
+bool create_session(size_t suite, uint8_t *key, srtp_ssrc_type_t direction, srtp_t *session) {
+    srtp_policy_t policy;
+    memset(&policy, 0, sizeof(policy));
+    set_crypto_policy(suite, &policy.rtp);
+    set_crypto_policy(suite, &policy.rtcp);
+    policy.ssrc.type = direction;
+    policy.key = key;
+    policy.window_size = 128;
+    policy.next = nullptr;
+    return srtp_create(session, &policy) == srtp_err_status_ok;
+}
+
+void build_packet(uint8_t *pkt, uint16_t seq) {
+    memset(pkt, 0, kPacketBytes);
+    pkt[0] = 0x80;  // V=2
+    pkt[1] = 0;     // PT 0 (PCMU)
+    pkt[2] = (uint8_t)(seq >> 8);
+    pkt[3] = (uint8_t)seq;
+    const uint32_t ts = (uint32_t)seq * 160u;
+    pkt[4] = (uint8_t)(ts >> 24);
+    pkt[5] = (uint8_t)(ts >> 16);
+    pkt[6] = (uint8_t)(ts >> 8);
+    pkt[7] = (uint8_t)ts;
+    pkt[8] = 0x12;  // SSRC
+    pkt[9] = 0x34;
+    pkt[10] = 0x56;
+    pkt[11] = 0x78;
+    for (size_t i = 0; i < kPayloadBytes; ++i) pkt[kHeaderBytes + i] = (uint8_t)(0xFF - ((i + seq) & 0x7F));
+}
+
+}  // namespace
+
+int suite_index(const char *name, size_t len) {
+    if (!name) return -1;
+    for (size_t i = 0; i < kSuiteCount; ++i) {
+        if (strlen(kSuites[i]) == len && strncmp(kSuites[i], name, len) == 0) return (int)i;
+    }
+    return -1;
+}
+
+SuiteCost measure_suite(size_t suite, unsigned packets, std::vector<uint32_t> *protect_samples,
+                        std::vector<uint32_t> *unprotect_samples) {
+    SuiteCost cost;
+    if (suite >= kSuiteCount || packets == 0) return cost;
+    // pjmedia has usually initialised the library already, and a second srtp_init() reports
+    // bad_param for its debug module: srtp_create() below is the real test
+    srtp_init();
+
+    uint8_t key[SRTP_MAX_KEY_LEN];
+    for (size_t i = 0; i < sizeof(key); ++i) key[i] = (uint8_t)(i * 37 + 11);
+    srtp_t tx = nullptr, rx = nullptr;
+    if (!create_session(suite, key, ssrc_any_outbound, &tx)) return cost;
+    if (!create_session(suite, key, ssrc_any_inbound, &rx)) {
+        srtp_dealloc(tx);
+        return cost;
+    }
+
+    std::vector<uint8_t> buffers((size_t)packets * kPacketBytes);
+    std::vector<int> lengths(packets);
+    for (unsigned i = 0; i < packets; ++i) build_packet(&buffers[(size_t)i * kPacketBytes], (uint16_t)(i + 1));
+
+    bool ok = true;
+    uint64_t protect_total = 0, unprotect_total = 0;
+    for (unsigned i = 0; i < packets && ok; ++i) {
+        lengths[i] = (int)(kHeaderBytes + kPayloadBytes);
+        const uint64_t start = now_ns();
+        ok = __real_srtp_protect(tx, &buffers[(size_t)i * kPacketBytes], &lengths[i]) == srtp_err_status_ok;
+        const uint64_t ns = now_ns() - start;
+        protect_total += ns;
+        if (protect_samples) protect_samples->push_back((uint32_t)ns);
+    }
+    for (unsigned i = 0; i < packets && ok; ++i) {
+        const uint64_t start = now_ns();
+        ok = __real_srtp_unprotect(rx, &buffers[(size_t)i * kPacketBytes], &lengths[i]) == srtp_err_status_ok &&
+             lengths[i] == (int)(kHeaderBytes + kPayloadBytes);
+        const uint64_t ns = now_ns() - start;
+        unprotect_total += ns;
+        if (unprotect_samples) unprotect_samples->push_back((uint32_t)ns);
+    }
+    srtp_dealloc(tx);
+    srtp_dealloc(rx);
+    if (!ok) return cost;
+
+    cost.available = true;
+    cost.protect_ns = (uint32_t)(protect_total / packets);
+    cost.unprotect_ns = (uint32_t)(unprotect_total / packets);
+    return cost;
+}
+
+std::vector<size_t> offered_suites(const SuiteCost (&costs)[kSuiteCount], uint64_t budget_us) {
+    std::vector<size_t> suites;
+    size_t cheapest = kSuiteCount;
+    for (size_t i = 0; i < kSuiteCount; ++i) {
+        if (!costs[i].available) continue;
+        if (call_cost_us_per_s(costs[i]) <= budget_us) suites.push_back(i);
+        if (cheapest == kSuiteCount || call_cost_us_per_s(costs[i]) < call_cost_us_per_s(costs[cheapest])) {
+            cheapest = i;
+        }
+    }
+    if (suites.empty() && cheapest < kSuiteCount) suites.push_back(cheapest);
+    return suites;
+}
+
+LiveCost live_cost() {
+    LiveCost cost;
+    cost.protect_packets = g_protect_packets.load(std::memory_order_relaxed);
+    cost.protect_ns = g_protect_ns.load(std::memory_order_relaxed);
+    cost.unprotect_packets = g_unprotect_packets.load(std::memory_order_relaxed);
+    cost.unprotect_ns = g_unprotect_ns.load(std::memory_order_relaxed);
+    return cost;
+}
+
+void set_packet_observer(PacketObserver observer) { g_observer.store(observer, std::memory_order_release); }
+
+}  // namespace voip_srtp
+
+// What pjmedia's SRTP transport calls for each RTP packet once the linker has wrapped libsrtp
+extern "C" srtp_err_status_t __wrap_srtp_protect(srtp_t ctx, void *rtp_hdr, int *len_ptr) {
+    const uint64_t start = voip_srtp::now_ns();
+    srtp_err_status_t status = __real_srtp_protect(ctx, rtp_hdr, len_ptr);
+    voip_srtp::record_live(true, voip_srtp::now_ns() - start);
+    return status;
+}
+
+extern "C" srtp_err_status_t __wrap_srtp_unprotect(srtp_t ctx, void *srtp_hdr, int *len_ptr) {
+    const uint64_t start = voip_srtp::now_ns();
+    srtp_err_status_t status = __real_srtp_unprotect(ctx, srtp_hdr, len_ptr);
+    voip_srtp::record_live(false, voip_srtp::now_ns() - start);
+    return status;
+}
@@ -0,0 +1,62 @@
+// SRTP cost model: measures what protecting and unprotecting one RTP packet costs with each
+// crypto suite pjmedia can negotiate, on this CPU and with the libsrtp crypto backend it was
+// built against (OpenSSL/BoringSSL EVP: ARMv8 Cryptography Extensions on the device, AES-NI
+// on x86). The engine uses it to offer only the suites that fit its per-call CPU budget.
+//
+// It also times the packets of real calls: VOIP_SRTP builds link the engine with
+// --wrap=srtp_protect and --wrap=srtp_unprotect (CMakeLists.txt), so every RTP packet
+// pjmedia's SRTP transport protects or unprotects goes through this file on its way to libsrtp.
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+
+namespace voip_srtp {
+
+// Default CPU budget of one call's SRTP: 0.1% of a core
+constexpr uint32_t kDefaultBudgetUs = 1000;
+
+// pjmedia crypto suite names, strongest first
+constexpr size_t kSuiteCount = 5;
+extern const char *const kSuites[kSuiteCount];
+
+// Index of name in kSuites, or -1
+int suite_index(const char *name, size_t len);
+
+struct SuiteCost {
+    bool available = false;  // libsrtp could create a session (GCM needs an OpenSSL build)
+    uint32_t protect_ns = 0;  // Mean per packet
+    uint32_t unprotect_ns = 0;
+};
+
+// Protects then unprotects that many synthetic 20 ms G.711 packets (12 B header, 160 B payload)
+// with the suite. Per-packet timings go to the sample vectors when given. Not counted as live.
+SuiteCost measure_suite(size_t suite, unsigned packets, std::vector<uint32_t> *protect_samples = nullptr,
+                        std::vector<uint32_t> *unprotect_samples = nullptr);
+
+// Live RTP packets since the library was loaded, failed calls included
+struct LiveCost {
+    uint64_t protect_packets = 0;
+    uint64_t protect_ns = 0;
+    uint64_t unprotect_packets = 0;
+    uint64_t unprotect_ns = 0;
+};
+
+LiveCost live_cost();
+
+// Called on the media thread that ran it with the time of each live packet; nullptr to stop
+typedef void (*PacketObserver)(bool protect, uint32_t ns);
+void set_packet_observer(PacketObserver observer);
+
+// CPU time of one call direction pair, in microseconds per second of call
+inline uint64_t call_cost_us_per_s(const SuiteCost &cost, unsigned packets_per_s = 50) {
+    return (uint64_t)packets_per_s * (cost.protect_ns + cost.unprotect_ns) / 1000u;
+}
+
+// Suites to offer, as indexes in kSuites: the available ones whose call_cost_us_per_s() fits
+// budget_us, strongest first; the cheapest available one alone when none fits; none when no
+// suite is available
+std::vector<size_t> offered_suites(const SuiteCost (&costs)[kSuiteCount], uint64_t budget_us);
+
+}  // namespace voip_srtp
@@ -0,0 +1,204 @@
+#include "voip_trace.h"
+
+#if VOIP_TRACE_ENABLED
+
+#include <atomic>
+#include <chrono>
+#include <map>
+#include <mutex>
+#include <string>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/syscall.h>
+
+#ifndef VOIP_TRACE_RING_SIZE
+#define VOIP_TRACE_RING_SIZE 16384  // Events kept (power of two), ~1 MB
+#endif
+#define VOIP_TRACE_ARG_LEN 40
+
+namespace voip_trace {
+
+namespace {
+
+struct Event {
+    // Per-slot seqlock: odd while being written, 2*(index+1) once complete
+    std::atomic<uint64_t> seq{0};
+    const char *cat;
+    const char *name;
+    uint64_t ts_us;
+    uint64_t dur_us;
+    uint64_t id;
+    uint32_t tid;
+    char phase;
+    char arg[VOIP_TRACE_ARG_LEN];
+};
+
+static_assert((VOIP_TRACE_RING_SIZE & (VOIP_TRACE_RING_SIZE - 1)) == 0, "ring size must be a power of two");
+
+Event g_ring[VOIP_TRACE_RING_SIZE];
+std::atomic<uint64_t> g_next{0};
+std::atomic<bool> g_enabled{true};
+const auto g_epoch = std::chrono::steady_clock::now();
+
+std::mutex g_names_mutex;
+std::map<uint32_t, std::string> g_thread_names;
+
+uint32_t current_tid() {
+    static thread_local uint32_t tid = (uint32_t)syscall(SYS_gettid);
+    return tid;
+}
+
+void record(char phase, const char *cat, const char *name, uint64_t ts_us, uint64_t dur_us, uint64_t id,
+            const char *arg) {
+    if (!g_enabled.load(std::memory_order_relaxed)) return;
+    uint64_t index = g_next.fetch_add(1, std::memory_order_relaxed);
+    Event &ev = g_ring[index & (VOIP_TRACE_RING_SIZE - 1)];
+    ev.seq.store(2 * index + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    ev.cat = cat;
+    ev.name = name;
+    ev.ts_us = ts_us;
+    ev.dur_us = dur_us;
+    ev.id = id;
+    ev.tid = current_tid();
+    ev.phase = phase;
+    if (arg) {
+        strncpy(ev.arg, arg, sizeof(ev.arg) - 1);
+        ev.arg[sizeof(ev.arg) - 1] = '\0';
+    } else {
+        ev.arg[0] = '\0';
+    }
+    ev.seq.store(2 * index + 2, std::memory_order_release);
+}
+
+// Minimal JSON string escaping for names and arguments
+void write_json_string(FILE *f, const char *s) {
+    fputc('"', f);
+    for (; s && *s; ++s) {
+        unsigned char c = (unsigned char)*s;
+        if (c == '"' || c == '\\') {
+            fputc('\\', f);
+            fputc(c, f);
+        } else if (c < 0x20) {
+            fprintf(f, "\\u%04x", c);
+        } else {
+            fputc(c, f);
+        }
+    }
+    fputc('"', f);
+}
+
+}  // namespace
+
+uint64_t now_us() {
+    return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - g_epoch).count();
+}
+
+bool enabled() {
+    return g_enabled.load(std::memory_order_relaxed);
+}
+
+void set_enabled(bool on) {
+    g_enabled.store(on, std::memory_order_relaxed);
+}
+
+void set_thread_name(const char *name) {
+    std::lock_guard<std::mutex> lock(g_names_mutex);
+    g_thread_names[current_tid()] = name ? name : "";
+}
+
+void complete(const char *cat, const char *name, uint64_t start_us, uint64_t dur_us, const char *arg) {
+    record('X', cat, name, start_us, dur_us, 0, arg);
+}
+
+void instant(const char *cat, const char *name, const char *arg) {
+    record('i', cat, name, now_us(), 0, 0, arg);
+}
+
+void flow_begin(const char *cat, const char *name, uint64_t id) {
+    record('s', cat, name, now_us(), 0, id, nullptr);
+}
+
+void flow_step(const char *cat, const char *name, uint64_t id) {
+    record('t', cat, name, now_us(), 0, id, nullptr);
+}
+
+void flow_end(const char *cat, const char *name, uint64_t id) {
+    record('f', cat, name, now_us(), 0, id, nullptr);
+}
+
+Scope::Scope(const char *cat, const char *name, const char *arg)
+    : cat_(cat), name_(name), arg_(arg), start_us_(now_us()) {}
+
+Scope::~Scope() {
+    record('X', cat_, name_, start_us_, now_us() - start_us_, 0, arg_);
+}
+
+long dump(const char *path) {
+    std::string tmp_path = std::string(path) + ".tmp";
+    FILE *f = fopen(tmp_path.c_str(), "w");
+    if (!f) return -1;
+
+    fputs("{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n", f);
+    long written = 0;
+    uint32_t pid = (uint32_t)getpid();
+    {
+        std::lock_guard<std::mutex> lock(g_names_mutex);
+        for (const auto &entry : g_thread_names) {
+            fprintf(f, "%s{\"ph\":\"M\",\"name\":\"thread_name\",\"pid\":%u,\"tid\":%u,\"args\":{\"name\":",
+                    written ? ",\n" : "", pid, entry.first);
+            write_json_string(f, entry.second.c_str());
+            fputs("}}", f);
+            written++;
+        }
+    }
+
+    uint64_t end = g_next.load(std::memory_order_acquire);
+    uint64_t begin = end > VOIP_TRACE_RING_SIZE ? end - VOIP_TRACE_RING_SIZE : 0;
+    for (uint64_t index = begin; index < end; ++index) {
+        const Event &slot = g_ring[index & (VOIP_TRACE_RING_SIZE - 1)];
+        uint64_t seq_before = slot.seq.load(std::memory_order_acquire);
+        if (seq_before != 2 * index + 2) continue;  // Being written or already overwritten
+        const char *cat = slot.cat;
+        const char *name = slot.name;
+        uint64_t ts = slot.ts_us, dur = slot.dur_us, id = slot.id;
+        uint32_t tid = slot.tid;
+        char phase = slot.phase;
+        char arg[VOIP_TRACE_ARG_LEN];
+        memcpy(arg, slot.arg, sizeof(arg));
+        arg[sizeof(arg) - 1] = '\0';
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (slot.seq.load(std::memory_order_relaxed) != seq_before) continue;
+
+        fprintf(f, "%s{\"ph\":\"%c\",\"cat\":", written ? ",\n" : "", phase);
+        write_json_string(f, cat);
+        fputs(",\"name\":", f);
+        write_json_string(f, name);
+        fprintf(f, ",\"pid\":%u,\"tid\":%u,\"ts\":%llu", pid, tid, (unsigned long long)ts);
+        if (phase == 'X') fprintf(f, ",\"dur\":%llu", (unsigned long long)dur);
+        if (phase == 'i') fputs(",\"s\":\"t\"", f);
+        if (phase == 's' || phase == 't' || phase == 'f') fprintf(f, ",\"id\":%llu", (unsigned long long)id);
+        if (phase == 'f') fputs(",\"bp\":\"e\"", f);
+        if (arg[0]) {
+            fputs(",\"args\":{\"detail\":", f);
+            write_json_string(f, arg);
+            fputc('}', f);
+        }
+        fputc('}', f);
+        written++;
+    }
+    fputs("\n]}\n", f);
+
+    bool ok = fflush(f) == 0;
+    ok = (fclose(f) == 0) && ok;
+    if (!ok || rename(tmp_path.c_str(), path) != 0) {
+        unlink(tmp_path.c_str());
+        return -1;
+    }
+    return written;
+}
+
+}  // namespace voip_trace
+
+#endif  // VOIP_TRACE_ENABLED
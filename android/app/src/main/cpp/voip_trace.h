@@ -0,0 +1,79 @@
+// Scoped trace spans, instants and flows recorded into an in-memory ring and dumped on
+// demand as Chrome trace JSON (open with ui.perfetto.dev or chrome://tracing).
+//
+// Everything compiles to nothing unless VOIP_TRACE_ENABLED is 1 (CMake option VOIP_TRACING).
+// The recorder is also built and tested on the Linux host (android/app/src/test/cpp).
+//
+// Names and categories must be string literals (only the pointer is stored); dynamic text
+// goes into the short per-event argument.
+#pragma once
+
+#include <stdint.h>
+
+#ifndef VOIP_TRACE_ENABLED
+#define VOIP_TRACE_ENABLED 0
+#endif
+
+#if VOIP_TRACE_ENABLED
+
+namespace voip_trace {
+
+uint64_t now_us();
+bool enabled();
+void set_enabled(bool on);
+
+// Names the calling thread in the dump ("engine", "jni", "pjsip"...)
+void set_thread_name(const char *name);
+
+void complete(const char *cat, const char *name, uint64_t start_us, uint64_t dur_us, const char *arg = nullptr);
+void instant(const char *cat, const char *name, const char *arg = nullptr);
+
+// Flow arrows between slices: begin in the producing slice, end in the consuming one
+void flow_begin(const char *cat, const char *name, uint64_t id);
+void flow_step(const char *cat, const char *name, uint64_t id);
+void flow_end(const char *cat, const char *name, uint64_t id);
+
+// Writes the ring (oldest first) to path; returns the number of events written, or -1
+long dump(const char *path);
+
+class Scope {
+public:
+    Scope(const char *cat, const char *name, const char *arg = nullptr);
+    ~Scope();
+    Scope(const Scope &) = delete;
+    Scope &operator=(const Scope &) = delete;
+
+private:
+    const char *cat_;
+    const char *name_;
+    const char *arg_;
+    uint64_t start_us_;
+};
+
+}  // namespace voip_trace
+
+#define VOIP_TRACE_CONCAT_(a, b) a##b
+#define VOIP_TRACE_CONCAT(a, b) VOIP_TRACE_CONCAT_(a, b)
+#define VOIP_TRACE_SCOPE(cat, name) voip_trace::Scope VOIP_TRACE_CONCAT(trace_scope_, __LINE__)(cat, name)
+#define VOIP_TRACE_SCOPE_ARG(cat, name, arg) voip_trace::Scope VOIP_TRACE_CONCAT(trace_scope_, __LINE__)(cat, name, arg)
+#define VOIP_TRACE_INSTANT(cat, name, arg) voip_trace::instant(cat, name, arg)
+#define VOIP_TRACE_NOW_US() voip_trace::now_us()
+#define VOIP_TRACE_COMPLETE(cat, name, start_us, dur_us, arg) voip_trace::complete(cat, name, start_us, dur_us, arg)
+#define VOIP_TRACE_FLOW_BEGIN(cat, name, id) voip_trace::flow_begin(cat, name, id)
+#define VOIP_TRACE_FLOW_STEP(cat, name, id) voip_trace::flow_step(cat, name, id)
+#define VOIP_TRACE_FLOW_END(cat, name, id) voip_trace::flow_end(cat, name, id)
+#define VOIP_TRACE_THREAD_NAME(name) voip_trace::set_thread_name(name)
+
+#else
+
+#define VOIP_TRACE_SCOPE(cat, name) do {} while (0)
+#define VOIP_TRACE_SCOPE_ARG(cat, name, arg) do {} while (0)
+#define VOIP_TRACE_INSTANT(cat, name, arg) do {} while (0)
+#define VOIP_TRACE_NOW_US() 0
+#define VOIP_TRACE_COMPLETE(cat, name, start_us, dur_us, arg) do {} while (0)
+#define VOIP_TRACE_FLOW_BEGIN(cat, name, id) do {} while (0)
+#define VOIP_TRACE_FLOW_STEP(cat, name, id) do {} while (0)
+#define VOIP_TRACE_FLOW_END(cat, name, id) do {} while (0)
+#define VOIP_TRACE_THREAD_NAME(name) do {} while (0)
+
+#endif
@@ -0,0 +1,69 @@
+package fr.celya.celyavox
+
+import java.nio.ByteBuffer
+import java.nio.ByteOrder
+
+/**
+ * One record of the native call log (voip_cdr.h), persisted by the engine when the call
+ * ended, whether or not the app was running a UI at the time.
+ */
+data class CallLogEntry(
+    val sequence: Long,
+    val callId: Int,
+    val incoming: Boolean,
+    val number: String,
+    val displayName: String,
+    val statusCode: Int,
+    val reason: String,
+    val startedAtMs: Long,
+    val setupMs: Long,
+    val talkMs: Long
+) {
+    fun toMap(): Map<String, Any> = mapOf(
+        "sequence" to sequence,
+        "callId" to callId.toString(),
+        "direction" to if (incoming) "incoming" else "outgoing",
+        "number" to number,
+        "displayName" to displayName,
+        "statusCode" to statusCode,
+        "reason" to reason,
+        "startedAt" to startedAtMs,
+        "setupMs" to setupMs,
+        "talkMs" to talkMs
+    )
+
+    companion object {
+        private const val RECORD_SIZE = 256
+
+        /** Decodes nativeGetRecentCalls(): back-to-back 256-byte records, newest first. */
+        fun decodeAll(bytes: ByteArray): List<CallLogEntry> {
+            val buffer = ByteBuffer.wrap(bytes).order(ByteOrder.LITTLE_ENDIAN)
+            val entries = ArrayList<CallLogEntry>(bytes.size / RECORD_SIZE)
+            var pos = 0
+            while (pos + RECORD_SIZE <= bytes.size) {
+                entries.add(
+                    CallLogEntry(
+                        sequence = buffer.getLong(pos),
+                        startedAtMs = buffer.getLong(pos + 8),
+                        setupMs = buffer.getLong(pos + 16),
+                        talkMs = buffer.getLong(pos + 24),
+                        callId = buffer.getInt(pos + 32),
+                        statusCode = buffer.getInt(pos + 36),
+                        incoming = buffer.get(pos + 40).toInt() != 0,
+                        number = cString(bytes, pos + 48, 64),
+                        displayName = cString(bytes, pos + 112, 64),
+                        reason = cString(bytes, pos + 176, 80)
+                    )
+                )
+                pos += RECORD_SIZE
+            }
+            return entries
+        }
+
+        private fun cString(bytes: ByteArray, offset: Int, size: Int): String {
+            var end = offset
+            while (end < offset + size && bytes[end].toInt() != 0) end++
+            return String(bytes, offset, end - offset, Charsets.UTF_8)
+        }
+    }
+}
@@ -0,0 +1,65 @@
+package fr.celya.celyavox
+
+/**
+ * Native per-call record (nativeGetCallRecord()): caller identity parsed once from the
+ * INVITE, direction and the timeline of the call. Still readable after call_ended, until
+ * the call slot is reused.
+ */
+data class CallRecord(
+    val incoming: Boolean,
+    val displayName: String,
+    val number: String,
+    val remoteInfo: String,
+    val state: String,
+    val startedAtMs: Long,
+    val ended: Boolean,
+    val endStatus: Int,
+    val endReason: String,
+    val timeline: List<Mark>
+) {
+
+    /** One timeline entry: [atUs] after the INVITE, [kind] "state", "media", "accept"... */
+    data class Mark(val atUs: Long, val kind: String, val value: String)
+
+    /** "Alice (100)", as shown in the call UI and notifications. */
+    val callerId: String
+        get() = when {
+            displayName.isNotBlank() && number.isNotBlank() -> "$displayName ($number)"
+            displayName.isNotBlank() -> displayName
+            number.isNotBlank() -> number
+            else -> remoteInfo.trim()
+        }
+
+    companion object {
+        /** Parses the "key value" / "mark ..." lines; null for an empty or unknown slot. */
+        fun parse(text: String?): CallRecord? {
+            if (text.isNullOrEmpty()) return null
+            val fields = HashMap<String, String>()
+            val marks = ArrayList<Mark>()
+            for (line in text.lineSequence()) {
+                if (line.isEmpty()) continue
+                val key = line.substringBefore(' ')
+                val value = line.substringAfter(' ', "")
+                if (key == "mark") {
+                    val parts = value.split(' ', limit = 3)
+                    if (parts.size == 3) marks.add(Mark(parts[0].toLongOrNull() ?: 0L, parts[1], parts[2]))
+                } else {
+                    fields[key] = value
+                }
+            }
+            val direction = fields["direction"] ?: return null
+            return CallRecord(
+                incoming = direction == "incoming",
+                displayName = fields["display_name"].orEmpty(),
+                number = fields["number"].orEmpty(),
+                remoteInfo = fields["remote_info"].orEmpty(),
+                state = fields["state"].orEmpty(),
+                startedAtMs = fields["started_ms"]?.toLongOrNull() ?: 0L,
+                ended = fields["ended"] == "1",
+                endStatus = fields["end_status"]?.toIntOrNull() ?: 0,
+                endReason = fields["end_reason"].orEmpty(),
+                timeline = marks
+            )
+        }
+    }
+}
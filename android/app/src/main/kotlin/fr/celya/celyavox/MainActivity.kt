@@ -5,6 +5,7 @@ import android.content.BroadcastReceiver
 import android.content.ComponentCallbacks2
 import android.content.Intent
 import android.content.IntentFilter
+import android.content.pm.ApplicationInfo
 import android.content.pm.PackageManager
 import android.net.Uri
 import android.app.NotificationManager
@@ -74,6 +75,8 @@ class MainActivity : FlutterActivity() {
         Log.i(TAG, "onCreate keepOverLockscreenForCall=$keepOverLockscreenForCall")
         handleBackgroundLaunchIntent(intent)
         handleNavigationIntent(intent)
+        handlePgoWorkloadIntent(intent)
+        handleSoakIntent(intent)
         registerScreenStateReceiver()
         if (Build.VERSION.SDK_INT >= Build.VERSION_CODES.TIRAMISU) {
             registerReceiver(
@@ -365,6 +368,43 @@ class MainActivity : FlutterActivity() {
         Log.i(TAG, "Background launch flag received")
     }
 
+    // android/pjsip/pgo.sh starts the activity with EXTRA_PGO_WORKLOAD: the instrumented build
+    // runs the training workload, the baseline and optimised builds the benchmarks they are
+    // compared on, any other build ignores it
+    private fun handlePgoWorkloadIntent(sourceIntent: Intent?) {
+        val intent = sourceIntent ?: return
+        val iterations = intent.getIntExtra(EXTRA_PGO_WORKLOAD, 0)
+        if (iterations <= 0) return
+        intent.removeExtra(EXTRA_PGO_WORKLOAD)
+        val engine = PjsipEngine.instance
+        val appContext = applicationContext
+        when (engine.pgoMode()) {
+            "generate" -> Thread({ engine.runPgoWorkload(appContext, iterations) }, "pgo-workload").start()
+            "baseline", "use" -> Thread({ engine.runPgoBenchmarks(appContext, iterations) }, "pgo-benchmarks").start()
+            else -> Log.w(TAG, "PGO workload requested on a non-PGO build; ignored")
+        }
+    }
+
+    // android/soak/soak.sh starts the activity with EXTRA_SOAK_PBX; release builds ignore it
+    private fun handleSoakIntent(sourceIntent: Intent?) {
+        val intent = sourceIntent ?: return
+        val pbx = intent.getStringExtra(EXTRA_SOAK_PBX) ?: return
+        intent.removeExtra(EXTRA_SOAK_PBX)
+        if ((applicationInfo.flags and ApplicationInfo.FLAG_DEBUGGABLE) == 0) {
+            Log.w(TAG, "Soak run requested on a release build; ignored")
+            return
+        }
+        val defaults = SoakRunner.Config(pbx)
+        val config = defaults.copy(
+            buddies = intent.getIntExtra(EXTRA_SOAK_BUDDIES, defaults.buddies),
+            stormSeconds = intent.getIntExtra(EXTRA_SOAK_STORM_SECONDS, defaults.stormSeconds),
+            cycles = intent.getIntExtra(EXTRA_SOAK_CYCLES, defaults.cycles),
+            restarts = intent.getIntExtra(EXTRA_SOAK_RESTARTS, defaults.restarts)
+        )
+        val runner = SoakRunner(applicationContext, PjsipEngine.instance, config)
+        Thread({ runner.run() }, "soak").start()
+    }
+
     private fun onCallEndedFromNative(source: String) {
         if (!wasLockscreenCallSession) {
             Log.i(TAG, "$source received with no lockscreen session; keeping app foreground")
@@ -498,5 +538,11 @@ class MainActivity : FlutterActivity() {
         const val EXTRA_FROM_ACCEPTED_CALL = "fromAcceptedCall"
         const val EXTRA_ACCEPTED_CALL_ID = "acceptedCallId"
         const val EXTRA_BACKGROUND_LAUNCH = "backgroundLaunch"
+        const val EXTRA_PGO_WORKLOAD = "pgoWorkload"
+        const val EXTRA_SOAK_PBX = "soakPbx"
+        const val EXTRA_SOAK_BUDDIES = "soakBuddies"
+        const val EXTRA_SOAK_STORM_SECONDS = "soakStormSeconds"
+        const val EXTRA_SOAK_CYCLES = "soakCycles"
+        const val EXTRA_SOAK_RESTARTS = "soakRestarts"
     }
 }
@@ -0,0 +1,212 @@
+package fr.celya.celyavox
+
+import java.nio.ByteBuffer
+import java.nio.ByteOrder
+
+/**
+ * Events of the native engine, decoded once from the shared binary ring (voip_events.h)
+ * or, when the ring is not attached, from the legacy "type" + "message" strings.
+ */
+sealed class NativeEvent {
+    data class IncomingCall(val callId: Int) : NativeEvent()
+    data class OutgoingCall(val callId: Int) : NativeEvent()
+    data class CallRinging(val callId: Int) : NativeEvent()
+    /** [acceptToOkUs]: accept command -> 200 OK sent, for incoming calls answered here (0 otherwise). */
+    data class CallConnected(val callId: Int, val acceptToOkUs: Long = 0) : NativeEvent()
+    data class CallEnded(val callId: Int, val statusCode: Int, val reason: String) : NativeEvent()
+    data class CallError(val status: Int, val message: String) : NativeEvent()
+    data class Registration(val accountId: Int, val statusCode: Int, val statusText: String) : NativeEvent() {
+        /** "200 OK", as the legacy registration message. */
+        val message: String get() = if (statusText.isEmpty()) "$statusCode" else "$statusCode $statusText"
+    }
+    data class PresenceUpdated(val buddyId: Int, val contact: String, val state: String) : NativeEvent()
+    /** [contact] could not be subscribed, e.g. the native buddy table is full; [status] is the pj_status_t. */
+    data class PresenceError(val contact: String, val status: Int, val reason: String) : NativeEvent()
+    /** [result]: what the command produced (call id of make_call) or the pj_status_t it failed with; -1 if none. */
+    data class CommandCompleted(
+        val requestId: Long,
+        val name: String,
+        val ok: Boolean,
+        val queueWaitUs: Long,
+        val execUs: Long,
+        val result: Int = -1
+    ) : NativeEvent()
+    object Benchmark : NativeEvent()
+    /** CDR emitted after CallEnded: [setupMs] to answer (or to the end if unanswered), [talkMs] once answered. */
+    data class CallSummary(
+        val callId: Int,
+        val incoming: Boolean,
+        val number: String,
+        val statusCode: Int,
+        val startedAtMs: Long,
+        val setupMs: Long,
+        val talkMs: Long
+    ) : NativeEvent()
+
+    companion object {
+        /** Parses the pre-ring string events; null for malformed or unknown ones. */
+        fun fromLegacy(type: String, message: String): NativeEvent? {
+            return when (type) {
+                "incoming_call" -> message.toIntOrNull()?.let { IncomingCall(it) }
+                "outgoing_call" -> message.toIntOrNull()?.let { OutgoingCall(it) }
+                "call_ringing" -> message.toIntOrNull()?.let { CallRinging(it) }
+                "call_connected" -> message.toIntOrNull()?.let { CallConnected(it) }
+                "call_ended" -> {
+                    // "callId|status reason"
+                    val parts = message.split("|", limit = 2)
+                    val callId = parts[0].toIntOrNull() ?: return null
+                    val status = parts.getOrNull(1).orEmpty()
+                    CallEnded(callId, status.substringBefore(' ').toIntOrNull() ?: 0, status.substringAfter(' ', ""))
+                }
+                "call_error" -> CallError(0, message)
+                "registration" -> {
+                    // "status text"
+                    val code = message.substringBefore(' ').toIntOrNull() ?: return null
+                    Registration(-1, code, message.substringAfter(' ', ""))
+                }
+                "presence_updated" -> {
+                    // "contact:state"; the state never contains ':' but a sip: contact does
+                    val idx = message.lastIndexOf(':')
+                    if (idx <= 0) null else PresenceUpdated(-1, message.substring(0, idx), message.substring(idx + 1))
+                }
+                "command_completed" -> {
+                    // "id|name|ok|wait_us|exec_us|result"
+                    val parts = message.split("|")
+                    if (parts.size < 5) return null
+                    val requestId = parts[0].toLongOrNull() ?: return null
+                    CommandCompleted(
+                        requestId, parts[1], parts[2] == "1", parts[3].toLongOrNull() ?: 0L, parts[4].toLongOrNull() ?: 0L,
+                        parts.getOrNull(5)?.toIntOrNull() ?: -1
+                    )
+                }
+                // Same shape as call_ended, parsed the same way so both paths do comparable work
+                "benchmark" -> fromLegacy("call_ended", message)?.let { Benchmark }
+                "call_summary" -> {
+                    // "id|status|direction|start_ms|setup_ms|talk_ms|number"
+                    val parts = message.split("|", limit = 7)
+                    if (parts.size < 7) return null
+                    val callId = parts[0].toIntOrNull() ?: return null
+                    CallSummary(
+                        callId, parts[2] == "incoming", parts[6], parts[1].toIntOrNull() ?: 0,
+                        parts[3].toLongOrNull() ?: 0L, parts[4].toLongOrNull() ?: 0L, parts[5].toLongOrNull() ?: 0L
+                    )
+                }
+                "presence_error" -> {
+                    // "status|contact|reason"
+                    val parts = message.split("|", limit = 3)
+                    if (parts.size < 3) return null
+                    PresenceError(parts[1], parts[0].toIntOrNull() ?: 0, parts[2])
+                }
+                else -> null
+            }
+        }
+    }
+}
+
+/**
+ * Reader side of the native event ring, over the direct ByteBuffer returned by
+ * nativeAttachEventRing(). See voip_events.h for the layout.
+ */
+class NativeEventRing private constructor(private val buffer: ByteBuffer, private val capacity: Int) {
+
+    private var readCursor = 0L
+    private var scratch = ByteArray(256)
+
+    /**
+     * Decodes every record below writeCursor, passing each to sink, and returns the new read
+     * cursor for the native side. The cursor is advanced before sink runs, so a sink that
+     * re-enters (an event emitted synchronously from a native call) does not see it twice.
+     */
+    @Synchronized
+    fun drain(writeCursor: Long, sink: (NativeEvent) -> Unit): Long {
+        while (readCursor < writeCursor) {
+            val offset = HEADER_SIZE + (readCursor and (capacity - 1).toLong()).toInt()
+            val size = buffer.getShort(offset).toInt() and 0xffff
+            if (size < 4 || size > capacity) {
+                // Corrupted ring: skip to what the writer published rather than loop forever
+                readCursor = writeCursor
+                break
+            }
+            val event = decode(offset)
+            readCursor += size
+            if (event != null) sink(event)
+        }
+        return readCursor
+    }
+
+    private fun decode(offset: Int): NativeEvent? {
+        val type = buffer.get(offset + 2).toInt() and 0xff
+        val stringCount = buffer.get(offset + 3).toInt() and 0xff
+        val id = buffer.getInt(offset + 8)
+        val code = buffer.getInt(offset + 12)
+        var pos = offset + RECORD_HEADER_SIZE
+        val strings = Array(stringCount) {
+            val len = buffer.getShort(pos).toInt() and 0xffff
+            val s = readString(pos + 2, len)
+            pos += 2 + len
+            s
+        }
+        fun str(i: Int) = strings.getOrElse(i) { "" }
+        return when (type) {
+            EV_INCOMING_CALL -> NativeEvent.IncomingCall(id)
+            EV_OUTGOING_CALL -> NativeEvent.OutgoingCall(id)
+            EV_CALL_RINGING -> NativeEvent.CallRinging(id)
+            EV_CALL_CONNECTED -> NativeEvent.CallConnected(id, buffer.getLong(offset + 24))
+            EV_CALL_ENDED -> NativeEvent.CallEnded(id, code, str(0))
+            EV_CALL_ERROR -> NativeEvent.CallError(code, str(0))
+            EV_REGISTRATION -> NativeEvent.Registration(id, code, str(0))
+            EV_PRESENCE_UPDATED -> NativeEvent.PresenceUpdated(id, str(0), str(1))
+            EV_PRESENCE_ERROR -> NativeEvent.PresenceError(str(0), code, str(1))
+            EV_COMMAND_COMPLETED -> NativeEvent.CommandCompleted(
+                buffer.getLong(offset + 24), str(0), code != 0, buffer.getLong(offset + 32), buffer.getLong(offset + 40), id
+            )
+            EV_BENCHMARK -> NativeEvent.Benchmark
+            EV_CALL_SUMMARY -> NativeEvent.CallSummary(
+                id, str(0) == "incoming", str(1), code,
+                buffer.getLong(offset + 24), buffer.getLong(offset + 32), buffer.getLong(offset + 40)
+            )
+            else -> null  // PAD, or a type newer than this reader
+        }
+    }
+
+    private fun readString(pos: Int, len: Int): String {
+        if (len == 0) return ""
+        if (scratch.size < len) scratch = ByteArray(len)
+        val view = buffer.duplicate()
+        view.position(pos)
+        view.get(scratch, 0, len)
+        return String(scratch, 0, len, Charsets.UTF_8)
+    }
+
+    companion object {
+        const val SCHEMA_VERSION = 1
+        private const val MAGIC = 0x54564556  // "VEVT"
+        private const val HEADER_SIZE = 64
+        private const val RECORD_HEADER_SIZE = 48
+
+        private const val EV_INCOMING_CALL = 1
+        private const val EV_OUTGOING_CALL = 2
+        private const val EV_CALL_RINGING = 3
+        private const val EV_CALL_CONNECTED = 4
+        private const val EV_CALL_ENDED = 5
+        private const val EV_CALL_ERROR = 6
+        private const val EV_REGISTRATION = 7
+        private const val EV_PRESENCE_UPDATED = 8
+        private const val EV_COMMAND_COMPLETED = 9
+        private const val EV_BENCHMARK = 10
+        private const val EV_CALL_SUMMARY = 11
+        private const val EV_PRESENCE_ERROR = 12
+
+        /** Validates the header; null if the buffer does not hold a ring of this schema. */
+        fun wrap(raw: ByteBuffer): NativeEventRing? {
+            val buffer = raw.order(ByteOrder.LITTLE_ENDIAN)
+            if (buffer.capacity() < HEADER_SIZE) return null
+            if (buffer.getInt(0) != MAGIC) return null
+            if ((buffer.getShort(4).toInt() and 0xffff) != SCHEMA_VERSION) return null
+            if ((buffer.getShort(6).toInt() and 0xffff) != HEADER_SIZE) return null
+            val capacity = buffer.getInt(8)
+            if (capacity <= 0 || capacity and (capacity - 1) != 0 || HEADER_SIZE + capacity > buffer.capacity()) return null
+            return NativeEventRing(buffer, capacity)
+        }
+    }
+}
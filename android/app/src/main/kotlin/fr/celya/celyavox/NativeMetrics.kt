@@ -0,0 +1,70 @@
+package fr.celya.celyavox
+
+/**
+ * Decoded view of one nativeSnapshotMetrics() buffer. Counters are cumulative since process
+ * start; compute rates by diffing two snapshots. Histogram buckets are log-linear
+ * (2^subBits buckets per power of two), so percentiles are approximate to ~12%.
+ */
+class NativeMetricsSnapshot private constructor(
+    val timestampUs: Long,
+    val counters: Map<String, Long>,
+    val gauges: Map<String, Long>,
+    val histograms: Map<String, Histogram>
+) {
+
+    class Histogram(val count: Long, val sum: Long, val max: Long, private val buckets: LongArray, private val subBits: Int) {
+        val mean: Double get() = if (count == 0L) 0.0 else sum.toDouble() / count
+
+        /** Upper bound of the bucket holding quantile q (0.0..1.0). */
+        fun percentile(q: Double): Long {
+            if (count == 0L) return 0
+            val target = (q * count).toLong().coerceIn(1, count)
+            var seen = 0L
+            for (i in buckets.indices) {
+                seen += buckets[i]
+                if (seen >= target) return minOf(bucketUpperBound(i), max)
+            }
+            return max
+        }
+
+        private fun bucketUpperBound(index: Int): Long {
+            val sub = 1 shl subBits
+            if (index < sub) return index.toLong()
+            val exp = (index - sub) / sub + subBits
+            val offset = (index - sub) % sub
+            return ((sub + offset + 1).toLong() shl (exp - subBits)) - 1
+        }
+    }
+
+    companion object {
+        private const val SUPPORTED_VERSION = 1L
+        private const val HEADER_SIZE = 7
+
+        fun decode(raw: LongArray, names: List<String>): NativeMetricsSnapshot? {
+            if (raw.size < HEADER_SIZE || raw[0] != SUPPORTED_VERSION) return null
+            val counterCount = raw[2].toInt()
+            val gaugeCount = raw[3].toInt()
+            val histCount = raw[4].toInt()
+            val bucketCount = raw[5].toInt()
+            val subBits = raw[6].toInt()
+            if (names.size != counterCount + gaugeCount + histCount) return null
+            if (raw.size != HEADER_SIZE + counterCount + gaugeCount + histCount * (3 + bucketCount)) return null
+
+            var pos = HEADER_SIZE
+            val counters = LinkedHashMap<String, Long>(counterCount)
+            for (i in 0 until counterCount) counters[names[i]] = raw[pos++]
+            val gauges = LinkedHashMap<String, Long>(gaugeCount)
+            for (i in 0 until gaugeCount) gauges[names[counterCount + i]] = raw[pos++]
+            val histograms = LinkedHashMap<String, Histogram>(histCount)
+            for (i in 0 until histCount) {
+                val count = raw[pos++]
+                val sum = raw[pos++]
+                val max = raw[pos++]
+                val buckets = raw.copyOfRange(pos, pos + bucketCount)
+                pos += bucketCount
+                histograms[names[counterCount + gaugeCount + i]] = Histogram(count, sum, max, buckets, subBits)
+            }
+            return NativeMetricsSnapshot(raw[1], counters, gauges, histograms)
+        }
+    }
+}
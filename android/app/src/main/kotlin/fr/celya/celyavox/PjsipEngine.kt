@@ -1,25 +1,53 @@
 package fr.celya.celyavox
 
 import androidx.annotation.Keep
+import android.content.Context
+import android.net.ConnectivityManager
+import android.net.LinkProperties
+import android.net.Network
+import android.net.NetworkCapabilities
+import android.net.NetworkRequest
+import android.os.Build
 import android.util.Log
+import java.io.File
+import java.net.Inet4Address
+import java.net.Inet6Address
+import java.nio.ByteBuffer
 import java.util.concurrent.atomic.AtomicBoolean
 
 class PjsipEngine private constructor() {
 
     interface Callback {
-        fun onEvent(type: String, message: String)
+        fun onNativeEvent(event: NativeEvent)
+    }
+
+    /** Completion of a queued native command (see the request ids returned by the wrappers). */
+    fun interface CommandListener {
+        fun onCommandCompleted(requestId: Long, name: String, ok: Boolean, queueWaitUs: Long, execUs: Long)
     }
 
     companion object {
         private const val TAG = "PjsipEngine"
+        private const val DNS_CACHE_FILE = "sip_dns_cache.txt"
+        private const val TRACE_FILE = "voip_trace.json"
+        private const val SIP_CAPTURE_PCAP_FILE = "sip_capture.pcap"
+        private const val SIP_CAPTURE_TEXT_FILE = "sip_capture.txt"
+        private const val CALL_LOG_FILE = "voip_call_log.bin"
+        private const val PGO_PROFILE_FILE = "voip_engine.profraw"
+        private const val PGO_REPORT_FILE = "pgo_report.txt"
         val instance: PjsipEngine by lazy { PjsipEngine() }
 
         @Volatile
         private var libraryLoaded = false
 
+        /** Wall time of System.loadLibrary("voip_engine"), for benchmarkStartup(). */
+        private var loadLibraryUs = -1L
+
         init {
             try {
+                val start = System.nanoTime()
                 System.loadLibrary("voip_engine")
+                loadLibraryUs = (System.nanoTime() - start) / 1_000
                 libraryLoaded = true
             } catch (t: Throwable) {
                 // On emulators/ABIs without the native lib, avoid crashing; callers will see init=false.
@@ -31,21 +59,95 @@ class PjsipEngine private constructor() {
         @Volatile
         private var callback: Callback? = null
 
+        @Volatile
+        private var commandListener: CommandListener? = null
+
+        @Volatile
+        private var eventRing: NativeEventRing? = null
+
+        @Volatile
+        private var eventTap: ((NativeEvent) -> Boolean)? = null
+
+        // Completion handlers of tracked commands, by request id
+        private val pendingCommands = HashMap<Long, (NativeEvent.CommandCompleted) -> Unit>()
+
+        /**
+         * Queues a native command through [submit] and hands its completion to [onDone] (on the
+         * dispatching thread). The id is stored before the completion can be dispatched.
+         */
+        private fun track(onDone: ((NativeEvent.CommandCompleted) -> Unit)?, submit: () -> Long): Long {
+            if (onDone == null) return submit()
+            synchronized(pendingCommands) {
+                val requestId = submit()
+                if (requestId > 0) pendingCommands[requestId] = onDone
+                return requestId
+            }
+        }
+
+        /** Legacy string events, used until the binary event ring is attached. */
         @Keep
         @JvmStatic
         fun handleNativeEvent(type: String, message: String) {
-            Log.d(TAG, "Native event: $type | $message")
-            callback?.onEvent(type, message)
+            val event = NativeEvent.fromLegacy(type, message)
+            if (event == null) {
+                Log.w(TAG, "Unknown or malformed native event: $type | $message")
+                return
+            }
+            dispatch(event)
+        }
+
+        /** Doorbell of the binary event ring: decodes up to writeCursor, returns the read cursor. */
+        @Keep
+        @JvmStatic
+        fun onNativeEvents(writeCursor: Long): Long {
+            // Rung before init() stored the ring: consume nothing, the next doorbell delivers them
+            val ring = eventRing ?: return 0L
+            return ring.drain(writeCursor, ::dispatch)
+        }
+
+        private fun dispatch(event: NativeEvent) {
+            when (event) {
+                is NativeEvent.Benchmark -> return
+                is NativeEvent.CommandCompleted -> {
+                    // Internal bookkeeping of the native command queue, not forwarded to Flutter
+                    if (!event.ok) {
+                        Log.w(TAG, "Native command #${event.requestId} ${event.name} failed (wait=${event.queueWaitUs}us exec=${event.execUs}us)")
+                    }
+                    commandListener?.onCommandCompleted(event.requestId, event.name, event.ok, event.queueWaitUs, event.execUs)
+                    synchronized(pendingCommands) { pendingCommands.remove(event.requestId) }?.invoke(event)
+                }
+                else -> {
+                    if (eventTap?.invoke(event) == true) return
+                    Log.d(TAG, "Native event: $event")
+                    callback?.onNativeEvent(event)
+                }
+            }
         }
     }
 
     private val initialized = AtomicBoolean(false)
     private val registered = AtomicBoolean(false)
 
+    /** Wall time of the first successful nativeInit(), for benchmarkStartup(). */
+    @Volatile
+    private var nativeInitUs = -1L
+
     fun setCallback(cb: Callback?) {
         callback = cb
     }
 
+    fun setCommandListener(listener: CommandListener?) {
+        commandListener = listener
+    }
+
+    /**
+     * Sees every native event before the callback, on the dispatching thread; returning true
+     * consumes it (the soak run keeps its own traffic away from the app this way).
+     */
+    fun setEventTap(tap: ((NativeEvent) -> Boolean)?) {
+        eventTap = tap
+    }
+
     fun isRegistered(): Boolean = registered.get()
 
     fun setRegistered(value: Boolean) {
@@ -59,20 +161,370 @@ class PjsipEngine private constructor() {
             return false
         }
         if (initialized.get()) return true
+        val start = System.nanoTime()
         val ok = try {
             nativeInit()
         } catch (t: Throwable) {
             Log.e(TAG, "nativeInit failed", t)
             false
         }
+        if (ok) nativeInitUs = (System.nanoTime() - start) / 1_000
+        if (ok && eventRing == null) {
+            val buffer = nativeAttachEventRing(NativeEventRing.SCHEMA_VERSION)
+            eventRing = buffer?.let { NativeEventRing.wrap(it) }
+            if (buffer != null && eventRing == null) {
+                Log.e(TAG, "Native event ring header not understood, events will be lost")
+            } else if (buffer == null) {
+                Log.w(TAG, "Binary event ring unavailable, using string events")
+            }
+        }
         initialized.set(ok)
         return ok
     }
 
+    /**
+     * Tears the native endpoint down: accounts unregistered, calls hung up, timers cancelled
+     * and media threads joined. Returns once done; init() (or the next command) starts a new
+     * endpoint, and subscribed contacts come back once an account registers on it.
+     */
+    @Synchronized
+    fun destroy(): Boolean {
+        if (!libraryLoaded || !initialized.getAndSet(false)) return false
+        registered.set(false)
+        return try {
+            nativeDestroy()
+        } catch (t: Throwable) {
+            Log.e(TAG, "nativeDestroy failed", t)
+            false
+        }
+    }
+
+    private var dnsNetworkCallback: ConnectivityManager.NetworkCallback? = null
+
+    /**
+     * Pushes the active network's DNS servers (IPv4 and IPv6) to the native resolver so PJSIP
+     * can use SRV lookups (with weighted failover) and a cache persisted across restarts.
+     * Safe to call before or after init(). The first call also watches the default network:
+     * its servers are pushed again whenever it changes (Wi-Fi/mobile handover, new DHCP lease).
+     */
+    @Synchronized
+    fun configureDns(context: Context) {
+        if (!libraryLoaded) return
+        val appContext = context.applicationContext
+        val servers = try {
+            val cm = appContext.getSystemService(ConnectivityManager::class.java)
+            dnsServersOf(cm?.getLinkProperties(cm.activeNetwork))
+        } catch (t: Throwable) {
+            Log.w(TAG, "configureDns: cannot read DNS servers", t)
+            emptyList()
+        }
+        pushDns(appContext, servers)
+        watchDefaultNetwork(appContext)
+    }
+
+    @Synchronized
+    private fun pushDns(context: Context, servers: List<String>) {
+        val cachePath = File(context.filesDir, DNS_CACHE_FILE).absolutePath
+        Log.i(TAG, "configureDns servers=$servers cache=$cachePath")
+        try {
+            nativeConfigureDns(servers.toTypedArray(), cachePath)
+        } catch (t: Throwable) {
+            Log.e(TAG, "nativeConfigureDns failed", t)
+        }
+    }
+
+    // Link-local IPv6 servers need a scope id the native resolver cannot take
+    private fun dnsServersOf(props: LinkProperties?): List<String> =
+        props?.dnsServers
+            ?.filter { it is Inet4Address || (it is Inet6Address && !it.isLinkLocalAddress) }
+            ?.mapNotNull { it.hostAddress?.substringBefore('%') }
+            .orEmpty()
+
+    private fun watchDefaultNetwork(context: Context) {
+        if (dnsNetworkCallback != null) return
+        val cm = context.getSystemService(ConnectivityManager::class.java) ?: return
+        val callback = object : ConnectivityManager.NetworkCallback() {
+            override fun onLinkPropertiesChanged(network: Network, linkProperties: LinkProperties) {
+                // Before API 24 every network with internet reports here, not only the default one
+                if (Build.VERSION.SDK_INT < Build.VERSION_CODES.N && network != cm.activeNetwork) return
+                pushDns(context, dnsServersOf(linkProperties))
+            }
+        }
+        try {
+            if (Build.VERSION.SDK_INT >= Build.VERSION_CODES.N) {
+                cm.registerDefaultNetworkCallback(callback)
+            } else {
+                val request = NetworkRequest.Builder()
+                    .addCapability(NetworkCapabilities.NET_CAPABILITY_INTERNET)
+                    .build()
+                cm.registerNetworkCallback(request, callback)
+            }
+            dnsNetworkCallback = callback
+        } catch (t: Throwable) {
+            Log.w(TAG, "configureDns: cannot watch network changes", t)
+        }
+    }
+
+    /**
+     * Maps the native call log in the app's private directory. Every call ending afterwards
+     * is persisted by the engine itself, also when no UI is running; idempotent.
+     */
+    fun openCallLog(context: Context): Boolean {
+        if (!libraryLoaded) return false
+        return nativeOpenCallLog(File(context.filesDir, CALL_LOG_FILE).absolutePath)
+    }
+
+    /** The [count] most recent calls of the native call log, newest first. */
+    fun getRecentCalls(count: Int): List<CallLogEntry> {
+        if (!libraryLoaded) return emptyList()
+        return CallLogEntry.decodeAll(nativeGetRecentCalls(count))
+    }
+
+    /**
+     * Sets the SDP rewrite rules applied to every local offer/answer, e.g.
+     * "drop-media:text,drop-attr:rtcp,drop-static-rtpmap,prune-to-offer,keep-codecs:PCMA/PCMU/telephone-event,compact-headers".
+     * Null restores the native defaults.
+     */
+    @Synchronized
+    fun setSdpRules(spec: String?) {
+        if (!libraryLoaded) return
+        nativeSetSdpRules(spec)
+    }
+
+    /**
+     * Idle media mode (on by default): 2 s after the last call the conference bridge clock
+     * stops and the media thread parks, so the process sleeps between calls. The next call
+     * resumes them; false keeps the media stack running all the time.
+     */
+    fun setMediaIdleEnabled(enabled: Boolean) {
+        if (!libraryLoaded) return
+        nativeSetMediaIdle(enabled)
+    }
+
+    /**
+     * Process wakeups per second without a call, with the media stack running (idle mode off)
+     * and then parked, [durationMs] each, as "name value" lines; empty while a call is up.
+     * Blocks for twice [durationMs]: call off the main thread.
+     */
+    fun benchmarkIdleWakeups(durationMs: Int = 10_000): String {
+        if (!libraryLoaded || !initialized.get()) return ""
+        val report = nativeBenchmarkIdleWakeups(durationMs)
+        Log.i(TAG, "benchmarkIdleWakeups\n$report")
+        return report
+    }
+
+    /**
+     * Incoming answer path. With [earlyMedia] a 180 is followed by the SDP answer in a 183,
+     * so codecs are negotiated and streams created before the user accepts; the caller hears
+     * a ringback tone and the mic is only bridged on answer. Otherwise (the default) a plain
+     * 180: nothing is pre-negotiated, the SDP answer only goes out with the 200.
+     * [reliableProvisional] offers 100rel/PRACK to accounts registered afterwards.
+     */
+    fun setAnswerMode(earlyMedia: Boolean, reliableProvisional: Boolean) {
+        if (!libraryLoaded) return
+        nativeSetAnswerMode(earlyMedia, reliableProvisional)
+    }
+
+    /**
+     * Echo cancellation in the capture path, applied at the next [refreshAudio]. [mode]: "off",
+     * "speaker" (only while [setSpeakerRoute] reports the loudspeaker) or "always". [tailMs] is
+     * the longest echo path cancelled, [budgetUs] the CPU allowed per 20 ms frame before the
+     * canceller falls back to a plain echo suppressor (0 keeps the defaults).
+     */
+    fun setEchoCanceller(mode: String, tailMs: Int = 0, budgetUs: Int = 0): Boolean {
+        if (!libraryLoaded) return false
+        return nativeSetEchoCanceller(mode, tailMs, budgetUs)
+    }
+
+    /** Whether audio currently plays through the loudspeaker, for the "speaker" echo mode. */
+    fun setSpeakerRoute(speaker: Boolean) {
+        if (!libraryLoaded) return
+        nativeSetSpeakerRoute(speaker)
+    }
+
+    /**
+     * Records the next [seconds] of the echo canceller's input into [farPath] (what was played)
+     * and [nearPath] (the microphone before cancellation), a fixture for [benchmarkEchoCanceller]
+     * and the host tests. Needs an echo canceller mode applied by [refreshAudio]. Returns the
+     * recording's sample rate, 0 when nothing is recorded; [seconds] <= 0 stops a recording.
+     */
+    fun captureEchoFixture(farPath: String, nearPath: String, seconds: Int): Int {
+        if (!libraryLoaded) return 0
+        return nativeCaptureEchoFixture(farPath, nearPath, seconds)
+    }
+
+    /**
+     * Echo canceller cost and ERLE on this device as "name value" lines. [farPath] and [nearPath]
+     * are a recorded fixture (raw mono 16-bit PCM at [clockRate], what was played and what the
+     * microphone captured); empty paths use a synthetic one. Call off the main thread.
+     */
+    fun benchmarkEchoCanceller(farPath: String = "", nearPath: String = "", clockRate: Int = 8000,
+                               tailMs: Int = 0, budgetUs: Int = 0): String {
+        if (!libraryLoaded) return ""
+        val report = nativeBenchmarkEchoCanceller(farPath, nearPath, clockRate, tailMs, budgetUs)
+        Log.i(TAG, "benchmarkEchoCanceller\n$report")
+        return report
+    }
+
+    /**
+     * Media encryption for [username]@[domain], applied when the account is next registered.
+     * [mode]: "off", "optional" or "mandatory"; [keying]: "dtls", "sdes" or both, comma
+     * separated (DTLS-SRTP is offered first). False when the native library was built without
+     * SRTP (VOIP_SRTP) or the arguments are not understood.
+     */
+    fun setAccountSrtp(username: String, domain: String, mode: String, keying: String = "dtls,sdes"): Boolean {
+        if (!libraryLoaded) return false
+        return nativeSetAccountSrtp(username, domain, mode, keying)
+    }
+
+    /**
+     * CPU budget of one encrypted call, in microseconds per second of call: accounts registered
+     * afterwards only offer the SRTP suites whose measured cost fits it (the cheapest one when
+     * none does). Non-positive restores the default.
+     */
+    fun setSrtpBudget(usPerSecond: Int) {
+        if (!libraryLoaded) return
+        nativeSetSrtpBudget(usPerSecond)
+    }
+
+    /**
+     * Per-packet protect/unprotect cost of every SRTP suite on this device, and the resulting
+     * cost per call, as "name value" lines; empty without SRTP. Call off the main thread.
+     */
+    fun benchmarkSrtp(packets: Int = 5_000): String {
+        if (!libraryLoaded) return ""
+        val report = nativeBenchmarkSrtp(packets)
+        Log.i(TAG, "benchmarkSrtp packets=$packets\n$report")
+        return report
+    }
+
+    /**
+     * Engine threading. [sipWorkers]: pjsua SIP worker threads (applied when the endpoint is
+     * created). [mediaClockThread] clocks the conference bridge from the engine's own thread
+     * instead of pjmedia's null sound device between calls, and reports its late ticks
+     * (media.tick_late_us); during calls the sound device callback clocks it, and its late
+     * ticks go to media.device_tick_late_us. [audioPriority] gives the media threads audio-class scheduling,
+     * [cores] ("any", "big", "little") pins them; both apply when those threads next start.
+     */
+    fun setThreadingProfile(sipWorkers: Int = 1, mediaClockThread: Boolean = false, audioPriority: Boolean = false, cores: String = "any"): Boolean {
+        if (!libraryLoaded) return false
+        return nativeSetThreadingProfile(sipWorkers, mediaClockThread, audioPriority, cores)
+    }
+
+    /**
+     * Media tick jitter under synthetic CPU load, default scheduling vs the threading profile,
+     * as "name value" lines. Blocks for twice [durationMs]: call off the main thread.
+     */
+    fun benchmarkMediaTick(durationMs: Int = 5_000, loadThreads: Int = Runtime.getRuntime().availableProcessors()): String {
+        if (!libraryLoaded) return ""
+        val report = nativeBenchmarkMediaTick(durationMs, loadThreads)
+        Log.i(TAG, "benchmarkMediaTick load=$loadThreads\n$report")
+        return report
+    }
+
+    /**
+     * Startup cost of the native engine as "name value" lines: System.loadLibrary and the first
+     * nativeInit() times measured in this process, plus the size of libvoip_engine.so on disk and
+     * mapped. Compare a release (VOIP_SIZE_OPTIMIZED) build against a debug one on the same device.
+     */
+    fun benchmarkStartup(): String {
+        if (!libraryLoaded) return ""
+        val report = buildString {
+            append("startup.load_library_us ").append(loadLibraryUs).append('\n')
+            append("startup.native_init_us ").append(nativeInitUs).append('\n')
+            append(nativeGetLibraryFootprint())
+        }
+        Log.i(TAG, "benchmarkStartup\n$report")
+        return report
+    }
+
+    /** Profile-guided build mode compiled into the native library: off, baseline, generate or use. */
+    fun pgoMode(): String = if (libraryLoaded) nativePgoMode() else "off"
+
+    /**
+     * Instrumented builds only (pgoMode() == "generate"): runs the native PGO training workload
+     * (REGISTER, BLF and call cycle traffic through the loopback transport, G.711 and bridge
+     * ticks) plus the benchmarks of [runPgoBenchmarks], [iterations] times each, then writes
+     * voip_engine.profraw and the "name value" report (pgo_report.txt) to the app's external
+     * files dir, where android/pjsip/pgo.sh pulls them. Blocks for the whole run: call off the
+     * main thread.
+     */
+    fun runPgoWorkload(context: Context, iterations: Int = 1_000): String {
+        if (nativePgoMode() != "generate" || !init()) return ""
+        val report = nativeRunPgoWorkload(iterations) + pgoBenchmarks(iterations)
+        val dir = context.getExternalFilesDir(null) ?: context.filesDir
+        val profile = File(dir, PGO_PROFILE_FILE)
+        Log.i(TAG, "runPgoWorkload profile written=${nativeWritePgoProfile(profile.absolutePath)} file=${profile.absolutePath}")
+        return writePgoReport(dir, "runPgoWorkload iterations=$iterations", report)
+    }
+
+    /**
+     * The benchmarks the baseline and profile-optimised builds are compared on (event dispatch,
+     * echo canceller, SRTP when built in), [iterations] times where they take a count, written
+     * to pgo_report.txt like [runPgoWorkload]. Blocks: call off the main thread.
+     */
+    fun runPgoBenchmarks(context: Context, iterations: Int = 1_000): String {
+        if (!init()) return ""
+        val dir = context.getExternalFilesDir(null) ?: context.filesDir
+        return writePgoReport(dir, "runPgoBenchmarks iterations=$iterations", pgoBenchmarks(iterations))
+    }
+
+    private fun pgoBenchmarks(iterations: Int): String = buildString {
+        for (binary in listOf(true, false)) {
+            val eventsNs = nativeBenchmarkEvents(iterations, binary)
+            append(if (binary) "events.binary_ns " else "events.legacy_ns ")
+                .append(if (eventsNs > 0) eventsNs / iterations else -1L).append('\n')
+        }
+        append(nativeBenchmarkEchoCanceller("", "", 8000, 0, 0))
+        append(nativeBenchmarkSrtp(iterations))
+    }
+
+    private fun writePgoReport(dir: File, what: String, body: String): String {
+        val report = "build.pgo ${nativePgoMode()}\n$body"
+        File(dir, PGO_REPORT_FILE).writeText(report)
+        Log.i(TAG, "$what\n$report")
+        return report
+    }
+
+    /**
+     * Memory profile used when the endpoint is created: "standard" (default: pjsua's call and
+     * port defaults, 1 MiB of pool reuse) or "compact" (3 calls, 8 bridge ports, 256 KiB of
+     * pool reuse). Call before init(); later calls apply after destroy() and the next init().
+     */
+    fun setMemoryProfile(name: String): Boolean {
+        if (!libraryLoaded) return false
+        return nativeSetMemoryProfile(name)
+    }
+
+    /**
+     * Registers user@domain. [proxy] ("host", "host:port" or a SIP URI) becomes the account's
+     * outbound proxy; empty routes directly to the domain. An invalid proxy fails the command.
+     * [onDone] gets the completion of the command (REGISTER sent or not), not the server's answer.
+     */
     @Synchronized
-    fun register(username: String, password: String, domain: String, proxy: String = ""): Boolean {
+    fun register(
+        username: String,
+        password: String,
+        domain: String,
+        proxy: String = "",
+        onDone: ((NativeEvent.CommandCompleted) -> Unit)? = null
+    ): Boolean {
         if (!initialized.get()) init()
-        return nativeRegister(username, password, domain, proxy)
+        return track(onDone) { nativeRegister(username, password, domain, proxy) } > 0
+    }
+
+    /** Makes an already registered account the one used for calls and new BLF subscriptions. */
+    @Synchronized
+    fun setActiveAccount(username: String, domain: String): Boolean {
+        if (!initialized.get()) return false
+        return nativeSetActiveAccount(username, domain) > 0
+    }
+
+    /** Unregisters one account and drops its BLF subscriptions; other accounts are untouched. */
+    @Synchronized
+    fun removeAccount(username: String, domain: String): Boolean {
+        if (!initialized.get()) return false
+        return nativeRemoveAccount(username, domain) > 0
     }
 
     @Synchronized
@@ -83,24 +535,29 @@ class PjsipEngine private constructor() {
             Log.w(TAG, "unregister ignored: engine not initialized")
             return
         }
-        nativeUnregister()
-        Log.i(TAG, "unregister native call dispatched")
+        val requestId = nativeUnregister()
+        Log.i(TAG, "unregister native call queued requestId=$requestId")
     }
 
+    /**
+     * Returns the request id of the queued INVITE, or -1. The call id arrives with "outgoing_call"
+     * and as the [NativeEvent.CommandCompleted.result] handed to [onDone].
+     */
     @Synchronized
-    fun makeCall(number: String): Int {
+    fun makeCall(number: String, onDone: ((NativeEvent.CommandCompleted) -> Unit)? = null): Long {
         if (!initialized.get()) init()
-        return nativeMakeCall(number)
+        return track(onDone) { nativeMakeCall(number) }
     }
 
+    /** True once queued; [onDone] tells whether a sound device (or the null one) was attached. */
     @Synchronized
-    fun refreshAudio(): Boolean {
+    fun refreshAudio(onDone: ((NativeEvent.CommandCompleted) -> Unit)? = null): Boolean {
         if (!initialized.get()) init()
-        return nativeRefreshAudio()
+        return track(onDone) { nativeRefreshAudio() } > 0
     }
 
     @Synchronized
-    fun acceptCall(callId: String): Boolean {
+    fun acceptCall(callId: String, onDone: ((NativeEvent.CommandCompleted) -> Unit)? = null): Boolean {
         val ready = initialized.get()
         Log.i(TAG, "acceptCall requested callId=$callId initialized=$ready")
         if (!ready) {
@@ -108,7 +565,7 @@ class PjsipEngine private constructor() {
             return false
         }
         val ok = try {
-            nativeAcceptCall(callId)
+            track(onDone) { nativeAcceptCall(callId) } > 0
         } catch (t: Throwable) {
             Log.e(TAG, "nativeAcceptCall failed for callId=$callId", t)
             false
@@ -118,7 +575,7 @@ class PjsipEngine private constructor() {
     }
 
     @Synchronized
-    fun hangupCall(callId: String): Boolean {
+    fun hangupCall(callId: String, onDone: ((NativeEvent.CommandCompleted) -> Unit)? = null): Boolean {
         val ready = initialized.get()
         if (!ready) {
             Log.w(TAG, "hangupCall ignored: engine not initialized")
@@ -130,7 +587,7 @@ class PjsipEngine private constructor() {
             return false
         }
         return try {
-            nativeHangupCall(normalized)
+            track(onDone) { nativeHangupCall(normalized) } > 0
         } catch (t: Throwable) {
             Log.e(TAG, "nativeHangupCall failed for callId=$callId", t)
             false
@@ -138,9 +595,15 @@ class PjsipEngine private constructor() {
     }
 
     @Synchronized
-    fun sendDtmf(callId: String, digits: String): Boolean {
+    fun sendDtmf(callId: String, digits: String, onDone: ((NativeEvent.CommandCompleted) -> Unit)? = null): Boolean {
         if (!initialized.get()) return false
-        return nativeSendDtmf(callId, digits)
+        return track(onDone) { nativeSendDtmf(callId, digits) } > 0
+    }
+
+    /** Native record of the call (identity, timeline); null if the slot never held a call. */
+    fun getCallRecord(callId: String): CallRecord? {
+        if (!libraryLoaded) return null
+        return CallRecord.parse(nativeGetCallRecord(callId))
     }
 
     @Synchronized
@@ -162,11 +625,27 @@ class PjsipEngine private constructor() {
     fun subscribePresence(contact: String, prefix: String = ""): Boolean {
         Log.i(TAG, ">>> PjsipEngine.subscribePresence: contact=$contact, prefix=$prefix, initialized=${initialized.get()}")
         if (!initialized.get()) init()
-        val result = nativeSubscribePresence(contact, prefix)
+        val result = nativeSubscribePresence(contact, prefix) > 0
         Log.i(TAG, ">>> PjsipEngine.subscribePresence result: $result")
         return result
     }
 
+    /**
+     * RFC 4662 resource list: one SUBSCRIBE to [listUri] (full SIP URI or user part on the
+     * account domain) for a whole lamp panel. [contacts] are subscribed one by one if the
+     * server refuses the list.
+     */
+    fun subscribePresenceList(listUri: String, contacts: List<String>, prefix: String = ""): Boolean {
+        Log.i(TAG, ">>> PjsipEngine.subscribePresenceList: list=$listUri, ${contacts.size} fallback contact(s), prefix=$prefix")
+        if (!initialized.get()) init()
+        return nativeSubscribePresenceList(listUri, contacts.toTypedArray(), prefix) > 0
+    }
+
+    fun unsubscribePresenceList(): Boolean {
+        if (!initialized.get()) return false
+        return nativeUnsubscribePresenceList() > 0
+    }
+
     @Synchronized
     fun unsubscribePresence(contact: String): Boolean {
         if (!initialized.get()) {
@@ -174,12 +653,12 @@ class PjsipEngine private constructor() {
             return false
         }
         Log.i(TAG, ">>> PjsipEngine.unsubscribePresence: contact=$contact")
-        val result = nativeUnsubscribePresence(contact)
+        val result = nativeUnsubscribePresence(contact) > 0
         Log.i(TAG, ">>> PjsipEngine.unsubscribePresence result: $result")
         return result
     }
 
-    @Synchronized
+    // Served from the native presence cache: no engine lock, no PJSUA call
     fun getPresenceStatus(contact: String): String {
         Log.i(TAG, ">>> PjsipEngine.getPresenceStatus: contact=$contact, initialized=${initialized.get()}")
         if (!initialized.get()) {
@@ -189,16 +668,174 @@ class PjsipEngine private constructor() {
         return nativeGetPresenceStatus(contact)
     }
 
+    /**
+     * Presence entries changed after [sinceVersion] (0 = every live entry) in one JNI call,
+     * for resyncing all BLF lamps after the app was in the background.
+     */
+    fun getPresenceSnapshot(sinceVersion: Long): PresenceSnapshot? {
+        if (!initialized.get()) {
+            Log.w(TAG, ">>> PjsipEngine.getPresenceSnapshot: engine not initialized")
+            return null
+        }
+        return PresenceSnapshot.decode(nativeGetPresenceSnapshot(sinceVersion))
+    }
+
+    /**
+     * Delay before a "ringing" lamp is shown (250 ms by default), so that a call answered or
+     * abandoned within that window never blinks the lamp. 0 publishes ringing immediately.
+     */
+    fun setPresenceDebounce(ms: Int) {
+        if (!libraryLoaded) return
+        nativeSetPresenceDebounce(ms)
+    }
+
+    /**
+     * Native lock contention per domain (endpoint, accounts, presence, calls), one line each:
+     * "name acquisitions contended wait_total_us wait_max_us".
+     */
+    fun getLockStats(): String {
+        if (!libraryLoaded) return ""
+        return nativeGetLockStats()
+    }
+
+    /**
+     * BLF subscription health, one line per contact kept subscribed:
+     * "contact buddy_id sub_state attempts failures terminations resubscribes last_code next_retry_ms".
+     */
+    fun getSubscriptionHealth(): String {
+        if (!libraryLoaded) return ""
+        return nativeGetSubscriptionHealth()
+    }
+
+    /**
+     * Native memory report, one "name value" line each: pool factory usage and its peak,
+     * pool bytes cached for reuse, and call / buddy / bridge port slots against their limits.
+     */
+    fun getMemoryReport(): String {
+        if (!libraryLoaded) return ""
+        return nativeGetMemoryReport()
+    }
+
+    private val metricNames: List<String> by lazy {
+        if (libraryLoaded) nativeGetMetricNames().toList() else emptyList()
+    }
+
+    /** Counters, gauges and latency histograms of the native engine; cheap enough to poll every second. */
+    fun snapshotMetrics(): NativeMetricsSnapshot? {
+        if (!libraryLoaded) return null
+        return try {
+            NativeMetricsSnapshot.decode(nativeSnapshotMetrics(), metricNames)
+        } catch (t: Throwable) {
+            Log.w(TAG, "snapshotMetrics failed", t)
+            null
+        }
+    }
+
+    /**
+     * Dumps the native trace ring (JNI entry points, PJSUA callbacks, lock waits, engine
+     * commands, SIP messages) as Chrome trace JSON, to open in ui.perfetto.dev.
+     * Returns the file, or null when tracing is compiled out (release builds).
+     */
+    fun dumpTrace(context: Context): File? {
+        if (!libraryLoaded) return null
+        val file = File(context.filesDir, TRACE_FILE)
+        val events = nativeDumpTrace(file.absolutePath)
+        Log.i(TAG, "dumpTrace events=$events file=${file.absolutePath}")
+        return if (events >= 0) file else null
+    }
+
+    fun setTraceEnabled(enabled: Boolean) {
+        if (!libraryLoaded) return
+        nativeSetTraceEnabled(enabled)
+    }
+
+    /** Resizes the native SIP capture rings (1 MiB per SIP thread by default); 0 disables capture. */
+    fun configureSipCapture(bytes: Int) {
+        if (!libraryLoaded) return
+        nativeConfigureSipCapture(bytes)
+    }
+
+    /** Writes the captured SIP messages as pcap (Wireshark) or as a plain text dump. */
+    fun exportSipCapture(context: Context, pcap: Boolean = true): File? {
+        if (!libraryLoaded) return null
+        val file = File(context.filesDir, if (pcap) SIP_CAPTURE_PCAP_FILE else SIP_CAPTURE_TEXT_FILE)
+        val messages = nativeExportSipCapture(file.absolutePath)
+        Log.i(TAG, "exportSipCapture messages=$messages file=${file.absolutePath}")
+        return if (messages >= 0) file else null
+    }
+
+    /**
+     * Pushes count synthetic events through the legacy string path, then through the binary
+     * ring, and returns both rates in events per second (debug aid; needs init()).
+     */
+    fun benchmarkEvents(count: Int = 10_000): String? {
+        if (!libraryLoaded || !initialized.get()) return null
+        val summary = "events=$count legacy=${eventRate(count, false)}/s binary=${eventRate(count, true)}/s"
+        Log.i(TAG, "benchmarkEvents $summary")
+        return summary
+    }
+
+    /** Binary ring dispatch rate over count synthetic events, in events per second, or -1. */
+    fun eventDispatchRate(count: Int = 10_000): Long {
+        if (!libraryLoaded || !initialized.get()) return -1L
+        return eventRate(count, true)
+    }
+
+    private fun eventRate(count: Int, binary: Boolean): Long {
+        val ns = nativeBenchmarkEvents(count, binary)
+        return if (ns > 0) count * 1_000_000_000L / ns else -1L
+    }
+
     private external fun nativeInit(): Boolean
-    private external fun nativeRegister(username: String, password: String, domain: String, proxy: String): Boolean
-    private external fun nativeUnregister()
-    private external fun nativeMakeCall(number: String): Int
-    private external fun nativeAcceptCall(callId: String): Boolean
-    private external fun nativeHangupCall(callId: String): Boolean
-    private external fun nativeRefreshAudio(): Boolean
-    private external fun nativeSendDtmf(callId: String, digits: String): Boolean
+    private external fun nativeDestroy(): Boolean
+    private external fun nativeConfigureDns(servers: Array<String>, cachePath: String)
+    private external fun nativeOpenCallLog(path: String): Boolean
+    private external fun nativeGetRecentCalls(count: Int): ByteArray
+    private external fun nativeSetSdpRules(spec: String?)
+    private external fun nativeRegister(username: String, password: String, domain: String, proxy: String): Long
+    private external fun nativeUnregister(): Long
+    private external fun nativeSetActiveAccount(username: String, domain: String): Long
+    private external fun nativeRemoveAccount(username: String, domain: String): Long
+    private external fun nativeMakeCall(number: String): Long
+    private external fun nativeAcceptCall(callId: String): Long
+    private external fun nativeHangupCall(callId: String): Long
+    private external fun nativeRefreshAudio(): Long
+    private external fun nativeSendDtmf(callId: String, digits: String): Long
     private external fun nativeGetCallerInfo(callId: String): String?
-    private external fun nativeSubscribePresence(contact: String, prefix: String): Boolean
-    private external fun nativeUnsubscribePresence(contact: String): Boolean
+    private external fun nativeGetCallRecord(callId: String): String
+    private external fun nativeSubscribePresence(contact: String, prefix: String): Long
+    private external fun nativeUnsubscribePresence(contact: String): Long
+    private external fun nativeSubscribePresenceList(listUri: String, contacts: Array<String>, prefix: String): Long
+    private external fun nativeUnsubscribePresenceList(): Long
     private external fun nativeGetPresenceStatus(contact: String): String
+    private external fun nativeGetPresenceSnapshot(sinceVersion: Long): ByteArray
+    private external fun nativeSetPresenceDebounce(ms: Int)
+    private external fun nativeSetMediaIdle(enabled: Boolean)
+    private external fun nativeBenchmarkIdleWakeups(durationMs: Int): String
+    private external fun nativeSetAnswerMode(earlyMedia: Boolean, reliableProvisional: Boolean)
+    private external fun nativeSetMemoryProfile(name: String): Boolean
+    private external fun nativeSetEchoCanceller(mode: String, tailMs: Int, budgetUs: Int): Boolean
+    private external fun nativeCaptureEchoFixture(farPath: String, nearPath: String, seconds: Int): Int
+    private external fun nativeSetSpeakerRoute(speaker: Boolean)
+    private external fun nativeBenchmarkEchoCanceller(farPath: String, nearPath: String, clockRate: Int, tailMs: Int, budgetUs: Int): String
+    private external fun nativeSetAccountSrtp(username: String, domain: String, mode: String, keying: String): Boolean
+    private external fun nativeSetSrtpBudget(usPerSecond: Int)
+    private external fun nativeBenchmarkSrtp(packets: Int): String
+    private external fun nativeSetThreadingProfile(sipWorkers: Int, mediaClock: Boolean, audioPriority: Boolean, cores: String): Boolean
+    private external fun nativeBenchmarkMediaTick(durationMs: Int, loadThreads: Int): String
+    private external fun nativeGetLibraryFootprint(): String
+    private external fun nativePgoMode(): String
+    private external fun nativeRunPgoWorkload(iterations: Int): String
+    private external fun nativeWritePgoProfile(path: String): Boolean
+    private external fun nativeGetMemoryReport(): String
+    private external fun nativeGetLockStats(): String
+    private external fun nativeGetSubscriptionHealth(): String
+    private external fun nativeSnapshotMetrics(): LongArray
+    private external fun nativeGetMetricNames(): Array<String>
+    private external fun nativeDumpTrace(path: String): Long
+    private external fun nativeSetTraceEnabled(enabled: Boolean)
+    private external fun nativeConfigureSipCapture(bytes: Int)
+    private external fun nativeExportSipCapture(path: String): Long
+    private external fun nativeAttachEventRing(schemaVersion: Int): ByteBuffer?
+    private external fun nativeBenchmarkEvents(count: Int, binary: Boolean): Long
 }
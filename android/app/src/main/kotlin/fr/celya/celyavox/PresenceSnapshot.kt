@@ -0,0 +1,86 @@
+package fr.celya.celyavox
+
+import java.nio.ByteBuffer
+import java.nio.ByteOrder
+
+/**
+ * Decoded nativeGetPresenceSnapshot() buffer: the presence cache entries that changed after
+ * the requested version. Keep [version] and pass it back to get the next delta.
+ */
+class PresenceSnapshot private constructor(val version: Long, val entries: List<Entry>) {
+
+    data class Entry(
+        val contact: String,
+        val state: String,
+        val source: String,
+        val subState: Int,
+        val buddyId: Int,
+        val version: Long,
+        val updatedAtUs: Long,
+        val removed: Boolean,
+        val emitted: Int,
+        val suppressed: Int
+    ) {
+        fun toMap(): Map<String, Any> = mapOf(
+            "contact" to contact,
+            "state" to state,
+            "source" to source,
+            "updatedAtUs" to updatedAtUs,
+            "version" to version,
+            "removed" to removed,
+            "emitted" to emitted,
+            "suppressed" to suppressed
+        )
+    }
+
+    fun toMap(): Map<String, Any> = mapOf(
+        "version" to version,
+        "entries" to entries.map { it.toMap() }
+    )
+
+    companion object {
+        private const val SUPPORTED_FORMAT = 2
+        private const val HEADER_SIZE = 16
+        private const val ENTRY_FIXED_SIZE = 32
+        private val SOURCES = arrayOf("subscription", "basic", "status_text", "notify_body")
+
+        fun decode(raw: ByteArray): PresenceSnapshot? {
+            if (raw.size < HEADER_SIZE) return null
+            val buffer = ByteBuffer.wrap(raw).order(ByteOrder.LITTLE_ENDIAN)
+            if ((buffer.getShort(0).toInt() and 0xffff) != SUPPORTED_FORMAT) return null
+            val count = buffer.getInt(4)
+            val version = buffer.getLong(8)
+            if (count < 0) return null
+
+            val entries = ArrayList<Entry>(count)
+            var pos = HEADER_SIZE
+            repeat(count) {
+                if (pos + ENTRY_FIXED_SIZE > raw.size) return null
+                val entryVersion = buffer.getLong(pos)
+                val updatedAtUs = buffer.getLong(pos + 8)
+                val buddyId = buffer.getInt(pos + 16)
+                val source = buffer.get(pos + 20).toInt() and 0xff
+                val subState = buffer.get(pos + 21).toInt() and 0xff
+                val removed = (buffer.get(pos + 22).toInt() and 1) != 0
+                val emitted = buffer.getInt(pos + 24)
+                val suppressed = buffer.getInt(pos + 28)
+                pos += ENTRY_FIXED_SIZE
+                val contact = readString(raw, buffer, pos) ?: return null
+                pos += 2 + (buffer.getShort(pos).toInt() and 0xffff)
+                val state = readString(raw, buffer, pos) ?: return null
+                pos += 2 + (buffer.getShort(pos).toInt() and 0xffff)
+                entries.add(
+                    Entry(contact, state, SOURCES.getOrElse(source) { "unknown" }, subState, buddyId, entryVersion, updatedAtUs, removed, emitted, suppressed)
+                )
+            }
+            return PresenceSnapshot(version, entries)
+        }
+
+        private fun readString(raw: ByteArray, buffer: ByteBuffer, pos: Int): String? {
+            if (pos + 2 > raw.size) return null
+            val len = buffer.getShort(pos).toInt() and 0xffff
+            if (pos + 2 + len > raw.size) return null
+            return String(raw, pos + 2, len, Charsets.UTF_8)
+        }
+    }
+}
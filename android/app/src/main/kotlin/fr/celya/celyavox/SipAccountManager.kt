@@ -1,10 +1,12 @@
 package fr.celya.celyavox
 
 import android.util.Log
+import java.util.concurrent.ConcurrentHashMap
 import java.util.concurrent.atomic.AtomicReference
 
 /**
  * Manages SIP account lifecycle with PJSIP native engine.
+ * Several accounts can stay registered at once; the current one is used for calls and BLF.
  * All sensitive values (password) are provided at runtime by Flutter.
  */
 class SipAccountManager(private val engine: PjsipEngine = PjsipEngine.instance) {
@@ -16,6 +18,7 @@ class SipAccountManager(private val engine: PjsipEngine = PjsipEngine.instance)
     }
 
     private val currentAccount = AtomicReference<SipAccount?>()
+    private val accounts = ConcurrentHashMap<String, SipAccount>()
     @Volatile
     var listener: Listener? = null
 
@@ -27,6 +30,7 @@ class SipAccountManager(private val engine: PjsipEngine = PjsipEngine.instance)
         // Password must not be logged.
         val ok = engine.register(account.username, account.password, account.domain, account.proxy)
         if (ok) {
+            accounts[keyOf(account)] = account
             currentAccount.set(account)
             listener?.onRegistered()
         } else {
@@ -41,6 +45,32 @@ class SipAccountManager(private val engine: PjsipEngine = PjsipEngine.instance)
         listener?.onUnregistered()
     }
 
+    /**
+     * Switches calls and BLF to another registered account without re-registering it.
+     */
+    fun switchTo(account: SipAccount): Boolean {
+        if (!accounts.containsKey(keyOf(account))) return register(account)
+        val ok = engine.setActiveAccount(account.username, account.domain)
+        if (ok) currentAccount.set(account)
+        return ok
+    }
+
+    /**
+     * Unregisters and forgets one account; the other registered accounts are kept.
+     */
+    fun remove(account: SipAccount): Boolean {
+        val ok = engine.removeAccount(account.username, account.domain)
+        accounts.remove(keyOf(account))
+        if (currentAccount.get()?.let { keyOf(it) } == keyOf(account)) {
+            currentAccount.set(null)
+        }
+        return ok
+    }
+
+    fun registeredAccounts(): List<SipAccount> = accounts.values.toList()
+
+    private fun keyOf(account: SipAccount) = "${account.username}@${account.domain}"
+
     /**
      * Attempt to re-register using last known credentials.
      */
@@ -0,0 +1,399 @@
+package fr.celya.celyavox
+
+import android.content.Context
+import android.os.Debug
+import android.os.SystemClock
+import android.util.Log
+import java.io.File
+import java.util.concurrent.LinkedBlockingQueue
+import java.util.concurrent.TimeUnit
+
+/**
+ * Soak and stress run of the native engine against the stand-in PBX of android/soak (started
+ * by soak.sh through MainActivity, debuggable builds only). Meant for a device or emulator with
+ * no account of its own: it registers its own, and takes every native event while it runs.
+ *
+ *  1. BLF storm: one RFC 4662 list subscription for [Config.buddies] lamps (more than
+ *     PJSUA_MAX_BUDDIES, so per-contact subscriptions are not an option), then the PBX's NOTIFY
+ *     storm. The lamp states the engine ends up with go to soak_blf_states.txt, for soak.sh to
+ *     compare with the last ones the PBX sent.
+ *  2. Buddy churn: per-contact subscriptions added then removed [Config.churnRounds] times.
+ *  3. Accounts: [Config.accounts] accounts registered on the same PBX; each one in turn is made
+ *     active with setActiveAccount(), subscribes its own lamps and places a call. The request-URI
+ *     user of each SUBSCRIBE and INVITE and the account it must go out as go to
+ *     soak_accounts.txt, for soak.sh to compare with the From and digest user the PBX saw.
+ *     Then one account is removed: the other accounts' lamps must stay subscribed, unchanged.
+ *  4. Call cycles: [Config.cycles] x (REGISTER, INVITE answered by the PBX, BYE), on the null
+ *     sound device (refreshAudio() is never called).
+ *  5. Endpoint restarts: [Config.restarts] x (destroy(), init(), REGISTER) with a few lamps
+ *     subscribed, which the engine restores after each registration. Native heap and thread
+ *     count after the last restart must not have grown past the ones after the warm-up.
+ *
+ * Native heap, pjlib pool usage and event dispatch throughput are sampled along the way, and
+ * no re-entrant PJSUA call may have been made under a native domain lock.
+ * soak_report.txt gets "name value" lines, then one "assert.<name> pass|fail" line per check.
+ * The event ring, call detail log and list NOTIFY parser also soak on the host, without
+ * pjproject (ctest -L soak).
+ */
+class SoakRunner(private val context: Context, private val engine: PjsipEngine, private val config: Config) {
+
+    data class Config(
+        val pbx: String,              // host:port of the stand-in PBX as the device reaches it
+        val buddies: Int = 500,
+        val firstLamp: Int = 1000,
+        val listUser: String = "lamps",
+        val stormSeconds: Int = 600,
+        val churnBuddies: Int = 64,   // Within PJSUA_MAX_BUDDIES
+        val churnRounds: Int = 20,
+        val accounts: Int = 3,        // At least 2; the second one is removed
+        val accountLamps: Int = 4,    // Per account, from the top of the lamp range
+        val cycles: Int = 10_000,
+        val holdMs: Long = 100,
+        val restarts: Int = 1_000
+    )
+
+    private class Sample(val label: String, val nativeHeap: Long, val poolBytes: Long, val eventsPerSec: Long)
+
+    private val events = LinkedBlockingQueue<NativeEvent>()
+    private val samples = ArrayList<Sample>()
+    private val report = StringBuilder()
+    private var failures = 0
+
+    @Volatile
+    private var presenceEvents = 0L
+
+    @Volatile
+    private var lastPresenceMs = 0L
+
+    /** Blocks for the whole run (hours with the defaults): call off the main thread. */
+    fun run(): String {
+        Log.i(TAG, "Soak run: $config")
+        engine.setEventTap { event ->
+            if (event is NativeEvent.PresenceUpdated) {
+                presenceEvents++
+                lastPresenceMs = SystemClock.elapsedRealtime()
+            } else {
+                events.offer(event)
+            }
+            true
+        }
+        try {
+            if (!engine.init()) {
+                check("init", false)
+                return finish()
+            }
+            check("register", register())
+            blfStorm()
+            buddyChurn()
+            accountSwitching()
+            callCycles()
+            restartCycles()
+            sample("end")
+            checkBounded("native_heap") { it.nativeHeap }
+            checkBounded("pool_bytes") { it.poolBytes }
+            checkThroughput()
+            stat("locks.held_across_pjsua", counter("locks.held_across_pjsua"))
+            check("locks.no_pjsua_call_under_lock", counter("locks.held_across_pjsua") == 0L)
+            engine.unregister()
+        } finally {
+            engine.setEventTap(null)
+        }
+        return finish()
+    }
+
+    private fun register(): Boolean {
+        if (!engine.register(SOAK_USER, SOAK_USER, config.pbx)) return false
+        return awaitEvent(STEP_TIMEOUT_MS) { it is NativeEvent.Registration && it.statusCode == 200 } != null
+    }
+
+    private fun blfStorm() {
+        val lamps = (0 until config.buddies).map { (config.firstLamp + it).toString() }
+        val before = counter("presence.notify_processed")
+        val start = SystemClock.elapsedRealtime()
+        check("blf.subscribe", engine.subscribePresenceList(config.listUser, lamps))
+        sample("blf.subscribed")
+        // The PBX starts its storm when the list subscription arrives
+        val stormEnd = start + config.stormSeconds * 1_000L
+        while (SystemClock.elapsedRealtime() < stormEnd) {
+            Thread.sleep(SAMPLE_EVERY_MS.coerceAtMost(stormEnd - SystemClock.elapsedRealtime()).coerceAtLeast(1))
+            sample("blf.storm")
+        }
+        // Settled once no lamp moved for a while (debounced emits included)
+        val settleDeadline = SystemClock.elapsedRealtime() + SETTLE_TIMEOUT_MS
+        while (SystemClock.elapsedRealtime() - lastPresenceMs < SETTLE_QUIET_MS &&
+            SystemClock.elapsedRealtime() < settleDeadline
+        ) {
+            Thread.sleep(500)
+        }
+        stat("blf.notify_processed", counter("presence.notify_processed") - before)
+        stat("blf.presence_events", presenceEvents)
+        File(outDir(), BLF_STATES_FILE).writeText(
+            lamps.joinToString("\n", postfix = "\n") { "$it ${engine.getPresenceStatus(it)}" }
+        )
+        check("blf.unsubscribe", engine.unsubscribePresenceList())
+        sample("blf.done")
+    }
+
+    private fun buddyChurn() {
+        val contacts = (0 until config.churnBuddies).map { (config.firstLamp + it).toString() }
+        repeat(config.churnRounds) {
+            contacts.forEach { engine.subscribePresence(it) }
+            Thread.sleep(CHURN_SETTLE_MS)
+            contacts.forEach { engine.unsubscribePresence(it) }
+            Thread.sleep(CHURN_SETTLE_MS)
+        }
+        check("churn.buddies_released", awaitIdle("buddies.active"))
+        sample("churn.done")
+    }
+
+    private fun accountSwitching() {
+        val users = listOf(SOAK_USER) + (2..config.accounts.coerceAtLeast(2)).map { "$SOAK_USER$it" }
+        val lampsOf = users.indices.associate { i ->
+            users[i] to (0 until config.accountLamps).map {
+                (config.firstLamp + config.buddies - 1 - i * config.accountLamps - it).toString()
+            }
+        }
+        val expected = StringBuilder()
+        var registered = true
+        users.drop(1).forEach { user ->
+            registered = engine.register(user, user, config.pbx) &&
+                awaitEvent(STEP_TIMEOUT_MS) { it is NativeEvent.Registration && it.statusCode == 200 } != null &&
+                registered
+        }
+        check("accounts.registered", registered)
+        var calls = 0
+        users.forEachIndexed { i, user ->
+            // Commands run in order on the engine thread: what follows goes out as this account
+            engine.setActiveAccount(user, config.pbx)
+            lampsOf.getValue(user).forEach {
+                engine.subscribePresence(it)
+                expected.append(it).append(' ').append(user).append('
+')
+            }
+            val callee = (ACCOUNT_CALLEE + i).toString()
+            expected.append(callee).append(' ').append(user).append('
+')
+            if (engine.makeCall(callee) < 0) return@forEachIndexed
+            val outgoing = awaitEvent(STEP_TIMEOUT_MS) { it is NativeEvent.OutgoingCall } as NativeEvent.OutgoingCall?
+                ?: return@forEachIndexed
+            val up = awaitEvent(STEP_TIMEOUT_MS) { it is NativeEvent.CallConnected && it.callId == outgoing.callId }
+            engine.hangupCall(outgoing.callId.toString())
+            val ended = awaitEvent(STEP_TIMEOUT_MS) { it is NativeEvent.CallEnded && it.callId == outgoing.callId }
+            if (up != null && ended != null) calls++
+        }
+        File(outDir(), ACCOUNTS_FILE).writeText(expected.toString())
+        check("accounts.calls", calls == users.size)
+        val allLamps = lampsOf.values.flatten()
+        check("accounts.lamps_subscribed", awaitValue("buddies.active", allLamps.size.toLong()))
+        sample("accounts.subscribed")
+
+        val removed = users[1]
+        val kept = lampsOf.filterKeys { it != removed }.values.flatten()
+        val before = kept.associateWith { engine.getPresenceStatus(it) }
+        check("accounts.remove", engine.removeAccount(removed, config.pbx))
+        check("accounts.others_kept", awaitValue("buddies.active", kept.size.toLong()))
+        Thread.sleep(CHURN_SETTLE_MS)
+        check("accounts.others_unchanged", kept.all { engine.getPresenceStatus(it) == before[it] })
+
+        kept.forEach { engine.unsubscribePresence(it) }
+        users.drop(2).forEach { engine.removeAccount(it, config.pbx) }
+        engine.setActiveAccount(SOAK_USER, config.pbx)
+        check("accounts.buddies_released", awaitIdle("buddies.active"))
+        sample("accounts.done")
+    }
+
+    private fun callCycles() {
+        var lost = 0
+        var connected = 0
+        for (cycle in 1..config.cycles) {
+            if (!register()) {
+                lost++
+                continue
+            }
+            if (engine.makeCall(CALLEE) < 0) {
+                lost++
+                continue
+            }
+            val outgoing = awaitEvent(STEP_TIMEOUT_MS) { it is NativeEvent.OutgoingCall } as NativeEvent.OutgoingCall?
+            if (outgoing == null) {
+                lost++
+                awaitIdle("calls.active")
+                continue
+            }
+            val callId = outgoing.callId
+            val up = awaitEvent(STEP_TIMEOUT_MS) { it is NativeEvent.CallConnected && it.callId == callId }
+            if (up != null) {
+                connected++
+                Thread.sleep(config.holdMs)
+            }
+            engine.hangupCall(callId.toString())
+            val ended = awaitEvent(STEP_TIMEOUT_MS) { it is NativeEvent.CallEnded && it.callId == callId }
+            if (up == null || ended == null) {
+                lost++
+                Log.w(TAG, "Soak cycle $cycle: call $callId connected=${up != null} ended=${ended != null}")
+                awaitIdle("calls.active")
+            }
+            if (cycle % SAMPLE_EVERY_CYCLES == 0) sample("calls.$cycle")
+        }
+        stat("calls.cycles", config.cycles.toLong())
+        stat("calls.connected", connected.toLong())
+        stat("calls.lost_transitions", lost.toLong())
+        check("calls.no_lost_transitions", lost == 0)
+        check("calls.slots_released", awaitIdle("calls.active"))
+    }
+
+    private fun restartCycles() {
+        if (config.restarts <= 0) return
+        val warmup = RESTART_WARMUP.coerceAtMost(config.restarts)
+        val lamps = (0 until RESTART_LAMPS).map { (config.firstLamp + it).toString() }
+        lamps.forEach { engine.subscribePresence(it) }
+        var failed = 0
+        var warmHeap = -1L
+        var warmThreads = -1
+        var restored = false
+        for (cycle in 1..config.restarts) {
+            if (!engine.destroy() || !engine.init() || !register()) {
+                failed++
+                Log.w(TAG, "Soak restart $cycle failed")
+                continue
+            }
+            if (cycle == warmup || cycle == config.restarts) {
+                // Measured once the engine has restored the lamps after the registration
+                restored = awaitValue("buddies.active", lamps.size.toLong())
+                val heap = Debug.getNativeHeapAllocatedSize()
+                val threads = threadCount()
+                if (warmHeap < 0) {
+                    warmHeap = heap
+                    warmThreads = threads
+                }
+                stat("restart.$cycle.native_heap", heap)
+                stat("restart.$cycle.threads", threads.toLong())
+            }
+            if (cycle % SAMPLE_EVERY_CYCLES == 0) sample("restart.$cycle")
+        }
+        val heap = Debug.getNativeHeapAllocatedSize()
+        val threads = threadCount()
+        stat("restart.cycles", config.restarts.toLong())
+        stat("restart.failed", failed.toLong())
+        check("restart.all_cycles", failed == 0)
+        check("restart.native_heap_flat", warmHeap >= 0 && heap <= warmHeap + warmHeap / 10 + MEMORY_SLACK_BYTES)
+        check("restart.threads_flat", warmThreads >= 0 && threads <= warmThreads)
+        check("restart.lamps_restored", restored)
+        lamps.forEach { engine.unsubscribePresence(it) }
+        check("restart.buddies_released", awaitIdle("buddies.active"))
+    }
+
+    private fun threadCount(): Int = File("/proc/self/task").list()?.size ?: -1
+
+    private fun awaitEvent(timeoutMs: Long, match: (NativeEvent) -> Boolean): NativeEvent? {
+        val deadline = SystemClock.elapsedRealtime() + timeoutMs
+        while (true) {
+            val left = deadline - SystemClock.elapsedRealtime()
+            if (left <= 0) return null
+            val event = events.poll(left, TimeUnit.MILLISECONDS) ?: return null
+            if (match(event)) return event
+        }
+    }
+
+    /** Waits for a getMemoryReport() slot count to drop back to 0. */
+    private fun awaitIdle(key: String): Boolean = awaitValue(key, 0L)
+
+    private fun awaitValue(key: String, expected: Long): Boolean {
+        val deadline = SystemClock.elapsedRealtime() + STEP_TIMEOUT_MS
+        while (true) {
+            val value = memoryReport()[key] ?: return false
+            if (value == expected) return true
+            if (SystemClock.elapsedRealtime() >= deadline) {
+                Log.w(TAG, "Soak: $key still $value")
+                return false
+            }
+            Thread.sleep(200)
+        }
+    }
+
+    private fun memoryReport(): Map<String, Long> =
+        engine.getMemoryReport().lineSequence().mapNotNull { line ->
+            val parts = line.trim().split(' ')
+            if (parts.size == 2) parts[1].toLongOrNull()?.let { parts[0] to it } else null
+        }.toMap()
+
+    private fun counter(name: String): Long = engine.snapshotMetrics()?.counters?.get(name) ?: 0L
+
+    private fun sample(label: String) {
+        val sample = Sample(
+            label,
+            Debug.getNativeHeapAllocatedSize(),
+            memoryReport()["pool.used_bytes"] ?: -1L,
+            engine.eventDispatchRate(RATE_EVENTS)
+        )
+        samples.add(sample)
+        report.append("sample ").append(label).append(" native_heap=").append(sample.nativeHeap)
+            .append(" pool_bytes=").append(sample.poolBytes).append(" events_per_s=").append(sample.eventsPerSec)
+            .append('\n')
+    }
+
+    // Bounded: the peak over the last third of the run stays within 10% (+1 MiB) of the peak
+    // over the first third, once the BLF list has been subscribed
+    private fun checkBounded(name: String, value: (Sample) -> Long) {
+        val warm = samples.dropWhile { it.label != "blf.subscribed" }.map(value)
+        if (warm.size < 3 || warm.any { it < 0 }) {
+            check("memory.$name", false)
+            return
+        }
+        val third = warm.size / 3
+        val early = warm.take(third).maxOrNull() ?: 0L
+        val late = warm.takeLast(third).maxOrNull() ?: 0L
+        stat("memory.$name.early_peak", early)
+        stat("memory.$name.late_peak", late)
+        check("memory.$name.bounded", late <= early + early / 10 + MEMORY_SLACK_BYTES)
+    }
+
+    // Stable: no sample below 70% of the first one
+    private fun checkThroughput() {
+        val rates = samples.map { it.eventsPerSec }
+        val first = rates.firstOrNull() ?: -1L
+        val min = rates.minOrNull() ?: -1L
+        stat("events.first_per_s", first)
+        stat("events.min_per_s", min)
+        check("events.throughput_stable", first > 0 && min >= first * 7 / 10)
+    }
+
+    private fun stat(name: String, value: Long) {
+        report.append(name).append(' ').append(value).append('\n')
+    }
+
+    private fun check(name: String, ok: Boolean) {
+        if (!ok) failures++
+        report.append("assert.").append(name).append(' ').append(if (ok) "pass" else "fail").append('\n')
+    }
+
+    private fun outDir(): File = context.getExternalFilesDir(null) ?: context.filesDir
+
+    private fun finish(): String {
+        report.append("soak.failures ").append(failures).append('\n')
+        val text = report.toString()
+        File(outDir(), REPORT_FILE).writeText(text)
+        Log.i(TAG, "Soak run done, $failures failure(s)\n$text")
+        return text
+    }
+
+    companion object {
+        private const val TAG = "SoakRunner"
+        private const val REPORT_FILE = "soak_report.txt"
+        private const val BLF_STATES_FILE = "soak_blf_states.txt"
+        private const val ACCOUNTS_FILE = "soak_accounts.txt"
+        private const val SOAK_USER = "soak"
+        private const val CALLEE = "2000"
+        private const val ACCOUNT_CALLEE = 2100  // + account index
+        private const val STEP_TIMEOUT_MS = 10_000L
+        private const val SAMPLE_EVERY_MS = 10_000L
+        private const val SAMPLE_EVERY_CYCLES = 250
+        private const val SETTLE_QUIET_MS = 3_000L
+        private const val SETTLE_TIMEOUT_MS = 120_000L
+        private const val CHURN_SETTLE_MS = 500L
+        private const val RATE_EVENTS = 10_000
+        private const val MEMORY_SLACK_BYTES = 1L shl 20
+        private const val RESTART_LAMPS = 8
+        private const val RESTART_WARMUP = 50
+    }
+}
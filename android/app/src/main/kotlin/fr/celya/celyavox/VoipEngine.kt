@@ -74,6 +74,8 @@ class VoipEngine(
         appContext = context.applicationContext
         // Registration can fail if MANAGE_OWN_CALLS role/permission is not granted; keep app alive.
         VoipConnectionService.registerSelfManaged(appContext!!)
+        sipEngine.configureDns(appContext!!)
+        sipEngine.openCallLog(appContext!!)
         val ok = sipEngine.init()
         if (!ok) {
             Log.e(TAG, "PJSIP init failed (native lib missing or init error); continuing without SIP")
@@ -90,25 +92,32 @@ class VoipEngine(
         stopFcmTokenMonitoring()
     }
 
-    fun register(username: String, password: String, domain: String, proxy: String) {
-        sipEngine.register(username, password, domain, proxy)
+    fun register(
+        username: String,
+        password: String,
+        domain: String,
+        proxy: String,
+        onDone: ((NativeEvent.CommandCompleted) -> Unit)? = null
+    ): Boolean {
+        return sipEngine.register(username, password, domain, proxy, onDone)
     }
 
     fun unregister() {
         sipEngine.unregister()
     }
 
-    fun startCall(callee: String): Int {
+    /** Request id of the queued INVITE or -1; [onDone] gets the call id as its result. */
+    fun startCall(callee: String, onDone: ((NativeEvent.CommandCompleted) -> Unit)? = null): Long {
         Log.i(TAG, "VoipEngine.startCall callee=$callee")
         // Initialize audio for outgoing calls (similar to incoming calls in VoipConnection.startAudio())
         initCallAudio()
         // Activate real audio devices in PJSIP (was using null audio at app startup)
         refreshAudio()
-        return sipEngine.makeCall(callee)
+        return sipEngine.makeCall(callee, onDone)
     }
 
-    fun endCall(callId: String): Boolean {
-        val ok = sipEngine.hangupCall(callId)
+    fun endCall(callId: String, onDone: ((NativeEvent.CommandCompleted) -> Unit)? = null): Boolean {
+        val ok = sipEngine.hangupCall(callId, onDone)
         Log.i(TAG, "VoipEngine.endCall callId=$callId ok=$ok")
         if (!ok) {
             Log.e(TAG, "ERROR: hangupCall failed for callId=$callId - BYE may not be sent!")
@@ -139,18 +148,19 @@ class VoipEngine(
         return ok
     }
 
-    fun acceptCall(callId: String) {
+    fun acceptCall(callId: String, onDone: ((NativeEvent.CommandCompleted) -> Unit)? = null): Boolean {
         Log.i(TAG, "VoipEngine.acceptCall callId=$callId")
         // Initialize audio for incoming calls (same as for outgoing calls)
         initCallAudio()
         // Activate real audio devices in PJSIP
         refreshAudio()
-        val ok = sipEngine.acceptCall(callId)
+        val ok = sipEngine.acceptCall(callId, onDone)
         Log.i(TAG, "VoipEngine.acceptCall result callId=$callId ok=$ok")
+        return ok
     }
 
-    fun refreshAudio(): Boolean {
-        return sipEngine.refreshAudio()
+    fun refreshAudio(onDone: ((NativeEvent.CommandCompleted) -> Unit)? = null): Boolean {
+        return sipEngine.refreshAudio(onDone)
     }
 
     fun subscribePresence(contact: String, prefix: String = "") {
@@ -159,6 +169,11 @@ class VoipEngine(
         Log.i(TAG, ">>> VoipEngine.subscribePresence DONE for $contact")
     }
 
+    fun subscribePresenceList(listUri: String, contacts: List<String>, prefix: String = "") {
+        Log.i(TAG, ">>> VoipEngine.subscribePresenceList: list=$listUri, ${contacts.size} contact(s)")
+        sipEngine.subscribePresenceList(listUri, contacts, prefix)
+    }
+
     fun unsubscribePresence(contact: String) {
         Log.i(TAG, ">>> VoipEngine.unsubscribePresence: contact=$contact")
         sipEngine.unsubscribePresence(contact)
@@ -172,6 +187,10 @@ class VoipEngine(
         return status
     }
 
+    fun getPresenceSnapshot(sinceVersion: Long): PresenceSnapshot? = sipEngine.getPresenceSnapshot(sinceVersion)
+
+    fun getRecentCalls(count: Int): List<CallLogEntry> = sipEngine.getRecentCalls(count)
+
     private fun initCallAudio() {
         val ctx = appContext ?: return
         val audioManager = ctx.getSystemService(Context.AUDIO_SERVICE) as AudioManager
@@ -221,6 +240,7 @@ class VoipEngine(
             audioManager.stopBluetoothSco()
             audioManager.isBluetoothScoOn = false
         }
+        sipEngine.setSpeakerRoute(enabled)
         
         logAudioState(audioManager, "AFTER setSpeakerphone($enabled)")
         Log.i(TAG, ">>> setSpeakerphone($enabled) END\n")
@@ -232,6 +252,7 @@ class VoipEngine(
         audioManager.mode = AudioManager.MODE_IN_COMMUNICATION
         if (enabled) {
             audioManager.isSpeakerphoneOn = false
+            sipEngine.setSpeakerRoute(false)
             audioManager.startBluetoothSco()
             audioManager.isBluetoothScoOn = true
         } else {
@@ -401,8 +422,8 @@ class VoipEngine(
         return device?.productName?.toString()
     }
 
-    fun sendDtmf(callId: String, digits: String): Boolean {
-        return sipEngine.sendDtmf(callId, digits)
+    fun sendDtmf(callId: String, digits: String, onDone: ((NativeEvent.CommandCompleted) -> Unit)? = null): Boolean {
+        return sipEngine.sendDtmf(callId, digits, onDone)
     }
 
     fun startInAppRinging(isOutgoing: Boolean = false) {
@@ -649,17 +670,23 @@ class VoipEngine(
         mainHandler.post { sink.success(event) }
     }
 
-    override fun onEvent(type: String, message: String) {
-        Log.d(TAG, "Native event $type | $message")
-        when (type) {
-            "registration" -> {
+    override fun onNativeEvent(event: NativeEvent) {
+        when (event) {
+            is NativeEvent.Registration -> {
                 // Update SIP registration status based on status code
-                val isRegistered = message.startsWith("200")
+                val isRegistered = event.statusCode == 200
                 sipEngine.setRegistered(isRegistered)
-                Log.i(TAG, "SIP registration status updated: registered=$isRegistered ($message)")
-                emit(mapOf("type" to "registration", "message" to message))
+                Log.i(TAG, "SIP registration status updated: registered=$isRegistered (${event.message})")
+                emit(
+                    mapOf(
+                        "type" to "registration",
+                        "message" to event.message,
+                        "statusCode" to event.statusCode,
+                    )
+                )
             }
-            "incoming_call" -> {
+            is NativeEvent.IncomingCall -> {
+                val callId = event.callId.toString()
                 VoipFirebaseService.cancelInviteWaitFallback()
                 val ctx = appContext
                 if (ctx != null) {
@@ -675,40 +702,39 @@ class VoipEngine(
                 
                 VoipForegroundService.cancelNoInviteTimeout()
                 if (ctx != null) {
-                    // Get CallerID from SIP INVITE (message = callId)
-                    val rawCallerInfo = sipEngine.getCallerInfo(message)
-                    val callerId = parseCallerInfo(rawCallerInfo)
+                    // CallerID parsed natively from the SIP INVITE
+                    val callerId = sipEngine.getCallRecord(callId)?.callerId.orEmpty()
                     // Store CallerID for this call
-                    callerIdMap[message] = callerId
-                    Log.i(TAG, "INCOMING_CALL: callId=$message, callerId=\"$callerId\"")
+                    callerIdMap[callId] = callerId
+                    Log.i(TAG, "INCOMING_CALL: callId=$callId, callerId=\"$callerId\"")
                     
                     // Always notify Flutter about the incoming call
-                    incomingCall(message, callerId)
+                    incomingCall(callId, callerId)
                     
-                    val ok = VoipConnectionService.startIncomingCall(ctx, message, callerId)
+                    val ok = VoipConnectionService.startIncomingCall(ctx, callId, callerId)
                     if (!ok) {
                         val now = System.currentTimeMillis()
                         val recentLaunch = now - CallActivity.lastLaunchAtMs < 10000L
                         if (CallActivity.isVisible) {
-                            if (message.isNotBlank() && CallActivity.visibleCallId != message) {
-                                startIncomingCallActivity(ctx, message, callerId)
+                            if (CallActivity.visibleCallId != callId) {
+                                startIncomingCallActivity(ctx, callId, callerId)
                             }
                             return
                         }
                         if (recentLaunch) {
-                            startIncomingCallActivity(ctx, message, callerId)
+                            startIncomingCallActivity(ctx, callId, callerId)
                             return
                         }
                         if (isAppInForeground(ctx) && !CallActivity.isVisible) {
-                            incomingCall(message, callerId)
+                            incomingCall(callId, callerId)
                             return
                         }
                         if (CallActivity.isVisible) {
                             return
                         }
-                        val launched = startIncomingCallActivity(ctx, message, callerId)
+                        val launched = startIncomingCallActivity(ctx, callId, callerId)
                         if (!launched) {
-                            incomingCall(message, callerId)
+                            incomingCall(callId, callerId)
                         }
                     } else {
                     }
@@ -716,70 +742,81 @@ class VoipEngine(
                     Log.w(TAG, "appContext is null, cannot process incoming call")
                 }
             }
-            "outgoing_call" -> {
+            is NativeEvent.OutgoingCall -> {
                 emit(
                     mapOf(
                         "type" to "outgoing_call",
-                        "callId" to message,
+                        "callId" to event.callId.toString(),
                     )
                 )
             }
-            "call_ringing" -> {
-                Log.i(TAG, "Call RINGING - callId=$message")
+            is NativeEvent.CallRinging -> {
+                Log.i(TAG, "Call RINGING - callId=${event.callId}")
                 emit(
                     mapOf(
                         "type" to "call_ringing",
-                        "callId" to message,
+                        "callId" to event.callId.toString(),
                     )
                 )
             }
-            "call_connected" -> {
-                VoipConnectionService.markCallActive(message)
+            is NativeEvent.CallConnected -> {
+                val callId = event.callId.toString()
+                if (event.acceptToOkUs > 0) Log.i(TAG, ">>> call_connected: callId=$callId accept->200 ${event.acceptToOkUs}us")
+                VoipConnectionService.markCallActive(callId)
                 // Reset FCM wakeup flag since call is now accepted and active
                 VoipFirebaseService.setFcmWakeup(false)
-                callConnected(message)
+                callConnected(callId)
             }
-            "call_ended" -> {
-                val parts = message.split("|", limit = 2)
-                val callId = parts.firstOrNull().orEmpty()
-                val reason = parts.getOrNull(1)
+            is NativeEvent.CallEnded -> {
+                val callId = event.callId.toString()
                 VoipConnectionService.markCallEnded(callId)
-                callEnded(callId, reason)
-            }
-            "call_cancelled" -> {
-                val ctx = appContext
-                if (ctx != null) {
-                    handleCallCancelled(ctx, message)
-                } else {
-                    Log.w(TAG, "appContext is null, cannot handle call cancellation")
-                }
-            }
-            "presence_updated" -> {
-                // Message format: "contact:status" (contact is already provided by native code)
-                Log.i(TAG, ">>> presence_updated event: message=$message")
-                val parts = message.split(":", limit = 2)
-                if (parts.size == 2) {
-                    val contact = parts[0]
-                    val status = parts[1]
-                    Log.i(TAG, ">>> presence_updated: contact=$contact, status=$status")
-                    if (contact.isNotEmpty()) {
-                        emit(
-                            mapOf(
-                                "type" to "presence_state",
-                                "number" to contact,
-                                "state" to status,
-                            )
+                callEnded(callId, "${event.statusCode} ${event.reason}", event.statusCode)
+            }
+            is NativeEvent.PresenceUpdated -> {
+                Log.i(TAG, ">>> presence_updated: contact=${event.contact}, status=${event.state}")
+                if (event.contact.isNotEmpty()) {
+                    emit(
+                        mapOf(
+                            "type" to "presence_state",
+                            "number" to event.contact,
+                            "state" to event.state,
                         )
-                    } else {
-                        Log.w(TAG, ">>> presence_updated: contact empty")
-                    }
+                    )
                 } else {
-                    Log.w(TAG, ">>> presence_updated: invalid format, expected 'contact:status', got '$message'")
+                    Log.w(TAG, ">>> presence_updated: contact empty")
                 }
             }
-            else -> {
-                emit(mapOf("type" to type, "message" to message))
+            is NativeEvent.CallError -> {
+                emit(mapOf("type" to "call_error", "message" to event.message))
+            }
+            is NativeEvent.PresenceError -> {
+                Log.w(TAG, ">>> presence_error: contact=${event.contact}, status=${event.status}, ${event.reason}")
+                emit(
+                    mapOf(
+                        "type" to "presence_error",
+                        "number" to event.contact,
+                        "status" to event.status,
+                        "message" to event.reason,
+                    )
+                )
             }
+            is NativeEvent.CallSummary -> {
+                Log.i(TAG, ">>> call_summary: callId=${event.callId} ${if (event.incoming) "in" else "out"} " +
+                    "${event.number} status=${event.statusCode} setup=${event.setupMs}ms talk=${event.talkMs}ms")
+                emit(
+                    mapOf(
+                        "type" to "call_summary",
+                        "callId" to event.callId.toString(),
+                        "direction" to if (event.incoming) "incoming" else "outgoing",
+                        "number" to event.number,
+                        "statusCode" to event.statusCode,
+                        "startedAt" to event.startedAtMs,
+                        "setupMs" to event.setupMs,
+                        "talkMs" to event.talkMs,
+                    )
+                )
+            }
+            is NativeEvent.CommandCompleted, is NativeEvent.Benchmark -> Unit  // Handled by PjsipEngine
         }
     }
 
@@ -820,7 +857,7 @@ class VoipEngine(
         )
     }
 
-    fun callEnded(callId: String, reason: String? = null) {
+    fun callEnded(callId: String, reason: String? = null, statusCode: Int = 0) {
         appContext?.let { ctx ->
             stopInAppRinging()
             VoipForegroundService.stop(ctx)
@@ -828,14 +865,13 @@ class VoipEngine(
             VoipFirebaseService.cancelSimpleIncomingNotification(ctx)
             
             // Check if this is a call cancellation (487 Request Terminated) and app was woken by FCM
-            val isRequestTerminated = reason?.contains("487") == true
+            val isRequestTerminated = statusCode == 487 || reason?.contains("487") == true
             
             if (isRequestTerminated) {
                 val wasWokenByFcm = VoipFirebaseService.consumeFcmWakeup()
                 if (wasWokenByFcm) {
-                    // Get CallerID from SIP call info and parse it
-                    val rawCallerInfo = sipEngine.getCallerInfo(callId) ?: ""
-                    val callerId = parseCallerInfo(rawCallerInfo)
+                    // The native call record outlives the call
+                    val callerId = sipEngine.getCallRecord(callId)?.callerId.orEmpty()
                     VoipFirebaseService.showCancelledCallNotification(ctx, reason ?: "Appel annulé", callerId)
                     
                     // Send minimize app broadcast after a delay to allow CallActivity to close first
@@ -885,6 +921,7 @@ class VoipEngine(
                 "type" to "call_ended",
                 "callId" to callId,
                 "reason" to reason,
+                "statusCode" to statusCode,
             )
         )
     }
@@ -898,24 +935,6 @@ class VoipEngine(
         )
     }
 
-    private fun handleCallCancelled(context: Context, message: String) {
-        
-        // Only handle cancellation if app was woken up by FCM push
-        val wasWokenByFcm = VoipFirebaseService.consumeFcmWakeup()
-        if (!wasWokenByFcm) {
-            return
-        }
-        
-        // Always show notification for call cancellation after FCM wakeup
-        VoipFirebaseService.showCancelledCallNotification(context, message)
-        
-        // Minimize the app to background
-        val intent = Intent(ACTION_MINIMIZE_APP).apply {
-            setPackage(context.packageName)
-        }
-        context.sendBroadcast(intent)
-    }
-
     private fun startIncomingCallActivity(context: Context, callId: String, callerId: String?): Boolean {
         val intent = Intent(context, CallActivity::class.java).apply {
             flags = Intent.FLAG_ACTIVITY_NEW_TASK or
@@ -966,47 +985,6 @@ class VoipEngine(
         eventSink = null
     }
 
-    /**
-     * Extrait le nom et le numéro du CallerID SIP brut.
-     * Format SIP: "Display Name" <sip:number@domain> ou sip:number@domain
-     * Retourne une string formatée: "Display Name" ou "Number" ou "Display Name (Number)"
-     */
-    private fun parseCallerInfo(rawCallerInfo: String?): String {
-        if (rawCallerInfo.isNullOrBlank()) return ""
-        
-        val info = rawCallerInfo.trim()
-        
-        // Extraire le Display Name (avant <)
-        val displayName = if (info.contains("<")) {
-            val before = info.substringBefore("<").trim()
-            // Supprimer les guillemets
-            before.replace("\"", "").replace("'", "")
-        } else {
-            ""
-        }
-        
-        // Extraire le numéro (entre <...> ou après sip:/tel:)
-        val number = when {
-            info.contains("tel:") -> {
-                // Format: tel:+33612345678 ou <tel:+33612345678>
-                info.substringAfter("tel:").substringBefore(">").substringBefore(";")
-            }
-            info.contains("sip:") -> {
-                // Format: sip:0612345678@example.com ou <sip:0612345678@example.com>
-                info.substringAfter("sip:").substringBefore("@").substringBefore(";")
-            }
-            else -> ""
-        }
-        
-        // Retourner le résultat formaté
-        return when {
-            displayName.isNotBlank() && number.isNotBlank() -> "$displayName ($number)"
-            displayName.isNotBlank() -> displayName
-            number.isNotBlank() -> number
-            else -> info
-        }
-    }
-
     companion object {
         private const val TAG = "VoipEngine"
         const val ACTION_MINIMIZE_APP = "fr.celya.celyavox.MINIMIZE_APP"
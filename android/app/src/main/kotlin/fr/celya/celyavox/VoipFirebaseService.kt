@@ -324,6 +324,8 @@ class VoipFirebaseService : FirebaseMessagingService() {
                     Log.w(TAG, "Skipping SIP register: missing provisioning data")
                     return@Thread
                 }
+                PjsipEngine.instance.configureDns(applicationContext)
+                PjsipEngine.instance.openCallLog(applicationContext)
                 val ok = PjsipEngine.instance.register(username, password, domain, proxy)
                 Log.i(TAG, "SIP register triggered from push: $ok")
             } catch (e: Exception) {
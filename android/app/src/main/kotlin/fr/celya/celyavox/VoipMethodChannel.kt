@@ -3,6 +3,8 @@ package fr.celya.celyavox
 import android.content.Context
 import android.content.Intent
 import android.net.Uri
+import android.os.Handler
+import android.os.Looper
 import android.provider.Settings
 import android.util.Log
 import com.google.firebase.messaging.FirebaseMessaging
@@ -18,6 +20,7 @@ class VoipMethodChannel(
 
     private val appContext: Context = context.applicationContext
     private val channel = MethodChannel(messenger, "voip_engine")
+    private val mainHandler = Handler(Looper.getMainLooper())
     private val provisioningManager: com.celya.voip.provisioning.ProvisioningManager?
     
     init {
@@ -42,8 +45,9 @@ class VoipMethodChannel(
                     val password = requireArgument<String>(call, "password")
                     val domain = requireArgument<String>(call, "domain")
                     val proxy = call.argument<String>("proxy") ?: ""
-                    engine.register(username, password, domain, proxy)
-                    result.success(null)
+                    if (!engine.register(username, password, domain, proxy, completeWith(result, "REGISTER"))) {
+                        result.error("REGISTER", "Native register could not be queued", null)
+                    }
                 }
                 "registerProvisioned" -> {
                     if (provisioningManager == null) {
@@ -68,34 +72,32 @@ class VoipMethodChannel(
                     }
                     
                     android.util.Log.i("VoipMethodChannel", "    >>> Calling engine.register() with proxy='$proxy'")
-                    engine.register(username, password, domain, proxy)
-                    result.success(null)
+                    if (!engine.register(username, password, domain, proxy, completeWith(result, "REGISTER"))) {
+                        result.error("REGISTER", "Native register could not be queued", null)
+                    }
                 }
                 "unregister" -> {
                     engine.unregister()
                     result.success(null)
                 }
                 "makeCall" -> {
+                    // Completed with the pjsua call id once the INVITE is out
                     val callee = requireArgument<String>(call, "callee")
-                    val callId = engine.startCall(callee)
-                    if (callId < 0) {
-                        result.error("CALL", "Native makeCall failed (callId=$callId)", null)
-                        return
+                    val requestId = engine.startCall(callee, completeWith(result, "CALL") { it.result })
+                    if (requestId < 0) {
+                        result.error("CALL", "Native makeCall could not be queued (requestId=$requestId)", null)
                     }
-                    result.success(callId)
                 }
                 "refreshAudio" -> {
-                    val ok = engine.refreshAudio()
-                    if (!ok) {
-                        result.error("AUDIO", "Failed to refresh audio device", null)
-                        return
+                    if (!engine.refreshAudio(completeWith(result, "AUDIO"))) {
+                        result.error("AUDIO", "Native refreshAudio could not be queued", null)
                     }
-                    result.success(null)
                 }
                 "acceptCall" -> {
                     val callId = requireArgument<String>(call, "callId")
-                    engine.acceptCall(callId)
-                    result.success(null)
+                    if (!engine.acceptCall(callId, completeWith(result, "ACCEPT"))) {
+                        result.error("ACCEPT", "Native acceptCall could not be queued (callId=$callId)", null)
+                    }
                 }
                 "startInAppRinging" -> {
                     val isOutgoing = call.argument<Boolean>("isOutgoing") ?: false
@@ -159,17 +161,15 @@ class VoipMethodChannel(
                 "sendDtmf" -> {
                     val callId = requireArgument<String>(call, "callId")
                     val digits = requireArgument<String>(call, "digits")
-                    val ok = engine.sendDtmf(callId, digits)
-                    if (!ok) {
-                        result.error("DTMF", "Failed to send DTMF", null)
-                        return
+                    if (!engine.sendDtmf(callId, digits, completeWith(result, "DTMF"))) {
+                        result.error("DTMF", "Native sendDtmf could not be queued (callId=$callId)", null)
                     }
-                    result.success(null)
                 }
                 "hangupCall" -> {
                     val callId = requireArgument<String>(call, "callId")
-                    engine.endCall(callId)
-                    result.success(null)
+                    if (!engine.endCall(callId, completeWith(result, "HANGUP"))) {
+                        result.error("HANGUP", "Native hangupCall could not be queued (callId=$callId)", null)
+                    }
                 }
                 "subscribePresence" -> {
                     val contact = requireArgument<String>(call, "contact")
@@ -190,6 +190,22 @@ class VoipMethodChannel(
                         }
                     }.start()
                 }
+                "subscribePresenceList" -> {
+                    val listUri = requireArgument<String>(call, "listUri")
+                    val contacts = call.argument<List<String>>("contacts") ?: emptyList()
+                    val prefix = call.argument<String>("prefix") ?: ""
+                    // Queued on the native engine thread, returns immediately
+                    engine.subscribePresenceList(listUri, contacts, prefix)
+                    result.success(null)
+                }
+                "getPresenceSnapshot" -> {
+                    val sinceVersion = call.argument<Number>("sinceVersion")?.toLong() ?: 0L
+                    result.success(engine.getPresenceSnapshot(sinceVersion)?.toMap())
+                }
+                "getRecentCalls" -> {
+                    val count = call.argument<Number>("count")?.toInt() ?: 50
+                    result.success(engine.getRecentCalls(count).map { it.toMap() })
+                }
                 else -> result.notImplemented()
             }
         } catch (e: IllegalArgumentException) {
@@ -203,6 +219,24 @@ class VoipMethodChannel(
         channel.setMethodCallHandler(null)
         engine.dispose()
     }
+
+    /**
+     * Resolves [result] from the completion of the native command it queued: [value] of the
+     * completion on success, [errorCode] with the native status as details on failure.
+     */
+    private fun completeWith(
+        result: MethodChannel.Result,
+        errorCode: String,
+        value: (NativeEvent.CommandCompleted) -> Any? = { null }
+    ): (NativeEvent.CommandCompleted) -> Unit = { done ->
+        mainHandler.post {
+            if (done.ok) {
+                result.success(value(done))
+            } else {
+                result.error(errorCode, "Native ${done.name} failed (status=${done.result})", done.result)
+            }
+        }
+    }
 }
 
 private fun <T> requireArgument(call: MethodCall, key: String): T {
@@ -0,0 +1,85 @@
+// Stand-in resource list server for the voip_rls tests and the RLS NOTIFY soak: keeps the state
+// of each lamp and renders the NOTIFY bodies a RFC 4662 notifier sends for them (RLMI document
+// + one dialog-info part per live resource)
+#pragma once
+
+#include <map>
+#include <string>
+#include <utility>
+#include <vector>
+
+class StandinNotifier {
+public:
+    struct Body {
+        std::string content_type;
+        std::string text;
+    };
+
+    explicit StandinNotifier(std::string boundary = "50UBfW7LSCVLtggUPytvwd") : boundary_(std::move(boundary)) {}
+
+    // "" (no dialog), "trying", "early", "confirmed" or "terminated" dialog; "gone" terminates
+    // the resource's subscription instance
+    void set(const std::string &user, const std::string &dialog_state) { lamps_[user] = dialog_state; }
+
+    Body full_state() {
+        std::vector<std::string> users;
+        for (const auto &lamp : lamps_) users.push_back(lamp.first);
+        return render(users, true);
+    }
+
+    Body partial(const std::vector<std::string> &users) { return render(users, false); }
+
+    const std::string &boundary() const { return boundary_; }
+
+    static std::string dialog_info(const std::string &entity, const std::string &dialog_state, int version = 0) {
+        std::string xml = "<?xml version=\"1.0\" encoding=\"UTF-8\"?>\r\n"
+                          "<dialog-info xmlns=\"urn:ietf:params:xml:ns:dialog-info\" version=\"" +
+                          std::to_string(version) + "\" state=\"full\" entity=\"" + entity + "\">\r\n";
+        if (!dialog_state.empty()) {
+            xml += "  <dialog id=\"as7d900as8\" call-id=\"a84b4c76e66710\" direction=\"recipient\">\r\n"
+                   "    <state>" + dialog_state + "</state>\r\n"
+                   "    <local><identity>" + entity + "</identity><target uri=\"" + entity + "\"/></local>\r\n"
+                   "    <remote><identity>sip:250999@pbx.example</identity></remote>\r\n"
+                   "  </dialog>\r\n";
+        }
+        return xml + "</dialog-info>\r\n";
+    }
+
+private:
+    Body render(const std::vector<std::string> &users, bool full) {
+        std::string rlmi = "<?xml version=\"1.0\" encoding=\"UTF-8\"?>\r\n"
+                           "<list xmlns=\"urn:ietf:params:xml:ns:rlmi\" uri=\"sip:blf-panel@pbx.example\" version=\"" +
+                           std::to_string(version_++) + "\" fullState=\"" + (full ? "true" : "false") + "\">\r\n";
+        std::string parts;
+        for (const auto &user : users) {
+            const std::string uri = "sip:" + user + "@pbx.example;user=phone";
+            const std::string &state = lamps_[user];
+            rlmi += "  <resource uri=\"" + uri + "\">\r\n    <name>Lamp " + user + "</name>\r\n";
+            if (state == "gone") {
+                rlmi += "    <instance id=\"" + user + "\" state=\"terminated\" reason=\"noresource\"/>\r\n";
+            } else {
+                rlmi += "    <instance id=\"" + user + "\" state=\"active\" cid=\"" + user + "@pbx.example\"/>\r\n";
+                parts += "--" + boundary_ + "\r\n"
+                         "Content-Transfer-Encoding: binary\r\n"
+                         "Content-ID: <" + user + "@pbx.example>\r\n"
+                         "Content-Type: application/dialog-info+xml;charset=\"UTF-8\"\r\n\r\n" +
+                         dialog_info(uri, state, version_);
+            }
+            rlmi += "  </resource>\r\n";
+        }
+        rlmi += "</list>\r\n";
+        Body body;
+        body.content_type = "multipart/related;type=\"application/rlmi+xml\";start=\"<nXYxAE@pbx.example>\";"
+                            "boundary=\"" + boundary_ + "\"";
+        body.text = "--" + boundary_ + "\r\n"
+                    "Content-Transfer-Encoding: binary\r\n"
+                    "Content-ID: <nXYxAE@pbx.example>\r\n"
+                    "Content-Type: application/rlmi+xml;charset=\"UTF-8\"\r\n\r\n" +
+                    rlmi + parts + "--" + boundary_ + "--\r\n";
+        return body;
+    }
+
+    std::string boundary_;
+    std::map<std::string, std::string> lamps_;
+    int version_ = 0;
+};
@@ -0,0 +1,155 @@
+#include "voip_aec.h"
+
+#include <gtest/gtest.h>
+
+#include <string>
+#include <vector>
+#include <stdio.h>
+#include <unistd.h>
+
+namespace {
+
+constexpr uint32_t kRate = 8000;
+constexpr uint32_t kFrame = kRate / 50;
+
+std::string temp_path(const char *name) {
+    return std::string(testing::TempDir()) + std::to_string(getpid()) + "." + name;
+}
+
+long file_size(const std::string &path) {
+    FILE *f = fopen(path.c_str(), "rb");
+    if (!f) return -1;
+    fseek(f, 0, SEEK_END);
+    long size = ftell(f);
+    fclose(f);
+    return size;
+}
+
+// A budget no frame reaches, so results only depend on the samples
+voip_aec::Config unhurried() {
+    voip_aec::Config config;
+    config.clock_rate = kRate;
+    config.samples_per_frame = kFrame;
+    config.budget_us = 1000000;
+    return config;
+}
+
+int64_t scalar_dot(const std::vector<int16_t> &w, const std::vector<int16_t> &x) {
+    int64_t sum = 0;
+    for (size_t k = 0; k < w.size(); ++k) sum += (int64_t)w[k] * x[k];
+    return sum;
+}
+
+}  // namespace
+
+TEST(VoipAec, DotKeepsFullScaleProducts) {
+    // Two -32768 * -32768 products already exceed INT32_MAX
+    std::vector<int16_t> w(64, -32768), x(64, -32768);
+    EXPECT_EQ(voip_aec::dot(w.data(), x.data(), 64), 64LL << 30);
+    for (size_t k = 0; k < x.size(); k += 2) x[k] = 32767;
+    EXPECT_EQ(voip_aec::dot(w.data(), x.data(), 64), scalar_dot(w, x));
+
+    uint32_t seed = 7;
+    std::vector<int16_t> a(512), b(512);
+    for (size_t k = 0; k < a.size(); ++k) {
+        seed = seed * 1664525u + 1013904223u;
+        a[k] = (int16_t)(seed >> 16);
+        b[k] = (int16_t)(seed >> 3);
+    }
+    EXPECT_EQ(voip_aec::dot(a.data(), b.data(), 512), scalar_dot(a, b)) << voip_aec::simd_name();
+}
+
+TEST(VoipAec, CancelsSyntheticEcho) {
+    std::vector<int16_t> far, near;
+    voip_aec::synth_fixture(kRate, 8, 20, &far, &near);
+    voip_aec::FixtureResult result = voip_aec::run_fixture(unhurried(), far.data(), near.data(), far.size());
+    EXPECT_EQ(result.taps, kRate / 1000 * 64);
+    EXPECT_EQ(result.stats.frames, far.size() / kFrame);
+    EXPECT_EQ(result.stats.fallbacks, 0u);
+    EXPECT_GT(voip_aec::erle_db(result.stats), 10.0);
+}
+
+TEST(VoipAec, OverBudgetFallsBackToSuppressor) {
+    std::vector<int16_t> far, near;
+    voip_aec::synth_fixture(kRate, 4, 20, &far, &near);
+    voip_aec::Config config = unhurried();
+    config.budget_us = 0;  // Every frame is over it
+    voip_aec::EchoCanceller aec(config);
+    double in = 0, out = 0;
+    for (size_t off = 0; off + kFrame <= far.size() / 2; off += kFrame) {
+        std::vector<int16_t> frame(near.begin() + off, near.begin() + off + kFrame);
+        aec.process(frame.data(), far.data() + off);
+        if (aec.stats().frames < 10) continue;  // Gain still ramping down
+        for (uint32_t i = 0; i < kFrame; ++i) {
+            in += (double)near[off + i] * near[off + i];
+            out += (double)frame[i] * frame[i];
+        }
+    }
+    EXPECT_EQ(aec.mode(), voip_aec::MODE_SUPPRESS);
+    EXPECT_EQ(aec.stats().fallbacks, 1u);
+    EXPECT_EQ(aec.stats().suppressed_frames, aec.stats().frames - 1);
+    EXPECT_LT(out, in / 10);  // Only the far end talks in the first half
+}
+
+// What captureEchoFixture records on the device replays exactly like the samples themselves
+TEST(VoipAec, RecordedFixtureReplaysLikeTheCapture) {
+    std::vector<int16_t> far, near;
+    voip_aec::synth_fixture(kRate, 6, 20, &far, &near);
+    const std::string far_path = temp_path("far.pcm"), near_path = temp_path("near.pcm");
+    voip_aec::FixtureWriter writer;
+    ASSERT_TRUE(writer.open(far_path, near_path, far.size()));
+    size_t frames = 0;
+    for (size_t off = 0; off + kFrame <= far.size(); off += kFrame) {
+        // The capture path's frame, far included, as AecPort hands it over
+        std::vector<int16_t> frame(near.begin() + off, near.begin() + off + kFrame);
+        ++frames;
+        if (!writer.write(frame.data(), far.data() + off, kFrame)) break;
+    }
+    writer.close();
+    EXPECT_EQ(frames, far.size() / kFrame);
+    EXPECT_EQ(writer.samples(), far.size());
+
+    std::vector<int16_t> far_replay, near_replay;
+    ASSERT_TRUE(voip_aec::load_fixture(far_path, near_path, &far_replay, &near_replay));
+    unlink(far_path.c_str());
+    unlink(near_path.c_str());
+    EXPECT_EQ(far_replay, far);
+    EXPECT_EQ(near_replay, near);
+
+    voip_aec::FixtureResult live = voip_aec::run_fixture(unhurried(), far.data(), near.data(), far.size());
+    voip_aec::FixtureResult replay =
+        voip_aec::run_fixture(unhurried(), far_replay.data(), near_replay.data(), far_replay.size());
+    EXPECT_EQ(replay.stats.frames, live.stats.frames);
+    EXPECT_EQ(replay.stats.echo_in_energy, live.stats.echo_in_energy);
+    EXPECT_EQ(replay.stats.echo_out_energy, live.stats.echo_out_energy);
+}
+
+TEST(VoipAec, FixtureWriterStopsAtItsLength) {
+    const std::string far_path = temp_path("far_short.pcm"), near_path = temp_path("near_short.pcm");
+    voip_aec::FixtureWriter writer;
+    ASSERT_TRUE(writer.open(far_path, near_path, kFrame * 5 / 2));
+    std::vector<int16_t> frame(kFrame, 1000);
+    EXPECT_TRUE(writer.write(frame.data(), nullptr, kFrame));  // No far frame: silence
+    EXPECT_TRUE(writer.write(frame.data(), frame.data(), kFrame));
+    EXPECT_FALSE(writer.write(frame.data(), frame.data(), kFrame));
+    EXPECT_FALSE(writer.write(frame.data(), frame.data(), kFrame));
+    writer.close();
+    EXPECT_EQ(file_size(far_path), (long)(kFrame * 5 / 2 * sizeof(int16_t)));
+    EXPECT_EQ(file_size(near_path), (long)(kFrame * 5 / 2 * sizeof(int16_t)));
+
+    std::vector<int16_t> far, near;
+    ASSERT_TRUE(voip_aec::load_fixture(far_path, near_path, &far, &near));
+    EXPECT_EQ(far[0], 0);
+    EXPECT_EQ(far[kFrame], 1000);
+    EXPECT_EQ(near[0], 1000);
+
+    // A near file cut short: both are trimmed to it
+    ASSERT_EQ(truncate(near_path.c_str(), kFrame * sizeof(int16_t)), 0);
+    ASSERT_TRUE(voip_aec::load_fixture(far_path, near_path, &far, &near));
+    EXPECT_EQ(far.size(), kFrame);
+    EXPECT_EQ(near.size(), kFrame);
+    unlink(far_path.c_str());
+    unlink(near_path.c_str());
+    EXPECT_FALSE(voip_aec::load_fixture(far_path, near_path, &far, &near));
+    EXPECT_FALSE(writer.open("/nonexistent/far.pcm", "/nonexistent/near.pcm", kFrame));
+}
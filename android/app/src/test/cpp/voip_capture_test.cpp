@@ -0,0 +1,147 @@
+#include "voip_capture.h"
+
+#include <gtest/gtest.h>
+
+#include <atomic>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+
+namespace {
+
+std::string temp_path(const char *name) {
+    return std::string(testing::TempDir()) + std::to_string(getpid()) + "." + name;
+}
+
+std::string read_file(const std::string &path) {
+    std::ifstream in(path, std::ios::binary);
+    std::stringstream text;
+    text << in.rdbuf();
+    return text.str();
+}
+
+size_t count(const std::string &text, const std::string &needle) {
+    size_t n = 0;
+    for (size_t at = text.find(needle); at != std::string::npos; at = text.find(needle, at + 1)) n++;
+    return n;
+}
+
+voip_capture::Address v4(uint8_t last, uint16_t port_be) {
+    voip_capture::Address a;
+    memset(&a, 0, sizeof(a));
+    a.family = 4;
+    a.addr[0] = 192;
+    a.addr[1] = 168;
+    a.addr[3] = last;
+    a.port = port_be;
+    return a;
+}
+
+void record_text(const std::string &msg) {
+    voip_capture::record(voip_capture::DIR_TX, voip_capture::TP_UDP, v4(2, 0xc413), v4(1, 0xc413), msg.data(),
+                         msg.size(), 1700000000000000ull);
+}
+
+}  // namespace
+
+TEST(VoipCapture, ExportsTextDumpOldestFirst) {
+    voip_capture::configure(64 * 1024);
+    record_text("OPTIONS sip:first@example.com SIP/2.0\r\n\r\n");
+    record_text("OPTIONS sip:second@example.com SIP/2.0\r\n\r\n");
+
+    std::string path = temp_path("capture.txt");
+    ASSERT_EQ(voip_capture::export_file(path.c_str()), 2);
+    std::string text = read_file(path);
+    unlink(path.c_str());
+
+    EXPECT_NE(text.find("# SIP capture: 2 message(s) recorded, 0 overwritten"), std::string::npos);
+    EXPECT_NE(text.find("TX UDP 192.168.0.2:5060 -> 192.168.0.1:5060"), std::string::npos);
+    EXPECT_LT(text.find("first@"), text.find("second@"));
+}
+
+TEST(VoipCapture, ExportsPcapWithOneRecordPerMessage) {
+    voip_capture::configure(64 * 1024);
+    record_text("NOTIFY sip:lamp@example.com SIP/2.0\r\n\r\n");
+
+    std::string path = temp_path("capture.pcap");
+    ASSERT_EQ(voip_capture::export_file(path.c_str()), 1);
+    std::string pcap = read_file(path);
+    unlink(path.c_str());
+
+    const std::string msg = "NOTIFY sip:lamp@example.com SIP/2.0\r\n\r\n";
+    // File header, packet header, IPv4 + UDP headers, then the message
+    ASSERT_EQ(pcap.size(), 24u + 16u + 28u + msg.size());
+    uint32_t magic;
+    memcpy(&magic, pcap.data(), 4);
+    EXPECT_EQ(magic, 0xa1b2c3d4u);
+    EXPECT_EQ(pcap.substr(24 + 16 + 28), msg);
+}
+
+TEST(VoipCapture, DisabledRingRecordsNothing) {
+    voip_capture::configure(0);
+    EXPECT_EQ(voip_capture::capacity(), 0u);
+    record_text("REGISTER sip:example.com SIP/2.0\r\n\r\n");
+
+    std::string path = temp_path("capture_off.txt");
+    EXPECT_EQ(voip_capture::export_file(path.c_str()), 0);
+    unlink(path.c_str());
+}
+
+// Writers on several threads lap their small rings while they are exported: every exported
+// message must be whole, and only the newest ring-full of each thread survives
+TEST(VoipCapture, ConcurrentWritersOverwriteOldestAndExportStaysConsistent) {
+    voip_capture::configure(32 * 1024);
+    constexpr int kThreads = 4;
+    constexpr int kPerThread = 5000;
+    const std::string body(200, 'x');
+    std::atomic<bool> go{false};
+    std::atomic<int> finished{0};
+    std::vector<std::thread> writers;
+    for (int t = 0; t < kThreads; ++t) {
+        writers.emplace_back([&, t] {
+            while (!go.load()) std::this_thread::yield();
+            for (int i = 0; i < kPerThread; ++i) {
+                record_text("MESSAGE sip:t" + std::to_string(t) + " SIP/2.0\r\n\r\n<" + body + ">");
+            }
+            // A thread that exits leaves its ring to the next new one: stay until all are done
+            finished++;
+            while (finished.load() < kThreads) std::this_thread::yield();
+        });
+    }
+    go = true;
+    std::string during = temp_path("capture_during.txt");
+    long exported = voip_capture::export_file(during.c_str());
+    std::string text = read_file(during);
+    unlink(during.c_str());
+    for (auto &writer : writers) writer.join();
+    EXPECT_GE(exported, 0);
+    EXPECT_EQ(count(text, "MESSAGE sip:t"), (size_t)exported);
+    EXPECT_EQ(count(text, "<" + body + ">"), (size_t)exported);
+
+    std::string after = temp_path("capture_after.txt");
+    exported = voip_capture::export_file(after.c_str());
+    text = read_file(after);
+    unlink(after.c_str());
+    EXPECT_GT(exported, 0);
+    EXPECT_GT(exported, kThreads * (32 * 1024 / 256) / 2);
+    EXPECT_LT(exported, kThreads * 32 * 1024 / 200);
+    EXPECT_EQ(count(text, "<" + body + ">"), (size_t)exported);
+    EXPECT_NE(text.find("20000 message(s) recorded, " + std::to_string(20000 - exported) + " overwritten"),
+              std::string::npos);
+}
+
+TEST(VoipCapture, ResizingWhileRecordingIsSafe) {
+    std::atomic<bool> stop{false};
+    std::thread writer([&] {
+        while (!stop.load()) record_text("OPTIONS sip:resize SIP/2.0\r\n\r\n");
+    });
+    for (size_t bytes = 4096; bytes <= 64 * 1024; bytes *= 2) voip_capture::configure(bytes);
+    stop = true;
+    writer.join();
+    EXPECT_EQ(voip_capture::capacity(), 64u * 1024u);
+}
@@ -0,0 +1,167 @@
+#include "voip_cdr.h"
+
+#include <gtest/gtest.h>
+
+#include <string>
+#include <vector>
+#include <fcntl.h>
+#include <signal.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+namespace {
+
+using voip_cdr::Record;
+
+constexpr uint32_t kCapacity = 8;
+
+std::string temp_path(const char *name) {
+    return std::string(testing::TempDir()) + std::to_string(getpid()) + "." + name;
+}
+
+Record call(int32_t call_id, const char *number) {
+    Record rec = {};
+    rec.started_ms = 1700000000000 + call_id;
+    rec.setup_ms = 120;
+    rec.talk_ms = 30000;
+    rec.call_id = call_id;
+    rec.status = 200;
+    rec.incoming = 1;
+    snprintf(rec.number, sizeof(rec.number), "%s", number);
+    snprintf(rec.reason, sizeof(rec.reason), "Normal call clearing");
+    return rec;
+}
+
+std::vector<Record> recent() {
+    std::vector<Record> out(2 * kCapacity);
+    out.resize(voip_cdr::recent(out.data(), out.size()));
+    return out;
+}
+
+off_t slot_offset(uint64_t seq) {
+    return (off_t)(voip_cdr::kHeaderSize + ((seq - 1) % kCapacity) * voip_cdr::kRecordSize);
+}
+
+// Rewrites bytes of the closed file behind the mapping's back
+void patch(const std::string &path, off_t at, const void *bytes, size_t len) {
+    int fd = ::open(path.c_str(), O_RDWR);
+    ASSERT_GE(fd, 0);
+    ASSERT_EQ(pwrite(fd, bytes, len, at), (ssize_t)len);
+    ::close(fd);
+}
+
+class VoipCdrFile : public testing::Test {
+protected:
+    void SetUp() override {
+        path_ = temp_path("cdr.bin");
+        unlink(path_.c_str());
+        ASSERT_TRUE(voip_cdr::open(path_.c_str(), kCapacity));
+    }
+    void TearDown() override {
+        voip_cdr::close();
+        unlink(path_.c_str());
+    }
+    void reopen() {
+        voip_cdr::close();
+        ASSERT_TRUE(voip_cdr::open(path_.c_str(), kCapacity));
+    }
+
+    std::string path_;
+};
+
+}  // namespace
+
+TEST_F(VoipCdrFile, AppendsAndListsNewestFirst) {
+    EXPECT_EQ(voip_cdr::append(call(1, "250100")), 1u);
+    EXPECT_EQ(voip_cdr::append(call(2, "250101")), 2u);
+    auto records = recent();
+    ASSERT_EQ(records.size(), 2u);
+    EXPECT_EQ(records[0].seq, 2u);
+    EXPECT_STREQ(records[0].number, "250101");
+    EXPECT_STREQ(records[1].reason, "Normal call clearing");
+    EXPECT_NE(records[1].checksum, 0u);
+}
+
+TEST_F(VoipCdrFile, WrapKeepsTheNewestCapacityRecordsAcrossReopen) {
+    for (int i = 1; i <= 20; ++i) voip_cdr::append(call(i, std::to_string(250100 + i).c_str()));
+    reopen();
+    auto records = recent();
+    ASSERT_EQ(records.size(), kCapacity);
+    EXPECT_EQ(records.front().seq, 20u);
+    EXPECT_EQ(records.back().seq, 13u);
+    EXPECT_EQ(voip_cdr::append(call(21, "250121")), 21u);
+}
+
+// The process dies without closing: MAP_SHARED pages reach the file anyway
+TEST_F(VoipCdrFile, RecordsSurviveAKilledProcess) {
+    voip_cdr::append(call(1, "250100"));
+    voip_cdr::close();
+    pid_t child = fork();
+    ASSERT_GE(child, 0);
+    if (child == 0) {
+        if (!voip_cdr::open(path_.c_str(), kCapacity)) _exit(1);
+        for (int i = 2; i <= 5; ++i) voip_cdr::append(call(i, "250199"));
+        kill(getpid(), SIGKILL);
+        _exit(2);
+    }
+    int status = 0;
+    ASSERT_EQ(waitpid(child, &status, 0), child);
+    ASSERT_TRUE(WIFSIGNALED(status));
+    ASSERT_TRUE(voip_cdr::open(path_.c_str(), kCapacity));
+    auto records = recent();
+    ASSERT_EQ(records.size(), 5u);
+    EXPECT_EQ(records.front().seq, 5u);
+    EXPECT_EQ(voip_cdr::append(call(6, "250106")), 6u);
+}
+
+// A record torn by a crash fails its checksum: skipped, and its slot taken by the next append
+TEST_F(VoipCdrFile, TornNewestRecordIsSkippedAndItsSlotReused) {
+    for (int i = 1; i <= 3; ++i) voip_cdr::append(call(i, "250100"));
+    voip_cdr::close();
+    const char torn[] = "half-written";
+    patch(path_, slot_offset(3) + (off_t)offsetof(Record, number), torn, sizeof(torn));
+    ASSERT_TRUE(voip_cdr::open(path_.c_str(), kCapacity));
+    auto records = recent();
+    ASSERT_EQ(records.size(), 2u);
+    EXPECT_EQ(records.front().seq, 2u);
+    EXPECT_EQ(voip_cdr::append(call(4, "250104")), 3u);
+    records = recent();
+    ASSERT_EQ(records.size(), 3u);
+    EXPECT_STREQ(records.front().number, "250104");
+}
+
+// A torn record in the middle only loses itself; a sequence that does not map back to its
+// slot is garbage and does not move the append position
+TEST_F(VoipCdrFile, CorruptSlotsDoNotMoveTheAppendPosition) {
+    for (int i = 1; i <= 12; ++i) voip_cdr::append(call(i, "250100"));
+    voip_cdr::close();
+    const uint32_t bad_checksum = 0xdeadbeef;
+    patch(path_, slot_offset(10) + (off_t)offsetof(Record, checksum), &bad_checksum, sizeof(bad_checksum));
+    const uint64_t foreign_seq = 1000003;  // Belongs to another slot
+    patch(path_, slot_offset(11) + (off_t)offsetof(Record, seq), &foreign_seq, sizeof(foreign_seq));
+    ASSERT_TRUE(voip_cdr::open(path_.c_str(), kCapacity));
+    std::vector<uint64_t> seqs;
+    for (const auto &rec : recent()) seqs.push_back(rec.seq);
+    EXPECT_EQ(seqs, (std::vector<uint64_t>{12, 9, 8, 7, 6, 5}));
+    EXPECT_EQ(voip_cdr::append(call(13, "250113")), 13u);
+}
+
+// A file of the wrong size or header (truncated, other layout) is reset, not trusted
+TEST_F(VoipCdrFile, TruncatedOrForeignFileStartsEmpty) {
+    for (int i = 1; i <= 3; ++i) voip_cdr::append(call(i, "250100"));
+    voip_cdr::close();
+    ASSERT_EQ(truncate(path_.c_str(), (off_t)slot_offset(2)), 0);
+    ASSERT_TRUE(voip_cdr::open(path_.c_str(), kCapacity));
+    EXPECT_TRUE(recent().empty());
+    EXPECT_EQ(voip_cdr::append(call(1, "250100")), 1u);
+
+    voip_cdr::close();
+    const uint32_t bad_magic = 0;
+    patch(path_, 0, &bad_magic, sizeof(bad_magic));
+    ASSERT_TRUE(voip_cdr::open(path_.c_str(), kCapacity));
+    EXPECT_TRUE(recent().empty());
+    reopen();
+    EXPECT_TRUE(recent().empty());
+}
@@ -0,0 +1,209 @@
+#include "voip_dns.h"
+
+#include <gtest/gtest.h>
+
+#include <stdio.h>
+#include <unistd.h>
+
+#include <map>
+#include <string>
+#include <vector>
+
+namespace {
+
+using voip_dns::Record;
+
+// Stand-in authoritative server for the PBX domain: answers a SRV query with the SRV set plus
+// the A records of its targets in the additional section, as pjsip's resolver hands them to
+// on_dns_prewarm_result, with absolute expiry computed from each record's TTL
+class StubDnsServer {
+public:
+    void add_srv(const std::string &name, uint16_t prio, uint16_t weight, uint16_t port,
+                 const std::string &target, long ttl) {
+        Record rr;
+        rr.name = name;
+        rr.type = voip_dns::kTypeSrv;
+        rr.prio = prio;
+        rr.weight = weight;
+        rr.port = port;
+        rr.target = target;
+        zone_.push_back({rr, ttl});
+    }
+
+    void add_a(const std::string &name, uint32_t ipv4, long ttl) {
+        Record rr;
+        rr.name = name;
+        rr.type = voip_dns::kTypeA;
+        rr.ipv4 = ipv4;
+        zone_.push_back({rr, ttl});
+    }
+
+    // Answer + additional section for a query of name/type received at now; additional A
+    // records are left out when glue is false (the resolver then has to ask for them)
+    std::vector<Record> query(const std::string &name, uint16_t type, long now, bool glue = true) const {
+        std::vector<Record> answers;
+        std::vector<std::string> targets;
+        for (const auto &entry : zone_) {
+            if (entry.rr.name != name || entry.rr.type != type) continue;
+            answers.push_back(with_expiry(entry, now));
+            if (type == voip_dns::kTypeSrv) targets.push_back(entry.rr.target);
+        }
+        if (!glue) return answers;
+        for (const auto &target : targets) {
+            for (const auto &entry : zone_) {
+                if (entry.rr.name == target && entry.rr.type == voip_dns::kTypeA) answers.push_back(with_expiry(entry, now));
+            }
+        }
+        return answers;
+    }
+
+    void clear() { zone_.clear(); }
+
+private:
+    struct Entry {
+        Record rr;
+        long ttl;
+    };
+
+    static Record with_expiry(const Entry &entry, long now) {
+        Record rr = entry.rr;
+        rr.expires_at = now + entry.ttl;
+        return rr;
+    }
+
+    std::vector<Entry> zone_;
+};
+
+std::string temp_path(const std::string &name) {
+    return testing::TempDir() + "voip_dns_" + std::to_string(getpid()) + "_" + name;
+}
+
+constexpr long kNow = 1760000000;
+const std::string kSrv = "_sip._udp.pbx.example";
+
+StubDnsServer two_pbx_zone() {
+    StubDnsServer dns;
+    dns.add_srv(kSrv, 10, 60, 5060, "pbx1.pbx.example", 3600);
+    dns.add_srv(kSrv, 20, 40, 5060, "pbx2.pbx.example", 3600);
+    dns.add_a("pbx1.pbx.example", 0x0100000a, 300);  // 10.0.0.1
+    dns.add_a("pbx2.pbx.example", 0x0200000a, 600);  // 10.0.0.2
+    return dns;
+}
+
+}  // namespace
+
+TEST(VoipDns, StoresAnswerAndAdditionalRecords) {
+    voip_dns::Cache cache;
+    cache.store(two_pbx_zone().query(kSrv, voip_dns::kTypeSrv, kNow));
+
+    voip_dns::Groups groups = cache.unexpired(kNow);
+    ASSERT_EQ(groups.size(), 3u);
+    const auto &srv = groups[{kSrv, voip_dns::kTypeSrv}];
+    ASSERT_EQ(srv.size(), 2u);
+    EXPECT_EQ(srv[0].target, "pbx1.pbx.example");
+    EXPECT_EQ(srv[0].prio, 10);
+    EXPECT_EQ(srv[1].weight, 40);
+    EXPECT_EQ(groups.at(std::make_pair(std::string("pbx2.pbx.example"), voip_dns::kTypeA)).at(0).ipv4, 0x0200000au);
+}
+
+TEST(VoipDns, NewAnswerReplacesOnlyItsOwnRecords) {
+    StubDnsServer dns = two_pbx_zone();
+    voip_dns::Cache cache;
+    cache.store(dns.query(kSrv, voip_dns::kTypeSrv, kNow));
+
+    // The operator drops pbx2 from the SRV set; the A record of pbx1 stays as it was
+    dns.clear();
+    dns.add_srv(kSrv, 10, 100, 5080, "pbx1.pbx.example", 3600);
+    cache.store(dns.query(kSrv, voip_dns::kTypeSrv, kNow + 10, false));
+
+    voip_dns::Groups groups = cache.unexpired(kNow + 10);
+    const auto &srv = groups[{kSrv, voip_dns::kTypeSrv}];
+    ASSERT_EQ(srv.size(), 1u);
+    EXPECT_EQ(srv[0].port, 5080);
+    EXPECT_EQ(groups.count({"pbx1.pbx.example", voip_dns::kTypeA}), 1u);
+}
+
+TEST(VoipDns, ListsSrvTargetsStillMissingAnAddress) {
+    StubDnsServer dns = two_pbx_zone();
+    voip_dns::Cache cache;
+    std::vector<Record> answer = dns.query(kSrv, voip_dns::kTypeSrv, kNow, false);
+    cache.store(answer);
+    EXPECT_EQ(cache.srv_targets_without_a(answer), (std::vector<std::string>{"pbx1.pbx.example", "pbx2.pbx.example"}));
+
+    cache.store(dns.query("pbx1.pbx.example", voip_dns::kTypeA, kNow));
+    EXPECT_EQ(cache.srv_targets_without_a(answer), (std::vector<std::string>{"pbx2.pbx.example"}));
+}
+
+TEST(VoipDns, RecordsExpireWithTheirTtl) {
+    voip_dns::Cache cache;
+    cache.store(two_pbx_zone().query(kSrv, voip_dns::kTypeSrv, kNow));
+
+    EXPECT_EQ(cache.unexpired(kNow + 299).count({"pbx1.pbx.example", voip_dns::kTypeA}), 1u);
+    voip_dns::Groups later = cache.unexpired(kNow + 300);
+    EXPECT_EQ(later.count({"pbx1.pbx.example", voip_dns::kTypeA}), 0u);
+    EXPECT_EQ(later.count({"pbx2.pbx.example", voip_dns::kTypeA}), 1u);
+    EXPECT_TRUE(cache.unexpired(kNow + 3600).empty());
+}
+
+TEST(VoipDns, SurvivesRestartWithoutExpiredRecords) {
+    const std::string path = temp_path("restart");
+    {
+        voip_dns::Cache cache;
+        cache.store(two_pbx_zone().query(kSrv, voip_dns::kTypeSrv, kNow));
+        ASSERT_TRUE(cache.save(path, kNow));
+    }
+
+    // Cold start 400 s later: pbx1's A record (TTL 300) is gone, the rest comes back as it was
+    voip_dns::Cache cache;
+    EXPECT_EQ(cache.load(path, kNow + 400), 3u);
+    voip_dns::Groups groups = cache.unexpired(kNow + 400);
+    EXPECT_EQ(groups.count({"pbx1.pbx.example", voip_dns::kTypeA}), 0u);
+    const auto &srv = groups[{kSrv, voip_dns::kTypeSrv}];
+    ASSERT_EQ(srv.size(), 2u);
+    EXPECT_EQ(srv[1].target, "pbx2.pbx.example");
+    EXPECT_EQ(srv[1].expires_at, kNow + 3600);
+    EXPECT_EQ(groups.at(std::make_pair(std::string("pbx2.pbx.example"), voip_dns::kTypeA)).at(0).ipv4, 0x0200000au);
+    remove(path.c_str());
+}
+
+TEST(VoipDns, LoadSkipsCorruptLinesAndReplacesContent) {
+    const std::string path = temp_path("corrupt");
+    FILE *f = fopen(path.c_str(), "w");
+    ASSERT_NE(f, nullptr);
+    fprintf(f, "SRV %s 10 60 5060 pbx1.pbx.example %ld\n", kSrv.c_str(), kNow + 100);
+    fprintf(f, "SRV %s ten 60 5060 pbx1.pbx.example %ld\n", kSrv.c_str(), kNow + 100);
+    fprintf(f, "A pbx1.pbx.example\n");
+    fprintf(f, "MX pbx.example 10 mail.pbx.example %ld\n", kNow + 100);
+    fprintf(f, "A pbx1.pbx.example 16777226 %ld\n", kNow + 100);
+    fclose(f);
+
+    voip_dns::Cache cache;
+    cache.store(two_pbx_zone().query(kSrv, voip_dns::kTypeSrv, kNow));
+    EXPECT_EQ(cache.load(path, kNow), 2u);
+    EXPECT_EQ(cache.records().size(), 2u);
+    remove(path.c_str());
+}
+
+TEST(VoipDns, MissingOrUnwritableFile) {
+    voip_dns::Cache cache;
+    cache.store(two_pbx_zone().query(kSrv, voip_dns::kTypeSrv, kNow));
+    EXPECT_FALSE(cache.save(temp_path("no_such_dir") + "/cache", kNow));
+    EXPECT_EQ(cache.load(temp_path("never_written"), kNow), 0u);
+    EXPECT_TRUE(cache.records().empty());
+}
+
+TEST(VoipDns, KeepsAtMostMaxRecords) {
+    StubDnsServer dns;
+    for (size_t i = 0; i < voip_dns::kMaxRecords + 10; ++i) {
+        dns.add_srv(kSrv, 10, 10, 5060, "pbx" + std::to_string(i) + ".pbx.example", 3600);
+    }
+    voip_dns::Cache cache;
+    cache.store(dns.query(kSrv, voip_dns::kTypeSrv, kNow, false));
+    EXPECT_EQ(cache.records().size(), voip_dns::kMaxRecords);
+
+    const std::string path = temp_path("cap");
+    ASSERT_TRUE(cache.save(path, kNow));
+    voip_dns::Cache reloaded;
+    EXPECT_EQ(reloaded.load(path, kNow), voip_dns::kMaxRecords);
+    remove(path.c_str());
+}
@@ -0,0 +1,155 @@
+#include "voip_events.h"
+
+#include <gtest/gtest.h>
+
+#include <string>
+#include <vector>
+#include <string.h>
+
+namespace {
+
+using voip_events::Event;
+using voip_events::Ring;
+
+template <typename T>
+T get(const uint8_t *p) {
+    T v;
+    memcpy(&v, p, sizeof(v));
+    return v;
+}
+
+Event presence(const char *contact, const char *state) {
+    Event ev;
+    ev.type = voip_events::EV_PRESENCE_UPDATED;
+    ev.id = 7;
+    ev.string_count = 2;
+    ev.strings[0] = contact;
+    ev.strings[1] = state;
+    return ev;
+}
+
+// Records of a copy-out buffer, as (type, first string) pairs
+std::vector<std::pair<int, std::string>> decode(const std::vector<uint8_t> &buf, size_t len) {
+    std::vector<std::pair<int, std::string>> out;
+    for (size_t pos = 0; pos < len;) {
+        const uint8_t *rec = &buf[pos];
+        std::string first;
+        if (rec[3] > 0) {
+            uint16_t n = get<uint16_t>(rec + voip_events::kRecordHeaderSize);
+            first.assign(reinterpret_cast<const char *>(rec + voip_events::kRecordHeaderSize + 2), n);
+        }
+        out.emplace_back(rec[2], first);
+        pos += get<uint16_t>(rec);
+    }
+    return out;
+}
+
+}  // namespace
+
+TEST(VoipEvents, WritesHeaderAndRecordLayout) {
+    Ring ring;
+    uint8_t *buf = ring.init(1000);  // Rounded up to 4096
+    ASSERT_NE(buf, nullptr);
+    EXPECT_EQ(ring.init(1 << 20), buf);
+    EXPECT_EQ(ring.buffer_size(), voip_events::kHeaderSize + 4096);
+    EXPECT_EQ(get<uint32_t>(buf), voip_events::kMagic);
+    EXPECT_EQ(get<uint16_t>(buf + 4), voip_events::kSchemaVersion);
+    EXPECT_EQ(get<uint16_t>(buf + 6), voip_events::kHeaderSize);
+    EXPECT_EQ(get<uint32_t>(buf + 8), 4096u);
+
+    Event ev;
+    ev.type = voip_events::EV_COMMAND_COMPLETED;
+    ev.id = 3;
+    ev.code = 1;
+    ev.v0 = 42;
+    ev.v1 = -5;
+    ev.v2 = 1LL << 40;
+    ev.string_count = 1;
+    ev.strings[0] = "make_call";
+    uint64_t cursor = ring.write(ev);
+
+    const uint8_t *rec = buf + voip_events::kHeaderSize;
+    const size_t size = get<uint16_t>(rec);
+    EXPECT_EQ(size, (voip_events::kRecordHeaderSize + 2 + 9 + 3) & ~(size_t)3);
+    EXPECT_EQ(cursor, size);
+    EXPECT_EQ(get<uint64_t>(buf + 16), cursor);  // Write cursor mirrored in the header
+    EXPECT_EQ(rec[2], voip_events::EV_COMMAND_COMPLETED);
+    EXPECT_EQ(rec[3], 1);
+    EXPECT_EQ(get<uint32_t>(rec + 4), 1u);
+    EXPECT_EQ(get<int32_t>(rec + 8), 3);
+    EXPECT_EQ(get<int32_t>(rec + 12), 1);
+    EXPECT_GT(get<int64_t>(rec + 16), 0);
+    EXPECT_EQ(get<int64_t>(rec + 24), 42);
+    EXPECT_EQ(get<int64_t>(rec + 32), -5);
+    EXPECT_EQ(get<int64_t>(rec + 40), 1LL << 40);
+    EXPECT_EQ(get<uint16_t>(rec + 48), 9);
+    EXPECT_EQ(std::string(reinterpret_cast<const char *>(rec + 50), 9), "make_call");
+}
+
+TEST(VoipEvents, TruncatesLongStrings) {
+    Ring ring;
+    uint8_t *buf = ring.init(8192);
+    std::string contact(3000, 'c');
+    ring.write(presence(contact.c_str(), "ringing"));
+    const uint8_t *rec = buf + voip_events::kHeaderSize;
+    EXPECT_EQ(get<uint16_t>(rec + 48), voip_events::kMaxStringBytes);
+    const uint8_t *second = rec + 48 + 2 + voip_events::kMaxStringBytes;
+    EXPECT_EQ(get<uint16_t>(second), 7);
+    EXPECT_EQ(std::string(reinterpret_cast<const char *>(second + 2), 7), "ringing");
+}
+
+TEST(VoipEvents, DropsWhenReaderIsTooFarBehind) {
+    Ring ring;
+    EXPECT_EQ(ring.write(presence("1000", "idle")), 0u);  // Not initialised yet: dropped, not counted
+    ring.init(4096);
+    uint64_t written = 0;
+    int accepted = 0;
+    while (ring.write(presence("1000", "idle")) != 0) accepted++;
+    EXPECT_GT(accepted, 0);
+    EXPECT_EQ(ring.dropped(), 1u);
+    written = get<uint64_t>(ring.init(0) + 16);
+    EXPECT_LE(written, 4096u);
+
+    // Consuming frees the space again
+    ring.consume(written);
+    EXPECT_NE(ring.write(presence("1000", "busy")), 0u);
+    EXPECT_EQ(ring.dropped(), 1u);
+}
+
+// A record never straddles the end of the data area: the gap is padded and the reader skips it
+TEST(VoipEvents, WrapsWithPaddingAndCopyOutSkipsIt) {
+    Ring ring;
+    ring.init(4096);
+    std::vector<uint8_t> out(8192);
+    int written = 0;
+    for (int lap = 0; lap < 5; ++lap) {
+        std::vector<std::string> contacts;
+        for (int i = 0; i < 40; ++i) {
+            contacts.push_back("lamp-" + std::to_string(written++));
+            ASSERT_NE(ring.write(presence(contacts.back().c_str(), "ringing")), 0u);
+        }
+        size_t copied = ring.read(out.data(), out.size());
+        auto records = decode(out, copied);
+        ASSERT_EQ(records.size(), contacts.size());
+        for (size_t i = 0; i < records.size(); ++i) {
+            EXPECT_EQ(records[i].first, voip_events::EV_PRESENCE_UPDATED);
+            EXPECT_EQ(records[i].second, contacts[i]);
+        }
+    }
+    EXPECT_EQ(ring.dropped(), 0u);
+}
+
+TEST(VoipEvents, CopyOutStopsAtWholeRecords) {
+    Ring ring;
+    ring.init(4096);
+    ring.write(presence("1001", "idle"));
+    ring.write(presence("1002", "idle"));
+    std::vector<uint8_t> out(80);  // Room for one record only
+    size_t copied = ring.read(out.data(), out.size());
+    ASSERT_EQ(decode(out, copied).size(), 1u);
+    EXPECT_EQ(decode(out, copied)[0].second, "1001");
+    copied = ring.read(out.data(), out.size());
+    ASSERT_EQ(decode(out, copied).size(), 1u);
+    EXPECT_EQ(decode(out, copied)[0].second, "1002");
+    EXPECT_EQ(ring.read(out.data(), out.size()), 0u);
+}
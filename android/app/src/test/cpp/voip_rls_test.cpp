@@ -0,0 +1,150 @@
+#include "voip_rls.h"
+
+#include "standin_notifier.h"
+
+#include <gtest/gtest.h>
+
+#include <map>
+#include <string>
+#include <vector>
+
+namespace {
+
+using voip_rls::States;
+
+std::map<std::string, std::string> parse(const StandinNotifier::Body &body, const std::string &prefix = "",
+                                         size_t *failures = nullptr) {
+    States states;
+    size_t failed = voip_rls::parse_notify(body.content_type, body.text.data(), body.text.size(), prefix, states);
+    if (failures) *failures = failed;
+    std::map<std::string, std::string> out;
+    for (const auto &st : states) out[st.first] = st.second;
+    return out;
+}
+
+}  // namespace
+
+TEST(VoipRls, ContactKeysMatchPerBuddyKeys) {
+    EXPECT_EQ(voip_rls::contact_key("sip:250100@pbx.example;user=phone", ""), "250100");
+    EXPECT_EQ(voip_rls::contact_key("<sips:250100@pbx.example>", ""), "250100");
+    EXPECT_EQ(voip_rls::contact_key("SIP:250100@pbx.example", ""), "250100");
+    EXPECT_EQ(voip_rls::contact_key("tel:250100", ""), "250100");
+    EXPECT_EQ(voip_rls::contact_key("0100", "25"), "250100");
+    EXPECT_EQ(voip_rls::contact_key("sip:0100@pbx.example", "25"), "250100");
+    EXPECT_EQ(voip_rls::contact_key("sip:250100@pbx.example", "25"), "250100");
+    EXPECT_EQ(voip_rls::contact_key("", "25"), "");
+}
+
+TEST(VoipRls, FullStateNotifyReportsEveryLamp) {
+    StandinNotifier notifier;
+    notifier.set("250100", "confirmed");
+    notifier.set("250101", "early");
+    notifier.set("250102", "trying");
+    notifier.set("250103", "terminated");
+    notifier.set("250104", "");
+    size_t failures = 1;
+    auto states = parse(notifier.full_state(), "", &failures);
+    EXPECT_EQ(failures, 0u);
+    EXPECT_EQ(states, (std::map<std::string, std::string>{
+                          {"250100", "busy"},
+                          {"250101", "ringing"},
+                          {"250102", "ringing"},
+                          {"250103", "available"},
+                          {"250104", "available"},
+                      }));
+}
+
+TEST(VoipRls, PartialNotifyCarriesOnlyChangedLamps) {
+    StandinNotifier notifier;
+    for (int i = 0; i < 50; ++i) notifier.set(std::to_string(250100 + i), "");
+    EXPECT_EQ(parse(notifier.full_state()).size(), 50u);
+    notifier.set("250107", "confirmed");
+    auto states = parse(notifier.partial({"250107"}));
+    EXPECT_EQ(states, (std::map<std::string, std::string>{{"250107", "busy"}}));
+}
+
+TEST(VoipRls, TerminatedInstanceGoesOffline) {
+    StandinNotifier notifier;
+    notifier.set("250100", "confirmed");
+    notifier.set("250101", "gone");
+    auto states = parse(notifier.full_state());
+    EXPECT_EQ(states, (std::map<std::string, std::string>{{"250100", "busy"}, {"250101", "offline"}}));
+}
+
+TEST(VoipRls, KeysGetTheDialPrefixLikeBuddies) {
+    StandinNotifier notifier;
+    notifier.set("0100", "confirmed");
+    notifier.set("250101", "gone");
+    auto states = parse(notifier.full_state(), "25");
+    EXPECT_EQ(states, (std::map<std::string, std::string>{{"250100", "busy"}, {"250101", "offline"}}));
+}
+
+// A server that does not expand the list answers with plain dialog-info
+TEST(VoipRls, PlainDialogInfoWithNamespacePrefixes) {
+    StandinNotifier::Body body;
+    body.content_type = "application/dialog-info+xml";
+    body.text = "<?xml version=\"1.0\"?>\n<!-- lamp -->\n"
+                "<dinfo:dialog-info xmlns:dinfo=\"urn:ietf:params:xml:ns:dialog-info\" version='3' state='partial' "
+                "entity='sip:250100@pbx.example'>"
+                "<dinfo:dialog id=\"1\"><dinfo:state event=\"remote-bye\">terminated</dinfo:state></dinfo:dialog>"
+                "<dinfo:dialog id=\"2\"><dinfo:state><![CDATA[confirmed]]></dinfo:state></dinfo:dialog>"
+                "</dinfo:dialog-info>";
+    EXPECT_EQ(parse(body), (std::map<std::string, std::string>{{"250100", "busy"}}));
+}
+
+// Per-buddy dialog-event NOTIFYs go through pjsua's parser, then this same mapping
+TEST(VoipRls, DialogStateMapsLikeListParts) {
+    EXPECT_EQ(voip_rls::dialog_presence("confirmed"), "busy");
+    EXPECT_EQ(voip_rls::dialog_presence(" Early\r\n"), "ringing");
+    EXPECT_EQ(voip_rls::dialog_presence("trying"), "ringing");
+    EXPECT_EQ(voip_rls::dialog_presence("proceeding"), "ringing");
+    EXPECT_EQ(voip_rls::dialog_presence("terminated"), "available");
+    EXPECT_EQ(voip_rls::dialog_presence(""), "available");
+}
+
+TEST(VoipRls, NestedListIsExpanded) {
+    StandinNotifier inner("inner-boundary;x");
+    inner.set("250200", "early");
+    StandinNotifier::Body nested = inner.full_state();
+
+    StandinNotifier outer;
+    outer.set("250100", "confirmed");
+    StandinNotifier::Body body = outer.full_state();
+    // Splice the inner list in as one more part of the outer body
+    const std::string close = "--" + outer.boundary() + "--\r\n";
+    body.text.insert(body.text.size() - close.size(),
+                     "--" + outer.boundary() + "\r\nContent-Type: " + nested.content_type + "\r\n\r\n" + nested.text);
+    size_t failures = 1;
+    auto states = parse(body, "", &failures);
+    EXPECT_EQ(failures, 0u);
+    EXPECT_EQ(states, (std::map<std::string, std::string>{{"250100", "busy"}, {"250200", "ringing"}}));
+}
+
+TEST(VoipRls, MalformedPartsAreSkipped) {
+    StandinNotifier notifier;
+    notifier.set("250100", "confirmed");
+    notifier.set("250101", "early");
+    StandinNotifier::Body body = notifier.full_state();
+    // Cut the second dialog-info document short
+    size_t at = body.text.find("<state>early");
+    ASSERT_NE(at, std::string::npos);
+    body.text.erase(at, body.text.find("</dialog-info>", at) + 14 - at);
+    size_t failures = 0;
+    auto states = parse(body, "", &failures);
+    EXPECT_EQ(failures, 1u);
+    EXPECT_EQ(states, (std::map<std::string, std::string>{{"250100", "busy"}}));
+
+    // No close delimiter: the parts before the cut still count
+    body = notifier.full_state();
+    body.text.resize(body.text.rfind("--" + notifier.boundary()) - 40);
+    states = parse(body, "", &failures);
+    EXPECT_EQ(failures, 1u);
+    EXPECT_EQ(states.count("250100"), 1u);
+
+    StandinNotifier::Body no_boundary{"multipart/related", body.text};
+    EXPECT_TRUE(parse(no_boundary, "", &failures).empty());
+    EXPECT_EQ(failures, 1u);
+    StandinNotifier::Body empty{"multipart/related;boundary=x", ""};
+    EXPECT_TRUE(parse(empty, "", &failures).empty());
+    EXPECT_EQ(failures, 0u);
+}
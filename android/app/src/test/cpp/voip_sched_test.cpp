@@ -0,0 +1,79 @@
+#include "voip_sched.h"
+
+#include <gtest/gtest.h>
+
+#include <chrono>
+#include <stdio.h>
+#include <thread>
+
+namespace {
+
+constexpr uint32_t kPeriodUs = 10000;
+
+uint64_t ms(uint64_t v) { return v * 1000000u; }
+
+void print(const char *name, const voip_sched::JitterReport &r) {
+    printf("[ jitter   ] %s: %llu ticks, %llu skipped, late mean %llu us p50 %llu us p99 %llu us max %llu us\n", name,
+           (unsigned long long)r.ticks, (unsigned long long)r.skipped, (unsigned long long)r.mean_us,
+           (unsigned long long)r.p50_us, (unsigned long long)r.p99_us, (unsigned long long)r.max_us);
+}
+
+}  // namespace
+
+TEST(VoipSched, TickMeterReportsOnlyLatenessPastOnePeriod) {
+    voip_sched::TickMeter meter(20000);
+    EXPECT_EQ(meter.on_tick_at(ms(100)), 0u);  // First tick: nothing to compare with
+    EXPECT_EQ(meter.on_tick_at(ms(120)), 0u);
+    EXPECT_EQ(meter.on_tick_at(ms(145)), 5000u);
+    EXPECT_EQ(meter.on_tick_at(ms(146)), 0u);  // Burst: the early tick is on time
+    EXPECT_EQ(meter.on_tick_at(ms(166) + 1500), 1u);
+    meter.reset();
+    EXPECT_EQ(meter.on_tick_at(ms(900)), 0u);
+}
+
+TEST(VoipSched, TickerKeepsAbsoluteDeadlines) {
+    voip_sched::Ticker ticker(5000);
+    const auto start = std::chrono::steady_clock::now();
+    uint64_t late_sum = 0;
+    for (int i = 0; i < 20; ++i) {
+        late_sum += ticker.wait_next();
+        // Work inside the tick must not push the schedule back
+        std::this_thread::sleep_for(std::chrono::milliseconds(2));
+    }
+    const auto elapsed_ms =
+        std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start).count();
+    EXPECT_GE(elapsed_ms, 100);
+    EXPECT_LT(elapsed_ms, 100 + 20 * 2 + 50) << "late ticks: " << late_sum << " us in total";
+}
+
+TEST(VoipSched, TickerRestartsAfterALongStall) {
+    voip_sched::Ticker ticker(1000);
+    ticker.wait_next();
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    EXPECT_GE(ticker.wait_next(), 4000u);
+    EXPECT_GE(ticker.skipped(), 10u);
+    EXPECT_LT(ticker.wait_next(2), 1000u + 5000u);  // Back on a schedule from now
+}
+
+// Benchmark, as the app's benchmarkMediaTick runs it on a device: a 10 ms ticker alone, then
+// against one busy thread per core. The numbers are printed; the checks only catch a ticker
+// that stops keeping time.
+TEST(VoipSched, TickJitterBenchmark) {
+    const unsigned cores = std::max(1u, std::thread::hardware_concurrency());
+    voip_sched::JitterReport idle =
+        voip_sched::measure_tick_jitter(kPeriodUs, 1000, 0, 0, 0, voip_sched::CORES_ANY);
+    print("idle", idle);
+    voip_sched::JitterReport loaded =
+        voip_sched::measure_tick_jitter(kPeriodUs, 1000, cores, 0, 0, voip_sched::CORES_ANY);
+    print("loaded", loaded);
+
+    for (const auto &r : {idle, loaded}) {
+        EXPECT_EQ(r.ticks, 100u);
+        EXPECT_EQ(r.priority, voip_sched::PRIO_UNCHANGED);
+        EXPECT_FALSE(r.pinned);
+        EXPECT_LE(r.p50_us, r.p99_us);
+        EXPECT_LE(r.p99_us, r.max_us);
+        EXPECT_LT(r.skipped, r.ticks / 2);
+    }
+    EXPECT_LT(idle.p50_us, kPeriodUs);
+}
@@ -0,0 +1,279 @@
+// Host soak of the modules the device soak run (android/soak/soak.sh) leans on hardest: the
+// event ring under sustained multi-producer load, the call detail log wrapping across reopens,
+// and the resource list NOTIFY parser under the BLF storm. Each test runs for VOIP_SOAK_SECONDS (default 2); `ctest -L soak` selects them,
+// e.g. VOIP_SOAK_SECONDS=3600 ctest -L soak --timeout 0 for an overnight run.
+#include "voip_cdr.h"
+#include "voip_events.h"
+#include "voip_rls.h"
+
+#include "standin_notifier.h"
+
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <map>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+Clock::duration soak_duration() {
+    const char *env = getenv("VOIP_SOAK_SECONDS");
+    const long seconds = env ? atol(env) : 0;
+    return std::chrono::seconds(seconds > 0 ? seconds : 2);
+}
+
+std::string temp_path(const char *name) {
+    return std::string(testing::TempDir()) + std::to_string(getpid()) + "." + name;
+}
+
+// Resident set, in KiB (0 when /proc is not there)
+long rss_kib() {
+    FILE *f = fopen("/proc/self/status", "r");
+    if (!f) return 0;
+    char line[256];
+    long kib = 0;
+    while (fgets(line, sizeof(line), f)) {
+        if (sscanf(line, "VmRSS: %ld kB", &kib) == 1) break;
+    }
+    fclose(f);
+    return kib;
+}
+
+template <typename T>
+T get(const uint8_t *p) {
+    T v;
+    memcpy(&v, p, sizeof(v));
+    return v;
+}
+
+}  // namespace
+
+// Producers write as fast as they can while one reader drains: every accepted event arrives
+// once and in order per producer, the rest are counted as dropped, memory stays flat and the
+// reader's throughput does not decay
+TEST(VoipSoak, EventRingUnderSustainedLoad) {
+    constexpr int kProducers = 3;
+    voip_events::Ring ring;
+    ASSERT_NE(ring.init(64 * 1024), nullptr);
+    std::atomic<bool> stop{false};
+    std::vector<uint64_t> attempted(kProducers, 0), accepted(kProducers, 0);
+    std::vector<std::thread> producers;
+    for (int p = 0; p < kProducers; ++p) {
+        producers.emplace_back([&, p] {
+            const std::string contact = "lamp-" + std::to_string(p);
+            voip_events::Event ev;
+            ev.type = voip_events::EV_PRESENCE_UPDATED;
+            ev.id = p;
+            ev.string_count = 2;
+            ev.strings[0] = contact.c_str();
+            ev.strings[1] = "busy";
+            while (!stop.load(std::memory_order_relaxed)) {
+                ev.v0 = (int64_t)attempted[p]++;
+                if (ring.write(ev) != 0) accepted[p]++;
+                if ((attempted[p] & 1023) == 0) std::this_thread::yield();
+            }
+        });
+    }
+
+    std::vector<uint64_t> delivered(kProducers, 0);
+    std::vector<int64_t> last(kProducers, -1);
+    std::vector<uint64_t> per_window;  // Records read per 250 ms
+    std::vector<uint8_t> out(16 * 1024);
+    uint64_t window_records = 0;
+    bool in_order = true;
+    const auto start = Clock::now();
+    const auto end = start + soak_duration();
+    auto window_end = start + std::chrono::milliseconds(250);
+    long rss_warm = 0;
+    auto drain = [&] {
+        const size_t len = ring.read(out.data(), out.size());
+        for (size_t pos = 0; pos < len;) {
+            const uint8_t *rec = &out[pos];
+            const int p = get<int32_t>(rec + 8);
+            const int64_t seq = get<int64_t>(rec + 24);
+            if (p < 0 || p >= kProducers || seq <= last[p]) {
+                in_order = false;
+            } else {
+                last[p] = seq;
+                delivered[p]++;
+            }
+            window_records++;
+            pos += get<uint16_t>(rec);
+        }
+        return len;
+    };
+    while (Clock::now() < end) {
+        if (drain() == 0) std::this_thread::yield();
+        if (Clock::now() >= window_end) {
+            per_window.push_back(window_records);
+            window_records = 0;
+            window_end += std::chrono::milliseconds(250);
+            if (per_window.size() == 2) rss_warm = rss_kib();
+        }
+    }
+    stop = true;
+    for (auto &producer : producers) producer.join();
+    while (drain() != 0) {
+    }
+
+    EXPECT_TRUE(in_order);
+    uint64_t total_attempted = 0, total_accepted = 0;
+    for (int p = 0; p < kProducers; ++p) {
+        EXPECT_EQ(delivered[p], accepted[p]) << "producer " << p;
+        total_attempted += attempted[p];
+        total_accepted += accepted[p];
+    }
+    EXPECT_GT(total_accepted, 0u);
+    EXPECT_EQ(total_accepted + ring.dropped(), total_attempted);
+    if (rss_warm > 0) EXPECT_LT(rss_kib() - rss_warm, 4 * 1024);
+    ASSERT_GE(per_window.size(), 4u);
+    std::vector<uint64_t> sorted(per_window.begin() + 1, per_window.end());
+    std::sort(sorted.begin(), sorted.end());
+    const uint64_t median = sorted[sorted.size() / 2];
+    // A loaded CI machine stalls the odd window; a leak or a lock convoy drags them all down
+    EXPECT_GE(sorted[sorted.size() / 4], median / 4) << "throughput decayed over the run";
+    printf("[ soak     ] %llu events in %zu windows, median %llu per 250 ms, %llu dropped\n",
+           (unsigned long long)total_accepted, per_window.size(), (unsigned long long)median,
+           (unsigned long long)ring.dropped());
+}
+
+// Appends wrap the file many times over, with the process "restarting" (close, reopen) every
+// few hundred calls: the newest records always read back complete and in sequence, and
+// neither the file nor the process grows
+TEST(VoipSoak, CallLogWrapsAcrossReopens) {
+    constexpr uint32_t kCapacity = 64;
+    const std::string path = temp_path("soak_cdr.bin");
+    unlink(path.c_str());
+    ASSERT_TRUE(voip_cdr::open(path.c_str(), kCapacity));
+    std::vector<voip_cdr::Record> recent(kCapacity * 2);
+    uint64_t seq = 0;
+    size_t reopens = 0;
+    bool consistent = true;
+    long rss_warm = 0;
+    const auto end = Clock::now() + soak_duration();
+    while (Clock::now() < end && consistent) {
+        voip_cdr::Record rec = {};
+        rec.call_id = (int32_t)(seq % 32);
+        rec.started_ms = 1700000000000 + (int64_t)seq;
+        rec.status = 200;
+        snprintf(rec.number, sizeof(rec.number), "2501%05llu", (unsigned long long)(seq % 100000));
+        const uint64_t got = voip_cdr::append(rec);
+        consistent = got == ++seq;
+        if (seq % 379 == 0) {
+            voip_cdr::close();
+            consistent = consistent && voip_cdr::open(path.c_str(), kCapacity);
+            ++reopens;
+            if (reopens == 10) rss_warm = rss_kib();
+        }
+        if (seq % 97 == 0) {
+            const size_t n = voip_cdr::recent(recent.data(), recent.size());
+            consistent = consistent && n == std::min<uint64_t>(seq, kCapacity);
+            for (size_t i = 0; consistent && i < n; ++i) {
+                const voip_cdr::Record &r = recent[i];
+                consistent = r.seq == seq - i && r.started_ms == 1700000000000 + (int64_t)(r.seq - 1);
+            }
+        }
+    }
+    voip_cdr::close();
+    struct stat st;
+    ASSERT_EQ(stat(path.c_str(), &st), 0);
+    unlink(path.c_str());
+
+    EXPECT_TRUE(consistent) << "after " << seq << " records";
+    EXPECT_GT(seq, (uint64_t)kCapacity * 10);
+    EXPECT_EQ((size_t)st.st_size, voip_cdr::kHeaderSize + kCapacity * voip_cdr::kRecordSize);
+    if (rss_warm > 0) EXPECT_LT(rss_kib() - rss_warm, 4 * 1024);
+    printf("[ soak     ] %llu records, %zu reopens, file wrapped %llu times\n", (unsigned long long)seq, reopens,
+           (unsigned long long)(seq / kCapacity));
+}
+
+// The device soak's BLF storm on the host: a 500-lamp list, full state first and every so
+// often, partial NOTIFYs moving a few random lamps in between, parsed as fast as they come.
+// Every lamp ends in the last state sent, no part is lost, memory stays flat, and the parser
+// keeps up with the stand-in PBX's storm rate in every window without decaying
+TEST(VoipSoak, RlsNotifyStorm) {
+    constexpr int kLamps = 500;
+    constexpr int kFullStateEvery = 500;  // NOTIFYs; a resubscription or refresh in real life
+    constexpr uint64_t kStormRate = 2000;  // NOTIFY/s of soak.sh's stand-in PBX
+    static const char *const kDialogStates[] = {"", "trying", "early", "confirmed", "terminated"};
+    static const std::map<std::string, std::string> kPresence = {
+        {"", "available"}, {"trying", "ringing"}, {"early", "ringing"}, {"confirmed", "busy"},
+        {"terminated", "available"}};
+
+    StandinNotifier notifier;
+    std::map<std::string, std::string> sent;  // Lamp → last dialog state sent
+    std::vector<std::string> users;
+    for (int i = 0; i < kLamps; ++i) {
+        users.push_back(std::to_string(1000 + i));
+        notifier.set(users.back(), "terminated");
+        sent[users.back()] = "terminated";
+    }
+    std::map<std::string, std::string> lamps;  // What the engine would publish
+    std::mt19937 rng(42);
+    uint64_t notifies = 0, resources = 0, failures = 0;
+    std::vector<uint64_t> per_window;  // NOTIFYs parsed per 250 ms
+    uint64_t window_notifies = 0;
+    long rss_warm = 0;
+    const auto start = Clock::now();
+    const auto end = start + soak_duration();
+    auto window_end = start + std::chrono::milliseconds(250);
+    while (Clock::now() < end) {
+        StandinNotifier::Body body;
+        if (notifies % kFullStateEvery == 0) {
+            body = notifier.full_state();
+        } else {
+            std::vector<std::string> changed;
+            const int count = 1 + (int)(rng() % 6);
+            for (int i = 0; i < count; ++i) {
+                const std::string &user = users[rng() % kLamps];
+                const char *state = kDialogStates[rng() % 5];
+                notifier.set(user, state);
+                sent[user] = state;
+                changed.push_back(user);
+            }
+            body = notifier.partial(changed);
+        }
+        voip_rls::States states;
+        failures += voip_rls::parse_notify(body.content_type, body.text.data(), body.text.size(), "", states);
+        for (const auto &st : states) lamps[st.first] = st.second;
+        resources += states.size();
+        ++notifies;
+        ++window_notifies;
+        if (Clock::now() >= window_end) {
+            per_window.push_back(window_notifies);
+            window_notifies = 0;
+            window_end += std::chrono::milliseconds(250);
+            if (per_window.size() == 2) rss_warm = rss_kib();
+        }
+    }
+
+    EXPECT_EQ(failures, 0u);
+    ASSERT_EQ(lamps.size(), (size_t)kLamps);
+    size_t mismatches = 0;
+    for (const auto &lamp : sent) {
+        if (lamps[lamp.first] != kPresence.at(lamp.second)) ++mismatches;
+    }
+    EXPECT_EQ(mismatches, 0u) << "lamps not in the last state sent";
+    if (rss_warm > 0) EXPECT_LT(rss_kib() - rss_warm, 4 * 1024);
+    ASSERT_GE(per_window.size(), 4u);
+    std::vector<uint64_t> sorted(per_window.begin() + 1, per_window.end());
+    std::sort(sorted.begin(), sorted.end());
+    const uint64_t median = sorted[sorted.size() / 2];
+    EXPECT_GE(sorted[sorted.size() / 4], median / 4) << "throughput decayed over the run";
+    EXPECT_GE(median * 4, kStormRate) << "parser slower than the storm";
+    printf("[ soak     ] %llu NOTIFYs (%llu resource states) in %zu windows, median %llu per 250 ms\n",
+           (unsigned long long)notifies, (unsigned long long)resources, per_window.size(),
+           (unsigned long long)median);
+}
@@ -0,0 +1,133 @@
+#include "voip_srtp.h"
+
+#include <gtest/gtest.h>
+
+#include <srtp2/srtp.h>
+#include <string.h>
+
+#include <vector>
+
+namespace {
+
+using voip_srtp::SuiteCost;
+
+SuiteCost cost(uint32_t protect_ns, uint32_t unprotect_ns) {
+    SuiteCost c;
+    c.available = true;
+    c.protect_ns = protect_ns;
+    c.unprotect_ns = unprotect_ns;
+    return c;
+}
+
+int index_of(const char *name) { return voip_srtp::suite_index(name, strlen(name)); }
+
+// Sessions as pjmedia's SRTP transport sets them up for AES_CM_128_HMAC_SHA1_80
+srtp_t session(srtp_ssrc_type_t direction, uint8_t *key) {
+    srtp_init();  // Each test runs in its own process; a second call only reports bad_param
+    srtp_policy_t policy;
+    memset(&policy, 0, sizeof(policy));
+    srtp_crypto_policy_set_aes_cm_128_hmac_sha1_80(&policy.rtp);
+    srtp_crypto_policy_set_aes_cm_128_hmac_sha1_80(&policy.rtcp);
+    policy.ssrc.type = direction;
+    policy.key = key;
+    policy.window_size = 128;
+    srtp_t s = nullptr;
+    return srtp_create(&s, &policy) == srtp_err_status_ok ? s : nullptr;
+}
+
+uint64_t live_packets() {
+    voip_srtp::LiveCost live = voip_srtp::live_cost();
+    return live.protect_packets + live.unprotect_packets;
+}
+
+}  // namespace
+
+TEST(VoipSrtp, SuiteNamesMatchPjmedia) {
+    EXPECT_EQ(index_of("AES_CM_128_HMAC_SHA1_80"), 3);
+    EXPECT_EQ(index_of("AEAD_AES_256_GCM"), 0);
+    EXPECT_EQ(index_of("AES_CM_128_HMAC_SHA1_8"), -1);
+    EXPECT_EQ(voip_srtp::suite_index(nullptr, 0), -1);
+}
+
+// Every libsrtp build has the AES-CM suites; GCM needs its OpenSSL backend
+TEST(VoipSrtp, MeasuresTheSuitesLibsrtpProvides) {
+    const uint64_t live_before = live_packets();
+    for (size_t i = 0; i < voip_srtp::kSuiteCount; ++i) {
+        std::vector<uint32_t> protect, unprotect;
+        SuiteCost c = voip_srtp::measure_suite(i, 50, &protect, &unprotect);
+        if ((int)i >= index_of("AES_256_CM_HMAC_SHA1_80")) {
+            EXPECT_TRUE(c.available) << voip_srtp::kSuites[i];
+        }
+        if (!c.available) continue;
+        EXPECT_EQ(protect.size(), 50u) << voip_srtp::kSuites[i];
+        EXPECT_EQ(unprotect.size(), 50u) << voip_srtp::kSuites[i];
+        EXPECT_GT(c.protect_ns + c.unprotect_ns, 0u) << voip_srtp::kSuites[i];
+    }
+    EXPECT_EQ(live_packets(), live_before);  // Calibration is not live traffic
+}
+
+TEST(VoipSrtp, DefaultBudgetOffersEveryMeasuredSuite) {
+    SuiteCost costs[voip_srtp::kSuiteCount];
+    std::vector<size_t> available;
+    for (size_t i = 0; i < voip_srtp::kSuiteCount; ++i) {
+        costs[i] = voip_srtp::measure_suite(i, 200);
+        if (costs[i].available) available.push_back(i);
+    }
+    ASSERT_FALSE(available.empty());
+    // A few microseconds per packet on any AES-capable CPU: far below 0.1% of a core per call
+    EXPECT_EQ(voip_srtp::offered_suites(costs, voip_srtp::kDefaultBudgetUs), available);
+}
+
+TEST(VoipSrtp, BudgetKeepsStrongestFirstWithinIt) {
+    SuiteCost costs[voip_srtp::kSuiteCount] = {cost(9000, 9000), cost(3000, 3000), cost(6000, 6000),
+                                               cost(4000, 4000), cost(3500, 3500)};
+    // 50 packets/s: 900, 300, 600, 400 and 350 us per second of call
+    EXPECT_EQ(voip_srtp::offered_suites(costs, voip_srtp::kDefaultBudgetUs), (std::vector<size_t>{0, 1, 2, 3, 4}));
+    EXPECT_EQ(voip_srtp::offered_suites(costs, 400), (std::vector<size_t>{1, 3, 4}));
+    costs[1].available = false;
+    EXPECT_EQ(voip_srtp::offered_suites(costs, 400), (std::vector<size_t>{3, 4}));
+}
+
+TEST(VoipSrtp, CheapestAloneWhenNothingFits) {
+    SuiteCost costs[voip_srtp::kSuiteCount] = {cost(9000, 9000), SuiteCost(), cost(6000, 6000),
+                                               cost(4000, 4000), cost(5000, 5000)};
+    EXPECT_EQ(voip_srtp::offered_suites(costs, 100), (std::vector<size_t>{3}));
+    for (SuiteCost &c : costs) c.available = false;
+    EXPECT_TRUE(voip_srtp::offered_suites(costs, voip_srtp::kDefaultBudgetUs).empty());
+}
+
+// The link wraps srtp_protect/srtp_unprotect as the engine's does: calls made as pjmedia makes
+// them are counted as live packets and reported to the observer
+TEST(VoipSrtp, LivePacketsGoThroughTheWrap) {
+    static std::vector<std::pair<bool, uint32_t>> observed;
+    observed.clear();
+    voip_srtp::set_packet_observer([](bool protect, uint32_t ns) { observed.emplace_back(protect, ns); });
+
+    uint8_t key[SRTP_MAX_KEY_LEN];
+    for (size_t i = 0; i < sizeof(key); ++i) key[i] = (uint8_t)(i * 7 + 3);
+    srtp_t tx = session(ssrc_any_outbound, key);
+    srtp_t rx = session(ssrc_any_inbound, key);
+    ASSERT_NE(tx, nullptr);
+    ASSERT_NE(rx, nullptr);
+
+    const voip_srtp::LiveCost before = voip_srtp::live_cost();
+    for (uint16_t seq = 1; seq <= 10; ++seq) {
+        uint8_t pkt[12 + 160 + SRTP_MAX_TRAILER_LEN] = {0x80, 0x00, (uint8_t)(seq >> 8), (uint8_t)seq,
+                                                        0, 0, 0, 0, 0x12, 0x34, 0x56, 0x78};
+        int len = 12 + 160;
+        ASSERT_EQ(srtp_protect(tx, pkt, &len), srtp_err_status_ok);
+        ASSERT_EQ(srtp_unprotect(rx, pkt, &len), srtp_err_status_ok);
+        EXPECT_EQ(len, 12 + 160);
+    }
+    const voip_srtp::LiveCost after = voip_srtp::live_cost();
+    voip_srtp::set_packet_observer(nullptr);
+    srtp_dealloc(tx);
+    srtp_dealloc(rx);
+
+    EXPECT_EQ(after.protect_packets - before.protect_packets, 10u);
+    EXPECT_EQ(after.unprotect_packets - before.unprotect_packets, 10u);
+    EXPECT_GT(after.protect_ns, before.protect_ns);
+    ASSERT_EQ(observed.size(), 20u);
+    EXPECT_TRUE(observed[0].first);
+    EXPECT_FALSE(observed[1].first);
+}
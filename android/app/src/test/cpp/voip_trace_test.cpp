@@ -0,0 +1,100 @@
+#include "voip_trace.h"
+
+#include <gtest/gtest.h>
+
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+#include <stdio.h>
+#include <unistd.h>
+
+namespace {
+
+std::string temp_path(const char *name) {
+    return std::string(testing::TempDir()) + name + "." + std::to_string(getpid());
+}
+
+std::string read_file(const std::string &path) {
+    std::ifstream in(path);
+    std::stringstream text;
+    text << in.rdbuf();
+    return text.str();
+}
+
+size_t count(const std::string &text, const std::string &needle) {
+    size_t n = 0;
+    for (size_t at = text.find(needle); at != std::string::npos; at = text.find(needle, at + 1)) n++;
+    return n;
+}
+
+}  // namespace
+
+TEST(VoipTrace, DumpsScopesInstantsAndFlowsAsChromeTrace) {
+    voip_trace::set_thread_name("test");
+    {
+        VOIP_TRACE_SCOPE("test", "scope_span");
+        VOIP_TRACE_INSTANT("test", "instant_mark", "with \"quotes\"\n");
+        VOIP_TRACE_FLOW_BEGIN("test", "flow_arrow", 42);
+    }
+    VOIP_TRACE_FLOW_END("test", "flow_arrow", 42);
+
+    std::string path = temp_path("trace_dump.json");
+    ASSERT_GT(voip_trace::dump(path.c_str()), 0);
+    std::string json = read_file(path);
+    unlink(path.c_str());
+
+    EXPECT_EQ(json.rfind("{\"displayTimeUnit\":\"ms\",\"traceEvents\":[", 0), 0u);
+    EXPECT_NE(json.find("\"args\":{\"name\":\"test\"}"), std::string::npos);
+    EXPECT_NE(json.find("\"ph\":\"X\",\"cat\":\"test\",\"name\":\"scope_span\""), std::string::npos);
+    EXPECT_NE(json.find("\"detail\":\"with \\\"quotes\\\"\\u000a\""), std::string::npos);
+    EXPECT_NE(json.find("\"ph\":\"s\",\"cat\":\"test\",\"name\":\"flow_arrow\""), std::string::npos);
+    EXPECT_NE(json.find("\"ph\":\"f\",\"cat\":\"test\",\"name\":\"flow_arrow\""), std::string::npos);
+    EXPECT_NE(json.find("\"bp\":\"e\""), std::string::npos);
+    EXPECT_EQ(json.substr(json.size() - 4), "\n]}\n");
+}
+
+TEST(VoipTrace, DisabledRecorderDropsEvents) {
+    voip_trace::set_enabled(false);
+    VOIP_TRACE_INSTANT("test", "while_disabled", nullptr);
+    voip_trace::set_enabled(true);
+
+    std::string path = temp_path("trace_disabled.json");
+    ASSERT_GE(voip_trace::dump(path.c_str()), 0);
+    std::string json = read_file(path);
+    unlink(path.c_str());
+    EXPECT_EQ(json.find("while_disabled"), std::string::npos);
+}
+
+// Writers on several threads lap the ring while it is dumped: every dumped event must be whole
+TEST(VoipTrace, ConcurrentWritersOverwriteOldestAndDumpStaysConsistent) {
+    constexpr int kThreads = 4;
+    constexpr int kPerThread = 20000;  // 80000 events: the 16384-slot ring wraps several times
+    std::vector<std::thread> writers;
+    for (int t = 0; t < kThreads; ++t) {
+        writers.emplace_back([] {
+            for (int i = 0; i < kPerThread; ++i) VOIP_TRACE_INSTANT("load", "lap_event", "0123456789");
+        });
+    }
+    std::string during = temp_path("trace_during.json");
+    long written_during = voip_trace::dump(during.c_str());
+    for (auto &writer : writers) writer.join();
+    EXPECT_GE(written_during, 0);
+    std::string json = read_file(during);
+    unlink(during.c_str());
+    EXPECT_EQ(count(json, "\"name\":\"lap_event\""), count(json, "\"detail\":\"0123456789\""));
+
+    std::string after = temp_path("trace_after.json");
+    long written = voip_trace::dump(after.c_str());
+    json = read_file(after);
+    unlink(after.c_str());
+    // Only the newest ring-full survives; the first events of the test are long gone
+    EXPECT_LE(written, 16384 + 1);
+    EXPECT_EQ(json.find("scope_span"), std::string::npos);
+    EXPECT_GE(count(json, "\"name\":\"lap_event\""), 16000u);
+}
+
+TEST(VoipTrace, DumpToUnwritablePathFails) {
+    EXPECT_EQ(voip_trace::dump("/nonexistent-dir/trace.json"), -1);
+}
@@ -43,6 +43,33 @@ build_for_abi() {
   export ANDROID_NDK="${NDK_PATH}"
   export TARGET_ABI="${abi}"
   export APP_PLATFORM="android-${API_LEVEL}"
+  # One section per function/object so the voip_engine link (--gc-sections, --icf) can drop
+  # what the engine never references
+  export CFLAGS="${CFLAGS:-} -ffunction-sections -fdata-sections"
+  # Profile-guided build, see pgo.sh: PJSIP_PGO=generate|use (PJSIP_PGO_PROFILE for use)
+  case "${PJSIP_PGO:-off}" in
+    generate)
+      CFLAGS="${CFLAGS} -fprofile-generate"
+      export LDFLAGS="${LDFLAGS:-} -fprofile-generate"
+      ;;
+    use)
+      CFLAGS="${CFLAGS} -fprofile-use=${PJSIP_PGO_PROFILE:-${ROOT_DIR}/pgo/voip_engine.profdata}"
+      CFLAGS="${CFLAGS} -Wno-profile-instr-out-of-date -Wno-profile-instr-unprofiled"
+      ;;
+  esac
+  # Media encryption, see "Media encryption (SRTP)" in voip_engine.cpp: PJSIP_SRTP=1 builds
+  # pjproject's bundled libsrtp against OpenSSL (OPENSSL_DIR: an Android build with include/
+  # and lib/libssl.a, lib/libcrypto.a), whose EVP AES uses the ARMv8 crypto extensions.
+  # config_site.h switches SRTP, DTLS-SRTP and AES-GCM on when VOIP_SRTP is defined.
+  local ssl_opt="--with-ssl=no"
+  if [[ "${PJSIP_SRTP:-0}" == "1" ]]; then
+    if [[ -z "${OPENSSL_DIR:-}" || ! -f "${OPENSSL_DIR}/lib/libcrypto.a" ]]; then
+      echo "ERROR: PJSIP_SRTP=1 needs OPENSSL_DIR with lib/libssl.a and lib/libcrypto.a" >&2
+      exit 1
+    fi
+    ssl_opt="--with-ssl=${OPENSSL_DIR}"
+    CFLAGS="${CFLAGS} -DVOIP_SRTP=1"
+  fi
 
   local host_triple=""
   case "${abi}" in
@@ -59,7 +86,7 @@ build_for_abi() {
 
   ./configure-android \
     --use-ndk-cflags \
-    --with-ssl=no \
+    "${ssl_opt}" \
     --with-sdl=no \
     --with-openh264=no \
     --with-v4l2=no \
@@ -77,6 +104,10 @@ build_for_abi() {
   make dep
   make clean
   make
+  if [[ "${PJSIP_SRTP:-0}" == "1" ]]; then
+    # third_party is skipped above: libsrtp is the one bundled library needed
+    make -C third_party/build/srtp
+  fi
 
   local out_dir="${ROOT_DIR}/../app/src/main/jniLibs/${abi}"
   mkdir -p "${out_dir}"
@@ -139,24 +170,13 @@ build_for_abi() {
     copy_norm "pjsip/lib" "pjsip-simple" "libpjsip-simple*.so" "libpjsip-simple*.a" "libpjsip-simple.so" "libpjsip-simple.a"
     copy_norm "pjsip/lib" "pjsip-ua" "libpjsip-ua*.so" "libpjsip-ua*.a" "libpjsip-ua.so" "libpjsip-ua.a"
     copy_norm "pjsip/lib" "pjsua" "libpjsua*.so" "libpjsua*.a" "libpjsua.so" "libpjsua.a"
-    copy_norm "pjsip/lib" "pjsua2" "libpjsua2*.so" "libpjsua2*.a" "libpjsua2.so" "libpjsua2.a"
-
-    # Locate and copy pjsua2 (shared or static) since path varies per toolchain
-    local pjsua2_lib
-    # Try ABI-specific match first; otherwise grab any available libpjsua2.
-    pjsua2_lib=$(find . \( -name "libpjsua2*${abi}*.so" -o -name "libpjsua2*${abi}*.a" \) -print -quit || true)
-    if [[ -z "$pjsua2_lib" ]]; then
-      pjsua2_lib=$(find . -name "libpjsua2*.so" -o -name "libpjsua2*.a" | head -n1 || true)
-    fi
-    if [[ -n "$pjsua2_lib" ]]; then
-      # Normalize name so CMake expects libpjsua2.(so|a) without extra suffixes.
-      if [[ "$pjsua2_lib" == *.so ]]; then
-        cp -a "$pjsua2_lib" "${out_dir}/libpjsua2.so"
-      else
-        cp -a "$pjsua2_lib" "${out_dir}/libpjsua2.a"
-      fi
+    # pjsua2 (C++ API) is not copied: voip_engine only links the C pjsua API
+    if [[ "${PJSIP_SRTP:-0}" == "1" ]]; then
+      copy_norm "third_party/lib" "srtp" "libsrtp*.so" "libsrtp*.a" "libsrtp.so" "libsrtp.a"
+      cp -a "${OPENSSL_DIR}/lib/libssl.a" "${OPENSSL_DIR}/lib/libcrypto.a" "${out_dir}/"
     else
-      echo "WARN: libpjsua2 (so/a) not found for ${abi}; SIP JNI may fail" >&2
+      # CMake enables VOIP_SRTP when libsrtp.a is present
+      rm -f "${out_dir}/libsrtp.a" "${out_dir}/libsrtp.so" "${out_dir}/libssl.a" "${out_dir}/libcrypto.a"
     fi
   popd >/dev/null
 }
@@ -23,14 +23,32 @@
 #define PJMEDIA_HAS_SPEEX_CODEC           0
 #define PJMEDIA_HAS_ILBC_CODEC            0
 #define PJMEDIA_HAS_SILK_CODEC            0
+#define PJMEDIA_HAS_G7221_CODEC           0
+#define PJMEDIA_HAS_G729_CODEC            0
+#define PJMEDIA_HAS_PASSTHROUGH_CODECS    0
+#define PJMEDIA_HAS_BCG729                0
+#define PJMEDIA_HAS_OPENCORE_AMRNB_CODEC  0
+#define PJMEDIA_HAS_OPENCORE_AMRWB_CODEC  0
+#define PJMEDIA_HAS_LYRA_CODEC            0
 
 /* Audio backend: use Android JNI (OpenSL ES has issues in 2.17) */
 #define PJMEDIA_AUDIO_DEV_HAS_OPENSL      0
 #define PJMEDIA_AUDIO_DEV_HAS_ANDROID_JNI 1
 #define PJMEDIA_AUDIO_DEV_HAS_PORTAUDIO   0
 
-/* Security / SRTP left out intentionally for minimal footprint */
+/* SRTP only in VOIP_SRTP builds (build_pjsip.sh PJSIP_SRTP=1, libsrtp + OpenSSL): SDES and
+ * DTLS-SRTP keying, AES-GCM suites. Left out otherwise for minimal footprint. */
+#if defined(VOIP_SRTP) && VOIP_SRTP
+#define PJMEDIA_HAS_SRTP                  1
+#define PJMEDIA_SRTP_HAS_DTLS             1
+#define PJMEDIA_SRTP_HAS_AES_GCM_128      1
+#define PJMEDIA_SRTP_HAS_AES_GCM_256      1
+#else
 #define PJMEDIA_HAS_SRTP                  0
+#endif
+
+/* IPv6 sockets, so the resolver accepts the IPv6 nameservers of IPv6-only and dual-stack networks */
+#define PJ_HAS_IPV6                       1
 
 /* Optimize for mobile VoIP */
 #define PJ_ENABLE_EXTRA_CHECK             0
@@ -39,7 +57,8 @@
 #define PJMEDIA_ECHO_SUPPRESSOR           0
 #define PJMEDIA_ECHO_USE_SIMPLE_FILTER    0
 
-/* Disable Speex AEC explicitly */
+/* Disable Speex AEC explicitly. Echo cancellation is the engine's own (voip_aec.h), put in the
+ * capture path by refreshAudio when enabled from PjsipEngine.setEchoCanceller() */
 #define PJMEDIA_HAS_SPEEX_AEC             0
 #define PJMEDIA_HAS_SPEEX_AEC_PREPROCESS  0
 #define PJMEDIA_HAS_SPEEX_AEC3            0
@@ -53,10 +72,28 @@
 #define PJMEDIA_HAS_ANDROID_MEDIACODEC    0
 #define PJMEDIA_SOUND_BUFFER_COUNT        4
 
-/* Disable AGC/NS to prevent automatic microphone gain reduction on Android OpenSL ES */
-/* AGC causes the microphone gain to drop significantly after a few seconds of call */
-#define PJMEDIA_HAS_ILBC_CODEC            0
-#define PJMEDIA_HAS_G729_CODEC            0
+/* Memory footprint: pjsua's call and account tables sized for a mobile client instead of a
+ * desktop softphone (defaults 32 calls / 8 accounts). Runtime limits below these caps are set
+ * by the memory profile in voip_engine.cpp. The buddy table keeps pjsua's 256 entries, one
+ * per BLF lamp; a smaller one can be built with -DPJSUA_MAX_BUDDIES=n. A full table is
+ * reported to the app as a presence_error event. */
+#define PJSUA_MAX_CALLS                   4
+#define PJSUA_MAX_ACC                     4
+#ifndef PJSUA_MAX_BUDDIES
+#define PJSUA_MAX_BUDDIES                 256
+#endif
+
+/* Lean build: features the engine never uses (built with --with-ssl=no, UDP/TCP only, no
+ * video, digest auth only), so their code and static tables leave the .so. DTLS-SRTP needs
+ * the OpenSSL socket, so VOIP_SRTP keeps it (still without the SIP TLS transport). */
+#if !defined(VOIP_SRTP) || !VOIP_SRTP
+#define PJ_HAS_SSL_SOCK                   0
+#endif
+#define PJSIP_HAS_TLS_TRANSPORT           0
+#define PJMEDIA_HAS_RTCP_XR               0
+#define PJMEDIA_STREAM_ENABLE_XR          0
+#define PJ_OS_HAS_CHECK_STACK             0
+#define PJSIP_HAS_DIGEST_AKA_AUTH         0
 
 /* Enable JNI for Android audio */
 #define PJ_ANDROID_JNI                     1
@@ -0,0 +1,115 @@
+#!/usr/bin/env bash
+set -euo pipefail
+
+# Profile-guided optimisation of libvoip_engine.so (engine + static pjproject).
+#
+#   1. baseline: pjproject and the release APK without profile, benchmark timings recorded
+#   2. generate: instrumented pjproject and APK, the workload writes voip_engine.profraw
+#   3. merge:    llvm-profdata merges the raw profiles into pgo/voip_engine.profdata
+#   4. use:      pjproject and the APK rebuilt with the profile, benchmark timings recorded
+#   5. report:   per-benchmark baseline vs PGO time and speedup
+#
+# The training workload only exists in the instrumented build (voip_pgo.cpp): REGISTER, call
+# cycle and BLF NOTIFY traffic through pjsip's loopback transport, G.711 and bridge ticks. The
+# baseline and optimised builds run the benchmarks (PjsipEngine.runPgoBenchmarks: event
+# dispatch, echo canceller, SRTP when built in) instead. It runs on a connected arm64 device
+# (adb), with release signing configured as for any release build.
+# Usage: pgo.sh [iterations]    (default 2000)
+
+ITERATIONS="${1:-2000}"
+ROOT_DIR="$(cd "$(dirname "${BASH_SOURCE[0]}")" && pwd)"
+ANDROID_DIR="${ROOT_DIR}/.."
+PGO_DIR="${ROOT_DIR}/pgo"
+OUT_DIR="${PGO_DIR}/out"
+PROFILE="${PGO_DIR}/voip_engine.profdata"
+PACKAGE="fr.celya.celyavox"
+DEVICE_DIR="/sdcard/Android/data/${PACKAGE}/files"
+
+if [[ -z "${ANDROID_NDK_ROOT:-}" && -z "${NDK_HOME:-}" ]]; then
+  echo "ERROR: ANDROID_NDK_ROOT (or NDK_HOME) must be set" >&2
+  exit 1
+fi
+NDK_PATH="${ANDROID_NDK_ROOT:-${NDK_HOME}}"
+PROFDATA="$(find "${NDK_PATH}/toolchains/llvm/prebuilt" -name llvm-profdata -type f -print -quit)"
+if [[ -z "${PROFDATA}" ]]; then
+  echo "ERROR: llvm-profdata not found in ${NDK_PATH}" >&2
+  exit 1
+fi
+
+build_variant() {
+  local mode="$1"
+  echo "=== Building pjproject + APK (VOIP_PGO=${mode}) ==="
+  local pjsip_pgo="off"
+  [[ "${mode}" == "generate" || "${mode}" == "use" ]] && pjsip_pgo="${mode}"
+  touch "${OUT_DIR}/.build_start"
+  PJSIP_PGO="${pjsip_pgo}" PJSIP_PGO_PROFILE="${PROFILE}" "${ROOT_DIR}/build_pjsip.sh"
+  pushd "${ANDROID_DIR}" >/dev/null
+  # CMake caches VOIP_PGO per variant directory: start each mode from a clean native build
+  rm -rf app/.cxx
+  ./gradlew --quiet assembleRelease "-PvoipPgo=${mode}"
+  popd >/dev/null
+}
+
+run_workload() {
+  local mode="$1"
+  local apk
+  # Flutter moves the Gradle build dir to <project>/build/app
+  apk="$(find "${ANDROID_DIR}/../build" "${ANDROID_DIR}/app/build" -path '*outputs/apk/release/*.apk' \
+    -newer "${OUT_DIR}/.build_start" -print -quit 2>/dev/null || true)"
+  if [[ -z "${apk}" ]]; then
+    echo "ERROR: release APK not found (is release signing configured?)" >&2
+    exit 1
+  fi
+  echo "=== Running $([[ "${mode}" == "generate" ]] && echo workload || echo benchmarks) (${mode}, ${ITERATIONS} iterations) ==="
+  adb install -r "${apk}" >/dev/null
+  adb shell am force-stop "${PACKAGE}"
+  adb shell rm -f "${DEVICE_DIR}/pgo_report.txt" "${DEVICE_DIR}/voip_engine.profraw"
+  adb shell am start -n "${PACKAGE}/.MainActivity" --ei pgoWorkload "${ITERATIONS}" >/dev/null
+  local waited=0
+  until adb shell test -s "${DEVICE_DIR}/pgo_report.txt"; do
+    sleep 2
+    waited=$((waited + 2))
+    if (( waited > 600 )); then
+      echo "ERROR: no workload report after ${waited}s (adb logcat -s PjsipEngine)" >&2
+      exit 1
+    fi
+  done
+  adb pull "${DEVICE_DIR}/pgo_report.txt" "${OUT_DIR}/${mode}.txt" >/dev/null
+  if [[ "${mode}" == "generate" ]]; then
+    adb pull "${DEVICE_DIR}/voip_engine.profraw" "${OUT_DIR}/voip_engine-$(date +%s).profraw" >/dev/null
+  fi
+  adb shell am force-stop "${PACKAGE}"
+}
+
+merge_profiles() {
+  echo "=== Merging profiles ==="
+  "${PROFDATA}" merge -output="${PROFILE}" "${OUT_DIR}"/*.profraw
+}
+
+report() {
+  echo "=== Speedup (ns or us per iteration, lower is better) ==="
+  printf "%-28s %12s %12s %8s\n" "benchmark" "baseline" "pgo" "speedup"
+  awk '
+    NR == FNR { if ($1 ~ /(_ns|_frame_us)$/) base[$1] = $2; next }
+    $1 ~ /(_ns|_frame_us)$/ && ($1 in base) {
+      speedup = ($2 > 0 && base[$1] > 0) ? sprintf("%.2fx", base[$1] / $2) : "n/a"
+      printf "%-28s %12s %12s %8s\n", $1, base[$1], $2, speedup
+    }
+  ' "${OUT_DIR}/baseline.txt" "${OUT_DIR}/use.txt" | tee "${OUT_DIR}/speedup.txt"
+}
+
+main() {
+  mkdir -p "${OUT_DIR}"
+  rm -f "${OUT_DIR}"/*.profraw
+  build_variant baseline
+  run_workload baseline
+  build_variant generate
+  run_workload generate
+  merge_profiles
+  build_variant use
+  run_workload use
+  report
+  echo "Profile: ${PROFILE} (build with -PvoipPgo=use and PJSIP_PGO=use to reuse it)"
+}
+
+main "$@"
@@ -0,0 +1,135 @@
+#!/usr/bin/env bash
+set -euo pipefail
+
+# Soak and stress run of the native engine against a local stand-in PBX (standin_pbx.php).
+#
+#   1. the PBX starts on this machine (UDP, port SOAK_PORT and SOAK_PORT+2 for RTP)
+#   2. the debug app installed on the adb device runs SoakRunner (MainActivity, EXTRA_SOAK_PBX):
+#      BLF list of SOAK_BUDDIES lamps under a NOTIFY storm of SOAK_RATE/s for <storm seconds>,
+#      per-contact subscription churn, account switching (three accounts, each subscribing its
+#      lamps and calling, then one removed), then <cycles> REGISTER / call / hangup cycles, null
+#      audio, then <restarts> endpoint destroy / init / REGISTER cycles
+#   3. both sides' reports are pulled into out/ and checked:
+#      - device asserts (bounded native heap and pools, no leaked call or buddy slots, no lost
+#        call transitions, stable event dispatch throughput, no PJSUA call under a native lock,
+#        native heap and thread count flat across endpoint restarts)
+#      - every lamp ends in the state the PBX last sent, every NOTIFY got a 2xx
+#      - every INVITE the PBX answered was hung up
+#      - every SUBSCRIBE and INVITE of the account phase came with the From and digest user of
+#        the account that was active when it was sent
+#
+# The engine itself (voip_engine.cpp: JNI over pjproject) only builds for Android, hence the
+# device run. Its pjproject-free modules build on the host too (android/app/src/test/cpp), where
+# the event ring, the call detail log and the resource list NOTIFY parser (500-lamp storm) have
+# their own soak: ctest -L soak, VOIP_SOAK_SECONDS per test.
+#
+# Needs php (CLI) and a debuggable build of the app without a configured account.
+# SOAK_PBX_HOST is how the device reaches this machine: 10.0.2.2 from the emulator (default),
+# the LAN address for a phone on Wi-Fi.
+# Usage: soak.sh [cycles] [storm seconds] [restarts]    (default 10000, 600 and 1000)
+
+CYCLES="${1:-10000}"
+STORM_SECONDS="${2:-600}"
+RESTARTS="${3:-1000}"
+PBX_HOST="${SOAK_PBX_HOST:-10.0.2.2}"
+PORT="${SOAK_PORT:-5062}"
+BUDDIES="${SOAK_BUDDIES:-500}"
+RATE="${SOAK_RATE:-2000}"
+ROOT_DIR="$(cd "$(dirname "${BASH_SOURCE[0]}")" && pwd)"
+OUT_DIR="${ROOT_DIR}/out"
+PACKAGE="fr.celya.celyavox"
+DEVICE_DIR="/sdcard/Android/data/${PACKAGE}/files"
+
+if ! command -v php >/dev/null; then
+  echo "ERROR: php (CLI) not found" >&2
+  exit 1
+fi
+
+mkdir -p "${OUT_DIR}"
+rm -f "${OUT_DIR}"/*.txt
+
+echo "=== Starting stand-in PBX on udp/${PORT} (reached as ${PBX_HOST}) ==="
+php "${ROOT_DIR}/standin_pbx.php" --host "${PBX_HOST}" --port "${PORT}" --buddies "${BUDDIES}" \
+  --rate "${RATE}" --storm "${STORM_SECONDS}" --out "${OUT_DIR}" 2>"${OUT_DIR}/pbx.log" &
+PBX_PID=$!
+trap 'kill "${PBX_PID}" 2>/dev/null || true' EXIT
+sleep 1
+if ! kill -0 "${PBX_PID}" 2>/dev/null; then
+  cat "${OUT_DIR}/pbx.log" >&2
+  exit 1
+fi
+
+echo "=== Running soak (${BUDDIES} lamps, ${RATE} NOTIFY/s for ${STORM_SECONDS}s, ${CYCLES} call cycles, ${RESTARTS} restarts) ==="
+adb shell am force-stop "${PACKAGE}"
+adb shell rm -f "${DEVICE_DIR}/soak_report.txt" "${DEVICE_DIR}/soak_blf_states.txt" "${DEVICE_DIR}/soak_accounts.txt"
+adb shell am start -n "${PACKAGE}/.MainActivity" --es soakPbx "${PBX_HOST}:${PORT}" \
+  --ei soakBuddies "${BUDDIES}" --ei soakStormSeconds "${STORM_SECONDS}" --ei soakCycles "${CYCLES}" \
+  --ei soakRestarts "${RESTARTS}" >/dev/null
+# A cycle or restart takes well under a second; allow two, plus the storm and its settling
+LIMIT=$((STORM_SECONDS + (CYCLES + RESTARTS) * 2 + 600))
+waited=0
+until adb shell test -s "${DEVICE_DIR}/soak_report.txt"; do
+  sleep 10
+  waited=$((waited + 10))
+  if (( waited > LIMIT )); then
+    echo "ERROR: no soak report after ${waited}s (adb logcat -s SoakRunner PjsipEngine)" >&2
+    exit 1
+  fi
+done
+adb pull "${DEVICE_DIR}/soak_report.txt" "${OUT_DIR}/soak_report.txt" >/dev/null
+adb pull "${DEVICE_DIR}/soak_blf_states.txt" "${OUT_DIR}/soak_blf_states.txt" >/dev/null || true
+adb pull "${DEVICE_DIR}/soak_accounts.txt" "${OUT_DIR}/soak_accounts.txt" >/dev/null || true
+adb shell am force-stop "${PACKAGE}"
+
+# The PBX rewrites its report every 5 s; let it catch up with the last BYE
+sleep 6
+kill "${PBX_PID}" 2>/dev/null || true
+wait "${PBX_PID}" 2>/dev/null || true
+
+pbx() { awk -v k="$1" '$1 == k { print $2 }' "${OUT_DIR}/pbx_report.txt"; }
+
+echo "=== Results ==="
+failures=0
+check() {
+  local name="$1" ok="$2"
+  if [[ "${ok}" == "1" ]]; then
+    echo "pass  ${name}"
+  else
+    echo "FAIL  ${name}"
+    failures=$((failures + 1))
+  fi
+}
+
+while read -r name result; do
+  check "${name#assert.}" "$([[ "${result}" == "pass" ]] && echo 1 || echo 0)"
+done < <(grep '^assert\.' "${OUT_DIR}/soak_report.txt")
+
+mismatches="$(join <(sort "${OUT_DIR}/pbx_blf_states.txt") <(sort "${OUT_DIR}/soak_blf_states.txt" 2>/dev/null) \
+  | awk '$2 != $3' | tee "${OUT_DIR}/blf_mismatches.txt" | wc -l)"
+lamps="$(sort "${OUT_DIR}/soak_blf_states.txt" 2>/dev/null | join - <(sort "${OUT_DIR}/pbx_blf_states.txt") | wc -l)"
+echo "      BLF: $(pbx storm_notify) storm NOTIFYs, ${lamps}/${BUDDIES} lamps compared, ${mismatches} mismatch(es)"
+check "blf.final_states_match" "$([[ "${lamps}" == "${BUDDIES}" && "${mismatches}" == "0" ]] && echo 1 || echo 0)"
+echo "      NOTIFY: $(pbx notify_sent) sent, $(pbx notify_ok) answered 2xx, $(pbx notify_failed) failed"
+check "pbx.notify_all_answered" "$([[ "$(pbx notify_sent)" == "$(pbx notify_ok)" ]] && echo 1 || echo 0)"
+echo "      Calls: $(pbx invite) INVITE, $(pbx answered) answered, $(pbx bye) BYE, $(pbx calls.open) still open"
+check "pbx.calls_hung_up" "$([[ "$(pbx invite)" == "$(pbx bye)" && "$(pbx calls.open)" == "0" ]] && echo 1 || echo 0)"
+check "pbx.subscriptions_closed" "$([[ "$(pbx subscriptions.open)" == "0" ]] && echo 1 || echo 0)"
+
+# soak_accounts.txt: "<request-URI user> <account>"; pbx_identities.txt: "<request-URI user>
+# <From user> <digest user>" for each authenticated SUBSCRIBE and INVITE (refreshes included).
+# Missing when a side never got there: empty, so the check fails instead of the script.
+touch "${OUT_DIR}/soak_accounts.txt" "${OUT_DIR}/pbx_identities.txt"
+wrong_identity="$(awk 'NR == FNR { want[$1] = $2; next }
+  ($1 in want) { seen[$1] = 1; if ($2 != want[$1] || $3 != want[$1]) { print; bad++ } }
+  END { for (k in want) if (!(k in seen)) { print k " never seen"; bad++ } }' \
+  "${OUT_DIR}/soak_accounts.txt" "${OUT_DIR}/pbx_identities.txt" \
+  | tee "${OUT_DIR}/identity_mismatches.txt" | wc -l)"
+requests="$(wc -l < "${OUT_DIR}/soak_accounts.txt")"
+echo "      Accounts: ${requests} request target(s), ${wrong_identity} wrong or missing identity, $(pbx auth_failed) rejected credential(s)"
+check "pbx.account_identities" "$([[ "${requests}" -gt 0 && "${wrong_identity}" == "0" && "$(pbx auth_failed)" == "0" ]] && echo 1 || echo 0)"
+
+echo "Reports: ${OUT_DIR}"
+if (( failures > 0 )); then
+  echo "${failures} check(s) failed" >&2
+  exit 1
+fi
@@ -0,0 +1,499 @@
+#!/usr/bin/env php
+<?php
+/**
+ * Stand-in PBX for the engine soak run (android/soak/soak.sh): a scripted SIP peer on UDP, no
+ * real media. It plays just enough of a PBX for the app's accounts:
+ *
+ *  - Digest authentication (MD5, qop=auth, realm "soak") of REGISTER, SUBSCRIBE and INVITE. Any
+ *    user exists, its password is its user name. A wrong response gets a 403.
+ *  - REGISTER: 200 OK.
+ *  - SUBSCRIBE Event: dialog to the list user (--list, Require: eventlist): RFC 4662 resource
+ *    list of --buddies lamps numbered from --first. The initial state goes out in chunks of a few
+ *    resources (UDP only: each NOTIFY stays well under pjsip's 4000-byte packet limit), later
+ *    changes as partial-state NOTIFYs. SUBSCRIBEs to a single lamp get plain dialog-info.
+ *  - Storm: once the list is subscribed, --rate NOTIFYs per second for --storm seconds, each one
+ *    moving a random lamp to another state (terminated, early, confirmed). Then quiet.
+ *  - INVITE: 100, 180, then 200 with a PCMU answer pointing at a discard RTP socket. BYE: 200.
+ *
+ * Every few seconds, and on exit (--duration elapsed, or SIGINT/SIGTERM with pcntl), writes
+ * <out>/pbx_report.txt ("name value" counters) and <out>/pbx_blf_states.txt (last state sent
+ * for each lamp, in the engine's words: available, ringing, busy). Every authenticated SUBSCRIBE
+ * and INVITE also appends "<request-URI user> <From user> <digest user>" to
+ * <out>/pbx_identities.txt, for soak.sh to check which account each one went out as.
+ *
+ * Usage: php standin_pbx.php --host 10.0.2.2 [--bind 0.0.0.0] [--port 5062] [--list lamps]
+ *        [--buddies 500] [--first 1000] [--rate 2000] [--storm 600] [--duration 0] [--out .]
+ */
+
+const CHUNK = 6;               // Resources per list NOTIFY: ~550 bytes each with the RLMI entry
+const STORM_BURST = 200;       // NOTIFYs sent per loop turn at most, so requests keep flowing
+const REPORT_EVERY_S = 5;
+const REALM = 'soak';
+const BOUNDARY = 'soak-boundary';
+const DIALOG_STATES = ['terminated', 'early', 'confirmed'];
+const ENGINE_STATES = ['terminated' => 'available', 'early' => 'ringing', 'confirmed' => 'busy'];
+const COMPACT_HEADERS = ['i' => 'call-id', 'f' => 'from', 't' => 'to', 'v' => 'via', 'm' => 'contact',
+    'l' => 'content-length', 'c' => 'content-type', 'o' => 'event', 'k' => 'supported'];
+
+$opts = getopt('', ['host:', 'bind:', 'port:', 'list:', 'buddies:', 'first:', 'rate:', 'storm:',
+    'duration:', 'out:']);
+$host = $opts['host'] ?? '127.0.0.1';  // Address the device reaches us at (Via, Contact, SDP)
+$bind = $opts['bind'] ?? '0.0.0.0';
+$port = (int)($opts['port'] ?? 5062);
+$listUser = $opts['list'] ?? 'lamps';
+$buddies = (int)($opts['buddies'] ?? 500);
+$firstLamp = (int)($opts['first'] ?? 1000);
+$rate = (int)($opts['rate'] ?? 2000);
+$stormSeconds = (int)($opts['storm'] ?? 600);
+$duration = (int)($opts['duration'] ?? 0);
+$outDir = rtrim($opts['out'] ?? '.', '/');
+
+$sock = stream_socket_server("udp://$bind:$port", $errno, $errstr, STREAM_SERVER_BIND);
+if (!$sock) {
+    fwrite(STDERR, "ERROR: cannot bind udp://$bind:$port: $errstr\n");
+    exit(1);
+}
+$rtpPort = $port + 2;
+$rtp = stream_socket_server("udp://$bind:$rtpPort", $errno, $errstr, STREAM_SERVER_BIND);
+if (!$rtp) {
+    fwrite(STDERR, "ERROR: cannot bind udp://$bind:$rtpPort: $errstr\n");
+    exit(1);
+}
+stream_set_blocking($sock, false);
+stream_set_blocking($rtp, false);
+
+$stats = ['register' => 0, 'subscribe' => 0, 'unsubscribe' => 0, 'notify_sent' => 0, 'notify_ok' => 0,
+    'notify_failed' => 0, 'storm_notify' => 0, 'invite' => 0, 'answered' => 0, 'bye' => 0,
+    'rtp_packets' => 0, 'other_requests' => 0, 'challenged' => 0, 'auth_failed' => 0];
+$nonce = bin2hex(random_bytes(8));  // One per run: pjsip keeps reusing it with a growing nc
+$identities = fopen("$outDir/pbx_identities.txt", 'w');
+$lamps = [];         // Lamp user => current dialog state
+$lampVersion = [];   // Lamp user => dialog-info version
+for ($i = 0; $i < $buddies; $i++) {
+    $lamps[(string)($firstLamp + $i)] = 'terminated';
+    $lampVersion[(string)($firstLamp + $i)] = 0;
+}
+$subs = [];          // Call-ID => subscription dialog (our side is the notifier)
+$lampSubs = [];      // Lamp user => Call-ID of its per-lamp subscription
+$listSub = null;     // Call-ID of the list subscription
+$calls = [];         // Call-ID => answered INVITE
+$branchSeq = 0;
+$stormStart = null;
+$stormSent = 0;
+$running = true;
+
+if (function_exists('pcntl_async_signals')) {
+    pcntl_async_signals(true);
+    $stop = function () use (&$running) { $running = false; };
+    pcntl_signal(SIGINT, $stop);
+    pcntl_signal(SIGTERM, $stop);
+}
+
+function parse_sip($data) {
+    $split = strpos($data, "\r\n\r\n");
+    if ($split === false) return null;
+    $lines = explode("\r\n", substr($data, 0, $split));
+    $start = array_shift($lines);
+    $headers = [];
+    foreach ($lines as $line) {
+        $colon = strpos($line, ':');
+        if ($colon === false) continue;
+        $name = strtolower(trim(substr($line, 0, $colon)));
+        $name = COMPACT_HEADERS[$name] ?? $name;
+        $headers[$name][] = trim(substr($line, $colon + 1));
+    }
+    $msg = ['start' => $start, 'headers' => $headers, 'body' => substr($data, $split + 4)];
+    if (strncmp($start, 'SIP/2.0 ', 8) === 0) {
+        $msg['status'] = (int)substr($start, 8, 3);
+    } else {
+        $parts = explode(' ', $start);
+        $msg['method'] = $parts[0];
+        $msg['uri'] = $parts[1] ?? '';
+    }
+    return $msg;
+}
+
+function header_value($msg, $name) {
+    return $msg['headers'][$name][0] ?? '';
+}
+
+// "Name <sip:x@y>;tag=1" or "sip:x@y;tag=1" → "sip:x@y"
+function uri_of($value) {
+    if (preg_match('/<([^>]+)>/', $value, $m)) return $m[1];
+    return explode(';', trim($value))[0];
+}
+
+// "sip:1000@pbx;user=phone" → "1000"
+function user_of($uri) {
+    return preg_match('/^sips?:([^@;>]+)@/i', $uri, $m) ? $m[1] : '';
+}
+
+function send_to($peer, $text) {
+    global $sock;
+    stream_socket_sendto($sock, $text, 0, $peer);
+}
+
+function build_response($msg, $code, $reason, $extra = [], $toTag = null, $contentType = '', $body = '') {
+    $out = "SIP/2.0 $code $reason\r\n";
+    foreach ($msg['headers']['via'] ?? [] as $via) $out .= "Via: $via\r\n";
+    $to = header_value($msg, 'to');
+    if ($toTag !== null && stripos($to, ';tag=') === false) $to .= ";tag=$toTag";
+    $out .= 'From: ' . header_value($msg, 'from') . "\r\n";
+    $out .= "To: $to\r\n";
+    $out .= 'Call-ID: ' . header_value($msg, 'call-id') . "\r\n";
+    $out .= 'CSeq: ' . header_value($msg, 'cseq') . "\r\n";
+    foreach ($extra as $line) $out .= "$line\r\n";
+    if ($contentType !== '') $out .= "Content-Type: $contentType\r\n";
+    return $out . 'Content-Length: ' . strlen($body) . "\r\n\r\n" . $body;
+}
+
+function respond($peer, $msg, $code, $reason, $extra = [], $toTag = null) {
+    send_to($peer, build_response($msg, $code, $reason, $extra, $toTag));
+}
+
+// 'Digest username="x", realm="y", ...' → [username => x, realm => y, ...]
+function digest_params($value) {
+    if (stripos($value, 'Digest ') !== 0) return [];
+    preg_match_all('/(\w+)=(?:"([^"]*)"|([^\s,]+))/', substr($value, 7), $m, PREG_SET_ORDER);
+    $params = [];
+    foreach ($m as $param) $params[strtolower($param[1])] = $param[2] !== '' ? $param[2] : ($param[3] ?? '');
+    return $params;
+}
+
+// Challenges requests without credentials, rejects wrong ones; returns the digest user name
+// of an authenticated request, null once it has been answered
+function authenticate($peer, $msg) {
+    global $nonce, $stats;
+    $auth = digest_params(header_value($msg, 'authorization'));
+    if (!isset($auth['username'], $auth['response']) || ($auth['nonce'] ?? '') !== $nonce) {
+        // Credentials for another nonce (a previous run of ours) are stale, not wrong
+        $stale = isset($auth['response']) ? ', stale=true' : '';
+        $stats['challenged']++;
+        respond($peer, $msg, 401, 'Unauthorized',
+            ['WWW-Authenticate: Digest realm="' . REALM . '", nonce="' . $nonce . '", algorithm=MD5, qop="auth"' . $stale],
+            bin2hex(random_bytes(4)));
+        return null;
+    }
+    $ha1 = md5($auth['username'] . ':' . REALM . ':' . $auth['username']);
+    $ha2 = md5($msg['method'] . ':' . ($auth['uri'] ?? ''));
+    $expected = isset($auth['qop'])
+        ? md5("$ha1:$nonce:" . ($auth['nc'] ?? '') . ':' . ($auth['cnonce'] ?? '') . ":{$auth['qop']}:$ha2")
+        : md5("$ha1:$nonce:$ha2");
+    if (!hash_equals($expected, $auth['response'])) {
+        $stats['auth_failed']++;
+        respond($peer, $msg, 403, 'Forbidden', [], bin2hex(random_bytes(4)));
+        return null;
+    }
+    return $auth['username'];
+}
+
+function log_identity($msg, $authUser) {
+    global $identities;
+    fwrite($identities, user_of($msg['uri']) . ' ' . user_of(uri_of(header_value($msg, 'from'))) . " $authUser\n");
+    fflush($identities);
+}
+
+function send_notify(&$sub, $subState, $contentType, $body) {
+    global $host, $port, $stats, $branchSeq;
+    $sub['cseq']++;
+    $branchSeq++;
+    $out = "NOTIFY {$sub['target']} SIP/2.0\r\n"
+        . "Via: SIP/2.0/UDP $host:$port;rport;branch=z9hG4bKsoak$branchSeq\r\n"
+        . "Max-Forwards: 70\r\n"
+        . "From: {$sub['local']}\r\n"
+        . "To: {$sub['remote']}\r\n"
+        . "Call-ID: {$sub['call_id']}\r\n"
+        . "CSeq: {$sub['cseq']} NOTIFY\r\n"
+        . "Contact: <sip:{$sub['user']}@$host:$port>\r\n"
+        . "Event: dialog\r\n"
+        . "Subscription-State: $subState\r\n"
+        . ($sub['list'] ? "Require: eventlist\r\n" : '')
+        . "Content-Type: $contentType\r\n"
+        . 'Content-Length: ' . strlen($body) . "\r\n\r\n" . $body;
+    send_to($sub['peer'], $out);
+    $stats['notify_sent']++;
+}
+
+function subscription_state($sub) {
+    return 'active;expires=' . max(0, $sub['expires_at'] - time());
+}
+
+function dialog_info($lamp) {
+    global $host, $lamps, $lampVersion;
+    return "<?xml version=\"1.0\"?>\r\n"
+        . "<dialog-info xmlns=\"urn:ietf:params:xml:ns:dialog-info\" version=\"{$lampVersion[$lamp]}\""
+        . " state=\"full\" entity=\"sip:$lamp@$host\">\r\n"
+        . "<dialog id=\"soak-$lamp\" direction=\"recipient\"><state>{$lamps[$lamp]}</state></dialog>\r\n"
+        . "</dialog-info>\r\n";
+}
+
+// One multipart/related NOTIFY body for some lamps of the list: RLMI root, then their dialog-info
+function list_notify(&$sub, $changed, $fullState, $subState = null) {
+    global $host;
+    $sub['version']++;
+    $rlmi = "<?xml version=\"1.0\"?>\r\n"
+        . "<list xmlns=\"urn:ietf:params:xml:ns:rlmi\" uri=\"sip:{$sub['user']}@$host\""
+        . " version=\"{$sub['version']}\" fullState=\"" . ($fullState ? 'true' : 'false') . "\">\r\n";
+    $parts = '';
+    foreach ($changed as $lamp) {
+        $rlmi .= "<resource uri=\"sip:$lamp@$host\"><instance id=\"i$lamp\" state=\"active\""
+            . " cid=\"$lamp@soak\"/></resource>\r\n";
+        $parts .= '--' . BOUNDARY . "\r\n"
+            . "Content-Type: application/dialog-info+xml\r\n"
+            . "Content-ID: <$lamp@soak>\r\n\r\n"
+            . dialog_info($lamp);
+    }
+    $rlmi .= "</list>\r\n";
+    $body = '--' . BOUNDARY . "\r\n"
+        . "Content-Type: application/rlmi+xml\r\n"
+        . "Content-ID: <list@soak>\r\n\r\n"
+        . $rlmi . $parts
+        . '--' . BOUNDARY . "--\r\n";
+    $type = 'multipart/related;type="application/rlmi+xml";start="<list@soak>";boundary="' . BOUNDARY . '"';
+    send_notify($sub, $subState ?? subscription_state($sub), $type, $body);
+}
+
+function notify_lamp($lamp) {
+    global $subs, $listSub, $lampSubs;
+    if ($listSub !== null && isset($subs[$listSub])) {
+        list_notify($subs[$listSub], [$lamp], false);
+    }
+    if (isset($lampSubs[$lamp], $subs[$lampSubs[$lamp]])) {
+        $sub = &$subs[$lampSubs[$lamp]];
+        send_notify($sub, subscription_state($sub), 'application/dialog-info+xml', dialog_info($lamp));
+    }
+}
+
+function on_subscribe($peer, $msg) {
+    global $subs, $lampSubs, $listSub, $lamps, $listUser, $host, $port, $stats;
+    $callId = header_value($msg, 'call-id');
+    if (stripos(header_value($msg, 'event'), 'dialog') !== 0) {
+        respond($peer, $msg, 489, 'Bad Event', ['Allow-Events: dialog']);
+        return;
+    }
+    $user = user_of($msg['uri']);
+    $isList = ($user === $listUser);
+    if (!$isList && !isset($lamps[$user])) {
+        respond($peer, $msg, 404, 'Not Found');
+        return;
+    }
+    $expiresHeader = header_value($msg, 'expires');
+    $expires = $expiresHeader === '' ? 3600 : (int)$expiresHeader;
+    $fresh = !isset($subs[$callId]);
+    if ($fresh) {
+        if ($expires === 0) {  // Fetch-and-forget or a late unsubscribe: nothing to keep
+            respond($peer, $msg, 200, 'OK', ['Expires: 0'], bin2hex(random_bytes(4)));
+            return;
+        }
+        $tag = bin2hex(random_bytes(4));
+        $subs[$callId] = [
+            'call_id' => $callId,
+            'peer' => $peer,
+            'user' => $user,
+            'list' => $isList,
+            'target' => uri_of(header_value($msg, 'contact')),
+            'local' => header_value($msg, 'to') . ";tag=$tag",
+            'remote' => header_value($msg, 'from'),
+            'tag' => $tag,
+            'cseq' => 0,
+            'version' => 0,
+            'expires_at' => 0,
+        ];
+        $stats['subscribe']++;
+    }
+    $sub = &$subs[$callId];
+    $sub['expires_at'] = time() + $expires;
+    $extra = ["Contact: <sip:$user@$host:$port>", "Expires: $expires"];
+    if ($isList) $extra[] = 'Require: eventlist';
+    respond($peer, $msg, 200, 'OK', $extra, $sub['tag']);
+
+    if ($expires === 0) {
+        $stats['unsubscribe']++;
+        if ($isList) {
+            list_notify($sub, [], true, 'terminated;reason=timeout');
+            $listSub = null;
+        } else {
+            send_notify($sub, 'terminated;reason=timeout', 'application/dialog-info+xml', dialog_info($user));
+            unset($lampSubs[$user]);
+        }
+        unset($subs[$callId]);
+        return;
+    }
+    if ($isList && !$fresh) {
+        list_notify($sub, [], false);  // Refresh: nothing changed since the last NOTIFY
+    } elseif ($isList) {
+        $listSub = $callId;
+        foreach (array_chunk(array_keys($lamps), CHUNK) as $i => $chunk) {
+            list_notify($sub, array_map('strval', $chunk), $i === 0);
+        }
+    } else {
+        $lampSubs[$user] = $callId;
+        send_notify($sub, subscription_state($sub), 'application/dialog-info+xml', dialog_info($user));
+    }
+}
+
+function on_invite($peer, $msg) {
+    global $calls, $host, $port, $rtpPort, $stats;
+    $callId = header_value($msg, 'call-id');
+    if (isset($calls[$callId])) {  // Retransmission: the 200 got lost
+        send_to($peer, $calls[$callId]['ok']);
+        return;
+    }
+    $stats['invite']++;
+    $tag = bin2hex(random_bytes(4));
+    $contact = ["Contact: <sip:pbx@$host:$port>"];
+    respond($peer, $msg, 100, 'Trying');
+    respond($peer, $msg, 180, 'Ringing', $contact, $tag);
+    $sessionId = time();
+    $sdp = "v=0\r\n"
+        . "o=soak $sessionId $sessionId IN IP4 $host\r\n"
+        . "s=soak\r\n"
+        . "c=IN IP4 $host\r\n"
+        . "t=0 0\r\n"
+        . "m=audio $rtpPort RTP/AVP 0 101\r\n"
+        . "a=rtpmap:0 PCMU/8000\r\n"
+        . "a=rtpmap:101 telephone-event/8000\r\n"
+        . "a=fmtp:101 0-16\r\n"
+        . "a=sendrecv\r\n";
+    // Kept so that a retransmitted INVITE gets the very same answer
+    $ok = build_response($msg, 200, 'OK', $contact, $tag, 'application/sdp', $sdp);
+    $calls[$callId] = ['ok' => $ok, 'acked' => false];
+    send_to($peer, $ok);
+}
+
+function on_request($peer, $msg) {
+    global $calls, $stats;
+    if (in_array($msg['method'], ['REGISTER', 'SUBSCRIBE', 'INVITE'], true)) {
+        $authUser = authenticate($peer, $msg);
+        if ($authUser === null) return;
+        if ($msg['method'] !== 'REGISTER') log_identity($msg, $authUser);
+    }
+    switch ($msg['method']) {
+        case 'REGISTER':
+            $stats['register']++;
+            $expires = header_value($msg, 'expires');
+            if ($expires === '' && preg_match('/;\s*expires=(\d+)/i', header_value($msg, 'contact'), $m)) {
+                $expires = $m[1];
+            }
+            $expires = $expires === '' ? '3600' : $expires;
+            $contact = header_value($msg, 'contact');
+            $extra = ["Expires: $expires"];
+            if ($contact !== '' && $contact !== '*') $extra[] = 'Contact: <' . uri_of($contact) . ">;expires=$expires";
+            respond($peer, $msg, 200, 'OK', $extra, bin2hex(random_bytes(4)));
+            break;
+        case 'SUBSCRIBE':
+            on_subscribe($peer, $msg);
+            break;
+        case 'INVITE':
+            on_invite($peer, $msg);
+            break;
+        case 'ACK':
+            $callId = header_value($msg, 'call-id');
+            if (isset($calls[$callId]) && !$calls[$callId]['acked']) {
+                $calls[$callId]['acked'] = true;
+                $stats['answered']++;
+            }
+            break;
+        case 'BYE':
+            $stats['bye']++;
+            unset($calls[header_value($msg, 'call-id')]);
+            respond($peer, $msg, 200, 'OK');
+            break;
+        case 'CANCEL':
+            respond($peer, $msg, 200, 'OK');
+            break;
+        default:
+            $stats['other_requests']++;
+            respond($peer, $msg, 200, 'OK');
+    }
+}
+
+function on_response($msg) {
+    global $subs, $lampSubs, $listSub, $stats;
+    if (stripos(header_value($msg, 'cseq'), 'NOTIFY') === false || $msg['status'] < 200) return;
+    if ($msg['status'] < 300) {
+        $stats['notify_ok']++;
+        return;
+    }
+    $stats['notify_failed']++;
+    $callId = header_value($msg, 'call-id');
+    if ($msg['status'] === 481 && isset($subs[$callId])) {  // Subscriber forgot the dialog
+        if ($subs[$callId]['list']) {
+            $listSub = null;
+        } else {
+            unset($lampSubs[$subs[$callId]['user']]);
+        }
+        unset($subs[$callId]);
+    }
+}
+
+function storm_tick() {
+    global $listSub, $lampSubs, $stormStart, $stormSent, $stormSeconds, $rate, $lamps, $lampVersion, $stats;
+    if ($stormStart === null) {
+        if ($listSub === null && count($lampSubs) === 0) return;
+        $stormStart = microtime(true);
+        fwrite(STDERR, "storm: $rate NOTIFY/s for {$stormSeconds}s\n");
+    }
+    $elapsed = microtime(true) - $stormStart;
+    if ($elapsed > $stormSeconds) return;
+    $due = min((int)($elapsed * $rate) - $stormSent, STORM_BURST);
+    $keys = array_keys($lamps);
+    for ($i = 0; $i < $due; $i++) {
+        $lamp = (string)$keys[mt_rand(0, count($keys) - 1)];
+        $next = DIALOG_STATES[mt_rand(0, count(DIALOG_STATES) - 1)];
+        if ($next === $lamps[$lamp]) $next = DIALOG_STATES[(array_search($next, DIALOG_STATES) + 1) % 3];
+        $lamps[$lamp] = $next;
+        $lampVersion[$lamp]++;
+        notify_lamp($lamp);
+        $stormSent++;
+        $stats['storm_notify']++;
+    }
+}
+
+function write_report() {
+    global $outDir, $stats, $lamps, $stormStart, $stormSeconds, $calls, $subs;
+    $storm = $stormStart === null ? 'idle' : (microtime(true) - $stormStart > $stormSeconds ? 'done' : 'running');
+    $report = "storm.state $storm\n";
+    foreach ($stats as $name => $value) $report .= "$name $value\n";
+    $report .= 'calls.open ' . count($calls) . "\n";
+    $report .= 'subscriptions.open ' . count($subs) . "\n";
+    file_put_contents("$outDir/pbx_report.txt.tmp", $report);
+    rename("$outDir/pbx_report.txt.tmp", "$outDir/pbx_report.txt");
+    $states = '';
+    foreach ($lamps as $lamp => $state) $states .= "$lamp " . ENGINE_STATES[$state] . "\n";
+    file_put_contents("$outDir/pbx_blf_states.txt", $states);
+}
+
+fwrite(STDERR, "standin_pbx: udp://$bind:$port as $host, list '$listUser' of $buddies lamps from $firstLamp\n");
+$startedAt = time();
+$lastReport = 0;
+while ($running) {
+    $read = [$sock, $rtp];
+    $write = null;
+    $except = null;
+    if (@stream_select($read, $write, $except, 0, 2000) === false) continue;  // EINTR on a signal
+    // One datagram per ready socket and turn: select returns at once while more are queued
+    foreach ($read as $ready) {
+        $data = stream_socket_recvfrom($ready, 65535, 0, $peer);
+        if ($data === false || $data === '') continue;
+        if ($ready === $rtp) {
+            $stats['rtp_packets']++;
+            continue;
+        }
+        $msg = parse_sip($data);
+        if ($msg === null) continue;
+        if (isset($msg['status'])) {
+            on_response($msg);
+        } else {
+            on_request($peer, $msg);
+        }
+    }
+    storm_tick();
+    if (time() - $lastReport >= REPORT_EVERY_S) {
+        write_report();
+        $lastReport = time();
+    }
+    if ($duration > 0 && time() - $startedAt >= $duration) break;
+}
+write_report();
+fwrite(STDERR, "standin_pbx: stopped\n");
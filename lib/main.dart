@@ -7,6 +7,7 @@ import 'theme/theme_controller.dart';
 import 'ui/dialpad_page.dart';
 import 'log/app_logger.dart';
 import 'voip/fcm_token_manager.dart';
+import 'voip/blf_state_manager.dart';
 import 'voip/fcm_token_sync.dart';
 import 'voip/voip_engine.dart';
 
@@ -45,6 +46,7 @@ class _VoipAppState extends State<VoipApp> with WidgetsBindingObserver {
     if (state == AppLifecycleState.resumed) {
       FcmTokenSync.instance.syncCachedToken();
       voipEngine.registerProvisioned();
+      BLFStateManager().resync(voipEngine);
     } else if (state == AppLifecycleState.inactive ||
         state == AppLifecycleState.paused ||
         state == AppLifecycleState.detached) {
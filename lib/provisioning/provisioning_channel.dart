@@ -35,6 +35,23 @@ class ProvisioningChannel {
     return null;
   }
 
+  /// URI de la liste de ressources BLF (RFC 4662) si le serveur en fournit une
+  static Future<String?> getBlfListUri() async {
+    final dump = await getProvisioningDump();
+    const candidateKeys = [
+      'blf_list_uri',
+      'rls_uri',
+    ];
+
+    for (final key in candidateKeys) {
+      final value = dump[key]?.trim();
+      if (value != null && value.isNotEmpty) {
+        return value;
+      }
+    }
+    return null;
+  }
+
   static Future<Map<String, String>> getProvisioningDump() async {
     final result = await _channel.invokeMethod<Map<dynamic, dynamic>>(
       'getProvisioningDump',
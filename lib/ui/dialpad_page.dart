@@ -37,6 +37,7 @@ class _DialpadPageState extends State<DialpadPage> {
   bool _isOpeningInCall = false;
   bool _showContactSearch = false;
   bool _isSearchingContacts = false;
+  bool _presenceErrorShown = false; // One message per page, a full table fails every remaining lamp
   bool _isSearchingFavorites = false;
   bool _isLoadingHistory = false;
   bool _historyLoaded = false;
@@ -113,50 +114,34 @@ class _DialpadPageState extends State<DialpadPage> {
     }
   }
 
-  Future<void> _subscribePresenceWithPrefix(String number) async {
+  Future<String> _presencePrefix() async {
     try {
-      final prefix = await ProvisioningChannel.getApiPrefixe();
-      print('>>> _subscribePresenceWithPrefix: number=$number, prefix=$prefix');
-      await widget.engine.subscribePresence(number, prefix: prefix ?? '');
-      print('>>> _subscribePresenceWithPrefix SUCCESS: $number');
+      return await ProvisioningChannel.getApiPrefixe() ?? '';
     } catch (e) {
-      print('>>> _subscribePresenceWithPrefix ERROR: $e (trying without prefix)');
-      try {
-        await widget.engine.subscribePresence(number);
-      } catch (e2) {
-        print('>>> _subscribePresenceWithPrefix FAILED (even without prefix): $e2');
-      }
+      print('>>> _presencePrefix ERROR: $e (subscribing without prefix)');
+      return '';
     }
   }
 
   /// Lancer les subscriptions de présence EN ARRIÈRE-PLAN (non-bloquant)
   Future<void> _subscribeAllPresenceInBackground(List<SavedContact> contacts) async {
     print('>>> _subscribeAllPresenceInBackground: subscribing to ${contacts.length} contacts');
-    // Lancer les subscriptions en parallèle avec un timeout par contact
-    final futures = contacts.map((contact) async {
-      try {
-        print('>>> BG: Subscribing to ${contact.number}...');
-        await _subscribePresenceWithPrefix(contact.number)
-            .timeout(const Duration(seconds: 5), onTimeout: () async {
-          print('>>> BG: Subscription timeout for ${contact.number}');
-        });
-        print('>>> BG: ✓ Subscribed to ${contact.number}');
-        AppLogger.instance.log('[BG] Subscribé à: ${contact.number}');
-      } catch (e) {
-        print('>>> BG: ✗ Error subscribing to ${contact.number}: $e');
-        AppLogger.instance.log('[BG] Erreur sub ${contact.number}: $e');
-      }
-    }).toList();
-    
-    // Attendre toutes les subscriptions (ou timeout global)
     try {
-      await Future.wait(futures)
-          .timeout(const Duration(seconds: 30), onTimeout: () {
+      final prefix = await _presencePrefix();
+      final numbers = contacts.map((contact) => contact.number).toList();
+      final listUri = await ProvisioningChannel.getBlfListUri();
+      // Une seule commande native pour toute la liste (au lieu d'un aller-retour par contact).
+      // Avec une liste RLS provisionnée: un seul SUBSCRIBE, repli par contact si le serveur refuse.
+      final subscription = listUri != null
+          ? widget.engine.subscribePresenceList(listUri, numbers, prefix: prefix)
+          : widget.engine.subscribePresenceBatch(numbers, prefix: prefix);
+      await subscription.timeout(const Duration(seconds: 30), onTimeout: () {
         print('>>> BG: Overall subscription timeout (30s)');
-        return [];
       });
+      AppLogger.instance.log('[BG] Subscribé à ${contacts.length} contact(s)');
     } catch (e) {
-      print('>>> BG: Error waiting for subscriptions: $e');
+      print('>>> BG: ✗ Error subscribing: $e');
+      AppLogger.instance.log('[BG] Erreur sub: $e');
     }
     print('>>> _subscribeAllPresenceInBackground: DONE');
   }
@@ -224,7 +209,7 @@ class _DialpadPageState extends State<DialpadPage> {
   void _listenRegistration() {
     _eventsSub = VoipEvents.stream.listen((event) {
       if (event is RegistrationEvent) {
-        final ok = event.statusText.contains('200');
+        final ok = event.statusCode == 200;
         if (mounted) setState(() => _isRegistered = ok);
         
         // IMPORTANT: Lancer les subscriptions de présence SEULEMENT après l'enregistrement réussi
@@ -320,6 +305,9 @@ class _DialpadPageState extends State<DialpadPage> {
         print('>>> Calling setState() to refresh UI');
         // Déclencher un refresh pour afficher les changements
         setState(() {});
+      } else if (event is PresenceErrorEvent && mounted && !_presenceErrorShown) {
+        _presenceErrorShown = true;
+        _showMessage('Voyant ${event.number} non suivi: ${event.message}');
       }
     });
   }
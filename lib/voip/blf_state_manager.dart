@@ -1,5 +1,6 @@
 import 'dart:async';
 import 'package:flutter/material.dart';
+import 'voip_engine.dart';
 import 'voip_events.dart';
 
 /// États possibles d'un contact BLF (Busy Lamp Field)
@@ -24,6 +25,9 @@ class BLFStateManager {
   // Map: numéro → état BLF
   final Map<String, BLFState> _stateMap = {};
   
+  // Version du cache natif déjà appliquée (0 = jamais synchronisé)
+  int _snapshotVersion = 0;
+  
   // Stream controller pour notifier les changements d'état
   final StreamController<BLFStateChanged> _stateController = 
       StreamController<BLFStateChanged>.broadcast();
@@ -71,6 +75,26 @@ class BLFStateManager {
     print('>>> BLFStateManager.handlePresenceEvent: updateState done');
   }
   
+  /// Resynchroniser tous les voyants en un seul appel (ex: retour au premier plan)
+  Future<void> resync(VoipEngine engine) async {
+    try {
+      final snapshot = await engine.getPresenceSnapshot(sinceVersion: _snapshotVersion);
+      if (snapshot == null) return;
+      if (snapshot.version < _snapshotVersion) {
+        // Moteur natif redémarré: son cache repart de zéro
+        _snapshotVersion = 0;
+        return resync(engine);
+      }
+      print('>>> BLFStateManager.resync: ${snapshot.entries.length} change(s) since v$_snapshotVersion → v${snapshot.version}');
+      for (final entry in snapshot.entries) {
+        updateState(entry.contact, entry.removed ? BLFState.offline : _parsePresenceState(entry.state));
+      }
+      _snapshotVersion = snapshot.version;
+    } catch (e) {
+      print('>>> BLFStateManager.resync ERROR: $e');
+    }
+  }
+  
   /// Convertir l'état de présence string en BLFState
   BLFState _parsePresenceState(String stateStr) {
     switch (stateStr.toLowerCase()) {
@@ -1,5 +1,7 @@
 import 'package:flutter/services.dart';
 
+import 'voip_native.dart';
+
 /// Flutter-facing VoIP bridge using a platform MethodChannel.
 class VoipEngine {
   const VoipEngine();
@@ -25,6 +27,7 @@ class VoipEngine {
 
   Future<void> unregister() => _invoke('unregister');
 
+  /// Completes with the native call id once the INVITE is sent; throws if it could not be.
   Future<String> makeCall(String callee) async {
     final result = await _invoke('makeCall', <String, dynamic>{'callee': callee});
     return result?.toString() ?? '-1';
@@ -65,20 +68,81 @@ class VoipEngine {
   Future<void> setMuted(bool enabled) =>
       _invoke('setMuted', <String, dynamic>{'enabled': enabled});
 
-  Future<void> sendDtmf(String callId, String digits) =>
-      _invoke('sendDtmf', <String, dynamic>{
+  Future<void> sendDtmf(String callId, String digits) async {
+    final native = VoipNative.instance;
+    final id = int.tryParse(callId);
+    if (native != null && id != null) {
+      _checkQueued('sendDtmf', native.sendDtmf(id, digits));
+      return;
+    }
+    await _invoke('sendDtmf', <String, dynamic>{
       'callId': callId,
       'digits': digits,
-      });
+    });
+  }
 
   Future<void> hangupCall(String callId) =>
       _invoke('hangupCall', <String, dynamic>{'callId': callId});
 
-  Future<void> subscribePresence(String contact, {String prefix = ''}) =>
-      _invoke('subscribePresence', <String, dynamic>{'contact': contact, 'prefix': prefix});
+  Future<void> subscribePresence(String contact, {String prefix = ''}) => subscribePresenceBatch([contact], prefix: prefix);
+
+  /// Subscribes a whole BLF list; over FFI this is a single native command.
+  Future<void> subscribePresenceBatch(List<String> contacts, {String prefix = ''}) async {
+    if (contacts.isEmpty) return;
+    final native = VoipNative.instance;
+    if (native != null) {
+      _checkQueued('subscribePresence', native.subscribeBatch(contacts, prefix: prefix));
+      return;
+    }
+    for (final contact in contacts) {
+      await _invoke('subscribePresence', <String, dynamic>{'contact': contact, 'prefix': prefix});
+    }
+  }
 
-  Future<void> unsubscribePresence(String contact) =>
-      _invoke('unsubscribePresence', <String, dynamic>{'contact': contact});
+  /// One RFC 4662 resource-list SUBSCRIBE for the whole panel; the native side falls back to
+  /// per-contact subscriptions of [contacts] when the server refuses the list.
+  Future<void> subscribePresenceList(String listUri, List<String> contacts, {String prefix = ''}) async {
+    final native = VoipNative.instance;
+    if (native != null) {
+      _checkQueued('subscribePresenceList', native.subscribeList(listUri, contacts, prefix: prefix));
+      return;
+    }
+    await _invoke('subscribePresenceList', <String, dynamic>{
+      'listUri': listUri,
+      'contacts': contacts,
+      'prefix': prefix,
+    });
+  }
+
+  Future<void> unsubscribePresence(String contact) async {
+    final native = VoipNative.instance;
+    if (native != null) {
+      _checkQueued('unsubscribePresence', native.unsubscribe(contact));
+      return;
+    }
+    await _invoke('unsubscribePresence', <String, dynamic>{'contact': contact});
+  }
+
+  /// Presence entries changed after [sinceVersion] (0 = everything), in one native call.
+  Future<PresenceSnapshot?> getPresenceSnapshot({int sinceVersion = 0}) async {
+    final result = await _invoke('getPresenceSnapshot', <String, dynamic>{'sinceVersion': sinceVersion});
+    if (result is! Map) return null;
+    return PresenceSnapshot.fromMap(result);
+  }
+
+  /// Most recent calls persisted by the native engine, newest first. Complete even for
+  /// calls that happened while no Flutter UI was running.
+  Future<List<CallLogEntry>> getRecentCalls({int count = 50}) async {
+    final result = await _invoke('getRecentCalls', <String, dynamic>{'count': count});
+    if (result is! List) return const [];
+    return result.map((e) => CallLogEntry.fromMap(e as Map<dynamic, dynamic>)).toList();
+  }
+
+  void _checkQueued(String method, int requestId) {
+    if (requestId < 0) {
+      throw Exception('VoIP method "$method" failed: native command could not be queued');
+    }
+  }
 
   Future<dynamic> _invoke(String method, [Map<String, dynamic>? arguments]) async {
     try {
@@ -91,3 +155,82 @@ class VoipEngine {
     }
   }
 }
+
+/// Delta of the native presence cache; pass [version] back to get the next one.
+class PresenceSnapshot {
+  PresenceSnapshot({required this.version, required this.entries});
+
+  final int version;
+  final List<PresenceSnapshotEntry> entries;
+
+  factory PresenceSnapshot.fromMap(Map<dynamic, dynamic> map) {
+    final raw = map['entries'] as List<dynamic>? ?? const [];
+    return PresenceSnapshot(
+      version: (map['version'] as num?)?.toInt() ?? 0,
+      entries: raw.map((e) => PresenceSnapshotEntry.fromMap(e as Map<dynamic, dynamic>)).toList(),
+    );
+  }
+}
+
+class PresenceSnapshotEntry {
+  PresenceSnapshotEntry({
+    required this.contact,
+    required this.state,
+    required this.source,
+    required this.updatedAt,
+    required this.removed,
+  });
+
+  final String contact;
+  final String state;
+  final String source; // notify_body, status_text, basic or subscription
+  final DateTime updatedAt;
+  final bool removed; // Unsubscribed since the previous snapshot
+
+  factory PresenceSnapshotEntry.fromMap(Map<dynamic, dynamic> map) => PresenceSnapshotEntry(
+        contact: map['contact'] as String? ?? '',
+        state: map['state'] as String? ?? 'offline',
+        source: map['source'] as String? ?? '',
+        updatedAt: DateTime.fromMicrosecondsSinceEpoch((map['updatedAtUs'] as num?)?.toInt() ?? 0),
+        removed: map['removed'] as bool? ?? false,
+      );
+}
+
+class CallLogEntry {
+  CallLogEntry({
+    required this.sequence,
+    required this.callId,
+    required this.incoming,
+    required this.number,
+    required this.displayName,
+    required this.statusCode,
+    required this.reason,
+    required this.startedAt,
+    required this.setupTime,
+    required this.talkTime,
+  });
+
+  final int sequence; // Append order in the native log
+  final String callId;
+  final bool incoming;
+  final String number;
+  final String displayName;
+  final int statusCode; // Final SIP status
+  final String reason;
+  final DateTime startedAt;
+  final Duration setupTime;
+  final Duration talkTime; // Zero when never answered
+
+  factory CallLogEntry.fromMap(Map<dynamic, dynamic> map) => CallLogEntry(
+        sequence: (map['sequence'] as num?)?.toInt() ?? 0,
+        callId: map['callId'] as String? ?? '',
+        incoming: map['direction'] == 'incoming',
+        number: map['number'] as String? ?? '',
+        displayName: map['displayName'] as String? ?? '',
+        statusCode: (map['statusCode'] as num?)?.toInt() ?? 0,
+        reason: map['reason'] as String? ?? '',
+        startedAt: DateTime.fromMillisecondsSinceEpoch((map['startedAt'] as num?)?.toInt() ?? 0),
+        setupTime: Duration(milliseconds: (map['setupMs'] as num?)?.toInt() ?? 0),
+        talkTime: Duration(milliseconds: (map['talkMs'] as num?)?.toInt() ?? 0),
+      );
+}
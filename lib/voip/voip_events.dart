@@ -3,6 +3,8 @@ import 'dart:developer' as developer;
 
 import 'package:flutter/services.dart';
 
+import 'voip_native.dart';
+
 const EventChannel _eventChannel = EventChannel('voip_events');
 
 /// Base class for all VoIP platform events.
@@ -22,6 +24,7 @@ sealed class VoipEvent {
         );
       case 'registration':
         return RegistrationEvent(
+          statusCode: map['statusCode'] as int? ?? 0,
           statusText: map['message'] as String? ?? '',
         );
       case 'call_connected':
@@ -40,6 +43,7 @@ sealed class VoipEvent {
       case 'call_ended':
         return CallEndedEvent(
           callId: map['callId'] as String? ?? '',
+          statusCode: map['statusCode'] as int? ?? 0,
           reason: map['reason'] as String?,
         );
       case 'bluetooth_available':
@@ -54,11 +58,27 @@ sealed class VoipEvent {
         );
       case 'navigate_to_call_history':
         return NavigateToCallHistoryEvent();
+      case 'call_summary':
+        return CallSummaryEvent(
+          callId: map['callId'] as String? ?? '',
+          incoming: map['direction'] == 'incoming',
+          number: map['number'] as String? ?? '',
+          statusCode: map['statusCode'] as int? ?? 0,
+          startedAt: DateTime.fromMillisecondsSinceEpoch(map['startedAt'] as int? ?? 0),
+          setupTime: Duration(milliseconds: map['setupMs'] as int? ?? 0),
+          talkTime: Duration(milliseconds: map['talkMs'] as int? ?? 0),
+        );
       case 'presence_state':
         return PresenceStateEvent(
           number: map['number'] as String? ?? '',
           state: map['state'] as String? ?? 'offline',
         );
+      case 'presence_error':
+        return PresenceErrorEvent(
+          number: map['number'] as String? ?? '',
+          status: map['status'] as int? ?? 0,
+          message: map['message'] as String? ?? '',
+        );
       default:
         throw PlatformException(
           code: 'UNKNOWN_EVENT',
@@ -96,15 +116,38 @@ class CallRingingEvent extends VoipEvent {
 
 class CallEndedEvent extends VoipEvent {
   final String callId;
+  final int statusCode; // SIP status of the end of the call, 0 if unknown
   final String? reason;
 
-  const CallEndedEvent({required this.callId, this.reason});
+  const CallEndedEvent({required this.callId, this.statusCode = 0, this.reason});
+}
+
+/// CDR-style record sent by the engine after [CallEndedEvent].
+class CallSummaryEvent extends VoipEvent {
+  final String callId;
+  final bool incoming;
+  final String number;
+  final int statusCode; // Final SIP status
+  final DateTime startedAt;
+  final Duration setupTime; // INVITE -> answer, or -> end when never answered
+  final Duration talkTime; // Zero when never answered
+
+  const CallSummaryEvent({
+    required this.callId,
+    required this.incoming,
+    required this.number,
+    required this.statusCode,
+    required this.startedAt,
+    required this.setupTime,
+    required this.talkTime,
+  });
 }
 
 class RegistrationEvent extends VoipEvent {
+  final int statusCode; // SIP status of the last REGISTER
   final String statusText;
 
-  const RegistrationEvent({required this.statusText});
+  const RegistrationEvent({this.statusCode = 0, required this.statusText});
 }
 
 class BluetoothAvailabilityEvent extends VoipEvent {
@@ -132,13 +175,24 @@ class PresenceStateEvent extends VoipEvent {
   const PresenceStateEvent({required this.number, required this.state});
 }
 
+/// A BLF contact the engine could not subscribe, e.g. its buddy table is full.
+class PresenceErrorEvent extends VoipEvent {
+  final String number;
+  final int status; // Native pj_status_t
+  final String message;
+
+  const PresenceErrorEvent({required this.number, required this.status, required this.message});
+}
+
 /// Exposes a broadcast stream of platform VoIP events.
 class VoipEvents {
   VoipEvents._();
 
   static Stream<VoipEvent>? _cached;
 
-  static Stream<VoipEvent> get stream => _cached ??= _eventChannel
+  static Stream<VoipEvent> get stream => _cached ??= _merge(_channelStream(), VoipNative.instance?.events);
+
+  static Stream<VoipEvent> _channelStream() => _eventChannel
       .receiveBroadcastStream()
       .map((event) => VoipEvent.fromMap(event as Map<dynamic, dynamic>))
       .handleError((error) {
@@ -146,4 +200,25 @@ class VoipEvents {
     if (error is PlatformException) throw error;
     throw PlatformException(code: 'VOIP_EVENT_ERROR', message: '$error');
   });
+
+  // BLF presence arrives over FFI when available, everything else over the EventChannel
+  static Stream<VoipEvent> _merge(Stream<VoipEvent> channel, Stream<VoipEvent>? native) {
+    if (native == null) return channel;
+    final subscriptions = <StreamSubscription<VoipEvent>>[];
+    late final StreamController<VoipEvent> controller;
+    controller = StreamController<VoipEvent>.broadcast(
+      onListen: () {
+        subscriptions
+          ..add(channel.listen(controller.add, onError: controller.addError))
+          ..add(native.listen(controller.add, onError: controller.addError));
+      },
+      onCancel: () {
+        for (final subscription in subscriptions) {
+          subscription.cancel();
+        }
+        subscriptions.clear();
+      },
+    );
+    return controller.stream;
+  }
 }
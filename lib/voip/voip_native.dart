@@ -0,0 +1,208 @@
+import 'dart:async';
+import 'dart:convert';
+import 'dart:developer' as developer;
+import 'dart:ffi';
+import 'dart:io';
+import 'dart:isolate';
+import 'dart:typed_data';
+
+import 'package:ffi/ffi.dart';
+
+import 'voip_events.dart';
+
+typedef _VersionC = Int32 Function();
+typedef _VersionDart = int Function();
+typedef _PostCObject = NativeFunction<Int8 Function(Int64, Pointer<Dart_CObject>)>;
+typedef _AttachC = Int32 Function(Pointer<_PostCObject>, Int64);
+typedef _AttachDart = int Function(Pointer<_PostCObject>, int);
+typedef _DetachC = Void Function();
+typedef _DetachDart = void Function();
+typedef _PollC = Int64 Function(Pointer<Uint8>, Int64);
+typedef _PollDart = int Function(Pointer<Uint8>, int);
+typedef _StringCommandC = Int64 Function(Pointer<Uint8>);
+typedef _StringCommandDart = int Function(Pointer<Uint8>);
+typedef _DtmfC = Int64 Function(Int32, Pointer<Uint8>);
+typedef _DtmfDart = int Function(int, Pointer<Uint8>);
+typedef _BatchC = Int64 Function(Pointer<Pointer<Uint8>>, Int32, Pointer<Uint8>);
+typedef _BatchDart = int Function(Pointer<Pointer<Uint8>>, int, Pointer<Uint8>);
+typedef _ListC = Int64 Function(Pointer<Uint8>, Pointer<Pointer<Uint8>>, Int32, Pointer<Uint8>);
+typedef _ListDart = int Function(Pointer<Uint8>, Pointer<Pointer<Uint8>>, int, Pointer<Uint8>);
+
+/// Direct FFI binding to the native engine core (android/app/src/main/cpp/voip_capi.h).
+///
+/// BLF presence events are read from a native ring without going through JNI, Kotlin and
+/// the EventChannel; presence and DTMF commands skip the MethodChannel. Everything that
+/// needs telecom (placing and answering calls, audio routing) stays on [VoipEngine]'s
+/// MethodChannel. [instance] is null off Android or when the native library does not
+/// match this binding.
+class VoipNative {
+  VoipNative._(DynamicLibrary lib)
+      : _attach = lib.lookupFunction<_AttachC, _AttachDart>('cv_attach_events'),
+        _detach = lib.lookupFunction<_DetachC, _DetachDart>('cv_detach_events'),
+        _poll = lib.lookupFunction<_PollC, _PollDart>('cv_poll_events'),
+        _sendDtmf = lib.lookupFunction<_DtmfC, _DtmfDart>('cv_send_dtmf'),
+        _subscribeBatch = lib.lookupFunction<_BatchC, _BatchDart>('cv_subscribe_batch'),
+        _subscribeList = lib.lookupFunction<_ListC, _ListDart>('cv_subscribe_list'),
+        _unsubscribe = lib.lookupFunction<_StringCommandC, _StringCommandDart>('cv_unsubscribe');
+
+  static const int _abiVersion = 2; // CV_ABI_VERSION
+  static const int _schemaVersion = 1; // voip_events::kSchemaVersion
+  static const int _pollBufferSize = 64 * 1024;
+  static const int _recordHeaderSize = 48;
+  static const int _evPresenceUpdated = 8;
+  static const int _evPresenceError = 12;
+
+  static final VoipNative? instance = _load();
+
+  final _AttachDart _attach;
+  final _DetachDart _detach;
+  final _PollDart _poll;
+  final _DtmfDart _sendDtmf;
+  final _BatchDart _subscribeBatch;
+  final _ListDart _subscribeList;
+  final _StringCommandDart _unsubscribe;
+
+  ReceivePort? _port;
+  Pointer<Uint8>? _pollBuffer;
+  late final StreamController<VoipEvent> _events = StreamController<VoipEvent>.broadcast(
+    onListen: _startEvents,
+    onCancel: _stopEvents,
+  );
+
+  static VoipNative? _load() {
+    if (!Platform.isAndroid) return null;
+    try {
+      final lib = DynamicLibrary.open('libvoip_engine.so');
+      final abi = lib.lookupFunction<_VersionC, _VersionDart>('cv_abi_version')();
+      final schema = lib.lookupFunction<_VersionC, _VersionDart>('cv_event_schema_version')();
+      if (abi != _abiVersion || schema != _schemaVersion) {
+        developer.log('Native ABI v$abi / schema v$schema, expected v$_abiVersion / v$_schemaVersion: FFI disabled',
+            name: 'VoipNative');
+        return null;
+      }
+      return VoipNative._(lib);
+    } catch (e) {
+      developer.log('FFI binding unavailable: $e', name: 'VoipNative');
+      return null;
+    }
+  }
+
+  /// Presence events straight from the native ring. While listened to, the native side
+  /// stops sending them through Kotlin.
+  Stream<VoipEvent> get events => _events.stream;
+
+  int sendDtmf(int callId, String digits) => _withString(digits, (p) => _sendDtmf(callId, p));
+
+  int unsubscribe(String contact) => _withString(contact, _unsubscribe);
+
+  /// Subscribes every contact in one engine command; returns the request id or -1.
+  int subscribeBatch(List<String> contacts, {String prefix = ''}) {
+    if (contacts.isEmpty) return -1;
+    return _withStringArray(contacts, prefix, (array, count, nativePrefix) => _subscribeBatch(array, count, nativePrefix));
+  }
+
+  /// One RFC 4662 SUBSCRIBE to [listUri]; [contacts] are the per-buddy fallback.
+  int subscribeList(String listUri, List<String> contacts, {String prefix = ''}) {
+    return _withString(
+      listUri,
+      (uri) => _withStringArray(contacts, prefix, (array, count, nativePrefix) => _subscribeList(uri, array, count, nativePrefix)),
+    );
+  }
+
+  static int _withStringArray(
+    List<String> values,
+    String prefix,
+    int Function(Pointer<Pointer<Uint8>>, int, Pointer<Uint8>) body,
+  ) {
+    final array = calloc<Pointer<Uint8>>(values.isEmpty ? 1 : values.length);
+    final strings = values.map(_toNative).toList();
+    final nativePrefix = _toNative(prefix);
+    try {
+      for (var i = 0; i < strings.length; i++) {
+        array[i] = strings[i];
+      }
+      return body(array, strings.length, nativePrefix);
+    } finally {
+      for (final s in strings) {
+        malloc.free(s);
+      }
+      malloc.free(nativePrefix);
+      calloc.free(array);
+    }
+  }
+
+  void _startEvents() {
+    final port = ReceivePort('voip_native_events');
+    _pollBuffer = malloc<Uint8>(_pollBufferSize);
+    port.listen((_) => _drain());
+    _port = port;
+    if (_attach(NativeApi.postCObject, port.sendPort.nativePort) != 0) {
+      developer.log('cv_attach_events failed', name: 'VoipNative');
+    }
+    // Whatever was written while no port was attached
+    _drain();
+  }
+
+  void _stopEvents() {
+    _detach();
+    _port?.close();
+    _port = null;
+    final buffer = _pollBuffer;
+    _pollBuffer = null;
+    if (buffer != null) malloc.free(buffer);
+  }
+
+  void _drain() {
+    final buffer = _pollBuffer;
+    if (buffer == null) return;
+    while (true) {
+      final length = _poll(buffer, _pollBufferSize);
+      if (length <= 0) return;
+      _decode(ByteData.sublistView(buffer.asTypedList(length)));
+    }
+  }
+
+  // Record layout: see voip_events.h
+  void _decode(ByteData data) {
+    var offset = 0;
+    while (offset + _recordHeaderSize <= data.lengthInBytes) {
+      final size = data.getUint16(offset, Endian.little);
+      if (size < _recordHeaderSize) return;
+      final type = data.getUint8(offset + 2);
+      final stringCount = data.getUint8(offset + 3);
+      final strings = <String>[];
+      var pos = offset + _recordHeaderSize;
+      for (var i = 0; i < stringCount; i++) {
+        final len = data.getUint16(pos, Endian.little);
+        strings.add(utf8.decode(Uint8List.sublistView(data, pos + 2, pos + 2 + len), allowMalformed: true));
+        pos += 2 + len;
+      }
+      if (type == _evPresenceUpdated && strings.length >= 2 && strings[0].isNotEmpty) {
+        _events.add(PresenceStateEvent(number: strings[0], state: strings[1]));
+      } else if (type == _evPresenceError && strings.length >= 2) {
+        final status = data.getInt32(offset + 12, Endian.little);
+        _events.add(PresenceErrorEvent(number: strings[0], status: status, message: strings[1]));
+      }
+      offset += size;
+    }
+  }
+
+  static int _withString(String value, int Function(Pointer<Uint8>) body) {
+    final p = _toNative(value);
+    try {
+      return body(p);
+    } finally {
+      malloc.free(p);
+    }
+  }
+
+  // Null-terminated UTF-8 copy in native memory; the caller frees it
+  static Pointer<Uint8> _toNative(String value) {
+    final bytes = utf8.encode(value);
+    final p = malloc<Uint8>(bytes.length + 1);
+    final view = p.asTypedList(bytes.length + 1);
+    view.setAll(0, bytes);
+    view[bytes.length] = 0;
+    return p;
+  }
+}